@@ -0,0 +1,226 @@
+/**
+ * @file align-sim.c
+ * @desc Checks the sensor alignment stage against the true altitude of
+ *       simulated flights
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef SENSOR_ALIGN_SIM_MAIN
+
+#include "flight-sim.h"
+#include "sensor-align.h"
+#include "host-sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Number of simulation steps remembered for comparison with the aligned
+    samples, must be a power of two and cover the time by which the aligned
+    samples lag the simulation */
+#define ALIGN_SIM_HISTORY   128
+
+/** State of the simulation at one step */
+struct align_sim_step {
+    uint32_t time;
+    /** True altitude in meters */
+    float altitude;
+    /** Altitude of the most recent reading on the deployment service's topic,
+        which is what the deployment service works from without alignment */
+    ms5611_alt_t held;
+    /** Acceleration sample taken at this step */
+    int16_t accel[3];
+};
+
+/** Error of the aligned and the held altitude over the timeline points */
+struct align_sim_result {
+    uint32_t points;
+    double aligned_sum;
+    double aligned_max;
+    double held_sum;
+    double held_max;
+    /** Aligned samples whose acceleration is not the sample taken at that
+        time */
+    uint32_t accel_mismatches;
+    uint32_t overruns;
+};
+
+/** Sink context which feeds the alignment stage from the board's topics */
+struct align_sim_recorder {
+    struct flight_sim_board *board;
+    struct sensor_align_desc_t align;
+    struct sensor_bus_cursor baro_cursor;
+    struct sensor_bus_cursor imu_cursor;
+    ms5611_alt_t held;
+    struct align_sim_step history[ALIGN_SIM_HISTORY];
+    struct align_sim_result *result;
+};
+
+static double align_sim_meters(ms5611_alt_t altitude)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return (double)altitude / 65536.0;
+#else
+    return (double)altitude;
+#endif
+}
+
+static void align_sim_error(double error, double *sum, double *max)
+{
+    error = fabs(error);
+    *sum += error;
+    *max = (error > *max) ? error : *max;
+}
+
+static void align_sim_sink(void *context, const struct flight_sim *sim,
+                           int new_baro)
+{
+    struct align_sim_recorder *const r = context;
+
+    flight_sim_replay_sink(&r->board->replay, sim, new_baro);
+
+    // Fed the same way as the variant's main loop does
+    const struct ms5611_sample *baro;
+    while ((baro = sensor_bus_peek(&r->baro_cursor)) != NULL) {
+        sensor_align_push_baro(&r->align, baro->time, baro->altitude);
+        r->held = baro->altitude;
+        sensor_bus_advance(&r->baro_cursor);
+    }
+    const struct mpu9250_sample *imu;
+    while ((imu = sensor_bus_peek(&r->imu_cursor)) != NULL) {
+        sensor_align_push_imu(&r->align, imu->time, imu->accel[0],
+                              imu->accel[1], imu->accel[2]);
+        sensor_bus_advance(&r->imu_cursor);
+    }
+
+    struct align_sim_step *const step =
+                            &r->history[sim->steps & (ALIGN_SIM_HISTORY - 1)];
+    step->time = sim->time;
+    step->altitude = sim->altitude[0];
+    step->held = r->held;
+    for (uint32_t k = 0; k < 3; k++) {
+        step->accel[k] = sim->accel[k * sim->count];
+    }
+
+    const struct sensor_align_sample *s;
+    while ((s = sensor_align_read(&r->align)) != NULL) {
+        const uint32_t n = (uint32_t)(((uint64_t)s->time *
+                                       sim->config.imu_odr) / 1000);
+        const struct align_sim_step *const at =
+                                    &r->history[n & (ALIGN_SIM_HISTORY - 1)];
+        if (at->time != s->time) {
+            // Not a step time or no longer remembered
+            continue;
+        }
+        struct align_sim_result *const result = r->result;
+        result->points++;
+        align_sim_error(align_sim_meters(s->altitude) - at->altitude,
+                        &result->aligned_sum, &result->aligned_max);
+        align_sim_error(align_sim_meters(at->held) - at->altitude,
+                        &result->held_sum, &result->held_max);
+        if ((s->accel[0] != at->accel[0]) || (s->accel[1] != at->accel[1]) ||
+                (s->accel[2] != at->accel[2])) {
+            result->accel_mismatches++;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    static struct flight_sim_board board;
+    static struct align_sim_recorder recorder = { .board = &board };
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .accel_noise = 0.05f, .accel_bias = 0.05f,
+        .gyro_noise = 0.1f, .gyro_bias = 1.0f, .roll_rate = 60.0f,
+        .temperature = 25.0f, .accel_fsr = IMU_ACCEL_FSR,
+        .gyro_fsr = IMU_GYRO_FSR, .imu_odr = IMU_AG_SAMPLE_RATE,
+        .baro_period = ALTIMETER_PERIOD, .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 10;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    struct align_sim_result result = { 0 };
+    recorder.result = &result;
+    for (uint32_t f = 0; f < flights; f++) {
+        struct flight_sim sim;
+        config.pad_time = 10.0f + (0.0137f * (float)f);
+        millis = 0;
+        if (init_flight_sim(&sim, &config, 1, seed + f) != 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        init_flight_sim_board(&board, &config);
+
+        // The replay timestamps each sample when it is taken. The vote's
+        // fused reading is stamped with the newest of the staggered readings
+        // it is taken from, while it follows the middle one, which is the
+        // latency to correct.
+        const uint32_t num_baro = flight_sim_num_baro(&config);
+        const int16_t baro_offset = -(int16_t)(((num_baro - 1) *
+                                                (config.baro_period /
+                                                 num_baro)) / 2);
+        init_sensor_align(&recorder.align, SENSOR_ALIGN_PERIOD, baro_offset,
+                          0);
+        init_sensor_bus_cursor(&recorder.baro_cursor,
+                               (board.replay.vote != NULL) ?
+                                    &board.vote_topic :
+                                    &board.altimeter_topic[0]);
+        init_sensor_bus_cursor(&recorder.imu_cursor, &board.imu_topic);
+        recorder.held = MS5611_ALT(0);
+
+        flight_sim_run(&sim, (uint32_t)((config.pad_time + 400.0f) * 1000),
+                       align_sim_sink, &recorder);
+        flight_sim_free(&sim);
+        result.overruns += recorder.align.overruns;
+    }
+
+    printf("%u flights, altimeters every %u ms, timeline every %u ms\n",
+           (unsigned)flights, (unsigned)ALTIMETER_PERIOD,
+           (unsigned)SENSOR_ALIGN_PERIOD);
+    if (result.points == 0) {
+        fprintf(stderr, "no aligned samples\n");
+        return 1;
+    }
+    printf("  %10s %10s %10s\n", "altitude", "mean (m)", "max (m)");
+    printf("  %10s %10.3f %10.3f\n", "aligned",
+           result.aligned_sum / result.points, result.aligned_max);
+    printf("  %10s %10.3f %10.3f\n", "held",
+           result.held_sum / result.points, result.held_max);
+    printf("%u points, %u acceleration mismatches, %u overruns\n",
+           (unsigned)result.points, (unsigned)result.accel_mismatches,
+           (unsigned)result.overruns);
+
+    if ((result.accel_mismatches != 0) || (result.overruns != 0) ||
+            (result.aligned_sum >= result.held_sum)) {
+        fprintf(stderr, "aligned samples are no better than the most recent "
+                "reading\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
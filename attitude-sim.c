@@ -0,0 +1,252 @@
+/**
+ * @file attitude-sim.c
+ * @desc Checks the batch attitude estimator against the scalar one on
+ *       simulated flights
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef ATTITUDE_SIM_MAIN
+
+#ifndef ATTITUDE_HOST_BATCH
+/* Build this file and attitude.c with -DATTITUDE_HOST_BATCH -O3
+   -fno-math-errno */
+#error "attitude-sim.c needs ATTITUDE_HOST_BATCH"
+#endif
+
+#include "flight-sim.h"
+#include "attitude.h"
+#include "host-sim.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Largest difference in any quaternion component or in the cosine of the
+    tilt between the batch and the scalar estimate */
+#define ATTITUDE_SIM_TOLERANCE  1e-4f
+
+#define RAD_TO_DEG 57.29577951308232
+
+/** Comparison of the two versions over a batch of flights */
+struct attitude_sim_result {
+    /** Flight samples updated by each version */
+    uint64_t updates;
+    double scalar_ns;
+    double batch_ns;
+    /** Largest difference between the versions */
+    float q_diff;
+    float cos_tilt_diff;
+    /** Smallest cosine of the tilt estimated by the scalar version, the
+        simulated flights stay vertical so this is the tilt error */
+    float cos_tilt_min;
+};
+
+static double attitude_sim_elapsed(const struct timespec *start,
+                                   const struct timespec *end)
+{
+    return (((double)(end->tv_sec - start->tv_sec) * 1e9) +
+            (double)(end->tv_nsec - start->tv_nsec));
+}
+
+static float attitude_sim_max(float max, float a, float b)
+{
+    const float diff = fabsf(a - b);
+    return (diff > max) ? diff : max;
+}
+
+/**
+ *  Replay a batch of flights through one scalar estimator per flight and
+ *  through the batch estimator. Both are fed the same way as the deployment
+ *  service feeds the scalar one: seeded on the pad, given the gyro bias
+ *  averaged on the pad and launched at ignition.
+ */
+static int attitude_sim_run(const struct flight_sim_config *config,
+                            uint32_t flights, uint32_t seed, float duration,
+                            struct attitude_sim_result *result)
+{
+    struct flight_sim sim;
+    struct attitude_batch batch;
+    struct mpu9250_desc_t imu = { .accel_fsr = config->accel_fsr,
+                                  .gyro_fsr = config->gyro_fsr };
+
+    if (init_flight_sim(&sim, config, flights, seed) != 0) {
+        return 1;
+    }
+    struct attitude_desc_t *const scalar = calloc(flights, sizeof(*scalar));
+    double *const gyro_sum = calloc(3 * (size_t)flights, sizeof(double));
+    if ((scalar == NULL) || (gyro_sum == NULL) ||
+            (init_attitude_batch(&batch, flights, &imu,
+                                 config->imu_odr) != 0)) {
+        free(scalar);
+        free(gyro_sum);
+        flight_sim_free(&sim);
+        return 1;
+    }
+    for (uint32_t i = 0; i < flights; i++) {
+        init_attitude(&scalar[i], &imu, config->imu_odr);
+    }
+
+    const int16_t *const ax = sim.accel;
+    const int16_t *const ay = &sim.accel[flights];
+    const int16_t *const az = &sim.accel[2 * flights];
+    const int16_t *const gx = sim.gyro;
+    const int16_t *const gy = &sim.gyro[flights];
+    const int16_t *const gz = &sim.gyro[2 * flights];
+    struct mpu9250_sample sample = { 0 };
+
+    // On the pad only the scalar version is run, since the batch version has
+    // no pad seeding
+    const uint32_t ignition = (uint32_t)(config->pad_time * 1000);
+    uint32_t pad_samples = 0;
+    while (sim.time < ignition) {
+        flight_sim_step(&sim);
+        for (uint32_t i = 0; i < flights; i++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                sample.accel[k] = sim.accel[(k * flights) + i];
+                sample.gyro[k] = sim.gyro[(k * flights) + i];
+                gyro_sum[(k * flights) + i] += sample.gyro[k];
+            }
+            attitude_update(&scalar[i], &sample);
+        }
+        pad_samples++;
+    }
+
+    // Launch, after which both versions run the same step
+    for (uint32_t i = 0; i < flights; i++) {
+        float bias[3];
+        for (uint32_t k = 0; k < 3; k++) {
+            bias[k] = (float)(gyro_sum[(k * flights) + i] / pad_samples);
+        }
+        attitude_set_gyro_bias(&scalar[i], bias);
+        attitude_launch(&scalar[i]);
+
+        batch.qw[i] = scalar[i].q[0];
+        batch.qx[i] = scalar[i].q[1];
+        batch.qy[i] = scalar[i].q[2];
+        batch.qz[i] = scalar[i].q[3];
+        batch.bias_x[i] = scalar[i].bias[0];
+        batch.bias_y[i] = scalar[i].bias[1];
+        batch.bias_z[i] = scalar[i].bias[2];
+    }
+
+    *result = (struct attitude_sim_result){ .cos_tilt_min = 1.0f };
+    const uint32_t end = ignition + (uint32_t)(duration * 1000);
+    while (sim.time < end) {
+        flight_sim_step(&sim);
+
+        struct timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        for (uint32_t i = 0; i < flights; i++) {
+            for (uint32_t k = 0; k < 3; k++) {
+                sample.accel[k] = sim.accel[(k * flights) + i];
+                sample.gyro[k] = sim.gyro[(k * flights) + i];
+            }
+            attitude_update(&scalar[i], &sample);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        attitude_batch_update(&batch, ax, ay, az, gx, gy, gz);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        result->scalar_ns += attitude_sim_elapsed(&t0, &t1);
+        result->batch_ns += attitude_sim_elapsed(&t1, &t2);
+        result->updates += flights;
+
+        for (uint32_t i = 0; i < flights; i++) {
+            const float *const q = scalar[i].q;
+            float d = result->q_diff;
+            d = attitude_sim_max(d, q[0], batch.qw[i]);
+            d = attitude_sim_max(d, q[1], batch.qx[i]);
+            d = attitude_sim_max(d, q[2], batch.qy[i]);
+            d = attitude_sim_max(d, q[3], batch.qz[i]);
+            result->q_diff = d;
+
+            const float cos_tilt = attitude_cos_tilt(&scalar[i]);
+            result->cos_tilt_diff = attitude_sim_max(result->cos_tilt_diff,
+                                                     cos_tilt,
+                                                     batch.cos_tilt[i]);
+            result->cos_tilt_min = ((cos_tilt < result->cos_tilt_min) ?
+                                    cos_tilt : result->cos_tilt_min);
+        }
+    }
+
+    attitude_batch_free(&batch);
+    free(scalar);
+    free(gyro_sum);
+    flight_sim_free(&sim);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .accel_noise = 0.05f, .accel_bias = 0.05f,
+        .gyro_noise = 0.1f, .gyro_bias = 1.0f, .roll_rate = 60.0f,
+        .temperature = 25.0f, .accel_fsr = IMU_ACCEL_FSR,
+        .gyro_fsr = IMU_GYRO_FSR, .imu_odr = IMU_AG_SAMPLE_RATE,
+        .baro_period = ALTIMETER_PERIOD, .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 1000;
+    uint32_t seed = 1;
+    float duration = 120.0f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:t:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                flights = (flights == 0) ? 1 : flights;
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 't':
+                duration = strtof(optarg, NULL);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] [-s seed] "
+                        "[-t seconds after ignition]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    struct attitude_sim_result r;
+    if (attitude_sim_run(&config, flights, seed, duration, &r) != 0) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    if (r.updates == 0) {
+        fprintf(stderr, "no samples after ignition\n");
+        return 1;
+    }
+
+    printf("%u flights, %.0f s after ignition at %u Hz, %.1f deg/s gyro "
+           "bias, %.0f deg/s roll\n", (unsigned)flights, (double)duration,
+           (unsigned)config.imu_odr, (double)config.gyro_bias,
+           (double)config.roll_rate);
+    printf("  %8s %16s\n", "", "ns/flight-sample");
+    printf("  %8s %16.2f\n", "scalar", r.scalar_ns / (double)r.updates);
+    printf("  %8s %16.2f\n", "batch", r.batch_ns / (double)r.updates);
+    printf("largest difference: %g in q, %g in cos(tilt)\n",
+           (double)r.q_diff, (double)r.cos_tilt_diff);
+    printf("largest tilt error: %.2f deg\n",
+           acos((r.cos_tilt_min < -1.0f) ? -1.0 : (double)r.cos_tilt_min) *
+           RAD_TO_DEG);
+
+    if ((r.q_diff > ATTITUDE_SIM_TOLERANCE) ||
+            (r.cos_tilt_diff > ATTITUDE_SIM_TOLERANCE)) {
+        fprintf(stderr, "the batch estimator does not match the scalar "
+                "estimator\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,283 @@
+/**
+ * @file attitude.c
+ * @desc Quaternion attitude estimator fed by every IMU sample
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "attitude.h"
+
+#include <math.h>
+#include <float.h>
+
+#ifdef ATTITUDE_HOST_BATCH
+#include <stdlib.h>
+#endif
+
+#define DEG_TO_RAD 0.017453292519943295f
+
+static void attitude_gains(struct attitude_gains *gains,
+                           const struct mpu9250_desc_t *imu,
+                           uint16_t sample_rate)
+{
+    // mpu9250_gyro_sensitivity() is in LSB per 1000 dps
+    const float gyro_scale = ((1000.0f * DEG_TO_RAD) /
+                              (float)mpu9250_gyro_sensitivity(imu));
+    const float dt = 1.0f / (float)sample_rate;
+
+    gains->half_gyro_step = 0.5f * dt * gyro_scale;
+    gains->accel_scale = 1.0f / (float)mpu9250_accel_sensitivity(imu);
+    gains->kp = ATTITUDE_KP / gyro_scale;
+    gains->ki = (ATTITUDE_KI * dt) / gyro_scale;
+    gains->gate_low_sq = ((1.0f - ATTITUDE_ACCEL_GATE) *
+                          (1.0f - ATTITUDE_ACCEL_GATE));
+    gains->gate_high_sq = ((1.0f + ATTITUDE_ACCEL_GATE) *
+                           (1.0f + ATTITUDE_ACCEL_GATE));
+}
+
+/**
+ *  One step of the estimator for one flight. Written without branches so that
+ *  the batch version vectorizes.
+ *
+ *  @param gains Gains and scale factors
+ *  @param q Attitude quaternion (w, x, y, z), updated
+ *  @param bias Integrated correction in LSB, updated
+ *  @param a Accelerometer reading in LSB
+ *  @param g Gyroscope reading in LSB
+ *  @param cos_tilt Where the cosine of the tilt angle is stored
+ */
+static inline __attribute__((always_inline)) void attitude_step(
+                                        const struct attitude_gains *gains,
+                                        float q[4], float bias[3],
+                                        const float a[3],
+                                        const float g[3], float *cos_tilt)
+{
+    float qw = q[0], qx = q[1], qy = q[2], qz = q[3];
+
+    const float ax = a[0] * gains->accel_scale;
+    const float ay = a[1] * gains->accel_scale;
+    const float az = a[2] * gains->accel_scale;
+
+    // Estimated direction of up in the body frame
+    const float vx = 2.0f * ((qx * qz) - (qw * qy));
+    const float vy = 2.0f * ((qw * qx) + (qy * qz));
+    const float vz = (qw * qw) - (qx * qx) - (qy * qy) + (qz * qz);
+
+    // Error between measured and estimated up, only when the accelerometer
+    // can be trusted as a gravity reference
+    const float a_sq = (ax * ax) + (ay * ay) + (az * az);
+    const float trusted = (float)((a_sq >= gains->gate_low_sq) &
+                                  (a_sq <= gains->gate_high_sq));
+    // FLT_MIN keeps the reciprocal finite in free fall
+    const float a_inv = trusted / sqrtf(a_sq + FLT_MIN);
+    const float ex = ((ay * vz) - (az * vy)) * a_inv;
+    const float ey = ((az * vx) - (ax * vz)) * a_inv;
+    const float ez = ((ax * vy) - (ay * vx)) * a_inv;
+
+    bias[0] += gains->ki * ex;
+    bias[1] += gains->ki * ey;
+    bias[2] += gains->ki * ez;
+
+    const float rx = (g[0] + bias[0] + (gains->kp * ex)) *
+                        gains->half_gyro_step;
+    const float ry = (g[1] + bias[1] + (gains->kp * ey)) *
+                        gains->half_gyro_step;
+    const float rz = (g[2] + bias[2] + (gains->kp * ez)) *
+                        gains->half_gyro_step;
+
+    // Integrate q' = q * (0, rate) / 2 over one sample period
+    const float nw = qw - (qx * rx) - (qy * ry) - (qz * rz);
+    const float nx = qx + (qw * rx) + (qy * rz) - (qz * ry);
+    const float ny = qy + (qw * ry) - (qx * rz) + (qz * rx);
+    const float nz = qz + (qw * rz) + (qx * ry) - (qy * rx);
+    const float n_inv = 1.0f / sqrtf((nw * nw) + (nx * nx) + (ny * ny) +
+                                     (nz * nz));
+    qw = nw * n_inv;
+    qx = nx * n_inv;
+    qy = ny * n_inv;
+    qz = nz * n_inv;
+    q[0] = qw;
+    q[1] = qx;
+    q[2] = qy;
+    q[3] = qz;
+
+    // Tilt of the new attitude
+    *cos_tilt = (qw * qw) - (qx * qx) - (qy * qy) + (qz * qz);
+}
+
+/**
+ *  Set an attitude which rotates the given accelerometer reading to point
+ *  straight up.
+ */
+static void attitude_from_accel(float q[4], const float a[3])
+{
+    const float norm = sqrtf((a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2]));
+    if (norm == 0.0f) {
+        q[0] = 1.0f;
+        q[1] = 0.0f;
+        q[2] = 0.0f;
+        q[3] = 0.0f;
+        return;
+    }
+
+    // Half way between the reading and up, rotation axis is reading x up
+    const float w = 1.0f + (a[2] / norm);
+    if (w < 1e-6f) {
+        // Upside down, turn over about x
+        q[0] = 0.0f;
+        q[1] = 1.0f;
+        q[2] = 0.0f;
+        q[3] = 0.0f;
+        return;
+    }
+    const float x = a[1] / norm;
+    const float y = -a[0] / norm;
+    const float q_inv = 1.0f / sqrtf((w * w) + (x * x) + (y * y));
+    q[0] = w * q_inv;
+    q[1] = x * q_inv;
+    q[2] = y * q_inv;
+    q[3] = 0.0f;
+}
+
+void init_attitude(struct attitude_desc_t *inst,
+                   const struct mpu9250_desc_t *imu, uint16_t sample_rate)
+{
+    attitude_gains(&inst->gains, imu, sample_rate);
+
+    inst->q[0] = 1.0f;
+    inst->q[1] = 0.0f;
+    inst->q[2] = 0.0f;
+    inst->q[3] = 0.0f;
+    for (uint8_t i = 0; i < 3; i++) {
+        inst->bias[i] = 0.0f;
+        inst->pad_accel[i] = 0.0f;
+    }
+    inst->cos_tilt = 1.0f;
+    inst->on_pad = 1;
+}
+
+void attitude_update(struct attitude_desc_t *inst,
+                     const struct mpu9250_sample *sample)
+{
+    const float a[3] = { sample->accel[0], sample->accel[1],
+                         sample->accel[2] };
+
+    const float a_sq = (((a[0] * a[0]) + (a[1] * a[1]) + (a[2] * a[2])) *
+                        inst->gains.accel_scale * inst->gains.accel_scale);
+    if (inst->on_pad && (a_sq >= inst->gains.gate_low_sq) &&
+            (a_sq <= inst->gains.gate_high_sq)) {
+        // Still on the pad, the average accelerometer reading is up. Samples
+        // from the start of the burn, before launch is detected, are left out.
+        for (uint8_t i = 0; i < 3; i++) {
+            inst->pad_accel[i] += ((a[i] - inst->pad_accel[i]) /
+                                   ATTITUDE_PAD_FILTER_DIV);
+        }
+        attitude_from_accel(inst->q, inst->pad_accel);
+    }
+
+    const float g[3] = { sample->gyro[0], sample->gyro[1], sample->gyro[2] };
+    attitude_step(&inst->gains, inst->q, inst->bias, a, g, &inst->cos_tilt);
+}
+
+#ifdef ATTITUDE_HOST_BATCH
+int init_attitude_batch(struct attitude_batch *batch, uint32_t count,
+                        const struct mpu9250_desc_t *imu, uint16_t sample_rate)
+{
+    batch->count = count;
+    attitude_gains(&batch->gains, imu, sample_rate);
+
+    float **const arrays[] = { &batch->qw, &batch->qx, &batch->qy,
+                               &batch->qz, &batch->bias_x, &batch->bias_y,
+                               &batch->bias_z, &batch->cos_tilt };
+    int failed = 0;
+    for (uint32_t i = 0; i < (sizeof(arrays) / sizeof(arrays[0])); i++) {
+        *arrays[i] = calloc(count, sizeof(float));
+        failed |= (*arrays[i] == NULL);
+    }
+    if (failed) {
+        attitude_batch_free(batch);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        batch->qw[i] = 1.0f;
+        batch->cos_tilt[i] = 1.0f;
+    }
+    return 0;
+}
+
+void attitude_batch_free(struct attitude_batch *batch)
+{
+    free(batch->qw);
+    free(batch->qx);
+    free(batch->qy);
+    free(batch->qz);
+    free(batch->bias_x);
+    free(batch->bias_y);
+    free(batch->bias_z);
+    free(batch->cos_tilt);
+}
+
+void attitude_batch_seed(struct attitude_batch *batch, uint32_t flight,
+                         const float accel[3])
+{
+    float q[4];
+    attitude_from_accel(q, accel);
+    batch->qw[flight] = q[0];
+    batch->qx[flight] = q[1];
+    batch->qy[flight] = q[2];
+    batch->qz[flight] = q[3];
+    batch->bias_x[flight] = 0.0f;
+    batch->bias_y[flight] = 0.0f;
+    batch->bias_z[flight] = 0.0f;
+}
+
+/**
+ *  Batch update with every array as a restrict qualified parameter, which GCC
+ *  needs in order to vectorize without run time alias checks.
+ */
+static void attitude_batch_kernel(const struct attitude_gains *gains,
+                                  uint32_t count,
+                                  float *restrict qw, float *restrict qx,
+                                  float *restrict qy, float *restrict qz,
+                                  float *restrict bx, float *restrict by,
+                                  float *restrict bz,
+                                  float *restrict cos_tilt,
+                                  const int16_t *restrict ax,
+                                  const int16_t *restrict ay,
+                                  const int16_t *restrict az,
+                                  const int16_t *restrict gx,
+                                  const int16_t *restrict gy,
+                                  const int16_t *restrict gz)
+{
+    for (uint32_t i = 0; i < count; i++) {
+        float q[4] = { qw[i], qx[i], qy[i], qz[i] };
+        float bias[3] = { bx[i], by[i], bz[i] };
+        const float a[3] = { ax[i], ay[i], az[i] };
+        const float g[3] = { gx[i], gy[i], gz[i] };
+
+        attitude_step(gains, q, bias, a, g, &cos_tilt[i]);
+
+        qw[i] = q[0];
+        qx[i] = q[1];
+        qy[i] = q[2];
+        qz[i] = q[3];
+        bx[i] = bias[0];
+        by[i] = bias[1];
+        bz[i] = bias[2];
+    }
+}
+
+void attitude_batch_update(struct attitude_batch *batch, const int16_t *ax,
+                           const int16_t *ay, const int16_t *az,
+                           const int16_t *gx, const int16_t *gy,
+                           const int16_t *gz)
+{
+    attitude_batch_kernel(&batch->gains, batch->count, batch->qw, batch->qx,
+                          batch->qy, batch->qz, batch->bias_x, batch->bias_y,
+                          batch->bias_z, batch->cos_tilt, ax, ay, az, gx, gy,
+                          gz);
+}
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @file attitude.h
+ * @desc Quaternion attitude estimator fed by every IMU sample
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef attitude_h
+#define attitude_h
+
+#include "test-global.h"
+#include "mpu9250-test.h"
+
+/** Proportional gain of the accelerometer correction in 1/s */
+#ifndef ATTITUDE_KP
+#define ATTITUDE_KP 1.0f
+#endif
+/** Integral gain of the accelerometer correction in 1/s^2 */
+#ifndef ATTITUDE_KI
+#define ATTITUDE_KI 0.02f
+#endif
+/** The accelerometer is only trusted as a gravity reference when the
+    magnitude of its reading is within this fraction of 1 g, which rules it out
+    under thrust and while coasting */
+#ifndef ATTITUDE_ACCEL_GATE
+#define ATTITUDE_ACCEL_GATE 0.1f
+#endif
+/** Weight of each new sample in the pad accelerometer average is 1/n */
+#define ATTITUDE_PAD_FILTER_DIV 16
+
+/**
+ *  Gains and scale factors, all pre-multiplied by the sample period so that
+ *  the update does no divisions.
+ */
+struct attitude_gains {
+    /** Half of the sample period times the gyro scale in rad/LSB */
+    float half_gyro_step;
+    /** Accelerometer scale in g/LSB */
+    float accel_scale;
+    /** ATTITUDE_KP divided by the gyro scale in LSB/(rad/s) */
+    float kp;
+    /** ATTITUDE_KI times the sample period divided by the gyro scale */
+    float ki;
+    /** Squared bounds on the accelerometer magnitude for it to be used as a
+        gravity reference in g^2 */
+    float gate_low_sq;
+    float gate_high_sq;
+};
+
+/**
+ *  Attitude of the body frame relative to an earth frame with z pointing up.
+ *  While on the pad the attitude is set from the averaged accelerometer
+ *  reading, using only readings close to 1 g. After launch it is integrated
+ *  from the gyroscope and corrected towards the accelerometer (Mahony style)
+ *  whenever the accelerometer reads close to 1 g. Each update is a fixed
+ *  amount of work with no loops.
+ */
+struct attitude_desc_t {
+    /** Unit quaternion (w, x, y, z) which rotates body vectors to earth */
+    float q[4];
+    /** Integrated correction, an estimate of gyro bias in LSB */
+    float bias[3];
+    /** Averaged accelerometer reading while on the pad in LSB */
+    float pad_accel[3];
+
+    /** Cosine of the angle between the body z axis and vertical */
+    float cos_tilt;
+
+    struct attitude_gains gains;
+
+    /** Flag set until attitude_launch() is called, while set the attitude is
+        taken from the accelerometer */
+    uint8_t on_pad:1;
+};
+
+/**
+ *  Initialize an attitude estimator. The estimator starts on the pad.
+ *
+ *  @param inst The estimator to initialize
+ *  @param imu IMU whose samples will be used, for its full scale ranges
+ *  @param sample_rate IMU sample rate in Hz
+ */
+extern void init_attitude(struct attitude_desc_t *inst,
+                          const struct mpu9250_desc_t *imu,
+                          uint16_t sample_rate);
+
+/**
+ *  Update the estimate with an IMU sample. Must be called for every sample,
+ *  including each sample of a FIFO burst, since the gyro rate is integrated
+ *  over one sample period.
+ *
+ *  @param inst The estimator
+ *  @param sample The sample
+ */
+extern void attitude_update(struct attitude_desc_t *inst,
+                            const struct mpu9250_sample *sample);
+
+/**
+ *  Stop seeding the attitude from the accelerometer and start integrating the
+ *  gyroscope. Called when launch is detected.
+ *
+ *  @param inst The estimator
+ */
+static inline void attitude_launch(struct attitude_desc_t *inst)
+{
+    inst->on_pad = 0;
+}
+
+/**
+ *  Set the gyro bias, which is subtracted from every gyro reading. The
+ *  integrated correction starts from this value.
+ *
+ *  @param inst The estimator
+ *  @param bias Gyro bias in LSB
+ */
+static inline void attitude_set_gyro_bias(struct attitude_desc_t *inst,
+                                          const float bias[3])
+{
+    inst->bias[0] = -bias[0];
+    inst->bias[1] = -bias[1];
+    inst->bias[2] = -bias[2];
+}
+
+/**
+ *  Get the cosine of the angle between the body z axis and vertical.
+ *
+ *  @param inst The estimator
+ *
+ *  @return 1 when upright, 0 when horizontal and -1 when inverted
+ */
+static inline float attitude_cos_tilt(const struct attitude_desc_t *inst)
+{
+    return inst->cos_tilt;
+}
+
+#ifdef ATTITUDE_HOST_BATCH
+/**
+ *  Attitude of a batch of flights for replay on the host, stored as arrays so
+ *  that each update vectorizes across flights. The math is the same as
+ *  attitude_update() after launch. Build with -O3 -fno-math-errno (or
+ *  -ffast-math) so that the square roots vectorize.
+ */
+struct attitude_batch {
+    /** Number of flights in batch */
+    uint32_t count;
+    struct attitude_gains gains;
+
+    float *qw;
+    float *qx;
+    float *qy;
+    float *qz;
+    float *bias_x;
+    float *bias_y;
+    float *bias_z;
+
+    /** Output from the most recent update */
+    float *cos_tilt;
+};
+
+/**
+ *  Allocate a batch of estimators.
+ *
+ *  @param batch The batch to be initialized
+ *  @param count Number of flights
+ *  @param imu IMU configuration shared by all flights, for its full scale
+ *             ranges
+ *  @param sample_rate IMU sample rate in Hz
+ *
+ *  @return 0 if successful
+ */
+extern int init_attitude_batch(struct attitude_batch *batch, uint32_t count,
+                               const struct mpu9250_desc_t *imu,
+                               uint16_t sample_rate);
+
+/**
+ *  Free the memory used by a batch.
+ *
+ *  @param batch The batch
+ */
+extern void attitude_batch_free(struct attitude_batch *batch);
+
+/**
+ *  Set the attitude of one flight from a pad accelerometer reading.
+ *
+ *  @param batch The batch
+ *  @param flight Which flight to set
+ *  @param accel Accelerometer reading in LSB
+ */
+extern void attitude_batch_seed(struct attitude_batch *batch, uint32_t flight,
+                                const float accel[3]);
+
+/**
+ *  Update every flight in the batch with one sample each. The inputs are
+ *  arrays with one raw reading per flight.
+ *
+ *  @param batch The batch
+ *  @param ax, ay, az Accelerometer readings in LSB
+ *  @param gx, gy, gz Gyroscope readings in LSB
+ */
+extern void attitude_batch_update(struct attitude_batch *batch,
+                                  const int16_t *ax, const int16_t *ay,
+                                  const int16_t *az, const int16_t *gx,
+                                  const int16_t *gy, const int16_t *gz);
+#endif
+
+#endif /* attitude_h */
@@ -0,0 +1,196 @@
+/**
+ * @file baro-vote-sim.c
+ * @desc Reports how well the altimeter vote keeps pressure glitches away from
+ *       the drogue deployment over simulated flights
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef BARO_VOTE_SIM_MAIN
+
+#include "flight-sim.h"
+#include "host-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Height above DROGUE_DEPLOY_ALTITUDE in meters at which a drogue deployment
+    is counted as early */
+#define BARO_VOTE_SIM_EARLY     20.0f
+
+/** Sink context which records when the drogue was deployed */
+struct baro_vote_sim_recorder {
+    struct flight_sim_board *board;
+    /** Time at which the flight came down through DROGUE_DEPLOY_ALTITUDE */
+    uint32_t crossing_time;
+    /** Time at which the deployment service deployed the drogue (0 if not
+        yet) */
+    uint32_t drogue_time;
+    /** Altitude of the flight when the drogue was deployed */
+    float drogue_altitude;
+};
+
+/** Outcome of a batch of flights */
+struct baro_vote_sim_result {
+    uint32_t early;
+    uint32_t missed;
+    /** Sum of the time from the crossing to the deployment of the drogue over
+        the flights on which it was neither early nor missed */
+    int64_t latency;
+    uint32_t exclusions;
+};
+
+static void baro_vote_sim_sink(void *context, const struct flight_sim *sim,
+                               int new_baro)
+{
+    struct baro_vote_sim_recorder *const r = context;
+
+    flight_sim_replay_sink(&r->board->replay, sim, new_baro);
+
+    if ((r->crossing_time == 0) && (sim->velocity[0] < 0) &&
+            (sim->altitude[0] <= DROGUE_DEPLOY_ALTITUDE)) {
+        r->crossing_time = sim->time;
+    }
+    if ((r->drogue_time == 0) && (r->board->deployment.state ==
+                                  DEPLOYMENT_STATE_DROGUE_DEPLOY)) {
+        r->drogue_time = sim->time;
+        r->drogue_altitude = sim->altitude[0];
+    }
+}
+
+/**
+ *  Replay flights with a number of altimeters, voted with the variant's
+ *  settings if there is more than one.
+ */
+static int baro_vote_sim_run(struct flight_sim_config *config, uint8_t count,
+                             uint32_t flights, uint32_t seed,
+                             struct baro_vote_sim_result *result)
+{
+    static struct flight_sim_board board;
+    struct baro_vote_sim_recorder recorder = { .board = &board };
+
+    *result = (struct baro_vote_sim_result){ 0 };
+    config->num_baro = count;
+    for (uint32_t f = 0; f < flights; f++) {
+        struct flight_sim sim;
+        config->pad_time = 10.0f + (0.0137f * (float)f);
+        millis = 0;
+        if (init_flight_sim(&sim, config, 1, seed + f) != 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        init_flight_sim_board(&board, config);
+        if (count > 1) {
+            init_baro_vote(&board.vote, &board.vote_topic,
+                           ALTIMETER_VOTE_MAX_AGE, ALTIMETER_VOTE_TOLERANCE);
+            for (uint8_t k = 0; k < count; k++) {
+                baro_vote_add_sensor(&board.vote, &board.altimeter[k]);
+            }
+        }
+
+        recorder.crossing_time = 0;
+        recorder.drogue_time = 0;
+        flight_sim_run(&sim, (uint32_t)((config->pad_time + 400.0f) * 1000),
+                       baro_vote_sim_sink, &recorder);
+        flight_sim_free(&sim);
+
+        if (recorder.drogue_time == 0) {
+            result->missed++;
+        } else if (recorder.drogue_altitude >
+                        (DROGUE_DEPLOY_ALTITUDE + BARO_VOTE_SIM_EARLY)) {
+            result->early++;
+        } else {
+            result->latency += (int64_t)recorder.drogue_time -
+                               (int64_t)recorder.crossing_time;
+        }
+        result->exclusions += board.vote.exclusions;
+    }
+    return 0;
+}
+
+static void baro_vote_sim_print(uint8_t count, uint32_t flights,
+                                const struct baro_vote_sim_result *r)
+{
+    const uint32_t on_time = flights - r->early - r->missed;
+    printf("  %10u %6u %6u %12.1f %12.1f\n", (unsigned)count,
+           (unsigned)r->early, (unsigned)r->missed,
+           (on_time == 0) ? 0.0 : ((double)r->latency / on_time),
+           (double)r->exclusions / flights);
+}
+
+int main(int argc, char **argv)
+{
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .transonic_spike = 2000.0f,
+        .baro_glitch_rate = 0.02f, .baro_glitch = 3000.0f,
+        .accel_noise = 0.05f, .accel_bias = 0.05f, .gyro_noise = 0.1f,
+        .gyro_bias = 1.0f, .roll_rate = 60.0f, .temperature = 25.0f,
+        .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+        .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = ALTIMETER_PERIOD,
+        .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 200;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                flights = (flights == 0) ? 1 : flights;
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    printf("%u flights, altimeters every %u ms, %.0f Pa glitches in %.0f%% "
+           "of readings, early above %.0f m\n", (unsigned)flights,
+           (unsigned)ALTIMETER_PERIOD, (double)config.baro_glitch,
+           100.0 * (double)config.baro_glitch_rate,
+           DROGUE_DEPLOY_ALTITUDE + (double)BARO_VOTE_SIM_EARLY);
+    printf("  %10s %6s %6s %12s %12s\n", "altimeters", "early", "missed",
+           "latency (ms)", "excluded");
+
+    // One altimeter, the shipped count and the count needed for a median
+    static const uint8_t counts[] = {1, ALTIMETER_COUNT, 3};
+    struct baro_vote_sim_result single = { 0 }, shipped = { 0 }, r;
+    for (uint8_t i = 0; i < (sizeof(counts) / sizeof(counts[0])); i++) {
+        if ((i > 0) && (counts[i] == counts[i - 1])) {
+            continue;
+        }
+        if (baro_vote_sim_run(&config, counts[i], flights, seed, &r) != 0) {
+            return 1;
+        }
+        baro_vote_sim_print(counts[i], flights, &r);
+        if (i == 0) {
+            single = r;
+        }
+        if (counts[i] == ALTIMETER_COUNT) {
+            shipped = r;
+        }
+    }
+
+    if ((ALTIMETER_COUNT > 1) &&
+            ((shipped.early + shipped.missed) >= (single.early +
+                                                  single.missed))) {
+        fprintf(stderr, "the shipped vote does no better than one "
+                "altimeter\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
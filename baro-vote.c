@@ -0,0 +1,226 @@
+/**
+ * @file baro-vote.c
+ * @desc Fuses readings from redundant altimeters with a median vote
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "baro-vote.h"
+
+void init_baro_vote(struct baro_vote_desc_t *inst,
+                    struct sensor_bus_topic *topic, uint32_t max_age,
+                    ms5611_alt_t tolerance)
+{
+    inst->topic = topic;
+    inst->max_age = max_age;
+    inst->tolerance = tolerance;
+    inst->no_quorum = 0;
+    inst->exclusions = 0;
+    inst->num_fused = 0;
+    inst->num_sensors = 0;
+    inst->have_reading = 0;
+    inst->voters = 0;
+}
+
+int baro_vote_add_sensor(struct baro_vote_desc_t *inst,
+                         struct ms5611_desc_t *sensor)
+{
+    if (inst->num_sensors >= BARO_VOTE_MAX_SENSORS) {
+        return 1;
+    }
+    const uint8_t i = inst->num_sensors++;
+    inst->sensors[i] = sensor;
+    init_sensor_bus_cursor(&inst->cursors[i], sensor->topic);
+    inst->disagreements[i] = 0;
+    return 0;
+}
+
+/**
+ *  Sort a few values in place (at most BARO_VOTE_MAX_SENSORS).
+ */
+#define SORT_SMALL(type, values, n) do { \
+    for (uint8_t a = 1; a < (n); a++) { \
+        const type v = (values)[a]; \
+        uint8_t b = a; \
+        for (; (b > 0) && ((values)[b - 1] > v); b--) { \
+            (values)[b] = (values)[b - 1]; \
+        } \
+        (values)[b] = v; \
+    } \
+} while (0)
+
+static inline ms5611_alt_t median_alt(ms5611_alt_t *values, uint8_t n)
+{
+    SORT_SMALL(ms5611_alt_t, values, n);
+    if (n & 1) {
+        return values[n / 2];
+    }
+    // Written to avoid overflow of Q16.16 altitudes
+    return values[(n / 2) - 1] + ((values[n / 2] - values[(n / 2) - 1]) / 2);
+}
+
+static inline int32_t median_i32(int32_t *values, uint8_t n)
+{
+    SORT_SMALL(int32_t, values, n);
+    if (n & 1) {
+        return values[n / 2];
+    }
+    return values[(n / 2) - 1] + ((values[n / 2] - values[(n / 2) - 1]) / 2);
+}
+
+/**
+ *  Predict the fused altitude at a time by extrapolating the last two fused
+ *  readings.
+ *
+ *  @return Non-zero if there is a recent enough fused reading to predict from
+ */
+static int predict_alt(const struct baro_vote_desc_t *inst, uint32_t time,
+                       ms5611_alt_t *predicted)
+{
+    if ((inst->num_fused == 0) ||
+            ((time - inst->fused_time[1]) > inst->max_age)) {
+        return 0;
+    }
+
+    *predicted = inst->fused_alt[1];
+    const uint32_t span = inst->fused_time[1] - inst->fused_time[0];
+    if ((inst->num_fused < 2) || (span == 0) || (span > inst->max_age)) {
+        return 1;
+    }
+    const int32_t dt = (int32_t)(time - inst->fused_time[1]);
+    const ms5611_alt_t change = inst->fused_alt[1] - inst->fused_alt[0];
+#ifdef FIXED_POINT_ALTITUDE
+    *predicted += (ms5611_alt_t)(((int64_t)change * dt) / (int64_t)span);
+#else
+    *predicted += (change * (float)dt) / (float)span;
+#endif
+    return 1;
+}
+
+/**
+ *  Choose which of two readings to leave out, if any.
+ *
+ *  @return Index into altitudes of the reading to leave out, or -1 to use both
+ */
+static int pair_outlier(const struct baro_vote_desc_t *inst,
+                        const ms5611_alt_t *altitudes, uint32_t time)
+{
+    ms5611_alt_t predicted;
+    if (!predict_alt(inst, time, &predicted)) {
+        return -1;
+    }
+
+    const ms5611_alt_t error0 = ms5611_alt_abs(altitudes[0] - predicted);
+    const ms5611_alt_t error1 = ms5611_alt_abs(altitudes[1] - predicted);
+    const int out0 = error0 > inst->tolerance;
+    const int out1 = error1 > inst->tolerance;
+    if (out0 != out1) {
+        return out0 ? 0 : 1;
+    } else if (out0 && (ms5611_alt_abs(altitudes[0] - altitudes[1]) >
+                            inst->tolerance)) {
+        return (error0 > error1) ? 0 : 1;
+    }
+    return -1;
+}
+
+/**
+ *  Publish the median of the usable altimeters' most recent readings.
+ *
+ *  @param time Time of the reading which triggered this vote
+ */
+static void publish_vote(struct baro_vote_desc_t *inst, uint32_t time)
+{
+    ms5611_alt_t altitudes[BARO_VOTE_MAX_SENSORS];
+    int32_t pressures[BARO_VOTE_MAX_SENSORS];
+    int32_t temperatures[BARO_VOTE_MAX_SENSORS];
+    uint8_t sensors[BARO_VOTE_MAX_SENSORS];
+    uint8_t n = 0;
+
+    inst->voters = 0;
+    for (uint8_t i = 0; i < inst->num_sensors; i++) {
+        if (!(inst->have_reading & (1 << i)) ||
+                (inst->sensors[i]->state == MS5611_FAILED) ||
+                ((time - inst->latest[i].time) > inst->max_age)) {
+            continue;
+        }
+        altitudes[n] = inst->latest[i].altitude;
+        pressures[n] = inst->latest[i].pressure;
+        temperatures[n] = inst->latest[i].temperature;
+        sensors[n] = i;
+        inst->voters |= (uint8_t)(1 << i);
+        n++;
+    }
+
+    if (n == 0) {
+        inst->no_quorum++;
+        return;
+    }
+
+    // Readings left out of the vote are still counted as disagreeing
+    const uint8_t usable = inst->voters;
+    if (n == 2) {
+        const int out = pair_outlier(inst, altitudes, time);
+        if (out >= 0) {
+            const int keep = 1 - out;
+            inst->voters &= (uint8_t)~(1 << sensors[out]);
+            inst->exclusions++;
+            altitudes[0] = altitudes[keep];
+            pressures[0] = pressures[keep];
+            temperatures[0] = temperatures[keep];
+            n = 1;
+        }
+    }
+
+    struct ms5611_sample *const fused = sensor_bus_claim(inst->topic);
+    fused->time = time;
+    fused->altitude = median_alt(altitudes, n);
+    fused->pressure = median_i32(pressures, n);
+    fused->temperature = median_i32(temperatures, n);
+
+    inst->fused_alt[0] = inst->fused_alt[1];
+    inst->fused_time[0] = inst->fused_time[1];
+    inst->fused_alt[1] = fused->altitude;
+    inst->fused_time[1] = time;
+    if (inst->num_fused < 2) {
+        inst->num_fused++;
+    }
+
+    for (uint8_t i = 0; i < inst->num_sensors; i++) {
+        if ((usable & (1 << i)) &&
+                (ms5611_alt_abs(inst->latest[i].altitude - fused->altitude) >
+                    inst->tolerance)) {
+            inst->disagreements[i]++;
+        }
+    }
+
+    sensor_bus_commit(inst->topic);
+}
+
+void baro_vote_service(struct baro_vote_desc_t *inst)
+{
+    for (;;) {
+        // Take the oldest unread reading from any altimeter
+        const struct ms5611_sample *next = NULL;
+        uint8_t next_sensor = 0;
+        for (uint8_t i = 0; i < inst->num_sensors; i++) {
+            const struct ms5611_sample *const s = sensor_bus_peek(
+                                                        &inst->cursors[i]);
+            if ((s != NULL) && ((next == NULL) ||
+                                ((int32_t)(s->time - next->time) < 0))) {
+                next = s;
+                next_sensor = i;
+            }
+        }
+        if (next == NULL) {
+            return;
+        }
+
+        inst->latest[next_sensor] = *next;
+        inst->have_reading |= (uint8_t)(1 << next_sensor);
+        sensor_bus_advance(&inst->cursors[next_sensor]);
+
+        publish_vote(inst, inst->latest[next_sensor].time);
+    }
+}
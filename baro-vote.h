@@ -0,0 +1,131 @@
+/**
+ * @file baro-vote.h
+ * @desc Fuses readings from redundant altimeters with a median vote
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef baro_vote_h
+#define baro_vote_h
+
+#include "test-global.h"
+#include "ms5611-test.h"
+#include "sensor-bus.h"
+
+/** Largest number of altimeters which can be voted on */
+#define BARO_VOTE_MAX_SENSORS   4
+
+/**
+ *  Each altimeter publishes to its own topic. Every time that any altimeter
+ *  produces a reading, a fused reading is published which is the median of
+ *  the most recent reading from every altimeter that has not failed and whose
+ *  most recent reading is not stale. With altimeters sampled in turn, the
+ *  fused stream has N times the rate of a single altimeter.
+ *
+ *  The median of two readings is their mean, which would still move by half of
+ *  a glitch. With two voters, a reading further than the tolerance from the
+ *  altitude predicted by the trend of the last two fused readings is left out
+ *  if the other is within it. If both are outside and disagree by more than
+ *  the tolerance, the closer one is used.
+ */
+struct baro_vote_desc_t {
+    /** Altimeters being voted on */
+    struct ms5611_desc_t *sensors[BARO_VOTE_MAX_SENSORS];
+    /** Subscriptions to each altimeter's readings */
+    struct sensor_bus_cursor cursors[BARO_VOTE_MAX_SENSORS];
+    /** Most recent reading from each altimeter */
+    struct ms5611_sample latest[BARO_VOTE_MAX_SENSORS];
+    /** Number of fused readings for which each altimeter was outside of the
+        tolerance from the fused altitude */
+    uint32_t disagreements[BARO_VOTE_MAX_SENSORS];
+
+    /** Topic to which fused readings are published */
+    struct sensor_bus_topic *topic;
+
+    /** Readings older than this are left out of the vote in milliseconds */
+    uint32_t max_age;
+    /** Difference from the fused altitude above which an altimeter is counted
+        as disagreeing */
+    ms5611_alt_t tolerance;
+    /** Number of fused readings produced with no usable altimeter */
+    uint32_t no_quorum;
+    /** Number of times a reading was left out of a vote between two
+        altimeters */
+    uint32_t exclusions;
+
+    /** Altitude of the last two fused readings, most recent last */
+    ms5611_alt_t fused_alt[2];
+    /** Time of the last two fused readings, most recent last */
+    uint32_t fused_time[2];
+    /** Number of fused readings in fused_alt (up to 2) */
+    uint8_t num_fused;
+
+    /** Number of altimeters */
+    uint8_t num_sensors;
+    /** Mask of altimeters which have produced at least one reading */
+    uint8_t have_reading;
+    /** Mask of altimeters which were used for the most recent fused reading */
+    uint8_t voters;
+};
+
+/**
+ *  Initialize an altimeter vote.
+ *
+ *  @param inst The vote to initialize
+ *  @param topic Topic to publish fused readings to
+ *  @param max_age Readings older than this are not used in milliseconds
+ *  @param tolerance Difference from the fused altitude above which an
+ *                   altimeter is counted as disagreeing, and from the
+ *                   predicted altitude above which one of two altimeters is
+ *                   left out
+ */
+extern void init_baro_vote(struct baro_vote_desc_t *inst,
+                           struct sensor_bus_topic *topic, uint32_t max_age,
+                           ms5611_alt_t tolerance);
+
+/**
+ *  Add an altimeter to the vote. The altimeter's topic must be set.
+ *
+ *  @param inst The vote
+ *  @param sensor The altimeter
+ *
+ *  @return 0 if the altimeter was added
+ */
+extern int baro_vote_add_sensor(struct baro_vote_desc_t *inst,
+                                struct ms5611_desc_t *sensor);
+
+/**
+ *  Consume new readings from all of the altimeters, in time order, and publish
+ *  a fused reading for each.
+ *
+ *  @param inst The vote
+ */
+extern void baro_vote_service(struct baro_vote_desc_t *inst);
+
+/**
+ *  Set the age after which readings are left out of the vote, for when the
+ *  altimeters' period is changed.
+ *
+ *  @param inst The vote
+ *  @param max_age Readings older than this are not used in milliseconds
+ */
+static inline void baro_vote_set_max_age(struct baro_vote_desc_t *inst,
+                                         uint32_t max_age)
+{
+    inst->max_age = max_age;
+}
+
+/**
+ *  Get the number of altimeters which were used for the most recent fused
+ *  reading.
+ *
+ *  @param inst The vote
+ */
+static inline uint8_t baro_vote_num_voters(const struct baro_vote_desc_t *inst)
+{
+    return (uint8_t)__builtin_popcount(inst->voters);
+}
+
+#endif /* baro_vote_h */
@@ -0,0 +1,93 @@
+/**
+ * @file buffer-arena.c
+ * @desc Statically allocated pool of I2C/DMA buffers shared between drivers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "buffer-arena.h"
+#include "variant-test.h"
+
+#ifndef BUFFER_ARENA_NUM_BUFFERS
+#define BUFFER_ARENA_NUM_BUFFERS 2
+#endif
+
+#if BUFFER_ARENA_NUM_BUFFERS > 32
+#error Buffer arena can have at most 32 buffers
+#endif
+
+/** Backing storage for all buffers, word aligned for DMA */
+static uint8_t arena_buffers[BUFFER_ARENA_NUM_BUFFERS]
+                            [BUFFER_ARENA_BUFFER_LENGTH]
+                            __attribute__((aligned(4)));
+
+/** Bitmask of buffers which are currently leased */
+static uint32_t arena_leased;
+/** Largest number of buffers leased at the same time */
+static uint8_t arena_high_water;
+/** Number of leases that could not be granted */
+static uint32_t arena_failures;
+
+uint8_t *buffer_arena_lease(void)
+{
+    uint32_t leased = __atomic_load_n(&arena_leased, __ATOMIC_ACQUIRE);
+
+    for (;;) {
+        const uint32_t free_mask = ~leased &
+                        (uint32_t)((1ULL << BUFFER_ARENA_NUM_BUFFERS) - 1);
+        if (free_mask == 0) {
+            __atomic_fetch_add(&arena_failures, 1, __ATOMIC_RELAXED);
+            return NULL;
+        }
+
+        const unsigned i = (unsigned)__builtin_ctz(free_mask);
+        const uint32_t new_leased = leased | (1UL << i);
+        // Retry if an interrupt leased or released a buffer in the mean time
+        if (__atomic_compare_exchange_n(&arena_leased, &leased, new_leased, 0,
+                                        __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+            // An interrupt may raise the high water mark in the mean time too
+            const uint8_t count = (uint8_t)__builtin_popcount(new_leased);
+            uint8_t high = __atomic_load_n(&arena_high_water,
+                                           __ATOMIC_RELAXED);
+            while (count > high) {
+                if (__atomic_compare_exchange_n(&arena_high_water, &high,
+                                                count, 0, __ATOMIC_RELAXED,
+                                                __ATOMIC_RELAXED)) {
+                    break;
+                }
+            }
+            return arena_buffers[i];
+        }
+    }
+}
+
+void buffer_arena_release(uint8_t *buffer)
+{
+    if (buffer == NULL) {
+        return;
+    }
+
+    const unsigned i = (unsigned)((buffer - &arena_buffers[0][0]) /
+                                  BUFFER_ARENA_BUFFER_LENGTH);
+    if (i >= BUFFER_ARENA_NUM_BUFFERS) {
+        return;
+    }
+    __atomic_fetch_and(&arena_leased, ~(1UL << i), __ATOMIC_RELEASE);
+}
+
+uint8_t buffer_arena_high_water(void)
+{
+    return __atomic_load_n(&arena_high_water, __ATOMIC_RELAXED);
+}
+
+uint32_t buffer_arena_lease_failures(void)
+{
+    return __atomic_load_n(&arena_failures, __ATOMIC_RELAXED);
+}
+
+uint32_t buffer_arena_size(void)
+{
+    return sizeof(arena_buffers);
+}
@@ -0,0 +1,57 @@
+/**
+ * @file buffer-arena.h
+ * @desc Statically allocated pool of I2C/DMA buffers shared between drivers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef buffer_arena_h
+#define buffer_arena_h
+
+#include "test-global.h"
+#include <stddef.h>
+
+/** Length of each buffer in the arena in bytes */
+#define BUFFER_ARENA_BUFFER_LENGTH  128
+
+/**
+ *  Lease a buffer from the arena. The buffer is owned by the caller until it is
+ *  returned with buffer_arena_release(). Safe to call from interrupt context.
+ *
+ *  @return Pointer to a buffer of BUFFER_ARENA_BUFFER_LENGTH bytes, or NULL if
+ *          all of the buffers are currently leased
+ */
+extern uint8_t *buffer_arena_lease(void);
+
+/**
+ *  Return a buffer to the arena.
+ *
+ *  @param buffer A buffer previously returned by buffer_arena_lease()
+ */
+extern void buffer_arena_release(uint8_t *buffer);
+
+/**
+ *  Get the largest number of buffers that have been leased at once.
+ *
+ *  @return Highest number of concurrently leased buffers
+ */
+extern uint8_t buffer_arena_high_water(void);
+
+/**
+ *  Get the number of times that a lease could not be granted because all of
+ *  the buffers were in use.
+ *
+ *  @return Number of failed leases
+ */
+extern uint32_t buffer_arena_lease_failures(void);
+
+/**
+ *  Get the total size of the arena.
+ *
+ *  @return Size of the arena in bytes
+ */
+extern uint32_t buffer_arena_size(void);
+
+#endif /* buffer_arena_h */
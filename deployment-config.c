@@ -0,0 +1,197 @@
+/**
+ * @file deployment-config.c
+ * @desc Versioned, CRC checked deployment configuration record
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "deployment-config.h"
+#include "deployment.h"
+#include "variant-test.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#ifdef DEPLOYMENT_CONFIG_HOST_FILE
+#include <stdio.h>
+
+static const char *config_file;
+#endif
+
+/** Largest altitude magnitude accepted in a record in millimeters, limited by
+    the range of Q16.16 altitudes */
+#define CONFIG_MAX_ALTITUDE DEPLOYMENT_MM(32000)
+/** Largest acceleration threashold accepted in a record in mg */
+#define CONFIG_MAX_ACCEL    64000
+/** Largest pyro event delay accepted in a record in milliseconds, an event
+    delayed past the end of any flight would never fire */
+#define CONFIG_MAX_DELAY    600000
+/** Largest pyro fire duration accepted in a record in milliseconds */
+#define CONFIG_MAX_DURATION 5000
+
+/** CRC-32 lookup table for one nibble at a time, to keep flash use small */
+static const uint32_t crc_table[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t deployment_config_crc(const void *data, uint32_t length)
+{
+    const uint8_t *bytes = data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    for (uint32_t i = 0; i < length; i++) {
+        crc = crc_table[(crc ^ bytes[i]) & 0xF] ^ (crc >> 4);
+        crc = crc_table[(crc ^ (bytes[i] >> 4)) & 0xF] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+void deployment_config_seal(struct deployment_config *config)
+{
+    config->magic = DEPLOYMENT_CONFIG_MAGIC;
+    config->version = DEPLOYMENT_CONFIG_VERSION;
+    config->length = sizeof(*config);
+    config->crc = deployment_config_crc(config,
+                                   offsetof(struct deployment_config, crc));
+}
+
+void deployment_config_defaults(struct deployment_config *config)
+{
+    memset(config, 0, sizeof(*config));
+
+    config->launch_accel = DEPLOYMENT_POWERED_ASCENT_ACCEL_THREASHOLD * 1000;
+    config->burnout_accel = DEPLOYMENT_COASTING_ASCENT_ACCEL_THREASHOLD * 1000;
+    config->launch_altitude = DEPLOYMENT_MM(
+                                    DEPLOYMENT_POWERED_ASCENT_ALT_THREASHOLD);
+    config->burnout_altitude = DEPLOYMENT_MM(
+                                    DEPLOYMENT_COASTING_ASCENT_ALT_THREASHOLD);
+    config->coast_min_altitude = DEPLOYMENT_MM(
+                                    DEPLOYMENT_COASTING_ASCENT_ALT_MINIMUM);
+    config->landed_alt_stddev = DEPLOYMENT_MM(DEPLOYMENT_LANDED_ALT_STDDEV);
+    config->landed_window = DEPLOYMENT_LANDED_WINDOW;
+    config->descending_samples = DEPLOYMENT_DESCENDING_SAMPLE_THREASHOLD;
+    config->accel_window_length = DEPLOYMENT_ACCEL_WINDOW_LENGTH;
+    config->launch_window_count = DEPLOYMENT_LAUNCH_WINDOW_COUNT;
+    config->burnout_window_count = DEPLOYMENT_BURNOUT_WINDOW_COUNT;
+
+    config->num_pyro = deployment_num_pyro_events_g;
+    for (uint8_t i = 0; i < deployment_num_pyro_events_g; i++) {
+        const struct deployment_pyro_event *const event =
+                                                &deployment_pyro_events_g[i];
+        config->pyro[i].altitude = event->altitude;
+        config->pyro[i].velocity = event->velocity;
+        config->pyro[i].delay = event->delay;
+        config->pyro[i].duration = event->duration;
+    }
+
+    deployment_config_seal(config);
+}
+
+static inline int altitude_in_range(int32_t altitude)
+{
+    return (altitude >= -CONFIG_MAX_ALTITUDE) &&
+           (altitude <= CONFIG_MAX_ALTITUDE);
+}
+
+enum deployment_config_status deployment_config_check(
+                                        const struct deployment_config *config,
+                                        uint8_t num_pyro)
+{
+    if (config->magic != DEPLOYMENT_CONFIG_MAGIC) {
+        return DEPLOYMENT_CONFIG_BAD_MAGIC;
+    } else if (config->version != DEPLOYMENT_CONFIG_VERSION) {
+        return DEPLOYMENT_CONFIG_BAD_VERSION;
+    } else if (config->length != sizeof(*config)) {
+        return DEPLOYMENT_CONFIG_BAD_LENGTH;
+    } else if (config->crc != deployment_config_crc(config,
+                                    offsetof(struct deployment_config, crc))) {
+        return DEPLOYMENT_CONFIG_BAD_CRC;
+    }
+
+    if ((config->launch_accel == 0) ||
+            (config->launch_accel > CONFIG_MAX_ACCEL) ||
+            (config->burnout_accel > CONFIG_MAX_ACCEL) ||
+            !altitude_in_range(config->launch_altitude) ||
+            !altitude_in_range(config->burnout_altitude) ||
+            !altitude_in_range(config->coast_min_altitude) ||
+            !altitude_in_range(config->landed_alt_stddev) ||
+            (config->landed_alt_stddev < 0) ||
+            (config->landed_window == 0) ||
+            (config->descending_samples == UINT8_MAX) ||
+            (config->accel_window_length < 1) ||
+            (config->accel_window_length > 32) ||
+            (config->launch_window_count == 0) ||
+            (config->launch_window_count > config->accel_window_length) ||
+            (config->burnout_window_count == 0) ||
+            (config->burnout_window_count > config->accel_window_length) ||
+            (config->num_pyro != num_pyro)) {
+        return DEPLOYMENT_CONFIG_BAD_VALUE;
+    }
+
+    for (uint8_t i = 0; i < config->num_pyro; i++) {
+        // A duration of 0 would turn the channel off on the next pass
+        if (!altitude_in_range(config->pyro[i].altitude) ||
+                !altitude_in_range(config->pyro[i].velocity) ||
+                (config->pyro[i].delay > CONFIG_MAX_DELAY) ||
+                (config->pyro[i].duration == 0) ||
+                (config->pyro[i].duration > CONFIG_MAX_DURATION)) {
+            return DEPLOYMENT_CONFIG_BAD_VALUE;
+        }
+    }
+
+    return DEPLOYMENT_CONFIG_OK;
+}
+
+#ifdef DEPLOYMENT_CONFIG_HOST_FILE
+void deployment_config_set_file(const char *path)
+{
+    config_file = path;
+}
+
+int deployment_config_save(const char *path,
+                           const struct deployment_config *config)
+{
+    FILE *const f = fopen(path, "wb");
+    if (f == NULL) {
+        return 1;
+    }
+    const size_t written = fwrite(config, sizeof(*config), 1, f);
+    return (fclose(f) != 0) || (written != 1);
+}
+
+enum deployment_config_status deployment_config_load(
+                                            struct deployment_config *config)
+{
+    if (config_file == NULL) {
+        return DEPLOYMENT_CONFIG_MISSING;
+    }
+    FILE *const f = fopen(config_file, "rb");
+    if (f == NULL) {
+        return DEPLOYMENT_CONFIG_MISSING;
+    }
+    const size_t read = fread(config, sizeof(*config), 1, f);
+    fclose(f);
+    return (read == 1) ? DEPLOYMENT_CONFIG_OK : DEPLOYMENT_CONFIG_MISSING;
+}
+#elif defined(DEPLOYMENT_CONFIG_NVM_ADDRESS)
+enum deployment_config_status deployment_config_load(
+                                            struct deployment_config *config)
+{
+    // Flash is memory mapped
+    memcpy(config, (const void *)DEPLOYMENT_CONFIG_NVM_ADDRESS,
+           sizeof(*config));
+    return DEPLOYMENT_CONFIG_OK;
+}
+#else
+enum deployment_config_status deployment_config_load(
+                                            struct deployment_config *config)
+{
+    (void)config;
+    return DEPLOYMENT_CONFIG_MISSING;
+}
+#endif
@@ -0,0 +1,180 @@
+/**
+ * @file deployment-config.h
+ * @desc Versioned, CRC checked deployment configuration record
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef deployment_config_h
+#define deployment_config_h
+
+#include "test-global.h"
+
+/** Value of the magic field of a configuration record ("DCFG") */
+#define DEPLOYMENT_CONFIG_MAGIC     0x47464344UL
+/** Current configuration record layout version */
+#define DEPLOYMENT_CONFIG_VERSION   2
+
+/** Convert meters (or meters per second) to the millimeter units used in
+    configuration records */
+#define DEPLOYMENT_MM(m) ((int32_t)((m) * 1000))
+
+/** Number of pyro event parameter slots in a configuration record */
+#define DEPLOYMENT_CONFIG_PYRO_SLOTS 16
+
+/** Tunable parameters of one pyro event, overriding the compile time table */
+struct deployment_config_pyro {
+    /** Altitude threashold in millimeters */
+    int32_t altitude;
+    /** Vertical velocity threashold in millimeters per second */
+    int32_t velocity;
+    /** Delay in milliseconds (at most 10 minutes) */
+    uint32_t delay;
+    /** Fire duration in milliseconds (1 to 5000) */
+    uint16_t duration;
+    uint16_t reserved;
+};
+
+/**
+ *  Deployment configuration as stored in non-volatile memory. All values are
+ *  integers in fixed units so that a record can be used regardless of how
+ *  altitudes are represented in the build. The deployment service converts it
+ *  into the units used on the hot path once, when it is applied.
+ */
+struct deployment_config {
+    /** DEPLOYMENT_CONFIG_MAGIC */
+    uint32_t magic;
+    /** DEPLOYMENT_CONFIG_VERSION */
+    uint16_t version;
+    /** sizeof(struct deployment_config) */
+    uint16_t length;
+
+    /** Acceleration above which a sample counts towards launch in mg */
+    uint32_t launch_accel;
+    /** Acceleration at or below which a sample counts towards burnout in mg */
+    uint32_t burnout_accel;
+    /** Backup launch detection altitude in millimeters */
+    int32_t launch_altitude;
+    /** Backup burnout detection altitude in millimeters */
+    int32_t burnout_altitude;
+    /** Minimum altitude for burnout detection in millimeters */
+    int32_t coast_min_altitude;
+    /** Largest standard deviation of altitude over a landing detection window
+        for the window to count as still in millimeters */
+    int32_t landed_alt_stddev;
+    /** Length of each landing detection window in milliseconds */
+    uint16_t landed_window;
+    /** Number of samples below the maximum altitude required to detect
+        descent */
+    uint8_t descending_samples;
+    /** Number of IMU samples in the launch/burnout window (1 to 32) */
+    uint8_t accel_window_length;
+    /** Samples in the window required to detect launch (1 to
+        accel_window_length) */
+    uint8_t launch_window_count;
+    /** Samples in the window required to detect burnout (1 to
+        accel_window_length) */
+    uint8_t burnout_window_count;
+    /** Number of entries in pyro which are used, must match the number of
+        events in the compile time pyro event table */
+    uint8_t num_pyro;
+    uint8_t reserved;
+
+    /** Parameters for each pyro event, in table order */
+    struct deployment_config_pyro pyro[DEPLOYMENT_CONFIG_PYRO_SLOTS];
+
+    /** CRC-32 of all preceding bytes */
+    uint32_t crc;
+};
+
+/** Result of checking or loading a configuration record */
+enum deployment_config_status {
+    DEPLOYMENT_CONFIG_OK = 0,
+    /** No record could be read from storage */
+    DEPLOYMENT_CONFIG_MISSING,
+    /** Magic value does not match */
+    DEPLOYMENT_CONFIG_BAD_MAGIC,
+    /** Record is from an incompatible layout version */
+    DEPLOYMENT_CONFIG_BAD_VERSION,
+    /** Record length does not match */
+    DEPLOYMENT_CONFIG_BAD_LENGTH,
+    /** CRC does not match */
+    DEPLOYMENT_CONFIG_BAD_CRC,
+    /** A value is out of range */
+    DEPLOYMENT_CONFIG_BAD_VALUE
+};
+
+/**
+ *  Compute the CRC-32 (IEEE 802.3) of a block of memory.
+ *
+ *  @param data Data to compute CRC of
+ *  @param length Length of data in bytes
+ *
+ *  @return CRC of data
+ */
+extern uint32_t deployment_config_crc(const void *data, uint32_t length);
+
+/**
+ *  Fill in a configuration record from the compile time defaults in the
+ *  variant header. The record is sealed and ready to be stored.
+ *
+ *  @param config The record to fill in
+ */
+extern void deployment_config_defaults(struct deployment_config *config);
+
+/**
+ *  Set the header fields and the CRC of a record after it has been modified.
+ *
+ *  @param config The record to seal
+ */
+extern void deployment_config_seal(struct deployment_config *config);
+
+/**
+ *  Check that a record is intact, is for this layout version and that its
+ *  values are in range.
+ *
+ *  @param config The record to check
+ *  @param num_pyro Number of events in the compile time pyro event table
+ *
+ *  @return DEPLOYMENT_CONFIG_OK if the record can be used
+ */
+extern enum deployment_config_status deployment_config_check(
+                                        const struct deployment_config *config,
+                                        uint8_t num_pyro);
+
+/**
+ *  Read the configuration record from non-volatile storage. On the host the
+ *  record is read from the file set with deployment_config_set_file(). The
+ *  record is not checked.
+ *
+ *  @param config Where to store the record
+ *
+ *  @return DEPLOYMENT_CONFIG_OK if a record was read, otherwise
+ *          DEPLOYMENT_CONFIG_MISSING
+ */
+extern enum deployment_config_status deployment_config_load(
+                                            struct deployment_config *config);
+
+#ifdef DEPLOYMENT_CONFIG_HOST_FILE
+/**
+ *  Set the file from which deployment_config_load() reads the record.
+ *
+ *  @param path Path of the file, NULL for no stored record
+ */
+extern void deployment_config_set_file(const char *path);
+
+/**
+ *  Write a configuration record to a file.
+ *
+ *  @param path Path of the file
+ *  @param config The record, which should be sealed
+ *
+ *  @return 0 on success
+ */
+extern int deployment_config_save(const char *path,
+                                  const struct deployment_config *config);
+#endif
+
+#endif /* deployment_config_h */
@@ -8,26 +8,469 @@
  */
 
 #include "deployment.h"
-#include <math.h>
 #include "variant-test.h"
 #include "gpio-test.h"
+#include "trace.h"
+
+#include <math.h>
+
+#if defined(ENABLE_ATTITUDE) && defined(FIXED_POINT_ALTITUDE)
+/* The estimator works in floating point, which FIXED_POINT_ALTITUDE keeps out
+   of deployment.c */
+#error "ENABLE_ATTITUDE cannot be used with FIXED_POINT_ALTITUDE"
+#endif
+
+/* Weight of each new sample in the vertical velocity filter is 1/n */
+#define VELOCITY_FILTER_DIV 8
+
+static inline uint64_t accel_magnitude_sq(
+                                    const struct mpu9250_sample *const sample)
+{
+    const int32_t x = sample->accel[0];
+    const int32_t y = sample->accel[1];
+    const int32_t z = sample->accel[2];
+
+    return (uint64_t)(x * x) + (uint64_t)(y * y) + (uint64_t)(z * z);
+}
+
+static inline uint64_t gyro_magnitude_sq(
+                                    const struct mpu9250_sample *const sample)
+{
+    const int32_t x = sample->gyro[0];
+    const int32_t y = sample->gyro[1];
+    const int32_t z = sample->gyro[2];
+
+    return (uint64_t)(x * x) + (uint64_t)(y * y) + (uint64_t)(z * z);
+}
+
+/**
+ *  Convert an altitude to the Q16.16 meters used by the running statistics.
+ */
+static inline int32_t alt_to_q16(ms5611_alt_t altitude)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return altitude;
+#else
+    return (int32_t)lrintf(altitude * 65536.0f);
+#endif
+}
+
+static inline ms5611_alt_t alt_from_q16(int32_t altitude)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return altitude;
+#else
+    return (float)altitude / 65536.0f;
+#endif
+}
+
+/** A standard deviation in meters as Q16.16 meters, folded at compile time */
+#define STDDEV_Q16(m) ((uint64_t)((m) * 65536))
+
+/**
+ *  Convert a rotation rate in thousandths of a degree per second to
+ *  1/DEPLOYMENT_GYRO_BIAS_SCALE LSB.
+ */
+static inline uint64_t gyro_from_mdps(uint32_t mdps,
+                                      const struct mpu9250_desc_t *imu)
+{
+    // mpu9250_gyro_sensitivity() is in LSB per 1000 dps
+    return (((uint64_t)mdps * mpu9250_gyro_sensitivity(imu) *
+             DEPLOYMENT_GYRO_BIAS_SCALE) / 1000000);
+}
+
+#ifdef ENABLE_PAD_BASELINE
+static void init_baseline(struct deployment_baseline *b,
+                          const struct mpu9250_desc_t *imu)
+{
+    running_stats_reset(&b->alt);
+    for (uint8_t i = 0; i < 3; i++) {
+        running_stats_reset(&b->gyro[i]);
+        b->gyro_bias[i] = 0;
+    }
+    b->alt_start = 0;
+    b->gyro_start = 0;
+    b->alt_max_var = (STDDEV_Q16(DEPLOYMENT_BASELINE_ALT_STDDEV) *
+                      STDDEV_Q16(DEPLOYMENT_BASELINE_ALT_STDDEV));
+    const uint64_t gyro_stddev = gyro_from_mdps(
+                    (uint32_t)(DEPLOYMENT_BASELINE_GYRO_STDDEV * 1000), imu);
+    b->gyro_max_var = gyro_stddev * gyro_stddev;
+    b->ground_altitude = MS5611_ALT(0);
+    b->alt_windows = 0;
+    b->gyro_windows = 0;
+}
+
+/**
+ *  Add an altimeter reading to the pad baseline. At the end of each window
+ *  the ground altitude is replaced if the altitude was steady, and the
+ *  altitudes which have already been processed are moved to the new ground
+ *  level so that the velocity and descent tracking do not see a step.
+ */
+static void baseline_baro_sample(struct deployment_service_desc_t *inst,
+                                 uint32_t time, ms5611_alt_t altitude)
+{
+    struct deployment_baseline *const b = &inst->baseline;
+
+    if (b->alt.count == 0) {
+        b->alt_start = time;
+    }
+    running_stats_add(&b->alt, alt_to_q16(altitude));
+    if ((time - b->alt_start) < DEPLOYMENT_BASELINE_WINDOW) {
+        return;
+    }
+
+    if (running_stats_variance(&b->alt) <= b->alt_max_var) {
+        const ms5611_alt_t ground = alt_from_q16(
+                                    (int32_t)running_stats_mean(&b->alt));
+        const ms5611_alt_t change = ground - b->ground_altitude;
+        b->ground_altitude = ground;
+        inst->max_altitude -= change;
+        inst->last_altitude -= change;
+        inst->sample_altitude -= change;
+        if (b->alt_windows < UINT16_MAX) {
+            b->alt_windows++;
+        }
+    }
+    running_stats_reset(&b->alt);
+}
+
+/**
+ *  Add an IMU sample to the pad baseline. At the end of each window the gyro
+ *  bias is replaced if no axis moved.
+ */
+static void baseline_gyro_sample(struct deployment_baseline *b,
+                                 const struct mpu9250_sample *sample)
+{
+    if (b->gyro[0].count == 0) {
+        b->gyro_start = sample->time;
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        running_stats_add(&b->gyro[i], ((int32_t)sample->gyro[i] *
+                                        DEPLOYMENT_GYRO_BIAS_SCALE));
+    }
+    if ((sample->time - b->gyro_start) < DEPLOYMENT_BASELINE_WINDOW) {
+        return;
+    }
+
+    if ((running_stats_variance(&b->gyro[0]) <= b->gyro_max_var) &&
+            (running_stats_variance(&b->gyro[1]) <= b->gyro_max_var) &&
+            (running_stats_variance(&b->gyro[2]) <= b->gyro_max_var)) {
+        for (uint8_t i = 0; i < 3; i++) {
+            b->gyro_bias[i] = (int32_t)running_stats_mean(&b->gyro[i]);
+        }
+        if (b->gyro_windows < UINT16_MAX) {
+            b->gyro_windows++;
+        }
+    }
+    for (uint8_t i = 0; i < 3; i++) {
+        running_stats_reset(&b->gyro[i]);
+    }
+}
+#endif
+
+static void init_landing(struct deployment_landing *l,
+                         const struct mpu9250_desc_t *imu)
+{
+    running_stats_reset(&l->alt);
+    running_stats_reset(&l->accel);
+    running_stats_reset(&l->gyro);
+    l->start = 0;
+    l->last_mean = 0;
+    l->last_end = 0;
+    const uint64_t accel_stddev = ((uint64_t)(DEPLOYMENT_LANDED_ACCEL_STDDEV *
+                                              1000) *
+                                   mpu9250_accel_sensitivity(imu)) / 1000;
+    l->accel_max_var = accel_stddev * accel_stddev;
+    const uint64_t gyro_stddev = gyro_from_mdps(
+                    (uint32_t)(DEPLOYMENT_LANDED_GYRO_STDDEV * 1000), imu) /
+                                        DEPLOYMENT_GYRO_BIAS_SCALE;
+    l->gyro_max_var = gyro_stddev * gyro_stddev;
+    l->time = 0;
+    l->have_last = 0;
+    l->landed = 0;
+}
+
+/**
+ *  Add an IMU sample to the current landing detection window. Magnitudes are
+ *  used so that the result does not depend on how the rocket lies, squared so
+ *  that no square roots are needed.
+ */
+static inline void landing_imu_sample(struct deployment_landing *l,
+                                      const struct mpu9250_sample *sample)
+{
+    running_stats_add(&l->accel, (int64_t)accel_magnitude_sq(sample));
+    running_stats_add(&l->gyro, (int64_t)gyro_magnitude_sq(sample));
+}
+
+/**
+ *  Check whether the magnitude of a vector was steady over a window from the
+ *  statistics of its squared magnitude. For small changes the variance of the
+ *  squared magnitude is 4 * |v|^2 * var(|v|), which also holds closely enough
+ *  when the magnitude is only noise.
+ *
+ *  @param stats Statistics of the squared magnitude in LSB^2
+ *  @param max_var Largest variance of the magnitude in LSB^2
+ */
+static inline int magnitude_steady(const struct running_stats *stats,
+                                   uint64_t max_var)
+{
+    const int64_t mean_sq = running_stats_mean(stats);
+    return running_stats_variance(stats) <= (4 * (uint64_t)mean_sq * max_var);
+}
+
+/** DEPLOYMENT_LANDED_VELOCITY in Q16.16 meters per second */
+#define LANDED_VELOCITY_Q16 ((int64_t)(DEPLOYMENT_LANDED_VELOCITY * 65536))
+
+/**
+ *  Add an altimeter reading to the current landing detection window. At the
+ *  end of each window landing is detected if the altitude and the IMU were
+ *  steady over the window and the mean altitude has stopped changing. While
+ *  the IMU is stalled only the altitude is used, so that landing is still
+ *  detected if the IMU fails during the descent.
+ */
+static void landing_baro_sample(struct deployment_service_desc_t *inst,
+                                uint32_t time, ms5611_alt_t altitude)
+{
+    struct deployment_landing *const l = &inst->landing;
+
+    if (l->alt.count == 0) {
+        l->start = time;
+    }
+    running_stats_add(&l->alt, alt_to_q16(altitude));
+    if ((time - l->start) < inst->params.landed_window) {
+        return;
+    }
+
+    // A window without IMU samples from a working IMU does not show that the
+    // rocket is still
+    const int imu_stalled = (deployment_imu_age(inst) >
+                             DEPLOYMENT_IMU_MAX_AGE);
+    const int imu_still = ((l->accel.count >= 2) &&
+                           magnitude_steady(&l->accel, l->accel_max_var) &&
+                           magnitude_steady(&l->gyro, l->gyro_max_var));
+    const int still = ((imu_stalled || imu_still) &&
+                       (running_stats_variance(&l->alt) <=
+                            inst->params.landed_alt_max_var));
+    const int32_t mean = (int32_t)running_stats_mean(&l->alt);
+    if (still && l->have_last) {
+        const int64_t change = (int64_t)mean - l->last_mean;
+        if ((((change < 0) ? -change : change) * 1000) <=
+                (LANDED_VELOCITY_Q16 * (int64_t)(time - l->last_end))) {
+            l->landed = 1;
+            l->time = time;
+        }
+    }
+
+    l->last_mean = mean;
+    l->last_end = time;
+    l->have_last = 1;
+    running_stats_reset(&l->alt);
+    running_stats_reset(&l->accel);
+    running_stats_reset(&l->gyro);
+}
+
+/**
+ *  Called for every IMU sample, including each sample in a FIFO burst. Keeps a
+ *  running k of n count of the samples which pass the acceleration test for
+ *  the current state.
+ */
+static void deployment_accel_sample(struct deployment_service_desc_t *inst,
+                                    const struct mpu9250_sample *sample)
+{
+    inst->imu_sample_time = sample->time;
+#ifdef ENABLE_PAD_BASELINE
+    if (inst->state <= DEPLOYMENT_STATE_ARMED) {
+        baseline_gyro_sample(&inst->baseline, sample);
+    }
+#endif
+#ifdef ENABLE_ATTITUDE
+    attitude_update(&inst->attitude, sample);
+#endif
+
+    int pass;
+    switch (inst->state) {
+        case DEPLOYMENT_STATE_ARMED:
+            pass = accel_magnitude_sq(sample) > inst->params.launch_accel_sq;
+            break;
+        case DEPLOYMENT_STATE_POWERED_ASCENT:
+            pass = accel_magnitude_sq(sample) <= inst->params.coast_accel_sq;
+            break;
+        case DEPLOYMENT_STATE_MAIN_DESCENT:
+            landing_imu_sample(&inst->landing, sample);
+            return;
+        default:
+            return;
+    }
+
+    const uint32_t oldest = ((inst->accel_window >>
+                              inst->params.accel_window_oldest) & 1);
+    inst->accel_window = (((inst->accel_window << 1) | (uint32_t)pass) &
+                          inst->params.accel_window_mask);
+    inst->accel_window_count = (uint8_t)(inst->accel_window_count + pass -
+                                         oldest);
+}
+
+/**
+ *  Convert a length in millimeters from a configuration record to the altitude
+ *  representation.
+ */
+static inline ms5611_alt_t alt_from_mm(int32_t mm)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return (ms5611_alt_t)((((int64_t)mm) * 65536) / 1000);
+#else
+    return (ms5611_alt_t)mm / 1000.0f;
+#endif
+}
+
+/**
+ *  Convert an acceleration in mg from a configuration record to a squared
+ *  magnitude in LSB^2.
+ */
+static inline uint64_t accel_sq_from_mg(uint32_t mg, uint16_t sensitivity)
+{
+    const uint64_t lsb = (((uint64_t)mg * sensitivity) + 500) / 1000;
+    return lsb * lsb;
+}
+
+enum deployment_config_status deployment_apply_config(
+                                    struct deployment_service_desc_t *inst,
+                                    const struct deployment_config *config)
+{
+    const enum deployment_config_status status = deployment_config_check(
+                                        config, deployment_num_pyro_events_g);
+    if (status != DEPLOYMENT_CONFIG_OK) {
+        return status;
+    }
+
+    struct deployment_params *const p = &inst->params;
+    const uint16_t sensitivity = mpu9250_accel_sensitivity(inst->mpu9250_imu);
+
+    p->launch_accel_sq = accel_sq_from_mg(config->launch_accel, sensitivity);
+    p->coast_accel_sq = accel_sq_from_mg(config->burnout_accel, sensitivity);
+    p->launch_altitude = alt_from_mm(config->launch_altitude);
+    p->burnout_altitude = alt_from_mm(config->burnout_altitude);
+    p->coast_min_altitude = alt_from_mm(config->coast_min_altitude);
+    const uint64_t landed_alt_stddev = (((uint64_t)config->landed_alt_stddev *
+                                         65536) / 1000);
+    p->landed_alt_max_var = landed_alt_stddev * landed_alt_stddev;
+    p->accel_window_mask = (uint32_t)((1ULL << config->accel_window_length) -
+                                      1);
+    p->accel_window_oldest = (uint8_t)(config->accel_window_length - 1);
+    p->landed_window = config->landed_window;
+    p->launch_window_count = config->launch_window_count;
+    p->burnout_window_count = config->burnout_window_count;
+    p->descending_samples = config->descending_samples;
+
+    for (uint8_t i = 0; i < config->num_pyro; i++) {
+        p->pyro[i].altitude = alt_from_mm(config->pyro[i].altitude);
+        p->pyro[i].velocity = alt_from_mm(config->pyro[i].velocity);
+        p->pyro[i].delay = config->pyro[i].delay;
+        p->pyro[i].duration = config->pyro[i].duration;
+    }
+
+    // The window may have changed length
+    inst->accel_window = 0;
+    inst->accel_window_count = 0;
+
+    return DEPLOYMENT_CONFIG_OK;
+}
+
+/**
+ *  Ask the IMU driver for the sampling mode used in a state.
+ */
+static inline void request_imu_mode(struct deployment_service_desc_t *inst,
+                                    enum deployment_service_state state)
+{
+#ifdef DEPLOYMENT_IMU_INTERRUPT_STATES
+    mpu9250_request_fifo(inst->mpu9250_imu,
+                         !(DEPLOYMENT_IMU_INTERRUPT_STATES &
+                           DEPLOYMENT_STATE_BIT(state)));
+#else
+    (void)inst;
+    (void)state;
+#endif
+}
 
 void init_deployment(struct deployment_service_desc_t *const inst,
-                     struct ms5611_desc_t *const ms5611_alt,
+                     struct sensor_bus_topic *const baro_topic,
                      struct mpu9250_desc_t *const mpu9250_imu)
 {
     inst->state = DEPLOYMENT_STATE_IDLE;
 
-    inst->ms5611_alt = ms5611_alt;
     inst->mpu9250_imu = mpu9250_imu;
-    inst->max_altitude = 0.0f;
+    inst->max_altitude = MS5611_ALT(0);
+    inst->last_altitude = MS5611_ALT(0);
     inst->last_sample_time = 0;
+    inst->imu_sample_time = 0;
+    inst->sample_altitude = MS5611_ALT(0);
+    inst->vertical_velocity = MS5611_ALT(0);
+    inst->state_time = millis;
     inst->decending_sample_count = 0;
+    inst->peer = NULL;
+
+    // Use the stored configuration if there is a valid one
+    struct deployment_config config;
+    inst->config_status = deployment_config_load(&config);
+    if (inst->config_status == DEPLOYMENT_CONFIG_OK) {
+        inst->config_status = deployment_apply_config(inst, &config);
+    }
+    if (inst->config_status != DEPLOYMENT_CONFIG_OK) {
+        deployment_config_defaults(&config);
+        deployment_apply_config(inst, &config);
+    }
+    inst->accel_window = 0;
+    inst->accel_window_count = 0;
+
+#ifdef ENABLE_ATTITUDE
+    init_attitude(&inst->attitude, mpu9250_imu, IMU_AG_SAMPLE_RATE);
+#endif
+#ifdef ENABLE_PAD_BASELINE
+    init_baseline(&inst->baseline, mpu9250_imu);
+#endif
+    init_landing(&inst->landing, mpu9250_imu);
+
+    init_sensor_bus_cursor(&inst->baro_cursor, baro_topic);
+    init_sensor_bus_cursor(&inst->imu_cursor, mpu9250_imu->topic);
+
+    // Build the mask of pyro events which can fire in each state
+    for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+        inst->pyro_state_events[s] = 0;
+    }
+    for (uint8_t i = 0; i < deployment_num_pyro_events_g; i++) {
+        for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+            if (deployment_pyro_events_g[i].states & DEPLOYMENT_STATE_BIT(s)) {
+                inst->pyro_state_events[s] |= (uint16_t)(1 << i);
+            }
+        }
+    }
+    inst->pyro_fired = 0;
+    inst->pyro_active = 0;
+
+    request_imu_mode(inst, inst->state);
 }
 
 
 
 
+static inline void set_state(struct deployment_service_desc_t *const inst,
+                             enum deployment_service_state state)
+{
+    inst->state = state;
+    inst->state_time = millis;
+    request_imu_mode(inst, state);
+    // Acceleration test depends on state, start over with a new window
+    inst->accel_window = 0;
+    inst->accel_window_count = 0;
+    TRACE(TRACE_DEPLOYMENT_STATE, 0, state);
+}
+
+static inline void set_ematch(uint8_t pin, uint8_t value)
+{
+    gpio_set_output(pin, value);
+    TRACE(TRACE_GPIO, pin, value);
+}
+
 static inline int is_armed(void)
 {
 #ifdef ARMED_SENSE_PIN
@@ -37,142 +480,264 @@ static inline int is_armed(void)
 #endif
 }
 
-static inline int test_abs_acceleration(
-                                const struct mpu9250_desc_t *const mpu9250_imu,
-                                uint32_t threashold)
-{
-    const uint16_t x = mpu9250_get_accel_x(mpu9250_imu);
-    const uint16_t y = mpu9250_get_accel_y(mpu9250_imu);
-    const uint16_t z = mpu9250_get_accel_z(mpu9250_imu);
-
-    int64_t abs = ((int64_t)((int32_t)x * x) + (int64_t)((int32_t)y * y) +
-                   (int64_t)((int32_t)z * z));
-    threashold *= mpu9250_accel_sensitivity(mpu9250_imu);
 
-    return abs > (threashold * threashold);
-}
-
-static inline int is_decending(struct deployment_service_desc_t *const inst)
+/**
+ *  Process an altimeter reading. Tracks the maximum altitude, the number of
+ *  samples since the maximum, the vertical velocity and, after the main
+ *  parachute is out, landing detection.
+ */
+static void deployment_baro_sample(struct deployment_service_desc_t *inst,
+                                   const struct ms5611_sample *sample)
 {
-#ifdef ENABLE_DEPLOYMENT_SERVICE
-    // Check if we have a new sample
-    const uint32_t alt_time = ms5611_get_last_reading_time(inst->ms5611_alt);
-    if (alt_time <= inst->last_sample_time) {
-        return 0;
+#ifdef ENABLE_PAD_BASELINE
+    // Altitudes are relative to the most recent ground altitude
+    if (inst->state <= DEPLOYMENT_STATE_ARMED) {
+        baseline_baro_sample(inst, sample->time, sample->altitude);
     }
-    inst->last_sample_time = alt_time;
+    const ms5611_alt_t altitude = (sample->altitude -
+                                   inst->baseline.ground_altitude);
+#else
+    const ms5611_alt_t altitude = sample->altitude;
+#endif
+
+    if ((inst->last_sample_time != 0) &&
+            (sample->time != inst->last_sample_time)) {
+        const uint32_t dt = sample->time - inst->last_sample_time;
+#ifdef FIXED_POINT_ALTITUDE
+        const ms5611_alt_t v = (ms5611_alt_t)(((int64_t)(altitude -
+                                                inst->sample_altitude) * 1000) /
+                                              dt);
+#else
+        const ms5611_alt_t v = ((altitude - inst->sample_altitude) * 1000.0f) /
+                                    dt;
+#endif
+        inst->vertical_velocity += (v - inst->vertical_velocity) /
+                                        VELOCITY_FILTER_DIV;
+    }
+    inst->last_sample_time = sample->time;
+    inst->sample_altitude = altitude;
 
     // Check if the new sample is the highest we have been
-    const float altitude = ms5611_get_altitude(inst->ms5611_alt);
     if (altitude >= inst->max_altitude) {
         inst->max_altitude = altitude;
         inst->decending_sample_count = 0;
-        return 0;
+    } else if (inst->decending_sample_count < UINT8_MAX) {
+        // This sample is less than our highest
+        inst->decending_sample_count++;
     }
 
-    // This sample is less than our highest
-    inst->decending_sample_count++;
+    if (inst->state == DEPLOYMENT_STATE_MAIN_DESCENT) {
+        landing_baro_sample(inst, sample->time, altitude);
+    }
+}
+
+/**
+ *  Consume every sample published by the altimeter and IMU since the last
+ *  pass.
+ */
+static inline void consume_samples(struct deployment_service_desc_t *inst)
+{
+    // Drivers publish from the main loop, so records can be used in place
+    const struct mpu9250_sample *imu_sample;
+    while ((imu_sample = sensor_bus_peek(&inst->imu_cursor)) != NULL) {
+        deployment_accel_sample(inst, imu_sample);
+        sensor_bus_advance(&inst->imu_cursor);
+    }
 
+    const struct ms5611_sample *baro_sample;
+    while ((baro_sample = sensor_bus_peek(&inst->baro_cursor)) != NULL) {
+        deployment_baro_sample(inst, baro_sample);
+        sensor_bus_advance(&inst->baro_cursor);
+    }
+}
+
+static inline int is_decending(struct deployment_service_desc_t *const inst)
+{
     // Check if we have enough samples to be sure we are decending
     return (inst->decending_sample_count >
-            DEPLOYMENT_DESCENDING_SAMPLE_THREASHOLD);
-#else
-    return 0;
-#endif
+            inst->params.descending_samples);
 }
 
 static inline int is_landed(struct deployment_service_desc_t *const inst)
 {
-#ifdef ENABLE_DEPLOYMENT_SERVICE
-    // Check if we have a new sample
-    const uint32_t alt_time = ms5611_get_last_reading_time(inst->ms5611_alt);
-    if (alt_time <= inst->last_sample_time) {
+    return inst->landing.landed;
+}
+
+static inline int pyro_conditions_met(
+                            struct deployment_service_desc_t *const inst,
+                            const struct deployment_pyro_event *const event,
+                            const struct deployment_pyro_params *const param,
+                            ms5611_alt_t altitude)
+{
+    const uint8_t cond = event->conditions;
+
+    // A stalled altimeter leaves the altitude frozen, only events which do not
+    // depend on it can fire until readings resume
+    if ((cond & DEPLOYMENT_PYRO_ALTIMETER_CONDITIONS) &&
+            (deployment_baro_age(inst) > DEPLOYMENT_BARO_MAX_AGE)) {
         return 0;
     }
-    inst->last_sample_time = alt_time;
 
-    // Check if the new sample is close to the last sample we saw
-    const float altitude = ms5611_get_altitude(inst->ms5611_alt);
-    if (fabsf(inst->last_altitude - altitude) > DEPLOYMENT_LANDED_ALT_CHANGE) {
-        inst->landing_sample_count = 0;
+    if ((cond & DEPLOYMENT_PYRO_BELOW_ALT) &&
+            !(altitude <= param->altitude)) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_ABOVE_ALT) &&
+            !(altitude > param->altitude)) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_DESCENDING) && !is_decending(inst)) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_BELOW_VELOCITY) &&
+            !(inst->vertical_velocity <= param->velocity)) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_AFTER_EVENT) &&
+            (!(inst->pyro_fired & (1 << event->ref_event)) ||
+             ((millis - inst->pyro_fire_time[event->ref_event]) <
+                    param->delay))) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_PEER_NOT_FIRED) && (inst->peer != NULL) &&
+            (peer_link_fired(inst->peer) & (1 << event->ref_event))) {
+        return 0;
+    }
+    if ((cond & DEPLOYMENT_PYRO_AFTER_STATE) &&
+            ((millis - inst->state_time) < param->delay)) {
+        return 0;
+    }
+#ifdef ENABLE_ATTITUDE
+    if ((cond & DEPLOYMENT_PYRO_UPRIGHT) &&
+            !(attitude_cos_tilt(&inst->attitude) >=
+                    DEPLOYMENT_UPRIGHT_COS_TILT)) {
         return 0;
     }
-
-    inst->landing_sample_count++;
-
-    // Check if we have enough samples to be sure we have landed
-    return inst->landing_sample_count > DEPLOYMENT_LANDED_SAMPLE_THREASHOLD;
 #else
-    return 0;
+    if (cond & DEPLOYMENT_PYRO_UPRIGHT) {
+        return 0;
+    }
 #endif
+    return 1;
+}
+
+/**
+ *  Evaluate the pyro event table. Only events which are on, or which can fire
+ *  in the current state and have not fired yet, are looked at.
+ */
+static void pyro_service(struct deployment_service_desc_t *const inst,
+                         ms5611_alt_t altitude)
+{
+    // Turn off channels which have been on for long enough
+    uint16_t active = inst->pyro_active;
+    while (active != 0) {
+        const uint8_t i = (uint8_t)__builtin_ctz(active);
+        active &= (uint16_t)(active - 1);
+
+        const struct deployment_pyro_event *const event =
+                                                &deployment_pyro_events_g[i];
+        if ((millis - inst->pyro_fire_time[i]) <=
+                inst->params.pyro[i].duration) {
+            continue;
+        }
+        set_ematch(event->pin, 0);
+        inst->pyro_active &= (uint16_t)~(1 << i);
+        if (event->done_state != DEPLOYMENT_PYRO_KEEP_STATE) {
+            set_state(inst, event->done_state);
+        }
+    }
+
+    // Fire events whose conditions are met
+    uint16_t candidates = (inst->pyro_state_events[inst->state] &
+                           (uint16_t)~inst->pyro_fired);
+    while (candidates != 0) {
+        const uint8_t i = (uint8_t)__builtin_ctz(candidates);
+        candidates &= (uint16_t)(candidates - 1);
+
+        const struct deployment_pyro_event *const event =
+                                                &deployment_pyro_events_g[i];
+        if (!pyro_conditions_met(inst, event, &inst->params.pyro[i],
+                                 altitude)) {
+            continue;
+        }
+        set_ematch(event->pin, 1);
+        inst->pyro_fire_time[i] = millis;
+        inst->pyro_fired |= (uint16_t)(1 << i);
+        inst->pyro_active |= (uint16_t)(1 << i);
+        if (event->fire_state != DEPLOYMENT_PYRO_KEEP_STATE) {
+            // The candidates were chosen for the old state
+            set_state(inst, event->fire_state);
+            break;
+        }
+    }
 }
 
 void deployment_service(struct deployment_service_desc_t *const inst)
 {
 #ifdef ENABLE_DEPLOYMENT_SERVICE
+    consume_samples(inst);
+
+    // While the IMU is stalled launch and burnout are only detected by the
+    // backup altitude thresholds
+    if (deployment_imu_age(inst) > DEPLOYMENT_IMU_MAX_AGE) {
+        inst->accel_window = 0;
+        inst->accel_window_count = 0;
+    }
+
     switch (inst->state) {
         case DEPLOYMENT_STATE_IDLE:
             if (is_armed()) {
-                inst->state = DEPLOYMENT_STATE_ARMED;
+                set_state(inst, DEPLOYMENT_STATE_ARMED);
             }
             break;
         case DEPLOYMENT_STATE_ARMED:
-            inst->last_altitude = ms5611_get_altitude(inst->ms5611_alt);
-            if (test_abs_acceleration(inst->mpu9250_imu,
-                                DEPLOYMENT_POWERED_ASCENT_ACCEL_THREASHOLD) ||
+            inst->last_altitude = inst->sample_altitude;
+            if ((inst->accel_window_count >=
+                                    inst->params.launch_window_count) ||
                 inst->last_altitude >
-                                DEPLOYMENT_POWERED_ASCENT_ALT_THREASHOLD) {
-                inst->state = DEPLOYMENT_STATE_POWERED_ASCENT;
+                                inst->params.launch_altitude) {
+                set_state(inst, DEPLOYMENT_STATE_POWERED_ASCENT);
+#ifdef ENABLE_ATTITUDE
+                // Attitude is integrated from the gyro from here on, starting
+                // with the bias measured on the pad
+#ifdef ENABLE_PAD_BASELINE
+                const float bias[3] = {
+                    (float)inst->baseline.gyro_bias[0] /
+                                            DEPLOYMENT_GYRO_BIAS_SCALE,
+                    (float)inst->baseline.gyro_bias[1] /
+                                            DEPLOYMENT_GYRO_BIAS_SCALE,
+                    (float)inst->baseline.gyro_bias[2] /
+                                            DEPLOYMENT_GYRO_BIAS_SCALE
+                };
+                attitude_set_gyro_bias(&inst->attitude, bias);
+#endif
+                attitude_launch(&inst->attitude);
+#endif
             }
             break;
         case DEPLOYMENT_STATE_POWERED_ASCENT:
-            inst->last_altitude = ms5611_get_altitude(inst->ms5611_alt);
-            if (!test_abs_acceleration(inst->mpu9250_imu,
-                                DEPLOYMENT_COASTING_ASCENT_ACCEL_THREASHOLD) ||
+            inst->last_altitude = inst->sample_altitude;
+            if ((inst->accel_window_count >=
+                                    inst->params.burnout_window_count) ||
                 inst->last_altitude >
-                                DEPLOYMENT_COASTING_ASCENT_ALT_THREASHOLD) {
+                                inst->params.burnout_altitude) {
                 if (inst->last_altitude >
-                    DEPLOYMENT_COASTING_ASCENT_ALT_MINIMUM) {
+                    inst->params.coast_min_altitude) {
 
-                    inst->state = DEPLOYMENT_STATE_COASTING_ASCENT;
+                    set_state(inst, DEPLOYMENT_STATE_COASTING_ASCENT);
                 }
             }
             break;
         case DEPLOYMENT_STATE_COASTING_ASCENT:
-            inst->last_altitude = ms5611_get_altitude(inst->ms5611_alt);
-            if (inst->last_altitude <= DROGUE_DEPLOY_ALTITUDE &&
-                                                        is_decending(inst)) {
-                gpio_set_output(DROGUE_EMATCH_PIN, 1);
-                inst->deployment_time = millis;
-                inst->state = DEPLOYMENT_STATE_DROGUE_DEPLOY;
-            }
-            break;
-        case DEPLOYMENT_STATE_DROGUE_DEPLOY:
-            if ((millis - inst->deployment_time) >
-                    DEPLOYMENT_EMATCH_FIRE_DURATION) {
-                gpio_set_output(DROGUE_EMATCH_PIN, 0);
-                inst->state = DEPLOYMENT_STATE_DROGUE_DESCENT;
-            }
-            break;
         case DEPLOYMENT_STATE_DROGUE_DESCENT:
-            inst->last_altitude = ms5611_get_altitude(inst->ms5611_alt);
-            if (inst->last_altitude <= MAIN_DEPLOY_ALTITUDE &&
-                                                        is_decending(inst)) {
-                gpio_set_output(MAIN_EMATCH_PIN, 1);
-                inst->deployment_time = millis;
-                inst->state = DEPLOYMENT_STATE_MAIN_DEPLOY;
-            }
+            inst->last_altitude = inst->sample_altitude;
             break;
+        case DEPLOYMENT_STATE_DROGUE_DEPLOY:
         case DEPLOYMENT_STATE_MAIN_DEPLOY:
-            if ((millis - inst->deployment_time) >
-                    DEPLOYMENT_EMATCH_FIRE_DURATION) {
-                gpio_set_output(MAIN_EMATCH_PIN, 0);
-                inst->state = DEPLOYMENT_STATE_MAIN_DESCENT;
-            }
             break;
         case DEPLOYMENT_STATE_MAIN_DESCENT:
             if (is_landed(inst)) {
-                inst->state = DEPLOYMENT_STATE_RECOVERY;
+                set_state(inst, DEPLOYMENT_STATE_RECOVERY);
             }
             break;
         case DEPLOYMENT_STATE_RECOVERY:
@@ -180,6 +745,10 @@ void deployment_service(struct deployment_service_desc_t *const inst)
         default:
             break;
     }
+
+    // Pyro events are evaluated after the state machine so that an event can
+    // fire in the same pass as the state change which enables it
+    pyro_service(inst, inst->sample_altitude);
 #else
     return;
 #endif
@@ -13,6 +13,11 @@
 #include "test-global.h"
 #include "ms5611-test.h"
 #include "mpu9250-test.h"
+#include "sensor-bus.h"
+#include "deployment-config.h"
+#include "attitude.h"
+#include "running-stats.h"
+#include "peer-link.h"
 
 enum deployment_service_state {
     DEPLOYMENT_STATE_IDLE = 0x0,
@@ -23,39 +28,291 @@ enum deployment_service_state {
     DEPLOYMENT_STATE_DROGUE_DESCENT,
     DEPLOYMENT_STATE_MAIN_DEPLOY,
     DEPLOYMENT_STATE_MAIN_DESCENT,
-    DEPLOYMENT_STATE_RECOVERY
+    DEPLOYMENT_STATE_RECOVERY,
+    DEPLOYMENT_NUM_STATES
+};
+
+/** Bit for a deployment state in a pyro event state mask */
+#define DEPLOYMENT_STATE_BIT(s) ((uint16_t)(1 << (s)))
+
+/** Pyro event state value which leaves the deployment state unchanged */
+#define DEPLOYMENT_PYRO_KEEP_STATE DEPLOYMENT_STATE_IDLE
+
+/** Maximum number of entries in the pyro event table */
+#define DEPLOYMENT_MAX_PYRO_EVENTS DEPLOYMENT_CONFIG_PYRO_SLOTS
+
+/**
+ *  Conditions which must all be met for a pyro event to fire.
+ */
+enum deployment_pyro_condition {
+    /** Altitude is at or below the event altitude */
+    DEPLOYMENT_PYRO_BELOW_ALT = (1 << 0),
+    /** Altitude is above the event altitude */
+    DEPLOYMENT_PYRO_ABOVE_ALT = (1 << 1),
+    /** Descent has been seen for DEPLOYMENT_DESCENDING_SAMPLE_THREASHOLD
+        altimeter samples */
+    DEPLOYMENT_PYRO_DESCENDING = (1 << 2),
+    /** Vertical velocity is at or below the event velocity */
+    DEPLOYMENT_PYRO_BELOW_VELOCITY = (1 << 3),
+    /** At least delay milliseconds have passed since ref_event fired */
+    DEPLOYMENT_PYRO_AFTER_EVENT = (1 << 4),
+    /** At least delay milliseconds have passed since the current state was
+        entered */
+    DEPLOYMENT_PYRO_AFTER_STATE = (1 << 5),
+    /** Tilt from vertical is within DEPLOYMENT_UPRIGHT_COS_TILT, never met
+        without ENABLE_ATTITUDE */
+    DEPLOYMENT_PYRO_UPRIGHT = (1 << 6),
+    /** No other flight computer has reported firing ref_event, always met
+        without a peer link (see deployment_set_peer()) */
+    DEPLOYMENT_PYRO_PEER_NOT_FIRED = (1 << 7)
+};
+
+/** Conditions which need the altimeter to have a new sample */
+#define DEPLOYMENT_PYRO_BARO_CONDITIONS (DEPLOYMENT_PYRO_DESCENDING | \
+                                         DEPLOYMENT_PYRO_BELOW_VELOCITY)
+
+/** Conditions which are never met while the most recent altimeter sample is
+    older than DEPLOYMENT_BARO_MAX_AGE */
+#define DEPLOYMENT_PYRO_ALTIMETER_CONDITIONS (DEPLOYMENT_PYRO_BELOW_ALT | \
+                                              DEPLOYMENT_PYRO_ABOVE_ALT | \
+                                              DEPLOYMENT_PYRO_BARO_CONDITIONS)
+
+/**
+ *  An entry in the pyro event table. Each event fires at most once per flight,
+ *  the first time that the deployment service is in one of the event's states
+ *  and all of the event's conditions are met. The altitude, velocity, delay
+ *  and duration given here are the defaults for the configuration record.
+ */
+struct deployment_pyro_event {
+    /** Altitude threashold for DEPLOYMENT_PYRO_BELOW_ALT or
+        DEPLOYMENT_PYRO_ABOVE_ALT in millimeters */
+    int32_t altitude;
+    /** Vertical velocity threashold for DEPLOYMENT_PYRO_BELOW_VELOCITY in
+        millimeters per second, positive upwards */
+    int32_t velocity;
+    /** Delay for DEPLOYMENT_PYRO_AFTER_EVENT or DEPLOYMENT_PYRO_AFTER_STATE in
+        milliseconds */
+    uint32_t delay;
+    /** Mask of states in which the event can fire */
+    uint16_t states;
+    /** Length of time that the channel is held on in milliseconds */
+    uint16_t duration;
+    /** Conditions, from enum deployment_pyro_condition */
+    uint8_t conditions;
+    /** Index of the event used by DEPLOYMENT_PYRO_AFTER_EVENT and
+        DEPLOYMENT_PYRO_PEER_NOT_FIRED */
+    uint8_t ref_event;
+    /** Pyro channel GPIO pin */
+    uint8_t pin;
+    /** State entered when the event fires */
+    uint8_t fire_state;
+    /** State entered when the channel is turned off again */
+    uint8_t done_state;
+};
+
+/** Pyro event parameters from the configuration record */
+struct deployment_pyro_params {
+    ms5611_alt_t altitude;
+    ms5611_alt_t velocity;
+    uint32_t delay;
+    uint16_t duration;
+};
+
+/**
+ *  Constants derived from the configuration record, in the units used on the
+ *  hot path.
+ */
+struct deployment_params {
+    /** Squared acceleration magnitude above which a sample counts towards
+        launch detection in LSB^2 */
+    uint64_t launch_accel_sq;
+    /** Squared acceleration magnitude at or below which a sample counts
+        towards burnout detection in LSB^2 */
+    uint64_t coast_accel_sq;
+    /** Backup launch detection altitude */
+    ms5611_alt_t launch_altitude;
+    /** Backup burnout detection altitude */
+    ms5611_alt_t burnout_altitude;
+    /** Minimum altitude for burnout detection */
+    ms5611_alt_t coast_min_altitude;
+    /** Largest altitude variance over a landing detection window for the
+        window to count as still in Q16.16 meters squared */
+    uint64_t landed_alt_max_var;
+    /** Mask of the bits of accel_window which are in use */
+    uint32_t accel_window_mask;
+    /** Length of each landing detection window in milliseconds */
+    uint16_t landed_window;
+    /** Bit of accel_window which holds the oldest sample */
+    uint8_t accel_window_oldest;
+    uint8_t launch_window_count;
+    uint8_t burnout_window_count;
+    uint8_t descending_samples;
+    /** Parameters for each pyro event */
+    struct deployment_pyro_params pyro[DEPLOYMENT_MAX_PYRO_EVENTS];
+};
+
+/** The gyro bias is kept in units of 1/DEPLOYMENT_GYRO_BIAS_SCALE LSB */
+#define DEPLOYMENT_GYRO_BIAS_SCALE 256
+
+/**
+ *  Ground altitude and gyro bias measured while on the pad. Samples are
+ *  collected over fixed windows and a window's means replace the previous
+ *  values only if the rocket was still for the whole window, so that slow
+ *  drift in pressure is followed without being fooled by handling.
+ */
+struct deployment_baseline {
+    /** Statistics of altitude over the current window in Q16.16 meters */
+    struct running_stats alt;
+    /** Statistics of each gyro axis over the current window in
+        1/DEPLOYMENT_GYRO_BIAS_SCALE LSB */
+    struct running_stats gyro[3];
+    /** Time of the first sample in each window */
+    uint32_t alt_start;
+    uint32_t gyro_start;
+    /** Largest altitude variance for a window to be used in Q16.16 meters
+        squared */
+    uint64_t alt_max_var;
+    /** Largest gyro variance for a window to be used in
+        (1/DEPLOYMENT_GYRO_BIAS_SCALE LSB)^2 */
+    uint64_t gyro_max_var;
+    /** Ground altitude from the most recent still window, subtracted from
+        every altimeter reading */
+    ms5611_alt_t ground_altitude;
+    /** Gyro bias from the most recent still window in
+        1/DEPLOYMENT_GYRO_BIAS_SCALE LSB */
+    int32_t gyro_bias[3];
+    /** Number of windows which have been used */
+    uint16_t alt_windows;
+    uint16_t gyro_windows;
+};
+
+/**
+ *  Landing detection after the main parachute is out. Altitude, acceleration
+ *  magnitude and rotation rate magnitude are collected over fixed windows and
+ *  landing is detected at the end of the first window in which none of them
+ *  varied by more than its limit and the mean altitude moved no faster than
+ *  DEPLOYMENT_LANDED_VELOCITY since the previous window. While the IMU is
+ *  stalled (see DEPLOYMENT_IMU_MAX_AGE) only the altitude is used. Each sample
+ *  is a constant amount of work, no samples are kept.
+ */
+struct deployment_landing {
+    /** Statistics of altitude over the current window in Q16.16 meters */
+    struct running_stats alt;
+    /** Statistics of squared acceleration magnitude over the current window
+        in LSB^2 */
+    struct running_stats accel;
+    /** Statistics of squared rotation rate magnitude over the current window
+        in LSB^2 */
+    struct running_stats gyro;
+    /** Time of the first altimeter sample in the window */
+    uint32_t start;
+    /** Mean altitude in Q16.16 meters and end time of the previous window */
+    int32_t last_mean;
+    uint32_t last_end;
+    /** Largest acceleration magnitude variance for a still window in LSB^2 */
+    uint64_t accel_max_var;
+    /** Largest rotation rate magnitude variance for a still window in
+        LSB^2 */
+    uint64_t gyro_max_var;
+    /** Time at which landing was detected */
+    uint32_t time;
+    /** Flag set once a window has been completed, so that last_mean is
+        valid */
+    uint8_t have_last:1;
+    /** Flag set once landing has been detected */
+    uint8_t landed:1;
 };
 
 struct deployment_service_desc_t {
     enum deployment_service_state state;
-    struct ms5611_desc_t *ms5611_alt;
     struct mpu9250_desc_t *mpu9250_imu;
-    union {
-        float max_altitude;
-        float last_altitude;
-    };
-    union {
-        uint32_t last_sample_time;
-        uint32_t deployment_time;
-    };
-    union {
-        uint8_t decending_sample_count;
-        uint8_t landing_sample_count;
-    };
+    /** Subscription to altimeter readings */
+    struct sensor_bus_cursor baro_cursor;
+    /** Subscription to the IMU's samples */
+    struct sensor_bus_cursor imu_cursor;
+    /** Highest altitude seen while waiting to descend */
+    ms5611_alt_t max_altitude;
+    /** Most recent altitude */
+    ms5611_alt_t last_altitude;
+    /** Time of the most recent altimeter sample that has been processed */
+    uint32_t last_sample_time;
+    /** Time of the most recent IMU sample that has been processed */
+    uint32_t imu_sample_time;
+    /** Altitude of the most recent altimeter sample that has been processed */
+    ms5611_alt_t sample_altitude;
+    /** Filtered vertical velocity from the altimeter in meters per second */
+    ms5611_alt_t vertical_velocity;
+    /** Time at which the current state was entered */
+    uint32_t state_time;
+    /** Number of altimeter samples below max_altitude since it was set */
+    uint8_t decending_sample_count;
+    /** Landing detection, updated in the main descent state */
+    struct deployment_landing landing;
+
+    /** Constants derived from the configuration record */
+    struct deployment_params params;
+    /** Result of loading the configuration record from storage at init */
+    enum deployment_config_status config_status;
+
+    /** Results of the acceleration test for the current state for the most
+        recent samples, one bit per sample with the newest in bit 0 */
+    uint32_t accel_window;
+    /** Number of set bits in accel_window */
+    uint8_t accel_window_count;
+
+    /** Attitude estimate, updated with every IMU sample when ENABLE_ATTITUDE
+        is defined */
+    struct attitude_desc_t attitude;
+    /** Pad baseline, updated in the idle and armed states when
+        ENABLE_PAD_BASELINE is defined */
+    struct deployment_baseline baseline;
+
+    /** Pyro events which can fire in each state, one bit per table entry */
+    uint16_t pyro_state_events[DEPLOYMENT_NUM_STATES];
+    /** Pyro events which have fired */
+    uint16_t pyro_fired;
+    /** Pyro events whose channel is currently on */
+    uint16_t pyro_active;
+    /** Time at which each pyro event fired */
+    uint32_t pyro_fire_time[DEPLOYMENT_MAX_PYRO_EVENTS];
+
+    /** Heartbeats from the other flight computers, for
+        DEPLOYMENT_PYRO_PEER_NOT_FIRED (may be NULL) */
+    const struct peer_link *peer;
 };
 
 
 /**
- *  Initialize the deployment service.
+ *  Initialize the deployment service. The IMU's topic must be set before this
+ *  is called, samples are consumed from it and from the altimeter topic rather
+ *  than read from the drivers. The configuration record is loaded from
+ *  non-volatile storage, or the compile time defaults are used if there is no
+ *  valid record.
  *
  *  @param inst A deployment service instance descriptor
- *  @param ms6511_alt Altimeter instance
+ *  @param baro_topic Topic of altimeter readings (struct ms5611_sample), either
+ *                    a single altimeter's topic or the output of a vote
  *  @param mpu9250_imu IMU instance
  */
 extern void init_deployment(struct deployment_service_desc_t *inst,
-                            struct ms5611_desc_t *ms5611_alt,
+                            struct sensor_bus_topic *baro_topic,
                             struct mpu9250_desc_t *mpu9250_imu);
 
+/**
+ *  Check a configuration record and, if it is valid, derive the constants used
+ *  by the service from it. Can be called between flights in simulation to
+ *  switch configurations.
+ *
+ *  @param inst A deployment service instance descriptor
+ *  @param config The configuration record
+ *
+ *  @return DEPLOYMENT_CONFIG_OK if the record was applied, otherwise the
+ *          service's constants are left unchanged
+ */
+extern enum deployment_config_status deployment_apply_config(
+                                    struct deployment_service_desc_t *inst,
+                                    const struct deployment_config *config);
+
 /**
  *  Deployment service function to be called in each iteration of the main loop.
  *
@@ -64,6 +321,19 @@ extern void init_deployment(struct deployment_service_desc_t *inst,
 extern void deployment_service(struct deployment_service_desc_t *inst);
 
 
+/**
+ *  Set the peer link through which the other flight computers are heard from.
+ *
+ *  @param inst A deployment service instance descriptor
+ *  @param peer The peer link, or NULL for none
+ */
+static inline void deployment_set_peer(
+                                struct deployment_service_desc_t *const inst,
+                                const struct peer_link *peer)
+{
+    inst->peer = peer;
+}
+
 /**
  *  Get state of deployment services.
  */
@@ -73,5 +343,30 @@ static inline enum deployment_service_state deployment_get_state(
     return inst->state;
 }
 
+/**
+ *  Get the age of the most recent altimeter sample used by the service.
+ *
+ *  @param inst A deployment service instance descriptor
+ *
+ *  @return Age in milliseconds
+ */
+static inline uint32_t deployment_baro_age(
+                            const struct deployment_service_desc_t *const inst)
+{
+    return (uint32_t)millis - inst->last_sample_time;
+}
+
+/**
+ *  Get the age of the most recent IMU sample used by the service.
+ *
+ *  @param inst A deployment service instance descriptor
+ *
+ *  @return Age in milliseconds
+ */
+static inline uint32_t deployment_imu_age(
+                            const struct deployment_service_desc_t *const inst)
+{
+    return (uint32_t)millis - inst->imu_sample_time;
+}
 
 #endif /* deployment_h */
@@ -0,0 +1,364 @@
+/**
+ * @file fixed-point-sim.c
+ * @desc Differential test of the fixed point build against the float build
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef FIXED_POINT_SIM_MAIN
+
+#include "flight-sim.h"
+#include "host-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/** Identifies a file written by this program */
+#define FIXED_POINT_SIM_MAGIC           0x46505331UL
+/** Largest difference in the altitude used by the deployment service between
+    the builds in meters */
+#define FIXED_POINT_SIM_ALT_TOLERANCE   0.1
+/** Largest difference in the time at which a state is entered or a pyro
+    event fires between the builds in milliseconds. An altitude within a few
+    millimeters of a threshold can cross it in one build and not the other, so
+    a decision can come one altimeter sample later. */
+#define FIXED_POINT_SIM_TIME_TOLERANCE  (ALTIMETER_PERIOD / ALTIMETER_COUNT)
+
+/** Start of a file */
+struct fixed_point_sim_header {
+    uint32_t magic;
+    /** Number of flights */
+    uint32_t flights;
+    /** Non-zero if written by the fixed point build */
+    uint32_t fixed_point;
+};
+
+/** Outcome of one flight, followed in the file by its samples */
+struct fixed_point_sim_flight {
+    /** Number of altimeter samples processed by the deployment service */
+    uint32_t samples;
+    /** Time at which each deployment state was first entered (UINT32_MAX if
+        never) */
+    uint32_t state_time[DEPLOYMENT_NUM_STATES];
+    /** Time at which each pyro event fired */
+    uint32_t pyro_fire_time[DEPLOYMENT_MAX_PYRO_EVENTS];
+    uint16_t pyro_fired;
+};
+
+/** One altimeter sample as processed by the deployment service */
+struct fixed_point_sim_sample {
+    uint32_t time;
+    /** Altitude above the pad in meters */
+    double altitude;
+};
+
+/** Sink context which records what the deployment service did */
+struct fixed_point_sim_recorder {
+    struct flight_sim_board *board;
+    struct fixed_point_sim_flight flight;
+    struct fixed_point_sim_sample *samples;
+    uint32_t length;
+    uint32_t last_sample_time;
+};
+
+static double fixed_point_sim_meters(ms5611_alt_t altitude)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return (double)altitude / 65536.0;
+#else
+    return (double)altitude;
+#endif
+}
+
+static void fixed_point_sim_sink(void *context, const struct flight_sim *sim,
+                                 int new_baro)
+{
+    struct fixed_point_sim_recorder *const r = context;
+    const struct deployment_service_desc_t *const dep =
+                                                    &r->board->deployment;
+
+    flight_sim_replay_sink(&r->board->replay, sim, new_baro);
+
+    if (r->flight.state_time[dep->state] == UINT32_MAX) {
+        r->flight.state_time[dep->state] = sim->time;
+    }
+    if (dep->last_sample_time == r->last_sample_time) {
+        return;
+    }
+    r->last_sample_time = dep->last_sample_time;
+
+    if (r->flight.samples == r->length) {
+        const uint32_t length = (r->length == 0) ? 4096 : (r->length * 2);
+        struct fixed_point_sim_sample *const grown =
+                        realloc(r->samples, length * sizeof(r->samples[0]));
+        if (grown == NULL) {
+            return;
+        }
+        r->samples = grown;
+        r->length = length;
+    }
+    struct fixed_point_sim_sample *const s = &r->samples[r->flight.samples++];
+    s->time = dep->last_sample_time;
+    s->altitude = fixed_point_sim_meters(dep->sample_altitude);
+}
+
+/**
+ *  Replay flights through this build and write what the deployment service
+ *  did with them.
+ */
+static int fixed_point_sim_write(const char *path, uint32_t flights,
+                                 uint32_t seed)
+{
+    static struct flight_sim_board board;
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .transonic_spike = 2000.0f,
+        .baro_glitch_rate = 0.001f, .baro_glitch = 5000.0f,
+        .accel_noise = 0.05f, .accel_bias = 0.05f, .gyro_noise = 0.1f,
+        .gyro_bias = 1.0f, .roll_rate = 60.0f, .temperature = 25.0f,
+        .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+        .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = ALTIMETER_PERIOD,
+        .num_baro = ALTIMETER_COUNT
+    };
+    struct fixed_point_sim_recorder recorder = { .board = &board };
+
+    FILE *const out = fopen(path, "wb");
+    if (out == NULL) {
+        perror(path);
+        return 1;
+    }
+    struct fixed_point_sim_header header = {
+        .magic = FIXED_POINT_SIM_MAGIC,
+        .flights = flights,
+#ifdef FIXED_POINT_ALTITUDE
+        .fixed_point = 1
+#endif
+    };
+    fwrite(&header, sizeof(header), 1, out);
+
+    for (uint32_t f = 0; f < flights; f++) {
+        struct flight_sim sim;
+        // Launch sites from sea level to about 2 km, so that p0 varies
+        config.ground_pressure = 101325.0f - (1300.0f * (float)(f % 16));
+        config.pad_time = 10.0f + (0.0137f * (float)f);
+        millis = 0;
+        if (init_flight_sim(&sim, &config, 1, seed + f) != 0) {
+            fprintf(stderr, "out of memory\n");
+            fclose(out);
+            return 1;
+        }
+        init_flight_sim_board(&board, &config);
+
+        memset(&recorder.flight, 0, sizeof(recorder.flight));
+        for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+            recorder.flight.state_time[s] = UINT32_MAX;
+        }
+        recorder.last_sample_time = board.deployment.last_sample_time;
+
+        flight_sim_run(&sim, (uint32_t)((config.pad_time + 400.0f) * 1000),
+                       fixed_point_sim_sink, &recorder);
+        flight_sim_free(&sim);
+
+        recorder.flight.pyro_fired = board.deployment.pyro_fired;
+        memcpy(recorder.flight.pyro_fire_time,
+               board.deployment.pyro_fire_time,
+               sizeof(recorder.flight.pyro_fire_time));
+        fwrite(&recorder.flight, sizeof(recorder.flight), 1, out);
+        fwrite(recorder.samples, sizeof(recorder.samples[0]),
+               recorder.flight.samples, out);
+    }
+    free(recorder.samples);
+
+    if (fclose(out) != 0) {
+        perror(path);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ *  Difference between two times which may be UINT32_MAX for never.
+ */
+static uint32_t fixed_point_sim_time_diff(uint32_t a, uint32_t b)
+{
+    if ((a == UINT32_MAX) || (b == UINT32_MAX)) {
+        return (a == b) ? 0 : UINT32_MAX;
+    }
+    return (a > b) ? (a - b) : (b - a);
+}
+
+/**
+ *  Compare what the deployment service did in two builds.
+ */
+static int fixed_point_sim_compare(const char *path_a, const char *path_b)
+{
+    FILE *const a = fopen(path_a, "rb");
+    FILE *const b = fopen(path_b, "rb");
+    struct fixed_point_sim_header ha, hb;
+    int ret = 1;
+
+    if ((a == NULL) || (b == NULL)) {
+        perror((a == NULL) ? path_a : path_b);
+        goto done;
+    }
+    if ((fread(&ha, sizeof(ha), 1, a) != 1) ||
+            (fread(&hb, sizeof(hb), 1, b) != 1) ||
+            (ha.magic != FIXED_POINT_SIM_MAGIC) ||
+            (hb.magic != FIXED_POINT_SIM_MAGIC) ||
+            (ha.flights != hb.flights)) {
+        fprintf(stderr, "files do not hold the same flights\n");
+        goto done;
+    }
+    printf("%s (%s) against %s (%s), %u flights\n", path_a,
+           ha.fixed_point ? "fixed" : "float", path_b,
+           hb.fixed_point ? "fixed" : "float", (unsigned)ha.flights);
+
+    double alt_max = 0, alt_sum = 0;
+    uint64_t samples = 0;
+    uint32_t state_max[DEPLOYMENT_NUM_STATES] = { 0 };
+    uint32_t state_flights[DEPLOYMENT_NUM_STATES] = { 0 };
+    uint32_t fire_max[DEPLOYMENT_MAX_PYRO_EVENTS] = { 0 };
+    uint32_t mismatched = 0;
+
+    for (uint32_t f = 0; f < ha.flights; f++) {
+        struct fixed_point_sim_flight fa, fb;
+        if ((fread(&fa, sizeof(fa), 1, a) != 1) ||
+                (fread(&fb, sizeof(fb), 1, b) != 1)) {
+            fprintf(stderr, "flight %u is truncated\n", (unsigned)f);
+            goto done;
+        }
+
+        for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+            const uint32_t d = fixed_point_sim_time_diff(fa.state_time[s],
+                                                         fb.state_time[s]);
+            state_max[s] = (d > state_max[s]) ? d : state_max[s];
+            state_flights[s] += (fa.state_time[s] != UINT32_MAX);
+        }
+        if (fa.pyro_fired != fb.pyro_fired) {
+            printf("flight %u: pyro events fired differ (%04x, %04x)\n",
+                   (unsigned)f, (unsigned)fa.pyro_fired,
+                   (unsigned)fb.pyro_fired);
+            mismatched++;
+        }
+        for (uint8_t e = 0; e < DEPLOYMENT_MAX_PYRO_EVENTS; e++) {
+            if (!(fa.pyro_fired & fb.pyro_fired & (1 << e))) {
+                continue;
+            }
+            const uint32_t d = fixed_point_sim_time_diff(fa.pyro_fire_time[e],
+                                                         fb.pyro_fire_time[e]);
+            fire_max[e] = (d > fire_max[e]) ? d : fire_max[e];
+        }
+
+        // Samples are taken at the same times in both builds, only the
+        // altitudes can differ
+        const uint32_t n = (fa.samples < fb.samples) ? fa.samples : fb.samples;
+        if (fa.samples != fb.samples) {
+            printf("flight %u: %u and %u samples\n", (unsigned)f,
+                   (unsigned)fa.samples, (unsigned)fb.samples);
+            mismatched++;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            struct fixed_point_sim_sample sa, sb;
+            if ((fread(&sa, sizeof(sa), 1, a) != 1) ||
+                    (fread(&sb, sizeof(sb), 1, b) != 1)) {
+                fprintf(stderr, "flight %u is truncated\n", (unsigned)f);
+                goto done;
+            }
+            if (sa.time != sb.time) {
+                printf("flight %u: sample %u at %u and %u ms\n", (unsigned)f,
+                       (unsigned)i, (unsigned)sa.time, (unsigned)sb.time);
+                mismatched++;
+                break;
+            }
+            const double d = (sa.altitude > sb.altitude) ?
+                                (sa.altitude - sb.altitude) :
+                                (sb.altitude - sa.altitude);
+            alt_max = (d > alt_max) ? d : alt_max;
+            alt_sum += d;
+            samples++;
+        }
+        const long size = (long)sizeof(struct fixed_point_sim_sample);
+        fseek(a, (long)(fa.samples - n) * size, SEEK_CUR);
+        fseek(b, (long)(fb.samples - n) * size, SEEK_CUR);
+    }
+
+    printf("altitude: %llu samples, max difference %.4f m, mean %.5f m\n",
+           (unsigned long long)samples, alt_max,
+           (samples != 0) ? (alt_sum / (double)samples) : 0.0);
+    uint32_t time_max = 0;
+    for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+        time_max = (state_max[s] > time_max) ? state_max[s] : time_max;
+        if (state_max[s] == UINT32_MAX) {
+            printf("state %u: entered in only one build\n", (unsigned)s);
+        } else {
+            printf("state %u: entered in %u flights, times differ by up to "
+                   "%u ms\n", (unsigned)s, (unsigned)state_flights[s],
+                   (unsigned)state_max[s]);
+        }
+    }
+    for (uint8_t e = 0; e < deployment_num_pyro_events_g; e++) {
+        time_max = (fire_max[e] > time_max) ? fire_max[e] : time_max;
+        printf("pyro event %u: fire times differ by up to %u ms\n",
+               (unsigned)e, (unsigned)fire_max[e]);
+    }
+
+    if ((mismatched != 0) || (alt_max > FIXED_POINT_SIM_ALT_TOLERANCE) ||
+            (time_max > FIXED_POINT_SIM_TIME_TOLERANCE)) {
+        fprintf(stderr, "builds differ beyond tolerance\n");
+        goto done;
+    }
+    ret = 0;
+
+done:
+    if (a != NULL) {
+        fclose(a);
+    }
+    if (b != NULL) {
+        fclose(b);
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *write_path = NULL;
+    uint32_t flights = 32;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "w:f:s:")) != -1) {
+        switch (opt) {
+            case 'w':
+                write_path = optarg;
+                break;
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (write_path != NULL) {
+        return fixed_point_sim_write(write_path, flights, seed);
+    } else if ((argc - optind) == 2) {
+        return fixed_point_sim_compare(argv[optind], argv[optind + 1]);
+    }
+
+usage:
+    fprintf(stderr, "usage: %s -w file [-f flights] [-s seed]\n"
+            "       %s float-file fixed-file\n", argv[0], argv[0]);
+    return 2;
+}
+
+#endif
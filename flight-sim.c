@@ -0,0 +1,751 @@
+/**
+ * @file flight-sim.c
+ * @desc Synthetic flight profile generator for host simulation
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "flight-sim.h"
+#include "host-sim.h"
+#include "wcet.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define GRAVITY             9.80665f
+#define SEA_LEVEL_DENSITY   1.225f
+#define DENSITY_SCALE_HEIGHT 8500.0f
+#define SPEED_OF_SOUND      340.0f
+/** Half width of the band around Mach 1 where pressure spikes occur */
+#define TRANSONIC_BAND      0.05f
+/** Time constant with which parachutes reach their descent rate in seconds */
+#define CHUTE_TIME_CONSTANT 0.5f
+/** Temperature sensor sensitivity in LSB per degree Celsius and the
+    temperature which reads as 0 LSB */
+#define TEMP_SENSITIVITY    333.87f
+#define TEMP_OFFSET         21.0f
+
+static inline uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+static inline float uniform(uint32_t x)
+{
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+/**
+ *  Approximately normal noise with unit variance (Irwin-Hall with 4 terms),
+ *  cheap enough to vectorize.
+ */
+static inline float gaussian(uint32_t *state)
+{
+    uint32_t x = *state;
+    float sum = 0;
+    for (int i = 0; i < 4; i++) {
+        x = xorshift32(x);
+        sum += uniform(x);
+    }
+    *state = x;
+    return (sum - 2.0f) * 1.7320508f;
+}
+
+/**
+ *  Round a value in LSBs to the nearest value a 16 bit register can hold, so
+ *  that readings beyond the full scale range clip the way the sensor's do.
+ */
+static inline int16_t to_lsb(float value)
+{
+    float lsb = roundf(value);
+    lsb = (lsb > 32767.0f) ? 32767.0f : lsb;
+    lsb = (lsb < -32768.0f) ? -32768.0f : lsb;
+    return (int16_t)lsb;
+}
+
+int init_flight_sim(struct flight_sim *sim,
+                    const struct flight_sim_config *config, uint32_t count,
+                    uint32_t seed)
+{
+    sim->config = *config;
+    sim->count = count;
+    sim->steps = 0;
+    sim->time = 0;
+
+    sim->altitude = calloc(count, sizeof(float));
+    sim->velocity = calloc(count, sizeof(float));
+    sim->mass = calloc(count, sizeof(float));
+    const uint32_t num_baro = flight_sim_num_baro(config);
+    sim->baro_offset = calloc(count * num_baro, sizeof(float));
+    sim->accel_offset = calloc(count * 3, sizeof(float));
+    sim->gyro_offset = calloc(count * 3, sizeof(float));
+    sim->rng = calloc(count, sizeof(uint32_t));
+    sim->pressure = calloc(count * num_baro, sizeof(int32_t));
+    sim->accel = calloc(count * 3, sizeof(int16_t));
+    sim->gyro = calloc(count * 3, sizeof(int16_t));
+    sim->temp = to_lsb((config->temperature - TEMP_OFFSET) *
+                       TEMP_SENSITIVITY);
+
+    if (!sim->altitude || !sim->velocity || !sim->mass || !sim->baro_offset ||
+            !sim->accel_offset || !sim->gyro_offset || !sim->rng ||
+            !sim->pressure || !sim->accel || !sim->gyro) {
+        flight_sim_free(sim);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t x = seed ^ (0x9E3779B9UL * (i + 1));
+        if (x == 0) {
+            x = 1;
+        }
+        for (uint32_t k = 0; k < num_baro; k++) {
+            x = xorshift32(x);
+            sim->baro_offset[(k * count) + i] = (config->baro_bias *
+                                                 (2.0f * uniform(x) - 1.0f));
+        }
+        for (uint32_t k = 0; k < 3; k++) {
+            x = xorshift32(x);
+            sim->accel_offset[(k * count) + i] = (config->accel_bias *
+                                                  (2.0f * uniform(x) - 1.0f));
+            x = xorshift32(x);
+            sim->gyro_offset[(k * count) + i] = (config->gyro_bias *
+                                                 (2.0f * uniform(x) - 1.0f));
+        }
+        sim->rng[i] = xorshift32(x);
+        sim->mass[i] = config->dry_mass + config->propellant_mass;
+    }
+
+    return 0;
+}
+
+void flight_sim_free(struct flight_sim *sim)
+{
+    free(sim->altitude);
+    free(sim->velocity);
+    free(sim->mass);
+    free(sim->baro_offset);
+    free(sim->accel_offset);
+    free(sim->gyro_offset);
+    free(sim->rng);
+    free(sim->pressure);
+    free(sim->accel);
+    free(sim->gyro);
+    sim->altitude = NULL;
+    sim->velocity = NULL;
+    sim->mass = NULL;
+    sim->baro_offset = NULL;
+    sim->accel_offset = NULL;
+    sim->gyro_offset = NULL;
+    sim->rng = NULL;
+    sim->pressure = NULL;
+    sim->accel = NULL;
+    sim->gyro = NULL;
+}
+
+int flight_sim_step(struct flight_sim *sim)
+{
+    const struct flight_sim_config *const c = &sim->config;
+    const float dt = 1.0f / (float)c->imu_odr;
+    const float t = (float)sim->steps * dt;
+    const float burn_t = t - c->pad_time;
+
+    const int burning = (burn_t >= 0.0f) && (burn_t < c->burn_time);
+    const float thrust = burning ? c->thrust : 0.0f;
+    const float mass_flow = burning ? (c->propellant_mass / c->burn_time) : 0;
+    const float lsb_per_g = (float)(16384 >> c->accel_fsr);
+    const float lsb_per_dps = 131.072f / (float)(1 << c->gyro_fsr);
+    const uint32_t n = sim->count;
+
+    float *const restrict alt = sim->altitude;
+    float *const restrict vel = sim->velocity;
+    float *const restrict mass = sim->mass;
+    int16_t *const restrict accel = sim->accel;
+    int16_t *const restrict gyro = sim->gyro;
+    const float *const restrict accel_offset = sim->accel_offset;
+    const float *const restrict gyro_offset = sim->gyro_offset;
+    uint32_t *const restrict rng = sim->rng;
+
+    // Dynamics and accelerometer, all flights share the same time so the only
+    // per flight branches are selects
+    for (uint32_t i = 0; i < n; i++) {
+        const float h = alt[i];
+        const float v = vel[i];
+        const float m = mass[i];
+
+        const float rho = SEA_LEVEL_DENSITY * expf(-h / DENSITY_SCALE_HEIGHT);
+        const float drag = 0.5f * rho * v * fabsf(v) * c->cd_area;
+        float a = ((thrust - drag) / m) - GRAVITY;
+
+        // Under a parachute once past apogee, relax towards descent rate
+        const int descending = !burning && (v < 0.0f);
+        const float rate = (h > c->main_altitude) ? c->drogue_rate :
+                                                    c->main_rate;
+        const float chute_a = ((-rate - v) / CHUTE_TIME_CONSTANT);
+        a = descending ? chute_a : a;
+
+        // Supported by the pad or the ground
+        const int on_ground = (h <= 0.0f) && (a < 0.0f) && (v <= 0.0f);
+        a = on_ground ? 0.0f : a;
+
+        float nv = v + (a * dt);
+        float nh = h + (nv * dt);
+        nv = (nh < 0.0f) ? 0.0f : nv;
+        nh = (nh < 0.0f) ? 0.0f : nh;
+
+        vel[i] = nv;
+        alt[i] = nh;
+        mass[i] = m - (mass_flow * dt);
+
+        // The body z axis points up the rocket, the accelerometer measures
+        // specific force along it and nothing across it. The gyroscope sees
+        // only the roll about the body axis once off the ground.
+        const float force[3] = { 0.0f, 0.0f, (a + GRAVITY) / GRAVITY };
+        const float body_rate[3] = { 0.0f, 0.0f,
+                                     (nh > 0.0f) ? c->roll_rate : 0.0f };
+        for (uint32_t k = 0; k < 3; k++) {
+            const float g = (force[k] + accel_offset[(k * n) + i] +
+                             (c->accel_noise * gaussian(&rng[i])));
+            accel[(k * n) + i] = to_lsb(g * lsb_per_g);
+            const float w = (body_rate[k] + gyro_offset[(k * n) + i] +
+                             (c->gyro_noise * gaussian(&rng[i])));
+            gyro[(k * n) + i] = to_lsb(w * lsb_per_dps);
+        }
+    }
+
+    sim->steps++;
+    sim->time = (uint32_t)(((uint64_t)sim->steps * 1000) / c->imu_odr);
+
+    // Barometers are sampled in turn
+    const uint32_t num_baro = flight_sim_num_baro(c);
+    const uint32_t slot = c->baro_period / num_baro;
+    if ((slot == 0) || ((sim->time % slot) != 0)) {
+        return 0;
+    }
+    const uint32_t k = (sim->time / slot) % num_baro;
+    const float ground_drift = c->pressure_drift * ((float)sim->time / 1000.0f);
+
+    int32_t *const restrict pressure = &sim->pressure[k * sim->count];
+    const float *const restrict offset = &sim->baro_offset[k * sim->count];
+    for (uint32_t i = 0; i < sim->count; i++) {
+        const float h = alt[i];
+        const float mach = fabsf(vel[i]) / SPEED_OF_SOUND;
+        float spike = 1.0f - (fabsf(mach - 1.0f) / TRANSONIC_BAND);
+        spike = (spike > 0.0f) ? spike : 0.0f;
+
+        float p = (((c->ground_pressure + ground_drift) *
+                    powf(1.0f - (h / 44330.0f), 5.255f)) +
+                   offset[i] + (c->transonic_spike * spike) +
+                   (c->baro_noise * gaussian(&rng[i])));
+        if (c->baro_glitch_rate > 0.0f) {
+            rng[i] = xorshift32(rng[i]);
+            p += (uniform(rng[i]) < c->baro_glitch_rate) ? c->baro_glitch : 0;
+        }
+        pressure[i] = (int32_t)lrintf(p);
+    }
+    return (int)(1U << k);
+}
+
+void flight_sim_run(struct flight_sim *sim, uint32_t duration,
+                    flight_sim_sink sink, void *context)
+{
+    const uint32_t end = sim->time + duration;
+    while ((int32_t)(end - sim->time) > 0) {
+        const int new_baro = flight_sim_step(sim);
+        if (sink != NULL) {
+            sink(context, sim, new_baro);
+        }
+    }
+}
+
+void init_flight_sim_radio(struct flight_sim_radio *radio, uint32_t rate,
+                           uint16_t depth)
+{
+    memset(radio, 0, sizeof(*radio));
+    radio->rate = rate;
+    radio->depth = (depth < FLIGHT_SIM_RADIO_MAX_QUEUE) ?
+                                        depth : FLIGHT_SIM_RADIO_MAX_QUEUE;
+    radio->last_time = (uint32_t)millis;
+}
+
+int flight_sim_radio_send(void *context, const uint8_t *frame,
+                          uint16_t length)
+{
+    struct flight_sim_radio *const radio = context;
+
+    if (radio->count >= radio->depth) {
+        radio->stats[radio->state].rejected++;
+        return 1;
+    }
+
+    // A frame starts being sent once the frame ahead of it is done
+    uint64_t start = (uint64_t)(uint32_t)millis * 1000;
+    if (radio->count != 0) {
+        const uint16_t last = ((radio->head + radio->count - 1) %
+                               FLIGHT_SIM_RADIO_MAX_QUEUE);
+        start = (radio->done_time[last] > start) ? radio->done_time[last] :
+                                                   start;
+    }
+
+    const uint16_t i = ((radio->head + radio->count) %
+                        FLIGHT_SIM_RADIO_MAX_QUEUE);
+    struct telemetry_header header;
+    memcpy(&header, frame, sizeof(header));
+    radio->type[i] = header.type;
+    radio->queued_state[i] = radio->state;
+    radio->length[i] = length;
+    radio->queued_time[i] = (uint32_t)millis;
+    radio->done_time[i] = start + (((uint64_t)length * 1000000) / radio->rate);
+    radio->count++;
+    return 0;
+}
+
+void flight_sim_radio_service(struct flight_sim_radio *radio)
+{
+    radio->stats[radio->state].time += (uint32_t)millis - radio->last_time;
+    radio->last_time = (uint32_t)millis;
+
+    const uint64_t now = (uint64_t)(uint32_t)millis * 1000;
+    while ((radio->count != 0) && (radio->done_time[radio->head] <= now)) {
+        const uint16_t i = radio->head;
+        struct flight_sim_radio_stats *const stats =
+                                        &radio->stats[radio->queued_state[i]];
+        const uint32_t delay = (uint32_t)((radio->done_time[i] / 1000) -
+                                          radio->queued_time[i]);
+
+        if (radio->type[i] < TELEMETRY_NUM_TYPES) {
+            stats->frames[radio->type[i]]++;
+        }
+        stats->bytes += radio->length[i];
+        stats->delay_sum += delay;
+        stats->delay_max = (delay > stats->delay_max) ? delay :
+                                                        stats->delay_max;
+
+        radio->head = (radio->head + 1) % FLIGHT_SIM_RADIO_MAX_QUEUE;
+        radio->count--;
+    }
+}
+
+/**
+ *  Bus for injected faults, transactions are accepted and never complete.
+ */
+static int replay_hung_bus_start(void *bus,
+                                 const struct i2c_transaction *transaction)
+{
+    (void)bus;
+    (void)transaction;
+    return 0;
+}
+
+static const struct i2c_bus_ops replay_hung_bus_ops = {
+    .start = replay_hung_bus_start,
+    .abort = NULL
+};
+
+void init_flight_sim_board(struct flight_sim_board *board,
+                           const struct flight_sim_config *config)
+{
+    // A read left hanging at the end of the previous flight still holds its
+    // buffer
+    mpu9250_release_buffer(&board->imu);
+    memset(board, 0, sizeof(*board));
+    // The wait timers of the previous flight went with the memset
+    init_timer_wheel(&board->wheel, (uint32_t)millis);
+
+    const uint32_t num_baro = flight_sim_num_baro(config);
+    for (uint32_t k = 0; k < num_baro; k++) {
+        struct ms5611_desc_t *const altimeter = &board->altimeter[k];
+        altimeter->period = config->baro_period;
+        altimeter->wheel = &board->wheel;
+        altimeter->state = MS5611_IDLE;
+        init_sensor_bus_topic(&board->altimeter_topic[k],
+                              board->altimeter_records[k],
+                              sizeof(board->altimeter_records[k][0]),
+                              FLIGHT_SIM_BARO_TOPIC_DEPTH);
+        ms5611_set_topic(altimeter, &board->altimeter_topic[k]);
+        ms5611_set_fast_altitude(altimeter, 1);
+    }
+    struct sensor_bus_topic *altitude_topic = &board->altimeter_topic[0];
+    if (num_baro > 1) {
+        init_sensor_bus_topic(&board->vote_topic, board->vote_records,
+                              sizeof(board->vote_records[0]),
+                              FLIGHT_SIM_BARO_TOPIC_DEPTH);
+        init_baro_vote(&board->vote, &board->vote_topic,
+                       2 * config->baro_period, FLIGHT_SIM_VOTE_TOLERANCE);
+        for (uint32_t k = 0; k < num_baro; k++) {
+            baro_vote_add_sensor(&board->vote, &board->altimeter[k]);
+        }
+        altitude_topic = &board->vote_topic;
+        board->replay.vote = &board->vote;
+    }
+
+    struct mpu9250_desc_t *const imu = &board->imu;
+    imu->accel_fsr = config->accel_fsr;
+    imu->gyro_fsr = config->gyro_fsr;
+    imu->wheel = &board->wheel;
+    imu->odr = (uint8_t)((1000 / config->imu_odr) - 1);
+    imu->state = MPU9250_FIFO_WAIT;
+    imu->use_fifo = 1;
+    imu->fifo_requested = 1;
+    init_sensor_bus_topic(&board->imu_topic, board->imu_records,
+                          sizeof(board->imu_records[0]),
+                          FLIGHT_SIM_IMU_TOPIC_DEPTH);
+    mpu9250_set_topic(imu, &board->imu_topic);
+
+    init_deployment(&board->deployment, altitude_topic, imu);
+
+    board->replay.altimeter = board->altimeter;
+    board->replay.imu = imu;
+    board->replay.deployment = &board->deployment;
+    board->replay.wheel = &board->wheel;
+    board->replay.fifo_burst = 10;
+}
+
+void flight_sim_replay_init_faults(struct flight_sim_replay *r, float rate,
+                                   uint32_t seed)
+{
+    init_i2c_queue(&r->fault_queue, &replay_hung_bus_ops, NULL);
+    r->fault_rate = rate;
+    r->fault_rng = (seed == 0) ? 1 : seed;
+}
+
+/**
+ *  Decide whether a read faults, if it does its transaction is left hanging
+ *  on the fault queue.
+ */
+static int replay_inject_fault(struct flight_sim_replay *r,
+                               struct i2c_transaction *transaction,
+                               struct flight_sim_fault_stats *stats,
+                               uint32_t *fault_time)
+{
+    if (r->fault_rate <= 0.0f) {
+        return 0;
+    }
+    r->fault_rng = xorshift32(r->fault_rng);
+    if (uniform(r->fault_rng) >= r->fault_rate) {
+        return 0;
+    }
+
+    init_i2c_transaction(transaction, I2C_PRIORITY_SAMPLE, NULL, NULL);
+    i2c_queue_submit(&r->fault_queue, transaction);
+    stats->faults++;
+    if (*fault_time == 0) {
+        *fault_time = (uint32_t)millis;
+    }
+    return 1;
+}
+
+/**
+ *  Record the time taken to recover from a fault once a sensor publishes
+ *  again.
+ */
+static void replay_recovered(struct flight_sim_fault_stats *stats,
+                             uint32_t *fault_time)
+{
+    if (*fault_time == 0) {
+        return;
+    }
+    const uint32_t t = (uint32_t)millis - *fault_time;
+    stats->recoveries++;
+    stats->recovery_sum += t;
+    stats->recovery_max = (t > stats->recovery_max) ? t : stats->recovery_max;
+    *fault_time = 0;
+}
+
+/**
+ *  Take the IMU sample of the flight being replayed from the current step.
+ */
+static void replay_take_imu(const struct flight_sim_replay *r,
+                            const struct flight_sim *sim,
+                            struct flight_sim_imu_sample *sample)
+{
+    sample->time = sim->time;
+    for (uint32_t k = 0; k < 3; k++) {
+        sample->accel[k] = sim->accel[(k * sim->count) + r->flight];
+        sample->gyro[k] = sim->gyro[(k * sim->count) + r->flight];
+    }
+    sample->temp = sim->temp;
+}
+
+static void replay_publish_imu(struct flight_sim_replay *r,
+                               const struct flight_sim_imu_sample *sample)
+{
+    struct flight_sim_imu_stats *const stats =
+                                    &r->imu_stats[r->deployment->state];
+    const uint32_t latency = (uint32_t)millis - sample->time;
+
+    r->imu->last_accel_x = sample->accel[0];
+    r->imu->last_accel_y = sample->accel[1];
+    r->imu->last_accel_z = sample->accel[2];
+    r->imu->last_gyro_x = sample->gyro[0];
+    r->imu->last_gyro_y = sample->gyro[1];
+    r->imu->last_gyro_z = sample->gyro[2];
+    r->imu->last_temp = sample->temp;
+    r->imu->last_sample_time = sample->time;
+    mpu9250_notify_sample(r->imu);
+    replay_recovered(&r->imu_faults, &r->imu_fault_time);
+
+    stats->samples++;
+    stats->latency_sum += latency;
+    stats->latency_max = (latency > stats->latency_max) ? latency :
+                                                          stats->latency_max;
+}
+
+/**
+ *  Read the simulated FIFO with a count read and a burst read. The IMU must
+ *  hold a leased buffer, which is returned once the samples are published.
+ */
+static void replay_read_fifo(struct flight_sim_replay *r)
+{
+    struct flight_sim_imu_stats *const stats =
+                                    &r->imu_stats[r->deployment->state];
+    stats->reads += 2;
+    stats->bytes += (FLIGHT_SIM_FIFO_COUNT_BYTES +
+                     (r->fifo_count * FLIGHT_SIM_IMU_SAMPLE_BYTES));
+
+    for (uint8_t i = 0; i < r->fifo_count; i++) {
+        replay_publish_imu(r, &r->fifo[i]);
+    }
+    r->fifo_count = 0;
+    mpu9250_release_buffer(r->imu);
+}
+
+/**
+ *  Take an IMU sample if one is due and read it the way the driver would in
+ *  its current mode.
+ */
+static void replay_sample_imu(struct flight_sim_replay *r,
+                              const struct flight_sim *sim)
+{
+    struct mpu9250_desc_t *const imu = r->imu;
+
+    if (r->imu_failed) {
+        // Nothing is read from a failed sensor, restarting it does not help
+        return;
+    }
+    // The restart sequence is a few register writes
+    if (imu->restarting && (imu->state < MPU9250_RUNNING) &&
+            ((sim->time - imu->restart_time) >= FLIGHT_SIM_IMU_RESTART_TIME)) {
+        imu->state = imu->use_fifo ? MPU9250_FIFO_WAIT : MPU9250_RUNNING;
+    }
+    if (mpu9250_watchdog(imu)) {
+        // The user reset clears the FIFO
+        r->fifo_count = 0;
+    }
+    if (imu->i2c_in_progress ||
+            (imu->restarting && (imu->state < MPU9250_RUNNING))) {
+        // Stuck or restarting, nothing is read
+        return;
+    }
+
+    // Mode changes are made at a sample boundary, leaving FIFO driven
+    // operation drains the FIFO. Each read goes into a buffer leased from the
+    // arena as the driver's would, a read which cannot get one waits.
+    if ((imu->fifo_requested != imu->use_fifo) ||
+            (imu->low_power_requested != imu->low_power)) {
+        if (r->fifo_count != 0) {
+            if (!mpu9250_lease_buffer(imu)) {
+                return;
+            }
+            replay_read_fifo(r);
+        }
+        imu->use_fifo = imu->fifo_requested;
+        imu->low_power = imu->low_power_requested;
+    }
+
+    // In low power operation most simulation steps fall between samples, the
+    // driver is not serviced until its wait timer fires
+    if (mpu9250_waiting(imu)) {
+        r->duty[r->deployment->state].service_skipped++;
+        return;
+    }
+    if (imu->low_power) {
+        mpu9250_start_wait(imu, 1000U / mpu9250_get_ag_odr(imu));
+    }
+
+    const uint8_t burst = ((r->fifo_burst < FLIGHT_SIM_FIFO_DEPTH) ?
+                           r->fifo_burst : FLIGHT_SIM_FIFO_DEPTH);
+    if (imu->use_fifo && (burst > 1)) {
+        // A full FIFO drops new samples
+        if (r->fifo_count < FLIGHT_SIM_FIFO_DEPTH) {
+            replay_take_imu(r, sim, &r->fifo[r->fifo_count]);
+            r->fifo_count++;
+        }
+        if ((r->fifo_count < burst) || !mpu9250_lease_buffer(imu)) {
+            return;
+        }
+        // A read which faults keeps its buffer until the watchdog returns it
+        if (replay_inject_fault(r, &imu->transaction, &r->imu_faults,
+                                &r->imu_fault_time)) {
+            imu->i2c_in_progress = 1;
+            return;
+        }
+        replay_read_fifo(r);
+    } else if (!mpu9250_lease_buffer(imu)) {
+        // The sample is missed
+        return;
+    } else if (replay_inject_fault(r, &imu->transaction, &r->imu_faults,
+                                   &r->imu_fault_time)) {
+        imu->i2c_in_progress = 1;
+    } else {
+        struct flight_sim_imu_stats *const stats =
+                                    &r->imu_stats[r->deployment->state];
+        stats->reads++;
+        stats->bytes += FLIGHT_SIM_IMU_SAMPLE_BYTES;
+        struct flight_sim_imu_sample sample;
+        replay_take_imu(r, sim, &sample);
+        replay_publish_imu(r, &sample);
+        mpu9250_release_buffer(imu);
+    }
+}
+
+/**
+ *  Switch the sensors to their recovery power modes, the way the variant does.
+ */
+static void replay_enter_recovery(struct flight_sim_replay *r,
+                                  const struct flight_sim *sim)
+{
+    r->recovered = 1;
+    r->recovery_time = sim->time;
+
+    if (r->recovery_baro_period != 0) {
+        for (uint32_t k = 0; k < flight_sim_num_baro(&sim->config); k++) {
+            ms5611_set_period(&r->altimeter[k], r->recovery_baro_period);
+        }
+        if (r->vote != NULL) {
+            baro_vote_set_max_age(r->vote, 2 * r->recovery_baro_period);
+        }
+    }
+    if (r->recovery_imu_low_power) {
+        mpu9250_request_low_power(r->imu, 1);
+    }
+}
+
+/**
+ *  Take a reading from an altimeter if the simulation has a new sample for it
+ *  and the driver would read it.
+ */
+static void replay_read_baro(struct flight_sim_replay *r,
+                             const struct flight_sim *sim, uint32_t k,
+                             int new_baro, struct flight_sim_duty *duty)
+{
+    struct ms5611_desc_t *const altimeter = &r->altimeter[k];
+    // The driver waits for its period between readings
+    if (ms5611_waiting(altimeter)) {
+        duty->service_skipped++;
+        return;
+    }
+    if (!(new_baro & (1 << k))) {
+        return;
+    }
+    if (altimeter->i2c_in_progress ||
+            (altimeter->restarting && (altimeter->state < MS5611_IDLE))) {
+        return;
+    }
+    if (replay_inject_fault(r, &altimeter->transaction, &r->baro_faults,
+                            &r->baro_fault_time[k])) {
+        altimeter->i2c_in_progress = 1;
+        return;
+    }
+    duty->baro_readings++;
+    const int32_t p = sim->pressure[(k * sim->count) + r->flight];
+    altimeter->pressure = p;
+    if (!altimeter->p0_set) {
+        ms5611_set_p0(altimeter, p);
+    }
+    altimeter->altitude = ms5611_calc_altitude(altimeter, p);
+    altimeter->last_reading_time = sim->time;
+    ms5611_start_wait(altimeter, altimeter->period);
+    ms5611_publish_sample(altimeter);
+    replay_recovered(&r->baro_faults, &r->baro_fault_time[k]);
+}
+
+void flight_sim_replay_sink(void *context, const struct flight_sim *sim,
+                            int new_baro)
+{
+    struct flight_sim_replay *const r = context;
+    struct mpu9250_desc_t *const imu = r->imu;
+    struct flight_sim_duty *const duty = &r->duty[r->deployment->state];
+
+    millis = sim->time;
+    WCET_BEGIN(loop, r->deployment->state);
+    timer_wheel_advance(r->wheel, sim->time);
+#ifdef ENABLE_WCET
+    // Each altimeter's watchdog and reading are measured together
+    uint8_t baro_wcet_state[BARO_VOTE_MAX_SENSORS];
+    uint32_t baro_wcet_cycles[BARO_VOTE_MAX_SENSORS];
+#endif
+
+    const uint32_t dt = sim->time - r->last_time;
+    r->last_time = sim->time;
+    duty->time += dt;
+    if (!imu->low_power) {
+        duty->mag_on_time += dt;
+    }
+    duty->service_calls += 1 + flight_sim_num_baro(&sim->config);
+
+    if (sim->altitude[r->flight] > 0.0f) {
+        r->airborne = 1;
+    } else if (r->airborne && (r->touchdown_time == 0)) {
+        r->touchdown_time = sim->time;
+    }
+
+    WCET_BEGIN(imu, imu->state);
+    replay_sample_imu(r, sim);
+    WCET_END(&wcet_mpu9250_g, imu, imu->state);
+
+    for (uint32_t k = 0; k < flight_sim_num_baro(&sim->config); k++) {
+        struct ms5611_desc_t *const altimeter = &r->altimeter[k];
+#ifdef ENABLE_WCET
+        baro_wcet_state[k] = altimeter->state;
+        const uint32_t start = WCET_CYCLES();
+#endif
+        if (altimeter->restarting && (altimeter->state < MS5611_IDLE) &&
+                ((sim->time - altimeter->restart_time) >=
+                    FLIGHT_SIM_BARO_RESTART_TIME)) {
+            altimeter->state = MS5611_IDLE;
+        }
+        ms5611_watchdog(altimeter);
+#ifdef ENABLE_WCET
+        baro_wcet_cycles[k] = WCET_CYCLES() - start;
+#endif
+    }
+
+    for (uint32_t k = 0; k < flight_sim_num_baro(&sim->config); k++) {
+#ifdef ENABLE_WCET
+        const uint32_t start = WCET_CYCLES();
+        replay_read_baro(r, sim, k, new_baro, duty);
+        wcet_record(&wcet_ms5611_g, baro_wcet_state[k], r->altimeter[k].state,
+                    baro_wcet_cycles[k] + (WCET_CYCLES() - start));
+#else
+        replay_read_baro(r, sim, k, new_baro, duty);
+#endif
+    }
+
+    if (r->vote != NULL) {
+        baro_vote_service(r->vote);
+    }
+
+    WCET_BEGIN(deployment, r->deployment->state);
+    deployment_service(r->deployment);
+    WCET_END(&wcet_deployment_g, deployment, r->deployment->state);
+
+    if (!r->recovered &&
+            (r->deployment->state == DEPLOYMENT_STATE_RECOVERY)) {
+        replay_enter_recovery(r, sim);
+    }
+
+    if (r->radio != NULL) {
+        r->radio->state = (uint8_t)r->deployment->state;
+        flight_sim_radio_service(r->radio);
+    }
+    if (r->telemetry != NULL) {
+        telemetry_sched_service(r->telemetry);
+    }
+    WCET_END(&wcet_loop_g, loop, r->deployment->state);
+}
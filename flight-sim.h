@@ -0,0 +1,481 @@
+/**
+ * @file flight-sim.h
+ * @desc Synthetic flight profile generator for host simulation
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef flight_sim_h
+#define flight_sim_h
+
+#include "test-global.h"
+#include "ms5611-test.h"
+#include "mpu9250-test.h"
+#include "deployment.h"
+#include "baro-vote.h"
+#include "telemetry-sched.h"
+
+/** Parameters shared by all simulated flights */
+struct flight_sim_config {
+    /** Average motor thrust in newtons */
+    float thrust;
+    /** Motor burn time in seconds */
+    float burn_time;
+    /** Mass without propellant in kilograms */
+    float dry_mass;
+    /** Propellant mass in kilograms */
+    float propellant_mass;
+    /** Drag coefficient times reference area in square meters */
+    float cd_area;
+    /** Descent rate under drogue in meters per second */
+    float drogue_rate;
+    /** Descent rate under main in meters per second */
+    float main_rate;
+    /** Altitude at which the simulated main opens in meters */
+    float main_altitude;
+    /** Ground level pressure in Pascals */
+    float ground_pressure;
+    /** Change in ground level pressure with weather in Pascals per second */
+    float pressure_drift;
+    /** Time spent on the pad before ignition in seconds */
+    float pad_time;
+
+    /** Standard deviation of barometer noise in Pascals */
+    float baro_noise;
+    /** Largest per flight barometer offset in Pascals */
+    float baro_bias;
+    /** Peak pressure error near Mach 1 in Pascals */
+    float transonic_spike;
+    /** Fraction of barometer readings which are glitches */
+    float baro_glitch_rate;
+    /** Pressure error of a glitched reading in Pascals */
+    float baro_glitch;
+    /** Standard deviation of accelerometer noise in g */
+    float accel_noise;
+    /** Largest per flight accelerometer bias in g */
+    float accel_bias;
+    /** Standard deviation of gyroscope noise in degrees per second */
+    float gyro_noise;
+    /** Largest per flight gyroscope bias in degrees per second */
+    float gyro_bias;
+    /** Roll rate about the body axis while off the ground in degrees per
+        second */
+    float roll_rate;
+    /** Temperature of the IMU in degrees Celsius */
+    float temperature;
+
+    /** Accelerometer full scale range */
+    enum mpu9250_accel_fsr accel_fsr;
+    /** Gyroscope full scale range */
+    enum mpu9250_gyro_fsr gyro_fsr;
+    /** Accelerometer and gyroscope sample rate in Hz (simulation step
+        rate) */
+    uint16_t imu_odr;
+    /** Sample period of each barometer in milliseconds */
+    uint16_t baro_period;
+    /** Number of barometers per flight, each with its own offset and noise
+        and sampled in turn at baro_period / num_baro intervals, which should
+        be a multiple of the accelerometer sample period (0 is treated as 1) */
+    uint8_t num_baro;
+};
+
+/** State of a batch of flights, stored as arrays so that each step vectorizes
+    across flights */
+struct flight_sim {
+    struct flight_sim_config config;
+    /** Number of flights in batch */
+    uint32_t count;
+    /** Number of steps taken */
+    uint32_t steps;
+    /** Current time in milliseconds */
+    uint32_t time;
+
+    float *altitude;
+    float *velocity;
+    float *mass;
+    float *baro_offset;
+    /** Per flight accelerometer and gyroscope biases, laid out by axis like
+        accel and gyro */
+    float *accel_offset;
+    float *gyro_offset;
+    uint32_t *rng;
+
+    /** Outputs from the most recent step, pressure holds count values for
+        each barometer in turn (barometer k of flight i is at
+        k * count + i) and accel and gyro hold count values for each axis in
+        turn (axis k of flight i is at k * count + i), in LSBs at the
+        configured full scale ranges */
+    int32_t *pressure;
+    int16_t *accel;
+    int16_t *gyro;
+    /** Temperature in LSBs, the same for all flights and steps */
+    int16_t temp;
+};
+
+/**
+ *  Get the number of barometers per flight.
+ */
+static inline uint32_t flight_sim_num_baro(const struct flight_sim_config *c)
+{
+    return (c->num_baro == 0) ? 1 : c->num_baro;
+}
+
+/**
+ *  Function which receives the output of every step.
+ *
+ *  @param context Context pointer passed to flight_sim_run()
+ *  @param sim The simulation
+ *  @param new_baro Mask of barometers for which pressure holds a new sample
+ */
+typedef void (*flight_sim_sink)(void *context, const struct flight_sim *sim,
+                                int new_baro);
+
+/**
+ *  Initialize a batch of flights on the pad.
+ *
+ *  @param sim The simulation to be initialized
+ *  @param config Parameters for all flights
+ *  @param count Number of flights
+ *  @param seed Seed for noise and per flight biases
+ *
+ *  @return 0 if successful
+ */
+extern int init_flight_sim(struct flight_sim *sim,
+                           const struct flight_sim_config *config,
+                           uint32_t count, uint32_t seed);
+
+/**
+ *  Free the memory used by a simulation.
+ *
+ *  @param sim The simulation
+ */
+extern void flight_sim_free(struct flight_sim *sim);
+
+/**
+ *  Advance all flights by one accelerometer sample period.
+ *
+ *  @param sim The simulation
+ *
+ *  @return Mask of barometers which produced a sample in this step (bit k for
+ *          barometer k)
+ */
+extern int flight_sim_step(struct flight_sim *sim);
+
+/**
+ *  Run the simulation, passing the output of each step to a sink.
+ *
+ *  @param sim The simulation
+ *  @param duration Length of time to simulate in milliseconds
+ *  @param sink Function which receives the output of each step
+ *  @param context Context for sink
+ */
+extern void flight_sim_run(struct flight_sim *sim, uint32_t duration,
+                           flight_sim_sink sink, void *context);
+
+/** Largest number of IMU samples held in the simulated FIFO */
+#define FLIGHT_SIM_FIFO_DEPTH 32
+/** One IMU sample as read from the simulated sensor */
+struct flight_sim_imu_sample {
+    uint32_t time;
+    int16_t accel[3];
+    int16_t gyro[3];
+    int16_t temp;
+};
+/** Bytes read from the IMU for each sample (accel, temperature and gyro) */
+#define FLIGHT_SIM_IMU_SAMPLE_BYTES 14
+/** Bytes read from the IMU for a FIFO count */
+#define FLIGHT_SIM_FIFO_COUNT_BYTES 2
+
+/** Bus use and latency of the simulated IMU */
+struct flight_sim_imu_stats {
+    /** Number of I2C reads */
+    uint32_t reads;
+    /** Number of bytes read */
+    uint32_t bytes;
+    /** Number of samples published */
+    uint32_t samples;
+    /** Largest time from a sample being taken to it being published in
+        milliseconds */
+    uint32_t latency_max;
+    /** Sum of the time from each sample being taken to it being published in
+        milliseconds */
+    uint64_t latency_sum;
+};
+
+/** Time taken by the IMU's watchdog restart sequence (user reset and
+    configuration register writes) in milliseconds */
+#define FLIGHT_SIM_IMU_RESTART_TIME 5
+/** Time taken by an altimeter's watchdog restart (reset command and reset
+    wait) in milliseconds */
+#define FLIGHT_SIM_BARO_RESTART_TIME 3
+
+/** Injected bus faults and recovery from them for one kind of sensor */
+struct flight_sim_fault_stats {
+    /** Number of transactions which were made to never complete */
+    uint32_t faults;
+    /** Number of times that a sample was published again after a fault */
+    uint32_t recoveries;
+    /** Longest time from a fault to the next published sample in
+        milliseconds */
+    uint32_t recovery_max;
+    /** Sum of the times from a fault to the next published sample in
+        milliseconds */
+    uint64_t recovery_sum;
+};
+
+/** Sensor activity of the simulated flight in one deployment state */
+struct flight_sim_duty {
+    /** Time spent in the state in milliseconds */
+    uint32_t time;
+    /** Number of altimeter readings taken */
+    uint32_t baro_readings;
+    /** Time for which the magnetometer was powered in milliseconds */
+    uint32_t mag_on_time;
+    /** Number of driver service calls the main loop would make, one per
+        driver per step */
+    uint32_t service_calls;
+    /** Number of those calls skipped because the driver's wait timer was
+        pending */
+    uint32_t service_skipped;
+};
+
+/** Largest number of frames held in the simulated radio's queue */
+#define FLIGHT_SIM_RADIO_MAX_QUEUE 256
+
+/** Frames carried by the simulated radio in one deployment state */
+struct flight_sim_radio_stats {
+    /** Time spent in the state in milliseconds */
+    uint32_t time;
+    /** Number of frames of each kind delivered */
+    uint32_t frames[TELEMETRY_NUM_TYPES];
+    /** Number of bytes delivered */
+    uint32_t bytes;
+    /** Number of frames refused because the queue was full */
+    uint32_t rejected;
+    /** Largest time from a frame being queued to it being delivered in
+        milliseconds */
+    uint32_t delay_max;
+    /** Sum of the times from each frame being queued to it being delivered
+        in milliseconds */
+    uint64_t delay_sum;
+};
+
+/** Radio link which sends queued frames one after another at a fixed rate.
+    Frames are counted under the deployment state in which they were
+    queued. */
+struct flight_sim_radio {
+    /** Link rate in bytes per second */
+    uint32_t rate;
+    /** Number of frames the queue holds (at most
+        FLIGHT_SIM_RADIO_MAX_QUEUE) */
+    uint16_t depth;
+    /** Deployment state to count new frames under, kept up to date by the
+        replay sink */
+    uint8_t state;
+
+    /** Queued frames, oldest first from head */
+    uint16_t head;
+    uint16_t count;
+    uint8_t type[FLIGHT_SIM_RADIO_MAX_QUEUE];
+    uint8_t queued_state[FLIGHT_SIM_RADIO_MAX_QUEUE];
+    uint16_t length[FLIGHT_SIM_RADIO_MAX_QUEUE];
+    uint32_t queued_time[FLIGHT_SIM_RADIO_MAX_QUEUE];
+    /** Time at which each frame finishes being sent in microseconds */
+    uint64_t done_time[FLIGHT_SIM_RADIO_MAX_QUEUE];
+    /** Time of the most recent service call in milliseconds */
+    uint32_t last_time;
+
+    struct flight_sim_radio_stats stats[DEPLOYMENT_NUM_STATES];
+};
+
+/**
+ *  Initialize a simulated radio.
+ *
+ *  @param radio The radio to initialize
+ *  @param rate Link rate in bytes per second
+ *  @param depth Number of frames the queue holds
+ */
+extern void init_flight_sim_radio(struct flight_sim_radio *radio,
+                                  uint32_t rate, uint16_t depth);
+
+/**
+ *  Queue a frame to be sent by a simulated radio, a telemetry_send_cb.
+ *
+ *  @param context Pointer to a struct flight_sim_radio
+ *  @param frame The frame
+ *  @param length Length of the frame in bytes
+ *
+ *  @return 0 if the frame was queued, 1 if the queue is full
+ */
+extern int flight_sim_radio_send(void *context, const uint8_t *frame,
+                                 uint16_t length);
+
+/**
+ *  Deliver the frames which have finished being sent by the current time.
+ *
+ *  @param radio The radio
+ */
+extern void flight_sim_radio_service(struct flight_sim_radio *radio);
+
+/** Sink context for replaying one simulated flight through the deployment
+    service */
+struct flight_sim_replay {
+    /** Altimeter for each simulated barometer */
+    struct ms5611_desc_t *altimeter;
+    struct mpu9250_desc_t *imu;
+    struct deployment_service_desc_t *deployment;
+    /** Timer wheel on which the drivers' wait timers are scheduled */
+    struct timer_wheel *wheel;
+    /** Which flight in the batch to replay */
+    uint32_t flight;
+    /** Vote which fuses the altimeters, serviced before the deployment
+        service (may be NULL) */
+    struct baro_vote_desc_t *vote;
+
+    /** Samples per burst when the IMU is in FIFO driven operation, 0 or 1 to
+        publish every sample as it is taken regardless of mode */
+    uint8_t fifo_burst;
+    /** Number of samples waiting in the simulated FIFO */
+    uint8_t fifo_count;
+    struct flight_sim_imu_sample fifo[FLIGHT_SIM_FIFO_DEPTH];
+    /** IMU bus use and latency in each deployment state */
+    struct flight_sim_imu_stats imu_stats[DEPLOYMENT_NUM_STATES];
+
+    /** Altimeter period set once the deployment service reaches the recovery
+        state, as the variant does (0 to leave the period unchanged) */
+    uint32_t recovery_baro_period;
+    /** Request low power operation of the IMU in the recovery state */
+    uint8_t recovery_imu_low_power;
+    /** Set once the recovery state has been reached */
+    uint8_t recovered;
+    /** Set once the simulated flight has left the ground */
+    uint8_t airborne;
+    /** Time of the most recent step */
+    uint32_t last_time;
+    /** Time at which the simulated flight came back to the ground */
+    uint32_t touchdown_time;
+    /** Time at which the deployment service reached the recovery state */
+    uint32_t recovery_time;
+    /** Sensor activity in each deployment state */
+    struct flight_sim_duty duty[DEPLOYMENT_NUM_STATES];
+
+    /** Queue on a bus which never completes a transaction, to which reads
+        which fault are submitted */
+    struct i2c_queue fault_queue;
+    /** Probability that any one read by a sensor never completes */
+    float fault_rate;
+    uint32_t fault_rng;
+    /** Time of the oldest fault of each sensor which has not been recovered
+        from yet (0 if none) */
+    uint32_t imu_fault_time;
+    uint32_t baro_fault_time[BARO_VOTE_MAX_SENSORS];
+    struct flight_sim_fault_stats imu_faults;
+    struct flight_sim_fault_stats baro_faults;
+    /** Set to make the IMU stop answering for the rest of the flight, as a
+        sensor which has failed would */
+    uint8_t imu_failed;
+
+    /** Telemetry scheduler serviced after the deployment service (may be
+        NULL) */
+    struct telemetry_sched *telemetry;
+    /** Simulated radio which the telemetry scheduler sends to, serviced
+        before it (may be NULL) */
+    struct flight_sim_radio *radio;
+};
+
+/** Depth of the altimeter and vote topics of a simulated board */
+#define FLIGHT_SIM_BARO_TOPIC_DEPTH 8
+/** Depth of the IMU topic of a simulated board, holds a full FIFO burst */
+#define FLIGHT_SIM_IMU_TOPIC_DEPTH  64
+/** Vote tolerance of a simulated board */
+#define FLIGHT_SIM_VOTE_TOLERANCE   MS5611_ALT(10)
+
+/** Drivers, vote and deployment service of one simulated flight computer,
+    set up for replaying a flight through it */
+struct flight_sim_board {
+    /** Timer wheel for the wait timers of the board's drivers */
+    struct timer_wheel wheel;
+    struct ms5611_desc_t altimeter[BARO_VOTE_MAX_SENSORS];
+    struct sensor_bus_topic altimeter_topic[BARO_VOTE_MAX_SENSORS];
+    struct ms5611_sample altimeter_records[BARO_VOTE_MAX_SENSORS]
+                                          [FLIGHT_SIM_BARO_TOPIC_DEPTH];
+    struct baro_vote_desc_t vote;
+    struct sensor_bus_topic vote_topic;
+    struct ms5611_sample vote_records[FLIGHT_SIM_BARO_TOPIC_DEPTH];
+    struct mpu9250_desc_t imu;
+    struct sensor_bus_topic imu_topic;
+    struct mpu9250_sample imu_records[FLIGHT_SIM_IMU_TOPIC_DEPTH];
+    struct deployment_service_desc_t deployment;
+    /** Sink context for the board, passed to flight_sim_replay_sink() */
+    struct flight_sim_replay replay;
+};
+
+/**
+ *  Set up a board for replaying flights with the given parameters, with one
+ *  altimeter per simulated barometer (fused by a vote if there is more than
+ *  one) and the IMU in FIFO driven operation. The driver state machines are
+ *  not part of host builds, so the descriptors are set up the way the drivers
+ *  leave them once initialized. The board must not be moved afterwards, the
+ *  replay refers to its members. The board must be zeroed (static) or set up
+ *  by an earlier call, so that a buffer still leased by its IMU is returned.
+ *  The IMU leases a buffer from the arena for each read, as the driver does.
+ *  The board's timer wheel is started at the current value of millis.
+ *
+ *  @param board The board to set up
+ *  @param config Parameters of the flights to be replayed
+ */
+extern void init_flight_sim_board(struct flight_sim_board *board,
+                                  const struct flight_sim_config *config);
+
+/**
+ *  Make sensor reads in a replay fail to complete at random, the way a stuck
+ *  bus would leave them. The drivers must be in normal operation (MS5611_IDLE
+ *  and MPU9250_RUNNING or MPU9250_FIFO_WAIT) with their periods set, their
+ *  watchdogs are run by the sink and the restart sequences are modelled as
+ *  taking FLIGHT_SIM_IMU_RESTART_TIME and FLIGHT_SIM_BARO_RESTART_TIME.
+ *
+ *  @param r The replay context
+ *  @param rate Probability that any one read never completes
+ *  @param seed Seed for choosing which reads fail
+ */
+extern void flight_sim_replay_init_faults(struct flight_sim_replay *r,
+                                          float rate, uint32_t seed);
+
+/**
+ *  Sink which loads the samples for one flight into the driver descriptors the
+ *  way the drivers would, publishes them to the drivers' topics, sets millis
+ *  and runs the vote (if any) and the deployment service. The altimeter array
+ *  must have one entry per simulated barometer. The topics must be set before
+ *  the deployment service is initialized.
+ *
+ *  The IMU is read the way the driver would in whichever mode has been
+ *  requested of it (see mpu9250_request_fifo()), one read per sample in
+ *  interrupt driven operation or a count and a burst read every fifo_burst
+ *  samples in FIFO driven operation. The FIFO is drained when switching back
+ *  to interrupt driven operation. In low power operation (see
+ *  mpu9250_request_low_power()) the IMU only takes samples at its reduced
+ *  rate and the magnetometer is off. Altimeter readings are only taken once
+ *  each altimeter's period has passed.
+ *
+ *  Each step is one pass of the main loop. The waits for the altimeter period
+ *  and for the next low power IMU sample are made on the drivers' wait timers
+ *  in the replay's timer wheel, which each step advances, and the service
+ *  calls skipped while a timer is pending are counted in the duty statistics.
+ *
+ *  Once the deployment service reaches the recovery state the sink switches
+ *  the sensors to their recovery power modes as given by recovery_baro_period
+ *  and recovery_imu_low_power, and records the time from touchdown to landing
+ *  detection. The radio and telemetry scheduler, if given, are serviced last.
+ *  With ENABLE_WCET the deployment service and the whole step are measured
+ *  into the global WCET tables. The driver tables measure the replay's
+ *  stand-ins for the driver services and the altimeter watchdog, not the
+ *  drivers' state machines.
+ *
+ *  @param context Pointer to a struct flight_sim_replay
+ */
+extern void flight_sim_replay_sink(void *context, const struct flight_sim *sim,
+                                   int new_baro);
+
+#endif /* flight_sim_h */
@@ -0,0 +1,563 @@
+/**
+ * @file ground-station.c
+ * @desc Ground station daemon which fans telemetry out to local clients
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+// For accept4()
+#define _GNU_SOURCE
+
+#include "ground-station.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifdef GROUND_STATION_MAIN
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+/** epoll identifiers for the source and listening sockets, clients are
+    identified by GROUND_STATION_CLIENT_ID plus their index */
+#define GROUND_STATION_SOURCE_ID    0
+#define GROUND_STATION_TCP_ID       1
+#define GROUND_STATION_UNIX_ID      2
+#define GROUND_STATION_CLIENT_ID    3
+
+static int ground_station_watch(struct ground_station *gs, int op, int fd,
+                                uint32_t events, uint64_t id)
+{
+    struct epoll_event event = { .events = events, .data.u64 = id };
+    return epoll_ctl(gs->epoll_fd, op, fd, &event);
+}
+
+static speed_t ground_station_speed(uint32_t baud)
+{
+    switch (baud) {
+        case 9600:
+            return B9600;
+        case 19200:
+            return B19200;
+        case 38400:
+            return B38400;
+        case 57600:
+            return B57600;
+        case 115200:
+            return B115200;
+        case 230400:
+            return B230400;
+        case 460800:
+            return B460800;
+        case 921600:
+            return B921600;
+        default:
+            return B0;
+    }
+}
+
+static int ground_station_open_source(struct ground_station *gs,
+                                      const char *source, uint32_t baud)
+{
+    gs->source_fd = open(source, O_RDONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (gs->source_fd < 0) {
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(gs->source_fd, &st) != 0) {
+        return -1;
+    }
+    if (S_ISREG(st.st_mode)) {
+        gs->source_is_file = 1;
+        return 0;
+    }
+
+    if (isatty(gs->source_fd)) {
+        const speed_t speed = ground_station_speed(baud);
+        struct termios tio;
+        if (speed == B0) {
+            errno = EINVAL;
+            return -1;
+        } else if (tcgetattr(gs->source_fd, &tio) != 0) {
+            return -1;
+        }
+        cfmakeraw(&tio);
+        cfsetispeed(&tio, speed);
+        cfsetospeed(&tio, speed);
+        tio.c_cflag |= CLOCAL | CREAD;
+        if (tcsetattr(gs->source_fd, TCSANOW, &tio) != 0) {
+            return -1;
+        }
+    }
+    return ground_station_watch(gs, EPOLL_CTL_ADD, gs->source_fd, EPOLLIN,
+                                GROUND_STATION_SOURCE_ID);
+}
+
+static int ground_station_listen(struct ground_station *gs, uint16_t port,
+                                 const char *unix_path)
+{
+    if (port != 0) {
+        gs->tcp_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK |
+                            SOCK_CLOEXEC, 0);
+        if (gs->tcp_fd < 0) {
+            return -1;
+        }
+        const int on = 1;
+        setsockopt(gs->tcp_fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+        struct sockaddr_in addr = {
+            .sin_family = AF_INET,
+            .sin_port = htons(port),
+            .sin_addr.s_addr = htonl(INADDR_LOOPBACK)
+        };
+        if ((bind(gs->tcp_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+                (listen(gs->tcp_fd, SOMAXCONN) != 0) ||
+                (ground_station_watch(gs, EPOLL_CTL_ADD, gs->tcp_fd, EPOLLIN,
+                                      GROUND_STATION_TCP_ID) != 0)) {
+            return -1;
+        }
+    }
+
+    if (unix_path != NULL) {
+        struct sockaddr_un addr = { .sun_family = AF_UNIX };
+        if (strlen(unix_path) >= sizeof(addr.sun_path)) {
+            errno = ENAMETOOLONG;
+            return -1;
+        }
+        strcpy(addr.sun_path, unix_path);
+
+        gs->unix_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK |
+                             SOCK_CLOEXEC, 0);
+        if (gs->unix_fd < 0) {
+            return -1;
+        }
+        // A stale socket may be left from a previous run
+        unlink(unix_path);
+        gs->unix_path = unix_path;
+        if ((bind(gs->unix_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) ||
+                (listen(gs->unix_fd, SOMAXCONN) != 0) ||
+                (ground_station_watch(gs, EPOLL_CTL_ADD, gs->unix_fd, EPOLLIN,
+                                      GROUND_STATION_UNIX_ID) != 0)) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int init_ground_station(struct ground_station *gs, const char *source,
+                        uint32_t baud, uint16_t port, const char *unix_path)
+{
+    gs->source_fd = -1;
+    gs->tcp_fd = -1;
+    gs->unix_fd = -1;
+    gs->unix_path = NULL;
+    gs->source_is_file = 0;
+    gs->source_done = 0;
+    gs->clients_dropped = 0;
+    for (uint32_t i = 0; i < GROUND_STATION_MAX_CLIENTS; i++) {
+        gs->clients[i].fd = -1;
+    }
+
+    init_telemetry_decoder(&gs->decoder);
+    init_sensor_bus_topic(&gs->frames, gs->ring, sizeof(gs->ring[0]),
+                          GROUND_STATION_RING_DEPTH);
+
+    gs->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if ((gs->epoll_fd < 0) ||
+            (ground_station_open_source(gs, source, baud) != 0) ||
+            (ground_station_listen(gs, port, unix_path) != 0)) {
+        const int error = errno;
+        ground_station_close(gs);
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
+
+static void ground_station_disconnect(struct ground_station_client *client)
+{
+    // Closing the socket also removes it from the epoll set
+    close(client->fd);
+    client->fd = -1;
+}
+
+static void ground_station_accept(struct ground_station *gs, int listen_fd)
+{
+    for (;;) {
+        const int fd = accept4(listen_fd, NULL, NULL,
+                               SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            return;
+        }
+
+        uint32_t i = 0;
+        while ((i < GROUND_STATION_MAX_CLIENTS) && (gs->clients[i].fd >= 0)) {
+            i++;
+        }
+        if ((i == GROUND_STATION_MAX_CLIENTS) ||
+                (ground_station_watch(gs, EPOLL_CTL_ADD, fd,
+                                      EPOLLIN | EPOLLRDHUP,
+                                      GROUND_STATION_CLIENT_ID + i) != 0)) {
+            close(fd);
+            continue;
+        }
+        // Frames are small and should go out as soon as they arrive, this has
+        // no effect on a Unix socket
+        const int on = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        const int send_buffer = GROUND_STATION_SEND_BUFFER;
+        setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &send_buffer,
+                   sizeof(send_buffer));
+
+        struct ground_station_client *const client = &gs->clients[i];
+        client->fd = fd;
+        init_sensor_bus_cursor(&client->cursor, &gs->frames);
+        client->offset = 0;
+        client->sent = 0;
+        client->downsampled = 0;
+        client->blocked = 0;
+        client->downsampling = 0;
+    }
+}
+
+/**
+ *  Get whether a frame should be left out for a client which is being
+ *  downsampled.
+ */
+static int ground_station_skip(const struct ground_station_client *client,
+                               const struct ground_station_frame *frame)
+{
+    if (!client->downsampling || (client->offset != 0)) {
+        return 0;
+    }
+    const struct telemetry_header *const header =
+                                        telemetry_frame_header(frame->data);
+    return ((header->type == TELEMETRY_IMU) &&
+            ((header->seq % GROUND_STATION_DOWNSAMPLE) != 0));
+}
+
+/**
+ *  Send as many frames as the client's socket will take.
+ *
+ *  @return 0 if successful, -1 if the client should be dropped
+ */
+static int ground_station_flush(struct ground_station *gs,
+                                struct ground_station_client *client)
+{
+    for (;;) {
+        uint32_t pending = sensor_bus_pending(&client->cursor);
+        if ((pending >= GROUND_STATION_RING_DEPTH) && (client->offset != 0)) {
+            // The rest of the frame that was being sent has been overwritten
+            return -1;
+        }
+        if (sensor_bus_peek(&client->cursor) == NULL) {
+            break;
+        }
+        if (client->cursor.overruns > GROUND_STATION_MAX_LOST) {
+            return -1;
+        }
+        pending = sensor_bus_pending(&client->cursor);
+
+        if (pending > GROUND_STATION_DOWNSAMPLE_LAG) {
+            client->downsampling = 1;
+        } else if (pending < (GROUND_STATION_DOWNSAMPLE_LAG / 2)) {
+            client->downsampling = 0;
+        }
+
+        // Gather frames straight from the ring, skipped frames are only
+        // consumed once everything before them has been sent
+        struct iovec iov[GROUND_STATION_WRITE_FRAMES];
+        uint32_t n_iov = 0;
+        uint32_t n_frames = 0;
+        while ((n_frames < pending) && (n_iov < GROUND_STATION_WRITE_FRAMES)) {
+            const uint32_t i = ((client->cursor.tail + n_frames) &
+                                (GROUND_STATION_RING_DEPTH - 1));
+            const struct ground_station_frame *const frame = &gs->ring[i];
+            n_frames++;
+            if ((n_iov == 0) && ground_station_skip(client, frame)) {
+                continue;
+            } else if (ground_station_skip(client, frame)) {
+                n_frames--;
+                break;
+            }
+            const uint16_t start = (n_iov == 0) ? client->offset : 0;
+            iov[n_iov].iov_base = (void *)(frame->data + start);
+            iov[n_iov].iov_len = frame->length - start;
+            n_iov++;
+        }
+
+        ssize_t sent = 0;
+        if (n_iov != 0) {
+            struct msghdr msg = { .msg_iov = iov, .msg_iovlen = n_iov };
+            sent = sendmsg(client->fd, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+            if ((sent < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+                sent = 0;
+            } else if (sent < 0) {
+                return -1;
+            }
+        }
+
+        // Consume skipped frames at the start and every frame fully sent
+        uint32_t consumed = 0;
+        uint32_t k = 0;
+        for (; consumed < n_frames; consumed++) {
+            const uint32_t i = ((client->cursor.tail) &
+                                (GROUND_STATION_RING_DEPTH - 1));
+            const struct ground_station_frame *const frame = &gs->ring[i];
+            if ((k == 0) && ground_station_skip(client, frame)) {
+                client->downsampled++;
+                sensor_bus_advance(&client->cursor);
+                continue;
+            }
+            const size_t left = frame->length - client->offset;
+            if ((size_t)sent < left) {
+                client->offset += sent;
+                break;
+            }
+            sent -= left;
+            client->offset = 0;
+            client->sent++;
+            k++;
+            sensor_bus_advance(&client->cursor);
+        }
+
+        if ((n_iov != 0) && (consumed < n_frames)) {
+            // The socket is full
+            if (!client->blocked) {
+                client->blocked = 1;
+                ground_station_watch(gs, EPOLL_CTL_MOD, client->fd,
+                                     EPOLLIN | EPOLLRDHUP | EPOLLOUT,
+                                     GROUND_STATION_CLIENT_ID +
+                                        (uint64_t)(client - gs->clients));
+            }
+            return 0;
+        }
+    }
+
+    if (client->blocked) {
+        client->blocked = 0;
+        ground_station_watch(gs, EPOLL_CTL_MOD, client->fd,
+                             EPOLLIN | EPOLLRDHUP,
+                             GROUND_STATION_CLIENT_ID +
+                                (uint64_t)(client - gs->clients));
+    }
+    return 0;
+}
+
+static void ground_station_store_frame(void *context, const uint8_t *frame,
+                                       uint16_t length)
+{
+    struct ground_station *const gs = context;
+    struct ground_station_frame *const slot = sensor_bus_claim(&gs->frames);
+    slot->length = length;
+    memcpy(slot->data, frame, length);
+    sensor_bus_commit(&gs->frames);
+}
+
+/**
+ *  Read from the source and send new frames to every client which is not
+ *  waiting for its socket to become writable.
+ */
+static void ground_station_read_source(struct ground_station *gs,
+                                       uint32_t limit)
+{
+    uint8_t buffer[GROUND_STATION_READ_LENGTH];
+    const uint32_t head = gs->frames.head;
+    uint32_t total = 0;
+
+    while (total < limit) {
+        const size_t want = ((limit - total) < sizeof(buffer)) ?
+                                (limit - total) : sizeof(buffer);
+        const ssize_t n = read(gs->source_fd, buffer, want);
+        if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+            break;
+        } else if (n <= 0) {
+            // End of file, or the other end of a pty has been closed
+            gs->source_done = 1;
+            if (!gs->source_is_file) {
+                epoll_ctl(gs->epoll_fd, EPOLL_CTL_DEL, gs->source_fd, NULL);
+            }
+            break;
+        }
+        telemetry_decode(&gs->decoder, buffer, (uint32_t)n,
+                         ground_station_store_frame, gs);
+        total += (uint32_t)n;
+    }
+
+    if (gs->frames.head == head) {
+        return;
+    }
+    for (uint32_t i = 0; i < GROUND_STATION_MAX_CLIENTS; i++) {
+        struct ground_station_client *const client = &gs->clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        const int drop = (client->blocked ?
+                          ((sensor_bus_pending(&client->cursor) >=
+                            GROUND_STATION_RING_DEPTH) &&
+                           (client->offset != 0)) :
+                          (ground_station_flush(gs, client) != 0));
+        if (drop) {
+            gs->clients_dropped++;
+            ground_station_disconnect(client);
+        }
+    }
+}
+
+static void ground_station_client_event(struct ground_station *gs,
+                                        struct ground_station_client *client,
+                                        uint32_t events)
+{
+    if (events & EPOLLIN) {
+        // Clients have nothing to say, anything they send is discarded
+        uint8_t discard[256];
+        while (recv(client->fd, discard, sizeof(discard), MSG_DONTWAIT) > 0) {
+        }
+    }
+    if (events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+        ground_station_disconnect(client);
+        return;
+    }
+    if ((events & EPOLLOUT) && (ground_station_flush(gs, client) != 0)) {
+        gs->clients_dropped++;
+        ground_station_disconnect(client);
+    }
+}
+
+int ground_station_poll(struct ground_station *gs, int timeout)
+{
+    const int replay = gs->source_is_file && !gs->source_done;
+    if (replay && ((timeout < 0) || (timeout > GROUND_STATION_FILE_PERIOD))) {
+        timeout = GROUND_STATION_FILE_PERIOD;
+    }
+
+    struct epoll_event events[GROUND_STATION_MAX_CLIENTS + 3];
+    const int n = epoll_wait(gs->epoll_fd, events,
+                             (int)(sizeof(events) / sizeof(events[0])),
+                             timeout);
+    if ((n < 0) && (errno != EINTR)) {
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        const uint64_t id = events[i].data.u64;
+        if (id == GROUND_STATION_SOURCE_ID) {
+            ground_station_read_source(gs, UINT32_MAX);
+        } else if (id == GROUND_STATION_TCP_ID) {
+            ground_station_accept(gs, gs->tcp_fd);
+        } else if (id == GROUND_STATION_UNIX_ID) {
+            ground_station_accept(gs, gs->unix_fd);
+        } else {
+            struct ground_station_client *const client =
+                                &gs->clients[id - GROUND_STATION_CLIENT_ID];
+            if (client->fd >= 0) {
+                ground_station_client_event(gs, client, events[i].events);
+            }
+        }
+    }
+
+    if (replay) {
+        ground_station_read_source(gs, GROUND_STATION_FILE_CHUNK);
+    }
+    return 0;
+}
+
+void ground_station_close(struct ground_station *gs)
+{
+    for (uint32_t i = 0; i < GROUND_STATION_MAX_CLIENTS; i++) {
+        if (gs->clients[i].fd >= 0) {
+            ground_station_disconnect(&gs->clients[i]);
+        }
+    }
+    const int fds[] = { gs->source_fd, gs->tcp_fd, gs->unix_fd,
+                        gs->epoll_fd };
+    for (uint32_t i = 0; i < (sizeof(fds) / sizeof(fds[0])); i++) {
+        if (fds[i] >= 0) {
+            close(fds[i]);
+        }
+    }
+    if (gs->unix_path != NULL) {
+        unlink(gs->unix_path);
+    }
+    gs->source_fd = -1;
+    gs->tcp_fd = -1;
+    gs->unix_fd = -1;
+    gs->epoll_fd = -1;
+    gs->unix_path = NULL;
+}
+
+#ifdef GROUND_STATION_MAIN
+static volatile sig_atomic_t ground_station_stop;
+
+static void ground_station_signal(int sig)
+{
+    (void)sig;
+    ground_station_stop = 1;
+}
+
+int main(int argc, char **argv)
+{
+    static struct ground_station gs;
+    uint32_t baud = 115200;
+    uint16_t port = 0;
+    const char *unix_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:p:u:")) != -1) {
+        switch (opt) {
+            case 'b':
+                baud = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                port = (uint16_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'u':
+                unix_path = optarg;
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if ((optind != (argc - 1)) || ((port == 0) && (unix_path == NULL))) {
+        fprintf(stderr, "usage: %s [-b baud] [-p tcp port] [-u unix socket] "
+                "source\n", argv[0]);
+        return 2;
+    }
+
+    if (init_ground_station(&gs, argv[optind], baud, port, unix_path) != 0) {
+        perror(argv[optind]);
+        return 1;
+    }
+    signal(SIGINT, ground_station_signal);
+    signal(SIGTERM, ground_station_signal);
+
+    while (!ground_station_stop) {
+        if (ground_station_poll(&gs, -1) != 0) {
+            perror("epoll_wait");
+            break;
+        }
+    }
+
+    fprintf(stderr, "%u frames, %u CRC errors, %u bytes skipped, %u clients "
+            "dropped\n", (unsigned)gs.decoder.frames,
+            (unsigned)gs.decoder.crc_errors, (unsigned)gs.decoder.skipped,
+            (unsigned)gs.clients_dropped);
+    ground_station_close(&gs);
+    return 0;
+}
+#endif
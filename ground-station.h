@@ -0,0 +1,143 @@
+/**
+ * @file ground-station.h
+ * @desc Ground station daemon which fans telemetry out to local clients
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef ground_station_h
+#define ground_station_h
+
+#include "test-global.h"
+#include "telemetry.h"
+#include "sensor-bus.h"
+
+/** Number of frames kept for clients, must be a power of two */
+#ifndef GROUND_STATION_RING_DEPTH
+#define GROUND_STATION_RING_DEPTH       4096
+#endif
+/** Largest number of clients connected at once */
+#ifndef GROUND_STATION_MAX_CLIENTS
+#define GROUND_STATION_MAX_CLIENTS      64
+#endif
+/** Number of frames behind the newest at which a client is only sent every
+    GROUND_STATION_DOWNSAMPLE th IMU frame, it is sent every frame again once
+    it has caught up to half of this */
+#define GROUND_STATION_DOWNSAMPLE_LAG   (GROUND_STATION_RING_DEPTH / 4)
+#define GROUND_STATION_DOWNSAMPLE       10
+/** Number of frames a client can lose to being overrun before it is dropped */
+#define GROUND_STATION_MAX_LOST         GROUND_STATION_RING_DEPTH
+/** Send buffer size for client sockets in bytes, kept small so that a client
+    which falls behind does so in the shared ring, where it is downsampled,
+    rather than in the kernel */
+#define GROUND_STATION_SEND_BUFFER      16384
+/** Largest number of frames sent to a client in one write */
+#define GROUND_STATION_WRITE_FRAMES     64
+/** Number of bytes read from the source at once */
+#define GROUND_STATION_READ_LENGTH      4096
+/** A regular file used as the source is replayed at this many bytes every
+    GROUND_STATION_FILE_PERIOD milliseconds */
+#define GROUND_STATION_FILE_CHUNK       512
+#define GROUND_STATION_FILE_PERIOD      10
+
+/** A decoded frame as stored in the shared ring */
+struct ground_station_frame {
+    /** Length of the frame in bytes */
+    uint16_t length;
+    uint8_t data[TELEMETRY_MAX_FRAME];
+};
+
+struct ground_station_client {
+    /** Socket, -1 if this slot is free */
+    int fd;
+    /** Position in the shared ring, the frame at the cursor is the next one to
+        be sent */
+    struct sensor_bus_cursor cursor;
+    /** Number of bytes of the frame at the cursor which have been sent */
+    uint16_t offset;
+    /** Number of frames sent */
+    uint32_t sent;
+    /** Number of frames left out while downsampling */
+    uint32_t downsampled;
+    /** Flag set while the socket is full, the client is written again once it
+        becomes writable */
+    uint8_t blocked:1;
+    /** Flag set while the client is far enough behind to be downsampled */
+    uint8_t downsampling:1;
+};
+
+/**
+ *  Ground station, which decodes frames from a serial port (or a pty or file
+ *  standing in for one) and sends every valid frame to each connected client.
+ *
+ *  Frames are decoded once into a shared ring, which each client reads through
+ *  its own cursor. Writes to clients gather frames straight from the ring, so
+ *  the data is never copied per client. Every socket is non-blocking and
+ *  served from one epoll loop, a client whose socket is full is only written
+ *  again once epoll reports it writable, so it never holds up the others. A
+ *  client which falls behind is downsampled, and one which falls so far behind
+ *  that frames it has not been sent are overwritten is dropped if it was part
+ *  way through a frame or has lost more than GROUND_STATION_MAX_LOST frames.
+ */
+struct ground_station {
+    int epoll_fd;
+    /** Serial port, pty or file frames are read from */
+    int source_fd;
+    /** Listening sockets, -1 if not used */
+    int tcp_fd;
+    int unix_fd;
+    /** Path of the Unix socket, removed when the ground station is closed */
+    const char *unix_path;
+
+    struct telemetry_decoder decoder;
+    /** Topic of decoded frames (struct ground_station_frame) */
+    struct sensor_bus_topic frames;
+    struct ground_station_frame ring[GROUND_STATION_RING_DEPTH];
+
+    struct ground_station_client clients[GROUND_STATION_MAX_CLIENTS];
+    /** Number of clients dropped for falling behind */
+    uint32_t clients_dropped;
+
+    /** Flag set if the source is a regular file, which epoll cannot wait on */
+    uint8_t source_is_file:1;
+    /** Flag set once the source has been closed or read to the end */
+    uint8_t source_done:1;
+};
+
+/**
+ *  Open the source and the listening sockets. A serial port source is set to
+ *  raw mode at the given baud rate. The TCP socket only listens on the
+ *  loopback interface.
+ *
+ *  @param gs The ground station to initialize
+ *  @param source Path of a serial port, pty or file
+ *  @param baud Baud rate for a serial port source
+ *  @param port TCP port to listen on, 0 for none
+ *  @param unix_path Path for a Unix socket to listen on, NULL for none
+ *
+ *  @return 0 if successful, -1 with errno set otherwise
+ */
+extern int init_ground_station(struct ground_station *gs, const char *source,
+                               uint32_t baud, uint16_t port,
+                               const char *unix_path);
+
+/**
+ *  Wait for and handle events.
+ *
+ *  @param gs The ground station
+ *  @param timeout Longest time to wait in milliseconds, -1 to wait forever
+ *
+ *  @return 0 if successful, -1 with errno set if waiting failed
+ */
+extern int ground_station_poll(struct ground_station *gs, int timeout);
+
+/**
+ *  Disconnect all clients and close the source and listening sockets.
+ *
+ *  @param gs The ground station
+ */
+extern void ground_station_close(struct ground_station *gs);
+
+#endif /* ground_station_h */
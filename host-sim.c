@@ -0,0 +1,20 @@
+/**
+ * @file host-sim.c
+ * @desc Variant globals for host simulations and benchmarks
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "host-sim.h"
+
+const struct deployment_pyro_event deployment_pyro_events_g[] =
+                                                        DEPLOYMENT_PYRO_EVENTS;
+const uint8_t deployment_num_pyro_events_g =
+        (uint8_t)(sizeof(deployment_pyro_events_g) /
+                  sizeof(deployment_pyro_events_g[0]));
+
+_Static_assert((sizeof(deployment_pyro_events_g) /
+                sizeof(deployment_pyro_events_g[0])) <=
+                    DEPLOYMENT_MAX_PYRO_EVENTS, "Too many pyro events");
@@ -0,0 +1,27 @@
+/**
+ * @file host-sim.h
+ * @desc Variant settings for host simulations and benchmarks
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef host_sim_h
+#define host_sim_h
+
+/* Host builds count time in milliseconds */
+#ifndef MS_TO_MILLIS
+#define MS_TO_MILLIS(x) (x)
+#endif
+
+#include "variant-test.h"
+
+/*
+ *  host-sim.c holds the variant's default pyro event table, which the
+ *  deployment service links against. Host programs which replay flights with
+ *  the variant's events link it, those with a table of their own (such as
+ *  lockstep-sim) do not.
+ */
+
+#endif /* host_sim_h */
@@ -0,0 +1,338 @@
+/**
+ * @file i2c-queue-sim.c
+ * @desc Host test of the I2C transaction queue against a mock bus
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef I2C_QUEUE_SIM_MAIN
+
+#include "i2c-queue.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Bus clock of the mock bus in Hz */
+#define I2C_QUEUE_SIM_CLOCK     400000
+/** Every this many transactions the mock bus fails one at once, so that its
+    completion interrupt is raised from within the queue */
+#define I2C_QUEUE_SIM_FAIL_EVERY 37
+
+/**
+ *  Mock bus which models the bus interrupt. A completion which is due while
+ *  the interrupt is masked, or while it is already being handled, is held
+ *  pending and delivered when the interrupt is unmasked, as on the real
+ *  peripheral.
+ */
+struct mock_bus {
+    struct i2c_queue *queue;
+    /** Current time in microseconds */
+    uint32_t now;
+    /** Time at which the transaction on the bus finishes */
+    uint32_t done_time;
+    /** Number of transactions started */
+    uint32_t starts;
+    /** Time the bus was occupied as seen by the bus in microseconds */
+    uint32_t busy;
+    uint32_t busy_start;
+    /** Times the queue started a transaction without masking the interrupt */
+    uint32_t violations;
+    /** Order of the addresses started, for the ordering checks */
+    uint8_t order[16];
+    uint8_t num_order;
+
+    uint8_t on_bus:1;
+    uint8_t pending:1;
+    uint8_t success:1;
+    uint8_t masked:1;
+    uint8_t in_irq:1;
+};
+
+static uint32_t mock_duration(const struct i2c_transaction *t)
+{
+    // Address byte, plus register byte and repeated start address for
+    // register transactions, each 9 bit times long
+    uint32_t bytes = 1u + t->length;
+    if ((t->type == I2C_TRANSACTION_REG_READ) ||
+            (t->type == I2C_TRANSACTION_REG_WRITE)) {
+        bytes += 2;
+    }
+    return (bytes * 9u * 1000000u) / I2C_QUEUE_SIM_CLOCK;
+}
+
+/**
+ *  Run the bus interrupt for every completion which is due and not masked.
+ */
+static void mock_deliver(struct mock_bus *bus)
+{
+    while (bus->pending && !bus->masked && !bus->in_irq) {
+        bus->pending = 0;
+        bus->in_irq = 1;
+        i2c_queue_complete(bus->queue, bus->success);
+        bus->in_irq = 0;
+    }
+}
+
+static void mock_raise(struct mock_bus *bus, int success)
+{
+    bus->on_bus = 0;
+    bus->busy += bus->now - bus->busy_start;
+    bus->pending = 1;
+    bus->success = (uint8_t)success;
+    mock_deliver(bus);
+}
+
+static int mock_start(void *b, const struct i2c_transaction *t)
+{
+    struct mock_bus *const bus = b;
+    if (!bus->masked && !bus->in_irq) {
+        bus->violations++;
+    }
+    if (bus->num_order < sizeof(bus->order)) {
+        bus->order[bus->num_order++] = t->address;
+    }
+
+    bus->on_bus = 1;
+    bus->busy_start = bus->now;
+    bus->done_time = bus->now + mock_duration(t);
+
+    if ((++bus->starts % I2C_QUEUE_SIM_FAIL_EVERY) == 0) {
+        // Address not acknowledged, the interrupt is raised right away
+        mock_raise(bus, 0);
+    }
+    return 0;
+}
+
+static void mock_abort(void *b)
+{
+    struct mock_bus *const bus = b;
+    if (bus->on_bus) {
+        bus->on_bus = 0;
+        bus->busy += bus->now - bus->busy_start;
+    }
+}
+
+static void mock_lock(void *b)
+{
+    struct mock_bus *const bus = b;
+    if (bus->masked && !bus->in_irq) {
+        bus->violations++;
+    }
+    bus->masked = 1;
+}
+
+static void mock_unlock(void *b)
+{
+    struct mock_bus *const bus = b;
+    bus->masked = 0;
+    mock_deliver(bus);
+}
+
+static uint32_t mock_micros(void *b)
+{
+    return ((struct mock_bus *)b)->now;
+}
+
+static const struct i2c_bus_ops mock_bus_ops = {
+    .start = mock_start,
+    .abort = mock_abort,
+    .lock = mock_lock,
+    .unlock = mock_unlock,
+    .micros = mock_micros
+};
+
+/**
+ *  Advance the mock bus to a time, completing the transactions which finish
+ *  on the way.
+ */
+static void mock_run_until(struct mock_bus *bus, uint32_t time)
+{
+    while (bus->on_bus && ((int32_t)(bus->done_time - time) <= 0)) {
+        bus->now = bus->done_time;
+        mock_raise(bus, 1);
+    }
+    bus->now = time;
+}
+
+static void init_mock_transaction(struct i2c_transaction *t, uint8_t address,
+                                  enum i2c_queue_priority priority,
+                                  enum i2c_transaction_type type,
+                                  uint8_t *buffer, uint16_t length)
+{
+    init_i2c_transaction(t, priority, NULL, NULL);
+    t->address = address;
+    t->type = type;
+    t->buffer = buffer;
+    t->length = length;
+}
+
+static int check(int ok, const char *what)
+{
+    if (!ok) {
+        fprintf(stderr, "FAILED: %s\n", what);
+    }
+    return ok ? 0 : 1;
+}
+
+/**
+ *  Check priority order, chaining, coalescing and abort.
+ */
+static int test_ordering(void)
+{
+    static struct mock_bus bus;
+    static struct i2c_queue queue;
+    static uint8_t data[16];
+    struct i2c_transaction a, b, c, d, e;
+    int failures = 0;
+
+    bus.queue = &queue;
+    init_i2c_queue(&queue, &mock_bus_ops, &bus);
+
+    init_mock_transaction(&a, 1, I2C_PRIORITY_CONFIG, I2C_TRANSACTION_WRITE,
+                          data, 2);
+    init_mock_transaction(&b, 2, I2C_PRIORITY_CONFIG, I2C_TRANSACTION_WRITE,
+                          data, 2);
+    init_mock_transaction(&c, 3, I2C_PRIORITY_SAMPLE,
+                          I2C_TRANSACTION_REG_READ, data, 14);
+    init_mock_transaction(&d, 4, I2C_PRIORITY_SAMPLE, I2C_TRANSACTION_READ,
+                          data, 7);
+    init_mock_transaction(&e, 5, I2C_PRIORITY_NORMAL, I2C_TRANSACTION_READ,
+                          data, 3);
+    c.chain = &d;
+
+    i2c_queue_submit(&queue, &a);
+    i2c_queue_submit(&queue, &b);
+    i2c_queue_submit(&queue, &c);
+    i2c_queue_submit(&queue, &b);
+    i2c_queue_submit(&queue, &e);
+    failures += check(queue.stats.coalesced == 1, "resubmission coalesced");
+
+    // Abort a queued transaction, then let the rest finish
+    failures += check(i2c_queue_abort(&e) && (e.state == I2C_TRANSACTION_IDLE),
+                      "abort of queued transaction");
+    mock_run_until(&bus, 10000);
+
+    static const uint8_t expected[] = {1, 3, 4, 2};
+    failures += check(bus.num_order == sizeof(expected), "start count");
+    for (uint8_t i = 0; i < sizeof(expected) && i < bus.num_order; i++) {
+        failures += check(bus.order[i] == expected[i],
+                          "sample chain started ahead of config");
+    }
+    failures += check(queue.stats.chained == 1, "chained count");
+    failures += check(i2c_transaction_finished(&a) &&
+                      i2c_transaction_finished(&b) &&
+                      i2c_transaction_finished(&c) &&
+                      i2c_transaction_finished(&d), "all finished");
+
+    // Abort a chain while its second part is on the bus
+    bus.starts = 1;
+    i2c_queue_submit(&queue, &c);
+    mock_run_until(&bus, bus.now + mock_duration(&c));
+    failures += check(queue.current == &d, "chain keeps the bus");
+    failures += check(i2c_queue_abort(&c) && (queue.current == NULL) &&
+                      (d.state == I2C_TRANSACTION_IDLE) && !bus.on_bus,
+                      "abort of chain on the bus");
+
+    failures += check(bus.violations == 0, "bus interrupt masked");
+    return failures;
+}
+
+/**
+ *  Run a typical sensor load and compare the queue's statistics with the time
+ *  the mock bus was actually occupied.
+ */
+static int test_load(uint32_t seconds)
+{
+    static struct mock_bus bus;
+    static struct i2c_queue queue;
+    static uint8_t data[32];
+    struct i2c_transaction imu, mag, baro, config;
+    int failures = 0;
+
+    bus.queue = &queue;
+    init_i2c_queue(&queue, &mock_bus_ops, &bus);
+
+    init_mock_transaction(&imu, 0x68, I2C_PRIORITY_SAMPLE,
+                          I2C_TRANSACTION_REG_READ, data, 14);
+    init_mock_transaction(&mag, 0x0C, I2C_PRIORITY_SAMPLE,
+                          I2C_TRANSACTION_REG_READ, data, 7);
+    init_mock_transaction(&baro, 0x77, I2C_PRIORITY_NORMAL,
+                          I2C_TRANSACTION_REG_READ, data, 3);
+    init_mock_transaction(&config, 0x68, I2C_PRIORITY_CONFIG,
+                          I2C_TRANSACTION_REG_WRITE, data, 1);
+    imu.chain = &mag;
+
+    // Main loop every 50 us, IMU at 1 kHz, barometer at 100 Hz and one
+    // configuration write every 100 ms. The barometer and configuration
+    // traffic is timed to still be on the bus when the IMU read is due.
+    for (uint32_t t = 0; t < seconds * 1000000u; t += 50) {
+        mock_run_until(&bus, t);
+        if ((t % 1000) == 0) {
+            i2c_queue_submit(&queue, &imu);
+        }
+        if ((t % 10000) == 9950) {
+            i2c_queue_submit(&queue, &baro);
+        }
+        if ((t % 100000) == 99900) {
+            i2c_queue_submit(&queue, &config);
+        }
+    }
+    mock_run_until(&bus, seconds * 1000000u);
+
+    const uint32_t elapsed = bus.now;
+    const uint16_t occupancy = i2c_queue_occupancy(&queue);
+    const uint32_t expected = (uint32_t)(((uint64_t)bus.busy * 1000) /
+                                         elapsed);
+
+    printf("%u s: sample %u, normal %u, config %u completed, %u failed, "
+           "%u coalesced\n", (unsigned)seconds,
+           (unsigned)queue.stats.completed[I2C_PRIORITY_SAMPLE],
+           (unsigned)queue.stats.completed[I2C_PRIORITY_NORMAL],
+           (unsigned)queue.stats.completed[I2C_PRIORITY_CONFIG],
+           (unsigned)queue.stats.failed, (unsigned)queue.stats.coalesced);
+    printf("max wait: sample %u us, normal %u us, config %u us\n",
+           (unsigned)queue.stats.max_wait[I2C_PRIORITY_SAMPLE],
+           (unsigned)queue.stats.max_wait[I2C_PRIORITY_NORMAL],
+           (unsigned)queue.stats.max_wait[I2C_PRIORITY_CONFIG]);
+    printf("occupancy %u.%u%% (bus %u.%u%%)\n", occupancy / 10,
+           occupancy % 10, (unsigned)(expected / 10),
+           (unsigned)(expected % 10));
+
+    failures += check(occupancy == expected, "occupancy matches the bus");
+    failures += check(queue.stats.failed > 0, "failures raised in the queue");
+    failures += check(queue.stats.max_wait[I2C_PRIORITY_SAMPLE] <=
+                      mock_duration(&baro), "sample waits for one transaction");
+    failures += check(bus.violations == 0, "bus interrupt masked");
+    return failures;
+}
+
+int main (int argc, char **argv)
+{
+    uint32_t seconds = 10;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                seconds = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s seconds of load]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    int failures = test_ordering();
+    failures += test_load(seconds);
+    if (failures != 0) {
+        fprintf(stderr, "%d checks failed\n", failures);
+        return 1;
+    }
+    printf("all checks passed\n");
+    return 0;
+}
+
+#endif
@@ -0,0 +1,316 @@
+/**
+ * @file i2c-queue.c
+ * @desc Shared queue which arbitrates I2C transactions between drivers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "i2c-queue.h"
+#include "trace.h"
+
+void init_i2c_queue(struct i2c_queue *inst, const struct i2c_bus_ops *ops,
+                    void *bus)
+{
+    for (int i = 0; i < I2C_NUM_PRIORITIES; i++) {
+        inst->head[i] = NULL;
+        inst->tail[i] = NULL;
+    }
+    inst->current = NULL;
+    inst->ops = ops;
+    inst->bus = bus;
+    inst->busy_start = 0;
+
+    i2c_queue_reset_stats(inst);
+}
+
+void init_i2c_transaction(struct i2c_transaction *t,
+                          enum i2c_queue_priority priority,
+                          i2c_transaction_cb callback, void *context)
+{
+    t->next = NULL;
+    t->chain = NULL;
+    t->callback = callback;
+    t->context = context;
+    t->buffer = NULL;
+    t->length = 0;
+    t->queue_time = 0;
+    t->queue = NULL;
+    t->address = 0;
+    t->reg = 0;
+    t->type = I2C_TRANSACTION_READ;
+    t->priority = priority;
+    t->state = I2C_TRANSACTION_IDLE;
+}
+
+static inline uint32_t queue_micros(const struct i2c_queue *inst)
+{
+    return (inst->ops->micros != NULL) ? inst->ops->micros(inst->bus) : 0;
+}
+
+/**
+ *  Mask the bus interrupt so that i2c_queue_complete() cannot change the queue
+ *  under the main loop.
+ */
+static inline void queue_lock(const struct i2c_queue *inst)
+{
+    if (inst->ops->lock != NULL) {
+        inst->ops->lock(inst->bus);
+    }
+}
+
+static inline void queue_unlock(const struct i2c_queue *inst)
+{
+    if (inst->ops->unlock != NULL) {
+        inst->ops->unlock(inst->bus);
+    }
+}
+
+static struct i2c_transaction *pop_next(struct i2c_queue *inst)
+{
+    for (int i = 0; i < I2C_NUM_PRIORITIES; i++) {
+        struct i2c_transaction *const t = inst->head[i];
+        if (t == NULL) {
+            continue;
+        }
+
+        inst->head[i] = t->next;
+        if (inst->head[i] == NULL) {
+            inst->tail[i] = NULL;
+        }
+        t->next = NULL;
+        return t;
+    }
+    return NULL;
+}
+
+static void start_transaction(struct i2c_queue *inst,
+                              struct i2c_transaction *t)
+{
+    const uint32_t now = queue_micros(inst);
+    if (inst->current == NULL) {
+        inst->busy_start = now;
+    }
+
+    inst->current = t;
+    t->state = I2C_TRANSACTION_IN_PROGRESS;
+    TRACE(TRACE_I2C_START, t->address, t->priority);
+
+    const uint32_t wait = now - t->queue_time;
+    if (wait > inst->stats.max_wait[t->priority]) {
+        inst->stats.max_wait[t->priority] = wait;
+    }
+
+    if (inst->ops->start(inst->bus, t) != 0) {
+        // Bus refused transaction, put it back at the front of its queue and
+        // try again from i2c_queue_service()
+        t->state = I2C_TRANSACTION_QUEUED;
+        t->next = inst->head[t->priority];
+        inst->head[t->priority] = t;
+        if (inst->tail[t->priority] == NULL) {
+            inst->tail[t->priority] = t;
+        }
+        inst->current = NULL;
+        inst->stats.busy_time += queue_micros(inst) - inst->busy_start;
+    }
+}
+
+/**
+ *  Start the next transaction if the bus is idle, the caller must hold the
+ *  lock or be the bus interrupt.
+ */
+static void service_locked(struct i2c_queue *inst)
+{
+    if (inst->current != NULL) {
+        return;
+    }
+
+    struct i2c_transaction *const t = pop_next(inst);
+    if (t != NULL) {
+        start_transaction(inst, t);
+    }
+}
+
+static void finish_transaction(struct i2c_transaction *t,
+                               enum i2c_transaction_state state)
+{
+    t->state = state;
+    if (t->callback != NULL) {
+        t->callback(t->context, t);
+    }
+}
+
+int i2c_queue_submit(struct i2c_queue *inst, struct i2c_transaction *t)
+{
+    queue_lock(inst);
+    if ((t->state == I2C_TRANSACTION_QUEUED) ||
+            (t->state == I2C_TRANSACTION_IN_PROGRESS)) {
+        inst->stats.coalesced++;
+        queue_unlock(inst);
+        return 0;
+    }
+
+    t->next = NULL;
+    t->queue_time = queue_micros(inst);
+    t->queue = inst;
+    t->state = I2C_TRANSACTION_QUEUED;
+
+    if (inst->tail[t->priority] == NULL) {
+        inst->head[t->priority] = t;
+    } else {
+        inst->tail[t->priority]->next = t;
+    }
+    inst->tail[t->priority] = t;
+
+    service_locked(inst);
+    queue_unlock(inst);
+    return 0;
+}
+
+void i2c_queue_complete(struct i2c_queue *inst, int success)
+{
+    struct i2c_transaction *const t = inst->current;
+    if (t == NULL) {
+        return;
+    }
+
+    struct i2c_transaction *const chain = t->chain;
+    TRACE(TRACE_I2C_COMPLETE, t->address, success);
+
+    if (success) {
+        inst->stats.completed[t->priority]++;
+    } else {
+        inst->stats.failed++;
+    }
+
+    if (success && (chain != NULL)) {
+        // Keep the bus and start the chained transaction right away
+        inst->stats.chained++;
+        chain->queue_time = queue_micros(inst);
+        finish_transaction(t, I2C_TRANSACTION_DONE);
+        start_transaction(inst, chain);
+        return;
+    }
+
+    inst->current = NULL;
+    inst->stats.busy_time += queue_micros(inst) - inst->busy_start;
+
+    finish_transaction(t, success ? I2C_TRANSACTION_DONE :
+                                    I2C_TRANSACTION_FAILED);
+
+    // The rest of a chain is abandoned if any part of it fails
+    for (struct i2c_transaction *c = chain; c != NULL; c = c->chain) {
+        finish_transaction(c, I2C_TRANSACTION_FAILED);
+    }
+
+    service_locked(inst);
+}
+
+/**
+ *  Remove a queued transaction from its priority queue.
+ */
+static int unlink_transaction(struct i2c_queue *inst,
+                              struct i2c_transaction *t)
+{
+    struct i2c_transaction *prev = NULL;
+    struct i2c_transaction *c = inst->head[t->priority];
+    while ((c != NULL) && (c != t)) {
+        prev = c;
+        c = c->next;
+    }
+    if (c == NULL) {
+        return 0;
+    }
+
+    if (prev == NULL) {
+        inst->head[t->priority] = t->next;
+    } else {
+        prev->next = t->next;
+    }
+    if (inst->tail[t->priority] == t) {
+        inst->tail[t->priority] = prev;
+    }
+    t->next = NULL;
+    return 1;
+}
+
+int i2c_queue_abort(struct i2c_transaction *t)
+{
+    struct i2c_queue *const inst = t->queue;
+    if (inst == NULL) {
+        return 0;
+    }
+
+    queue_lock(inst);
+    int found = 0;
+    if (t->state == I2C_TRANSACTION_QUEUED) {
+        found = unlink_transaction(inst, t);
+    }
+
+    // Whichever part of the chain is on the bus gives it up
+    for (struct i2c_transaction *c = t; c != NULL; c = c->chain) {
+        if (inst->current != c) {
+            continue;
+        }
+        if (inst->ops->abort != NULL) {
+            inst->ops->abort(inst->bus);
+        }
+        TRACE(TRACE_I2C_COMPLETE, c->address, 0);
+        inst->current = NULL;
+        inst->stats.busy_time += queue_micros(inst) - inst->busy_start;
+        found = 1;
+        break;
+    }
+
+    for (struct i2c_transaction *c = t; c != NULL; c = c->chain) {
+        c->state = I2C_TRANSACTION_IDLE;
+    }
+    if (found) {
+        inst->stats.aborted++;
+        service_locked(inst);
+    }
+    queue_unlock(inst);
+    return found;
+}
+
+void i2c_queue_service(struct i2c_queue *inst)
+{
+    queue_lock(inst);
+    service_locked(inst);
+    queue_unlock(inst);
+}
+
+void i2c_queue_reset_stats(struct i2c_queue *inst)
+{
+    queue_lock(inst);
+    for (int i = 0; i < I2C_NUM_PRIORITIES; i++) {
+        inst->stats.completed[i] = 0;
+        inst->stats.max_wait[i] = 0;
+    }
+    inst->stats.failed = 0;
+    inst->stats.aborted = 0;
+    inst->stats.chained = 0;
+    inst->stats.coalesced = 0;
+    inst->stats.busy_time = 0;
+    inst->stats.start_time = queue_micros(inst);
+    inst->busy_start = inst->stats.start_time;
+    queue_unlock(inst);
+}
+
+uint16_t i2c_queue_occupancy(const struct i2c_queue *inst)
+{
+    queue_lock(inst);
+    const uint32_t now = queue_micros(inst);
+    uint32_t busy = inst->stats.busy_time;
+    if (inst->current != NULL) {
+        busy += now - inst->busy_start;
+    }
+    queue_unlock(inst);
+
+    const uint32_t elapsed = now - inst->stats.start_time;
+    if (elapsed == 0) {
+        return 0;
+    }
+    return (uint16_t)(((uint64_t)busy * 1000) / elapsed);
+}
@@ -0,0 +1,270 @@
+/**
+ * @file i2c-queue.h
+ * @desc Shared queue which arbitrates I2C transactions between drivers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef i2c_queue_h
+#define i2c_queue_h
+
+#include "test-global.h"
+#include <stddef.h>
+
+/** Transaction priority classes, lower values are started first */
+enum i2c_queue_priority {
+    /** Flight critical sample reads */
+    I2C_PRIORITY_SAMPLE,
+    /** Routine traffic (conversion commands, status polling) */
+    I2C_PRIORITY_NORMAL,
+    /** Configuration and calibration traffic */
+    I2C_PRIORITY_CONFIG,
+
+    I2C_NUM_PRIORITIES
+};
+
+enum i2c_transaction_type {
+    /** Write buffer to device */
+    I2C_TRANSACTION_WRITE,
+    /** Read into buffer from device */
+    I2C_TRANSACTION_READ,
+    /** Write buffer to device starting at register */
+    I2C_TRANSACTION_REG_WRITE,
+    /** Read into buffer from device starting at register */
+    I2C_TRANSACTION_REG_READ
+};
+
+enum i2c_transaction_state {
+    /** Transaction is not queued */
+    I2C_TRANSACTION_IDLE,
+    /** Transaction is waiting for the bus */
+    I2C_TRANSACTION_QUEUED,
+    /** Transaction is on the bus */
+    I2C_TRANSACTION_IN_PROGRESS,
+    /** Transaction completed successfully */
+    I2C_TRANSACTION_DONE,
+    /** Transaction failed (NACK, bus error or timeout) */
+    I2C_TRANSACTION_FAILED
+};
+
+struct i2c_transaction;
+struct i2c_queue;
+
+/**
+ *  Function called when a transaction completes. This is called from the
+ *  context in which the bus reports completion.
+ *
+ *  @param context The context pointer from the transaction
+ *  @param transaction The transaction which completed
+ */
+typedef void (*i2c_transaction_cb)(void *context,
+                                   struct i2c_transaction *transaction);
+
+struct i2c_transaction {
+    /** Next transaction in the same priority queue */
+    struct i2c_transaction *next;
+    /** Transaction to be started as soon as this one completes successfully,
+        without giving up the bus */
+    struct i2c_transaction *chain;
+    /** Function called when the transaction completes (may be NULL) */
+    i2c_transaction_cb callback;
+    /** Context for callback */
+    void *context;
+    /** Data to be written or buffer for data to be read */
+    uint8_t *buffer;
+    /** Number of bytes to be written or read */
+    uint16_t length;
+    /** Time at which the transaction was queued in microseconds */
+    uint32_t queue_time;
+    /** Queue to which the transaction was last submitted */
+    struct i2c_queue *queue;
+    /** Device address */
+    uint8_t address;
+    /** Register address for register transactions */
+    uint8_t reg;
+    /** Kind of transaction */
+    enum i2c_transaction_type type:2;
+    /** Priority class */
+    enum i2c_queue_priority priority:2;
+    /** Current state */
+    enum i2c_transaction_state state:3;
+};
+
+/** Interface to the underlying bus driver (real peripheral or host mock) */
+struct i2c_bus_ops {
+    /**
+     *  Start a transaction on the bus. The bus must call i2c_queue_complete()
+     *  when the transaction finishes.
+     *
+     *  @return 0 if the transaction was started
+     */
+    int (*start)(void *bus, const struct i2c_transaction *transaction);
+    /**
+     *  Abandon the transaction on the bus and return the bus to idle (may be
+     *  NULL). i2c_queue_complete() must not be called for the abandoned
+     *  transaction.
+     */
+    void (*abort)(void *bus);
+    /**
+     *  Mask the bus interrupt from which i2c_queue_complete() is called. May
+     *  be NULL only if the bus driver defers completion to the main loop.
+     */
+    void (*lock)(void *bus);
+    /**
+     *  Unmask the bus interrupt, a completion which arrived while it was
+     *  masked is then delivered. May be NULL only if lock is NULL.
+     */
+    void (*unlock)(void *bus);
+    /**
+     *  Get a free running timestamp in microseconds for wait and occupancy
+     *  statistics. A transaction takes a fraction of a millisecond, so millis
+     *  is much too coarse. May be NULL, in which case the time statistics
+     *  stay zero.
+     */
+    uint32_t (*micros)(void *bus);
+};
+
+struct i2c_queue_stats {
+    /** Number of transactions completed for each priority class */
+    uint32_t completed[I2C_NUM_PRIORITIES];
+    /** Number of transactions that failed */
+    uint32_t failed;
+    /** Number of transactions that were abandoned with i2c_queue_abort() */
+    uint32_t aborted;
+    /** Number of transactions that were started straight from a chain */
+    uint32_t chained;
+    /** Number of submissions of transactions that were already queued */
+    uint32_t coalesced;
+    /** Longest time a transaction waited for the bus in microseconds for each
+        priority class */
+    uint32_t max_wait[I2C_NUM_PRIORITIES];
+    /** Total time that the bus has been occupied in microseconds */
+    uint32_t busy_time;
+    /** Time at which statistics were last reset */
+    uint32_t start_time;
+};
+
+struct i2c_queue {
+    /** Head of queue for each priority class */
+    struct i2c_transaction *head[I2C_NUM_PRIORITIES];
+    /** Tail of queue for each priority class */
+    struct i2c_transaction *tail[I2C_NUM_PRIORITIES];
+    /** Transaction currently on the bus */
+    struct i2c_transaction *current;
+    /** Bus driver */
+    const struct i2c_bus_ops *ops;
+    /** Bus driver instance */
+    void *bus;
+    /** Time at which current transaction was started in microseconds */
+    uint32_t busy_start;
+
+    struct i2c_queue_stats stats;
+};
+
+/**
+ *  Initialize an I2C transaction queue.
+ *
+ *  @param inst The queue to be initialized
+ *  @param ops The bus driver interface
+ *  @param bus The bus driver instance passed to ops
+ */
+extern void init_i2c_queue(struct i2c_queue *inst,
+                           const struct i2c_bus_ops *ops, void *bus);
+
+/**
+ *  Initialize a transaction descriptor.
+ *
+ *  @param t The transaction descriptor
+ *  @param priority Priority class for the transaction
+ *  @param callback Function to be called on completion (may be NULL)
+ *  @param context Context for callback
+ */
+extern void init_i2c_transaction(struct i2c_transaction *t,
+                                 enum i2c_queue_priority priority,
+                                 i2c_transaction_cb callback, void *context);
+
+/**
+ *  Queue a transaction. The descriptor is owned by the queue until it
+ *  completes. Submitting a transaction which is already queued has no effect.
+ *  The highest priority queued transaction is started whenever the bus becomes
+ *  free, a transaction already on the bus is never interrupted.
+ *
+ *  @param inst The queue
+ *  @param t The transaction to be queued, address, register, buffer, length and
+ *           type must already be set
+ *
+ *  @return 0 if the transaction is queued or in progress
+ */
+extern int i2c_queue_submit(struct i2c_queue *inst, struct i2c_transaction *t);
+
+/**
+ *  Called by the bus driver when the transaction currently on the bus
+ *  finishes. Calls the transaction's callback and starts its chained
+ *  transaction if there is one, otherwise starts the next highest priority
+ *  transaction.
+ *
+ *  This may be called from the bus interrupt, all of the other queue functions
+ *  mask that interrupt with the lock hook while they change the queue. It must
+ *  not be called from any other interrupt.
+ *
+ *  @param inst The queue
+ *  @param success Non-zero if the transaction completed successfully
+ */
+extern void i2c_queue_complete(struct i2c_queue *inst, int success);
+
+/**
+ *  Take a transaction out of the queue it was submitted to without calling its
+ *  callback, for recovering from a transaction which never completes. If the
+ *  transaction, or a transaction chained to it, is on the bus it is abandoned
+ *  and the bus is given to the next queued transaction. The rest of the chain
+ *  is abandoned as well. All of the abandoned transactions are left idle so
+ *  that they can be submitted again.
+ *
+ *  @param t The transaction
+ *
+ *  @return Non-zero if the transaction was queued or on the bus
+ */
+extern int i2c_queue_abort(struct i2c_transaction *t);
+
+/**
+ *  Start the next transaction if the bus is idle. Only needs to be called if a
+ *  bus driver refused to start a transaction.
+ *
+ *  @param inst The queue
+ */
+extern void i2c_queue_service(struct i2c_queue *inst);
+
+/**
+ *  Reset bus occupancy statistics. The microsecond timestamps wrap after about
+ *  71 minutes, so statistics should be reset more often than that.
+ *
+ *  @param inst The queue
+ */
+extern void i2c_queue_reset_stats(struct i2c_queue *inst);
+
+/**
+ *  Get the fraction of time that the bus has been occupied since statistics
+ *  were last reset.
+ *
+ *  @param inst The queue
+ *
+ *  @return Bus occupancy in tenths of a percent
+ */
+extern uint16_t i2c_queue_occupancy(const struct i2c_queue *inst);
+
+/**
+ *  Get whether a transaction has finished.
+ *
+ *  @param t The transaction
+ *
+ *  @return Non-zero if the transaction is done or failed
+ */
+static inline int i2c_transaction_finished(const struct i2c_transaction *t)
+{
+    return (t->state == I2C_TRANSACTION_DONE) ||
+           (t->state == I2C_TRANSACTION_FAILED);
+}
+
+#endif /* i2c_queue_h */
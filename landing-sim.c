@@ -0,0 +1,158 @@
+/**
+ * @file landing-sim.c
+ * @desc Checks landing detection on simulated flights, with a working IMU and
+ *       with one which fails during the main descent
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef LANDING_SIM_MAIN
+
+#include "flight-sim.h"
+#include "host-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Sink context which fails the IMU once the main parachute is out */
+struct landing_sim_recorder {
+    struct flight_sim_board *board;
+    /** Fail the IMU on entering the main descent state */
+    uint8_t fail_imu;
+};
+
+/** Outcome of a batch of flights */
+struct landing_sim_result {
+    /** Flights on which the recovery state was never reached */
+    uint32_t missed;
+    /** Flights on which the recovery state was reached before touchdown */
+    uint32_t early;
+    /** Time from touchdown to the recovery state over the other flights */
+    uint64_t latency_sum;
+    uint32_t latency_max;
+};
+
+static void landing_sim_sink(void *context, const struct flight_sim *sim,
+                             int new_baro)
+{
+    struct landing_sim_recorder *const r = context;
+
+    flight_sim_replay_sink(&r->board->replay, sim, new_baro);
+
+    if (r->fail_imu && (r->board->deployment.state ==
+                        DEPLOYMENT_STATE_MAIN_DESCENT)) {
+        r->board->replay.imu_failed = 1;
+    }
+}
+
+static int landing_sim_run(struct flight_sim_config *config, uint8_t fail_imu,
+                           uint32_t flights, uint32_t seed,
+                           struct landing_sim_result *result)
+{
+    static struct flight_sim_board board;
+    struct landing_sim_recorder recorder = { .board = &board,
+                                             .fail_imu = fail_imu };
+
+    *result = (struct landing_sim_result){ 0 };
+    for (uint32_t f = 0; f < flights; f++) {
+        struct flight_sim sim;
+        config->pad_time = 10.0f + (0.0137f * (float)f);
+        millis = 0;
+        if (init_flight_sim(&sim, config, 1, seed + f) != 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        init_flight_sim_board(&board, config);
+
+        flight_sim_run(&sim, (uint32_t)((config->pad_time + 400.0f) * 1000),
+                       landing_sim_sink, &recorder);
+        flight_sim_free(&sim);
+
+        const struct flight_sim_replay *const r = &board.replay;
+        if (!r->recovered) {
+            result->missed++;
+        } else if ((r->touchdown_time == 0) ||
+                        (r->recovery_time < r->touchdown_time)) {
+            result->early++;
+        } else {
+            const uint32_t latency = r->recovery_time - r->touchdown_time;
+            result->latency_sum += latency;
+            result->latency_max = ((latency > result->latency_max) ?
+                                   latency : result->latency_max);
+        }
+    }
+    return 0;
+}
+
+static void landing_sim_print(const char *name, uint32_t flights,
+                              const struct landing_sim_result *r)
+{
+    const uint32_t landed = flights - r->missed - r->early;
+    printf("  %8s %6u %6u %12.1f %12.1f\n", name, (unsigned)r->early,
+           (unsigned)r->missed,
+           (landed == 0) ? 0.0 : ((double)r->latency_sum / landed / 1000.0),
+           (double)r->latency_max / 1000.0);
+}
+
+int main(int argc, char **argv)
+{
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .transonic_spike = 2000.0f,
+        .baro_glitch_rate = 0.001f, .baro_glitch = 5000.0f,
+        .accel_noise = 0.05f, .accel_bias = 0.05f, .gyro_noise = 0.1f,
+        .gyro_bias = 1.0f, .roll_rate = 60.0f, .temperature = 25.0f,
+        .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+        .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = ALTIMETER_PERIOD,
+        .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 20;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                flights = (flights == 0) ? 1 : flights;
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    printf("%u flights, %u ms landing windows, IMU stalled after %u ms\n",
+           (unsigned)flights, (unsigned)DEPLOYMENT_LANDED_WINDOW,
+           (unsigned)DEPLOYMENT_IMU_MAX_AGE);
+    printf("  %8s %6s %6s %12s %12s\n", "IMU", "early", "missed",
+           "latency (s)", "max (s)");
+
+    struct landing_sim_result working, failed;
+    if ((landing_sim_run(&config, 0, flights, seed, &working) != 0) ||
+            (landing_sim_run(&config, 1, flights, seed, &failed) != 0)) {
+        return 1;
+    }
+    landing_sim_print("working", flights, &working);
+    landing_sim_print("failed", flights, &failed);
+
+    if ((working.early + working.missed + failed.early + failed.missed) !=
+            0) {
+        fprintf(stderr, "landing was not detected after touchdown on every "
+                "flight\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,556 @@
+/**
+ * @file lockstep-sim.c
+ * @desc Lockstep simulation of redundant flight computers in separate processes
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "lockstep-sim.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "host-sim.h"
+
+#ifdef LOCKSTEP_SIM_MAIN
+#include <stdio.h>
+#include <stdlib.h>
+#endif
+
+/** Message sent by each board to each of the others at the end of every
+    step */
+struct lockstep_sim_msg {
+    /** Time of the step which the sender has finished */
+    uint32_t time;
+    /** Time at which the heartbeat reaches the receiver */
+    uint32_t deliver_time;
+    /** Set if the message carries a heartbeat */
+    uint8_t has_heartbeat;
+    struct peer_heartbeat heartbeat;
+};
+
+/** A heartbeat on its way to a board */
+struct lockstep_sim_pending {
+    uint32_t deliver_time;
+    struct peer_heartbeat heartbeat;
+};
+
+/** Everything simulated by one board's process */
+struct lockstep_sim_state {
+    struct flight_sim sim;
+    struct flight_sim_board board;
+    struct peer_link link;
+
+    struct lockstep_sim_pending pending[LOCKSTEP_SIM_MAX_PENDING];
+    uint16_t num_pending;
+    /** State of the generator for heartbeat loss and jitter */
+    uint32_t rng;
+};
+
+static inline uint32_t lockstep_sim_random(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+/**
+ *  Set up a board and its peer link.
+ */
+static int lockstep_sim_board_init(struct lockstep_sim_state *s,
+                                   const struct lockstep_sim_config *config,
+                                   uint8_t board)
+{
+    memset(s, 0, sizeof(*s));
+    millis = 0;
+
+    const uint32_t board_seed = config->seed ^ (0x9E3779B9UL * (board + 1U));
+    if (init_flight_sim(&s->sim, &config->flight, 1, board_seed) != 0) {
+        return -1;
+    }
+    s->rng = (board_seed == 0) ? 1 : board_seed;
+
+    init_flight_sim_board(&s->board, &config->flight);
+    init_peer_link(&s->link, board, config->heartbeat_period,
+                   config->heartbeat_timeout);
+    deployment_set_peer(&s->board.deployment, &s->link);
+    return 0;
+}
+
+/**
+ *  Pass the heartbeats which have arrived by now to the peer link.
+ */
+static void lockstep_sim_deliver(struct lockstep_sim_state *s,
+                                 struct lockstep_sim_board *result)
+{
+    uint16_t kept = 0;
+    for (uint16_t i = 0; i < s->num_pending; i++) {
+        const struct lockstep_sim_pending *const p = &s->pending[i];
+        if ((int32_t)((uint32_t)millis - p->deliver_time) < 0) {
+            s->pending[kept++] = *p;
+            continue;
+        }
+        const uint32_t latency = (uint32_t)millis - p->heartbeat.time;
+        result->latency_sum += latency;
+        result->latency_max = (latency > result->latency_max) ?
+                                                latency : result->latency_max;
+        peer_link_receive(&s->link, &p->heartbeat);
+    }
+    s->num_pending = kept;
+}
+
+static void lockstep_sim_board_finish(const struct lockstep_sim_state *s,
+                                      struct lockstep_sim_board *result)
+{
+    const struct deployment_service_desc_t *const dep = &s->board.deployment;
+    result->pyro_fired = dep->pyro_fired;
+    for (uint8_t i = 0; i < DEPLOYMENT_MAX_PYRO_EVENTS; i++) {
+        result->pyro_fire_time[i] = (dep->pyro_fired & (1 << i)) ?
+                                    dep->pyro_fire_time[i] : LOCKSTEP_SIM_NEVER;
+    }
+    for (uint8_t i = 0; i < PEER_LINK_MAX_BOARDS; i++) {
+        const struct peer_link_peer *const peer = &s->link.peers[i];
+        result->received += peer->received;
+        result->missed += peer->missed;
+        result->timeouts += peer->timeouts;
+        result->gap_max = (peer->gap_max > result->gap_max) ?
+                                            peer->gap_max : result->gap_max;
+    }
+}
+
+/**
+ *  Run one board, talking to board j through fds[j].
+ */
+static void lockstep_sim_board_run(const struct lockstep_sim_config *config,
+                                   uint8_t board, const int *fds,
+                                   struct lockstep_sim_board *result)
+{
+    static struct lockstep_sim_state s;
+
+    memset(result, 0, sizeof(*result));
+    for (uint8_t i = 0; i < DEPLOYMENT_NUM_STATES; i++) {
+        result->state_time[i] = LOCKSTEP_SIM_NEVER;
+    }
+    if (lockstep_sim_board_init(&s, config, board) != 0) {
+        return;
+    }
+    const struct deployment_service_desc_t *const dep = &s.board.deployment;
+    result->state_time[dep->state] = 0;
+
+    // Boards which are still running
+    uint32_t live = ((1UL << config->num_boards) - 1) & ~(1UL << board);
+
+    while (s.sim.time < config->duration) {
+        if ((board == config->failed_board) &&
+                (s.sim.time >= config->fail_time)) {
+            break;
+        }
+
+        const int new_baro = flight_sim_step(&s.sim);
+        millis = s.sim.time;
+        lockstep_sim_deliver(&s, result);
+        peer_link_service(&s.link);
+        flight_sim_replay_sink(&s.board.replay, &s.sim, new_baro);
+
+        if (result->state_time[dep->state] == LOCKSTEP_SIM_NEVER) {
+            result->state_time[dep->state] = s.sim.time;
+        }
+
+        struct peer_heartbeat heartbeat;
+        const int beat = peer_link_heartbeat(&s.link, dep, &heartbeat);
+
+        for (uint8_t j = 0; j < config->num_boards; j++) {
+            if (!(live & (1UL << j))) {
+                continue;
+            }
+            struct lockstep_sim_msg msg = {
+                .time = s.sim.time,
+                .deliver_time = s.sim.time + config->latency,
+                .has_heartbeat = 0
+            };
+            if (beat) {
+                result->sent++;
+                const uint32_t r = lockstep_sim_random(&s.rng);
+                if (((float)r / 4294967296.0f) < config->loss) {
+                    result->lost++;
+                } else {
+                    msg.has_heartbeat = 1;
+                    msg.heartbeat = heartbeat;
+                    if (config->jitter != 0) {
+                        msg.deliver_time += (lockstep_sim_random(&s.rng) %
+                                             (config->jitter + 1));
+                    }
+                }
+            }
+            if (send(fds[j], &msg, sizeof(msg), MSG_NOSIGNAL) !=
+                    (ssize_t)sizeof(msg)) {
+                live &= ~(1UL << j);
+            }
+        }
+
+        // Wait for every other board to finish this step
+        for (uint8_t j = 0; j < config->num_boards; j++) {
+            if (!(live & (1UL << j))) {
+                continue;
+            }
+            struct lockstep_sim_msg msg;
+            if (recv(fds[j], &msg, sizeof(msg), 0) != (ssize_t)sizeof(msg)) {
+                // The board has stopped
+                live &= ~(1UL << j);
+                continue;
+            }
+            if (msg.has_heartbeat &&
+                    (s.num_pending < LOCKSTEP_SIM_MAX_PENDING)) {
+                s.pending[s.num_pending].deliver_time = msg.deliver_time;
+                s.pending[s.num_pending].heartbeat = msg.heartbeat;
+                s.num_pending++;
+            }
+        }
+    }
+
+    result->finished = (s.sim.time >= config->duration);
+    lockstep_sim_board_finish(&s, result);
+    flight_sim_free(&s.sim);
+}
+
+int lockstep_sim_run(const struct lockstep_sim_config *config,
+                     struct lockstep_sim_board *results)
+{
+    const uint8_t n = config->num_boards;
+    if ((n == 0) || (n > LOCKSTEP_SIM_MAX_BOARDS)) {
+        errno = EINVAL;
+        return -1;
+    }
+
+    // fds[i][j] is board i's end of the socket to board j
+    int fds[LOCKSTEP_SIM_MAX_BOARDS][LOCKSTEP_SIM_MAX_BOARDS];
+    int result_fds[LOCKSTEP_SIM_MAX_BOARDS][2];
+    pid_t pids[LOCKSTEP_SIM_MAX_BOARDS];
+    int ret = 0;
+
+    for (uint8_t i = 0; i < n; i++) {
+        fds[i][i] = -1;
+        result_fds[i][0] = -1;
+        result_fds[i][1] = -1;
+        pids[i] = -1;
+    }
+    for (uint8_t i = 0; (ret == 0) && (i < n); i++) {
+        for (uint8_t j = i + 1; (ret == 0) && (j < n); j++) {
+            int pair[2];
+            ret = socketpair(AF_UNIX, SOCK_SEQPACKET, 0, pair);
+            fds[i][j] = (ret == 0) ? pair[0] : -1;
+            fds[j][i] = (ret == 0) ? pair[1] : -1;
+        }
+        if (ret == 0) {
+            ret = pipe(result_fds[i]);
+        }
+    }
+
+    for (uint8_t i = 0; (ret == 0) && (i < n); i++) {
+        pids[i] = fork();
+        if (pids[i] < 0) {
+            ret = -1;
+        } else if (pids[i] == 0) {
+            // Only keep this board's ends of the sockets
+            for (uint8_t j = 0; j < n; j++) {
+                for (uint8_t k = 0; k < n; k++) {
+                    if ((j != i) && (fds[j][k] >= 0)) {
+                        close(fds[j][k]);
+                    }
+                }
+                close(result_fds[j][0]);
+                if (j != i) {
+                    close(result_fds[j][1]);
+                }
+            }
+
+            struct lockstep_sim_board result;
+            lockstep_sim_board_run(config, i, fds[i], &result);
+            // Closing the sockets on exit lets the other boards go on alone
+            const ssize_t w = write(result_fds[i][1], &result,
+                                    sizeof(result));
+            _exit((w == (ssize_t)sizeof(result)) ? 0 : 1);
+        }
+    }
+    const int saved_errno = errno;
+
+    for (uint8_t i = 0; i < n; i++) {
+        for (uint8_t j = 0; j < n; j++) {
+            if ((i != j) && (fds[i][j] >= 0)) {
+                close(fds[i][j]);
+            }
+        }
+        if (result_fds[i][1] >= 0) {
+            close(result_fds[i][1]);
+        }
+    }
+
+    for (uint8_t i = 0; i < n; i++) {
+        if ((pids[i] > 0) && (ret == 0)) {
+            if (read(result_fds[i][0], &results[i], sizeof(results[i])) !=
+                    (ssize_t)sizeof(results[i])) {
+                ret = -1;
+            }
+        }
+        if (result_fds[i][0] >= 0) {
+            close(result_fds[i][0]);
+        }
+        if (pids[i] > 0) {
+            waitpid(pids[i], NULL, 0);
+        }
+    }
+
+    if (ret != 0) {
+        errno = (saved_errno != 0) ? saved_errno : ECHILD;
+    }
+    return ret;
+}
+
+#ifdef LOCKSTEP_SIM_MAIN
+/** Delay after a board's own primary event before it fires the backup for
+    that event, unless another board has reported firing it, in
+    milliseconds */
+#define LOCKSTEP_SIM_BACKUP_DELAY   2000
+
+/* The variant is not linked into the simulation, it has its own pyro event
+   table with backup charges on each board which only fire if no other board
+   has reported firing the primary. Host builds have no pyro channels, so the
+   backups share the primary pins. */
+const struct deployment_pyro_event deployment_pyro_events_g[] = {
+    {
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_COASTING_ASCENT),
+        .conditions = (DEPLOYMENT_PYRO_BELOW_ALT | DEPLOYMENT_PYRO_DESCENDING),
+        .altitude = DEPLOYMENT_MM(DROGUE_DEPLOY_ALTITUDE),
+        .pin = DROGUE_EMATCH_PIN,
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION,
+        .fire_state = DEPLOYMENT_STATE_DROGUE_DEPLOY,
+        .done_state = DEPLOYMENT_STATE_DROGUE_DESCENT
+    },
+    {
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_DROGUE_DESCENT),
+        .conditions = (DEPLOYMENT_PYRO_AFTER_EVENT |
+                       DEPLOYMENT_PYRO_PEER_NOT_FIRED),
+        .ref_event = 0,
+        .delay = LOCKSTEP_SIM_BACKUP_DELAY,
+        .pin = DROGUE_EMATCH_PIN,
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION
+    },
+    {
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_DROGUE_DESCENT),
+        .conditions = (DEPLOYMENT_PYRO_BELOW_ALT | DEPLOYMENT_PYRO_DESCENDING),
+        .altitude = DEPLOYMENT_MM(MAIN_DEPLOY_ALTITUDE),
+        .pin = MAIN_EMATCH_PIN,
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION,
+        .fire_state = DEPLOYMENT_STATE_MAIN_DEPLOY,
+        .done_state = DEPLOYMENT_STATE_MAIN_DESCENT
+    },
+    {
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_MAIN_DESCENT),
+        .conditions = (DEPLOYMENT_PYRO_AFTER_EVENT |
+                       DEPLOYMENT_PYRO_PEER_NOT_FIRED),
+        .ref_event = 2,
+        .delay = LOCKSTEP_SIM_BACKUP_DELAY,
+        .pin = MAIN_EMATCH_PIN,
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION
+    }
+};
+const uint8_t deployment_num_pyro_events_g =
+        (uint8_t)(sizeof(deployment_pyro_events_g) /
+                  sizeof(deployment_pyro_events_g[0]));
+
+/** Names of the events in deployment_pyro_events_g */
+static const char *const lockstep_sim_event_names[] = {
+    "drogue", "backup drogue", "main", "backup main"
+};
+
+/**
+ *  Spread between the earliest and latest of the boards which got there.
+ */
+static uint32_t lockstep_sim_skew(const uint32_t *times, uint8_t n,
+                                  uint8_t *count)
+{
+    uint32_t first = LOCKSTEP_SIM_NEVER;
+    uint32_t last = 0;
+    *count = 0;
+    for (uint8_t i = 0; i < n; i++) {
+        if (times[i] == LOCKSTEP_SIM_NEVER) {
+            continue;
+        }
+        first = (times[i] < first) ? times[i] : first;
+        last = (times[i] > last) ? times[i] : last;
+        (*count)++;
+    }
+    return (*count != 0) ? (last - first) : 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct lockstep_sim_config config = {
+        .flight = {
+            .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+            .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+            .main_rate = 6.0f, .main_altitude = 450.0f,
+            .ground_pressure = 101325.0f, .pad_time = 10.0f,
+            .baro_noise = 3.0f, .baro_bias = 50.0f,
+            .transonic_spike = 2000.0f, .accel_noise = 0.05f,
+            .accel_bias = 0.05f, .gyro_noise = 0.1f, .gyro_bias = 1.0f,
+            .roll_rate = 60.0f, .temperature = 25.0f,
+            .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+            .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = 100,
+            .num_baro = ALTIMETER_COUNT
+        },
+        .duration = 400000,
+        .seed = 1,
+        .num_boards = 2,
+        .heartbeat_period = 100,
+        .heartbeat_timeout = 500,
+        .latency = 20,
+        .jitter = 0,
+        .loss = 0.0f,
+        .failed_board = -1,
+        .fail_time = 0
+    };
+    uint32_t flights = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:f:l:j:p:k:t:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                config.num_boards = (uint8_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'l':
+                config.latency = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'j':
+                config.jitter = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                config.loss = strtof(optarg, NULL);
+                break;
+            case 'k':
+                config.failed_board = (int8_t)strtol(optarg, NULL, 10);
+                break;
+            case 't':
+                config.fail_time = (uint32_t)(strtof(optarg, NULL) * 1000);
+                break;
+            case 's':
+                config.seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n boards] [-f flights] "
+                        "[-l latency ms] [-j jitter ms] [-p loss] "
+                        "[-k failed board] [-t fail time s] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    const uint8_t n = config.num_boards;
+    uint32_t state_skew_max[DEPLOYMENT_NUM_STATES] = { 0 };
+    uint64_t state_skew_sum[DEPLOYMENT_NUM_STATES] = { 0 };
+    uint32_t state_count[DEPLOYMENT_NUM_STATES] = { 0 };
+    uint32_t fire_skew_max[DEPLOYMENT_MAX_PYRO_EVENTS] = { 0 };
+    uint64_t fire_skew_sum[DEPLOYMENT_MAX_PYRO_EVENTS] = { 0 };
+    uint32_t fire_flights[DEPLOYMENT_MAX_PYRO_EVENTS] = { 0 };
+    uint32_t fire_boards[DEPLOYMENT_MAX_PYRO_EVENTS] = { 0 };
+    uint64_t sent = 0, lost = 0, received = 0, missed = 0, timeouts = 0;
+    uint64_t latency_sum = 0;
+    uint32_t latency_max = 0, gap_max = 0;
+
+    for (uint32_t f = 0; f < flights; f++) {
+        struct lockstep_sim_board results[LOCKSTEP_SIM_MAX_BOARDS];
+        config.seed += 1;
+        config.flight.pad_time = 10.0f + (0.0137f * (float)f);
+        if (lockstep_sim_run(&config, results) != 0) {
+            perror("lockstep_sim_run");
+            return 1;
+        }
+
+        for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+            uint32_t times[LOCKSTEP_SIM_MAX_BOARDS];
+            for (uint8_t i = 0; i < n; i++) {
+                times[i] = results[i].state_time[s];
+            }
+            uint8_t count;
+            const uint32_t skew = lockstep_sim_skew(times, n, &count);
+            if (count > 1) {
+                state_count[s]++;
+                state_skew_sum[s] += skew;
+                state_skew_max[s] = (skew > state_skew_max[s]) ?
+                                                    skew : state_skew_max[s];
+            }
+        }
+        for (uint8_t e = 0; e < deployment_num_pyro_events_g; e++) {
+            uint32_t times[LOCKSTEP_SIM_MAX_BOARDS];
+            for (uint8_t i = 0; i < n; i++) {
+                times[i] = results[i].pyro_fire_time[e];
+            }
+            uint8_t count;
+            const uint32_t skew = lockstep_sim_skew(times, n, &count);
+            fire_boards[e] += count;
+            fire_flights[e] += (count != 0);
+            fire_skew_sum[e] += skew;
+            fire_skew_max[e] = (skew > fire_skew_max[e]) ?
+                                                    skew : fire_skew_max[e];
+        }
+        for (uint8_t i = 0; i < n; i++) {
+            sent += results[i].sent;
+            lost += results[i].lost;
+            received += results[i].received;
+            missed += results[i].missed;
+            timeouts += results[i].timeouts;
+            latency_sum += results[i].latency_sum;
+            latency_max = (results[i].latency_max > latency_max) ?
+                                        results[i].latency_max : latency_max;
+            gap_max = (results[i].gap_max > gap_max) ?
+                                        results[i].gap_max : gap_max;
+        }
+    }
+
+    printf("%u flights, %u boards, latency %u ms, jitter %u ms, loss %.3f\n",
+           (unsigned)flights, (unsigned)n, (unsigned)config.latency,
+           (unsigned)config.jitter, (double)config.loss);
+    if (config.failed_board >= 0) {
+        printf("board %d stops at %.1f s\n", (int)config.failed_board,
+               (double)config.fail_time / 1000.0);
+    }
+    printf("state entry skew between boards (ms):\n");
+    for (uint8_t s = 1; s < DEPLOYMENT_NUM_STATES; s++) {
+        if (state_count[s] == 0) {
+            continue;
+        }
+        printf("  state %u: mean %.1f max %u\n", (unsigned)s,
+               (double)state_skew_sum[s] / state_count[s],
+               (unsigned)state_skew_max[s]);
+    }
+    printf("ematch fires:\n");
+    for (uint8_t e = 0; e < deployment_num_pyro_events_g; e++) {
+        printf("  %-13s fired on %u boards in %u/%u flights, skew mean "
+               "%.1f max %u ms\n", lockstep_sim_event_names[e],
+               (unsigned)fire_boards[e], (unsigned)fire_flights[e],
+               (unsigned)flights,
+               fire_flights[e] ? (double)fire_skew_sum[e] / fire_flights[e] :
+                                 0.0,
+               (unsigned)fire_skew_max[e]);
+    }
+    printf("heartbeats: %llu sent, %llu lost, %llu received, %llu missed, "
+           "%llu timeouts, latency mean %.1f max %u ms, longest gap %u ms\n",
+           (unsigned long long)sent, (unsigned long long)lost,
+           (unsigned long long)received, (unsigned long long)missed,
+           (unsigned long long)timeouts,
+           received ? (double)latency_sum / received : 0.0,
+           (unsigned)latency_max, (unsigned)gap_max);
+    return 0;
+}
+#endif
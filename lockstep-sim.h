@@ -0,0 +1,100 @@
+/**
+ * @file lockstep-sim.h
+ * @desc Lockstep simulation of redundant flight computers in separate processes
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef lockstep_sim_h
+#define lockstep_sim_h
+
+#include "test-global.h"
+#include "flight-sim.h"
+#include "peer-link.h"
+
+/** Largest number of boards simulated at once */
+#define LOCKSTEP_SIM_MAX_BOARDS     PEER_LINK_MAX_BOARDS
+/** Largest number of heartbeats in flight to one board at once */
+#define LOCKSTEP_SIM_MAX_PENDING    256
+/** Time for states which were never entered and events which never fired */
+#define LOCKSTEP_SIM_NEVER          UINT32_MAX
+
+/** Parameters for a simulation of one flight */
+struct lockstep_sim_config {
+    /** The flight, every board sees the same flight */
+    struct flight_sim_config flight;
+    /** Length of time to simulate in milliseconds */
+    uint32_t duration;
+    /** Seed for the flight, each board's sensor noise and biases are seeded
+        from this and its board number */
+    uint32_t seed;
+    /** Number of boards */
+    uint8_t num_boards;
+
+    /** Time between heartbeats in milliseconds */
+    uint32_t heartbeat_period;
+    /** Time after which a silent board is counted as lost in milliseconds */
+    uint32_t heartbeat_timeout;
+    /** Time taken for a heartbeat to reach another board in milliseconds,
+        heartbeats arrive at the next step at the earliest */
+    uint32_t latency;
+    /** Largest random delay added to latency in milliseconds */
+    uint32_t jitter;
+    /** Probability that a heartbeat to any one board is lost */
+    float loss;
+
+    /** Board which stops running at fail_time, as though it lost power, or -1
+        for none */
+    int8_t failed_board;
+    /** Time at which failed_board stops in milliseconds */
+    uint32_t fail_time;
+};
+
+/** Outcome of a simulated flight for one board */
+struct lockstep_sim_board {
+    /** Time at which each deployment state was first entered */
+    uint32_t state_time[DEPLOYMENT_NUM_STATES];
+    /** Pyro events which fired and the times at which they fired */
+    uint16_t pyro_fired;
+    uint32_t pyro_fire_time[DEPLOYMENT_MAX_PYRO_EVENTS];
+
+    /** Heartbeats sent, counted once for each board they are sent to */
+    uint32_t sent;
+    /** Heartbeats lost in transit */
+    uint32_t lost;
+    /** Totals from the peer link over all of the other boards */
+    uint32_t received;
+    uint32_t missed;
+    uint32_t timeouts;
+    uint32_t gap_max;
+    /** Time from heartbeats being sent to them being received in
+        milliseconds */
+    uint32_t latency_max;
+    uint64_t latency_sum;
+
+    /** Set if the board ran to the end of the simulation */
+    uint8_t finished;
+};
+
+/**
+ *  Simulate one flight with each board in its own process. Each process runs
+ *  a flight_sim_replay of the same flight with its own sensor noise, so it has
+ *  its own drivers, vote and deployment service. The processes exchange
+ *  heartbeats over Unix domain sockets and are kept in lockstep, no board
+ *  starts a step until every running board has finished the one before, so
+ *  results are repeatable regardless of how the processes are scheduled.
+ *  Heartbeats are passed to the other boards through their peer links after
+ *  the given latency unless they are lost.
+ *
+ *  @param config Simulation parameters
+ *  @param results Outcome for each board (config->num_boards entries)
+ *
+ *  @return 0 if successful, -1 with errno set if the processes could not be
+ *          started
+ */
+extern int lockstep_sim_run(const struct lockstep_sim_config *config,
+                            struct lockstep_sim_board *results);
+
+#endif /* lockstep_sim_h */
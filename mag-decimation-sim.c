@@ -0,0 +1,173 @@
+/**
+ * @file mag-decimation-sim.c
+ * @desc Host mock of MPU9250 FIFO reads measuring the bus traffic saved by
+ *       magnetometer decimation
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef MAG_DECIMATION_SIM_MAIN
+
+#include "mpu9250-test.h"
+#include "host-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/** Traffic and magnetometer data seen by the mock driver */
+struct mag_decimation_sim_result {
+    /** Bytes moved over the bus, including read overhead */
+    uint32_t bytes;
+    /** Magnetometer samples taken by the AK8963 */
+    uint32_t mag_produced;
+    /** Magnetometer samples which reached the driver */
+    uint32_t mag_fresh;
+    /** Magnetometer data read which the driver had already seen */
+    uint32_t mag_stale;
+};
+
+/**
+ *  Run the mock for a number of seconds. The AK8963 takes a sample every
+ *  magnetometer period. The I2C master copies the latest one into
+ *  EXT_SENS_DATA on each accel/gyro sample, or every I2C_MST_DLY + 1 samples
+ *  with decimation. Without decimation every FIFO record carries a copy of
+ *  EXT_SENS_DATA, with decimation the driver reads EXT_SENS_DATA each time the
+ *  I2C master refreshes it. The FIFO is read with a count read and a burst
+ *  read once a burst worth of records is waiting.
+ */
+static void mag_decimation_sim_run(const struct mpu9250_desc_t *imu,
+                                   uint32_t seconds,
+                                   struct mag_decimation_sim_result *result)
+{
+    const uint32_t ag_period = 1000u / mpu9250_get_ag_odr(imu);
+    const uint32_t mag_period = 1000u / mpu9250_get_mag_odr(imu);
+    const uint32_t slave_every =
+                imu->mag_decimate ? ((uint32_t)mpu9250_get_mag_delay(imu) + 1) :
+                                    1;
+    const uint8_t per_burst = mpu9250_fifo_samples_per_burst(imu);
+    const uint8_t size = mpu9250_fifo_sample_size(imu);
+
+    // Magnetometer samples are numbered from 1 so that 0 means none yet
+    uint32_t mag_sample = 0, ext_sens = 0, seen = 0;
+    uint32_t next_mag = 0;
+    uint32_t fifo[MPU9250_BUFFER_LENGTH];
+    uint8_t fifo_count = 0;
+
+    *result = (struct mag_decimation_sim_result){ 0 };
+    const uint32_t duration = seconds * 1000u;
+    for (uint32_t n = 0; (n * ag_period) < duration; n++) {
+        const uint32_t t = n * ag_period;
+        while (next_mag <= t) {
+            mag_sample++;
+            result->mag_produced++;
+            next_mag += mag_period;
+        }
+        const int refreshed = ((n % slave_every) == 0);
+        if (refreshed) {
+            ext_sens = mag_sample;
+        }
+
+        fifo[fifo_count++] = imu->mag_decimate ? 0 : ext_sens;
+        if (fifo_count == per_burst) {
+            result->bytes += 2 + MPU9250_I2C_READ_OVERHEAD;
+            result->bytes += (per_burst * size) + MPU9250_I2C_READ_OVERHEAD;
+            for (uint8_t i = 0; !imu->mag_decimate && (i < per_burst); i++) {
+                if (fifo[i] != seen) {
+                    seen = fifo[i];
+                    result->mag_fresh++;
+                } else {
+                    result->mag_stale++;
+                }
+            }
+            fifo_count = 0;
+        }
+
+        if (imu->mag_decimate && refreshed) {
+            result->bytes += (MPU9250_FIFO_MAG_SAMPLE_SIZE +
+                              MPU9250_I2C_READ_OVERHEAD);
+            if (ext_sens != seen) {
+                seen = ext_sens;
+                result->mag_fresh++;
+            } else {
+                result->mag_stale++;
+            }
+        }
+    }
+}
+
+static void mag_decimation_sim_print(const struct mpu9250_desc_t *imu,
+                                     uint32_t seconds,
+                                     const struct mag_decimation_sim_result *r)
+{
+    printf("  %4u Hz %8s %6u %10u %10u %8.1f %8.1f %8.1f\n",
+           (unsigned)mpu9250_get_mag_odr(imu), imu->mag_decimate ? "yes" : "no",
+           (unsigned)mpu9250_fifo_samples_per_burst(imu),
+           (unsigned)(r->bytes / seconds),
+           (unsigned)mpu9250_fifo_bus_bytes_per_second(imu),
+           (double)r->mag_produced / seconds, (double)r->mag_fresh / seconds,
+           (double)r->mag_stale / seconds);
+}
+
+int main (int argc, char **argv)
+{
+    static struct mpu9250_desc_t imu;
+    uint32_t seconds = 60;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:")) != -1) {
+        switch (opt) {
+            case 's':
+                seconds = (uint32_t)strtoul(optarg, NULL, 10);
+                seconds = (seconds == 0) ? 1 : seconds;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s seconds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    imu.odr = (uint8_t)((1000 / IMU_AG_SAMPLE_RATE) - 1);
+    printf("accel/gyro at %u Hz, %u s\n", (unsigned)mpu9250_get_ag_odr(&imu),
+           (unsigned)seconds);
+    printf("  %7s %8s %6s %10s %10s %8s %8s %8s\n", "mag", "decimate",
+           "burst", "bytes/s", "estimate", "mag/s", "fresh/s", "stale/s");
+
+    struct mag_decimation_sim_result r;
+    static const enum ak8963_odr odrs[] = {AK8963_ODR_100HZ, AK8963_ODR_8HZ};
+    for (uint8_t i = 0; i < (sizeof(odrs) / sizeof(odrs[0])); i++) {
+        for (uint8_t decimate = 0; decimate <= 1; decimate++) {
+            imu.mag_odr = odrs[i];
+            imu.mag_decimate = decimate;
+            mag_decimation_sim_run(&imu, seconds, &r);
+            mag_decimation_sim_print(&imu, seconds, &r);
+        }
+    }
+
+    // The shipped configuration, decimation is only kept if it saves traffic
+    imu.mag_odr = IMU_MAG_SAMPLE_RATE;
+    imu.mag_decimate = 0;
+    struct mag_decimation_sim_result every_record;
+    mag_decimation_sim_run(&imu, seconds, &every_record);
+#ifdef IMU_MAG_DECIMATE
+    mpu9250_set_mag_decimation(&imu, 1);
+#endif
+    mag_decimation_sim_run(&imu, seconds, &r);
+    printf("shipped:\n");
+    mag_decimation_sim_print(&imu, seconds, &r);
+
+    if (r.bytes > every_record.bytes) {
+        fprintf(stderr, "shipped configuration moves more bytes than "
+                "magnetometer data in every record\n");
+        return 1;
+    }
+    if (r.mag_fresh < every_record.mag_fresh) {
+        fprintf(stderr, "shipped configuration loses magnetometer samples\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -1 +1,106 @@
+/**
+ * @file mpu9250.c
+ * @desc Driver for MPU9250 IMU
+ * @author Samuel Dewan
+ * @date 2021-09-29
+ * Last Author:
+ * Last Edited On:
+ */
+
 #include "mpu9250-test.h"
+
+void mpu9250_start_wait(struct mpu9250_desc_t *inst, uint32_t duration)
+{
+    timer_wheel_schedule(inst->wheel, &inst->wait_timer,
+                         (uint32_t)millis + duration);
+}
+
+int mpu9250_check_mode_switch(struct mpu9250_desc_t *inst)
+{
+    if (inst->async_i2c_in_progress || inst->i2c_in_progress) {
+        return 0;
+    }
+
+    if (inst->low_power_requested != inst->low_power) {
+        inst->state = MPU9250_LP_MAG_POWER;
+        inst->next_state = MPU9250_LP_SET_ODR;
+        inst->low_power = inst->low_power_requested;
+        return 1;
+    }
+
+    if (inst->fifo_requested == inst->use_fifo) {
+        return 0;
+    }
+
+    if (inst->fifo_requested) {
+        inst->state = MPU9250_SWITCH_DISABLE_INT;
+        inst->next_state = MPU9250_AG_CONFIG_FIFO;
+    } else {
+        inst->state = MPU9250_SWITCH_STOP_FIFO;
+        inst->next_state = MPU9250_FIFO_READ_COUNT;
+    }
+    inst->use_fifo = inst->fifo_requested;
+    return 1;
+}
+
+/**
+ *  Longest time that the driver can go without a sample in normal operation.
+ */
+static uint32_t mpu9250_watchdog_timeout(const struct mpu9250_desc_t *inst)
+{
+    const uint32_t samples = (inst->use_fifo ?
+                              mpu9250_fifo_samples_per_burst(inst) : 1);
+    const uint32_t interval = (samples * 1000) / mpu9250_get_ag_odr(inst);
+    return (2 * interval) + MPU9250_WATCHDOG_MARGIN;
+}
+
+int mpu9250_watchdog(struct mpu9250_desc_t *inst)
+{
+    const int running = ((inst->state >= MPU9250_RUNNING) &&
+                         (inst->state < MPU9250_FAILED));
+    if (inst->state >= MPU9250_FAILED) {
+        return 0;
+    } else if (!running && !inst->restarting) {
+        // Still initializing, samples are expected from the end of the
+        // initialization sequence
+        inst->restart_time = (uint32_t)millis;
+        return 0;
+    } else if (running) {
+        inst->restarting = 0;
+    }
+
+    // Progress is measured from initialization or the most recent restart
+    // until the first new sample
+    uint32_t progress = inst->last_sample_time;
+    if ((int32_t)(inst->restart_time - progress) > 0) {
+        progress = inst->restart_time;
+    }
+    if (((uint32_t)millis - progress) <= mpu9250_watchdog_timeout(inst)) {
+        return 0;
+    }
+
+    i2c_queue_abort(&inst->transaction);
+    timer_wheel_cancel(inst->wheel, &inst->wait_timer);
+    if (inst->buffer != NULL) {
+        mpu9250_release_buffer(inst);
+    }
+    inst->i2c_in_progress = 0;
+    inst->async_i2c_in_progress = 0;
+    inst->post_cmd_wait = 0;
+    inst->cmd_ready = 0;
+    inst->samples_left = 0;
+
+    // The configuration sequence sets up the requested mode at the normal
+    // sample rate, clearing low_power makes a low power request apply again
+    inst->use_fifo = inst->fifo_requested;
+    inst->low_power = 0;
+    inst->state = MPU9250_USER_REST;
+    inst->next_state = MPU9250_MAG_ENABLE;
+
+    inst->restarting = 1;
+    inst->restart_time = (uint32_t)millis;
+    if (inst->restart_count < UINT16_MAX) {
+        inst->restart_count++;
+    }
+    return 1;
+}
@@ -11,9 +11,27 @@
 #define mpu9250_test_h
 #include "test-global.h"
 #include "gpio-test.h"
+#include "buffer-arena.h"
+#include "i2c-queue.h"
+#include "timer-wheel.h"
+#include "sensor-bus.h"
 
 
-#define MPU9250_BUFFER_LENGTH   128
+#define MPU9250_BUFFER_LENGTH   BUFFER_ARENA_BUFFER_LENGTH
+
+/** Size of accel, temp and gyro data in a FIFO record */
+#define MPU9250_FIFO_AG_SAMPLE_SIZE     14
+/** Size of magnetometer data (HXL to ST2) in a FIFO record */
+#define MPU9250_FIFO_MAG_SAMPLE_SIZE    7
+/** Bytes on the bus for a register read in addition to the data (address
+    write, register, address read and start/stop conditions) */
+#define MPU9250_I2C_READ_OVERHEAD       4
+/** Value loaded into the sample rate register in low power operation (1000 /
+    (1 + 249) = 4 Hz, the lowest rate with the DLPF enabled) */
+#define MPU9250_LOW_POWER_ODR           249
+/** Time beyond two sample intervals (or two FIFO bursts) without a new
+    sample after which the driver is considered stalled in milliseconds */
+#define MPU9250_WATCHDOG_MARGIN         50
 
 
 /** MPU9250 sample rate */
@@ -197,7 +215,10 @@ enum mpu9250_state {
     /** Write I2C_MST_CTRL, I2C_SLV0_ADDR, I2C_SLV0_REG and I2C_SLV0_CTRL to
         read 7 bytes from magnetometer starting at HXL, I2C master configured
         for 400 KHz clock and to delay data ready interrupt until external
-        sensor data is ready */
+        sensor data is ready. When magnetometer decimation is enabled also
+        write I2C_SLV4_CTRL with I2C_MST_DLY and I2C_MST_DELAY_CTRL with
+        I2C_SLV0_DLY_EN so that slave 0 is only read at the magnetometer
+        ODR. */
     MPU9250_CONFIG_I2C_MST,
     /** Write to USER_CTRL to enable I2C master (and enable FIFO for FIFO driven
         operation) */
@@ -214,7 +235,8 @@ enum mpu9250_state {
     MPU9250_AG_CONFIG_INT,
 // For FIFO driven operation:
     /** Write to FIFO_EN to enable writing of gyro x, y and z, accel, temp and
-        I2C slave 0 data to FIFO */
+        I2C slave 0 data to FIFO (slave 0 data is left out of the FIFO when
+        magnetometer decimation is enabled) */
     MPU9250_AG_CONFIG_FIFO,
 
 // ##### Normal operation (interrupt driven) #####
@@ -228,6 +250,33 @@ enum mpu9250_state {
     MPU9250_FIFO_READ_COUNT,
     /** Read samples from FIFO */
     MPU9250_FIFO_READ,
+    /** Read EXT_SENS_DATA_00 through EXT_SENS_DATA_06 once every
+        I2C_MST_DLY + 1 samples, after the I2C master has refreshed it (only
+        when magnetometer decimation is enabled) */
+    MPU9250_FIFO_READ_MAG,
+
+// ##### Switch between interrupt and FIFO driven operation #####
+// Entered from MPU9250_RUNNING or MPU9250_FIFO_WAIT by
+// mpu9250_check_mode_switch(), calibration is not repeated
+    /** Write to INT_ENABLE to disable the raw data ready interrupt, then
+        continue with MPU9250_AG_CONFIG_FIFO and MPU9250_FIFO_WAIT */
+    MPU9250_SWITCH_DISABLE_INT,
+    /** Write to FIFO_EN to stop writing data to the FIFO, then drain it with
+        MPU9250_FIFO_READ_COUNT and MPU9250_FIFO_READ and continue with
+        MPU9250_AG_CONFIG_INT and MPU9250_RUNNING */
+    MPU9250_SWITCH_STOP_FIFO,
+
+// ##### Enter or leave low power operation #####
+// Entered from MPU9250_RUNNING or MPU9250_FIFO_WAIT by
+// mpu9250_check_mode_switch(), interrupt or FIFO driven operation is kept
+    /** Write to I2C_SLV0_CTRL to stop reading the magnetometer and write CNTL1
+        through I2C_SLV4 to power it down (when leaving low power operation,
+        write CNTL1 to select continuous mode and enable slave 0 again) */
+    MPU9250_LP_MAG_POWER,
+    /** Write to SMPLRT_DIV to select MPU9250_LOW_POWER_ODR (odr when leaving
+        low power operation), then continue with MPU9250_RUNNING or
+        MPU9250_FIFO_WAIT */
+    MPU9250_LP_SET_ODR,
 
 // ##### Failure states #####
     /** Driver failed */
@@ -243,18 +292,39 @@ enum mpu9250_state {
 };
 
 
+/** Record published for every accel/gyro sample */
+struct mpu9250_sample {
+    /** Time of sample */
+    uint32_t time;
+    int16_t accel[3];
+    int16_t gyro[3];
+    /** Most recent magnetometer values, which may be older than the
+        accel/gyro values if magnetometer reads are decimated */
+    int16_t mag[3];
+    int16_t temp;
+};
+
 struct mpu9250_desc_t {
 
-    /** Buffer used for I2C transaction data */
-    uint8_t buffer[MPU9250_BUFFER_LENGTH];
-
-    /** Pointer to buffer to be used when reading samples from sensor, could be
-        a buffer provided by the telemetry service or this driver instances own
-        buffer */
-    uint8_t *telem_buffer;
+    /** Buffer used for I2C transaction data, leased from the buffer arena
+        for the duration of a transaction (NULL when no buffer is leased) */
+    uint8_t *buffer;
 
     /** The millis value when we started waiting for something */
     uint32_t wait_start;
+    /** Timer for clock settle, self test and post command waits, the service
+        does not need to be run while it is pending */
+    struct timer_wheel_timer wait_timer;
+    /** Timer wheel on which wait_timer is scheduled */
+    struct timer_wheel *wheel;
+
+    /** Topic to which every sample is published (may be NULL) */
+    struct sensor_bus_topic *topic;
+
+    /** Pointer to buffer to be used when reading samples from sensor, could be
+        a buffer provided by the telemetry service or a buffer leased from the
+        buffer arena */
+    uint8_t *telem_buffer;
 
     /** Values used when averaging samples for self test and offset
         calibration */
@@ -267,6 +337,14 @@ struct mpu9250_desc_t {
     uint32_t next_sample_time;
 
     uint32_t last_sample_time;
+    /** Time at which the driver was last restarted by the watchdog, or last
+        seen initializing */
+    uint32_t restart_time;
+    /** Number of times that the driver has been restarted by the watchdog */
+    uint16_t restart_count;
+    /** Time at which the magnetometer data was last read when magnetometer
+        reads are decimated */
+    uint32_t last_mag_read_time;
     int16_t last_accel_x;
     int16_t last_accel_y;
     int16_t last_accel_z;
@@ -290,8 +368,10 @@ struct mpu9250_desc_t {
     uint8_t mpu9250_addr;
 
 
-    /** I2C transaction id */
-    uint8_t t_id;
+    /** Descriptor for transactions on the shared I2C queue, FIFO and sample
+        reads are queued as I2C_PRIORITY_SAMPLE, everything else as
+        I2C_PRIORITY_CONFIG */
+    struct i2c_transaction transaction;
 
     uint8_t retry_count;
 
@@ -318,6 +398,15 @@ struct mpu9250_desc_t {
         read data in larger chunks rather than reading each sample using the
         interrupt */
     uint8_t use_fifo:1;
+    /** Mode requested with mpu9250_request_fifo(), use_fifo is changed to
+        match at the next sample boundary */
+    uint8_t fifo_requested:1;
+    /** Flag set while the sample rate is reduced and the magnetometer is
+        powered down */
+    uint8_t low_power:1;
+    /** Power mode requested with mpu9250_request_low_power(), low_power is
+        changed to match at the next sample boundary */
+    uint8_t low_power_requested:1;
     /** Flag to indicate that we the register values to be sent in the current
         state have been marshaled */
     uint8_t cmd_ready:1;
@@ -338,12 +427,20 @@ struct mpu9250_desc_t {
     /** Flag to indicate that an I2C transaction initiated from an interrupt is
         in progress (separate from i2c_in_progress to avoid affecting FSM) */
     uint8_t async_i2c_in_progress:1;
+    /** Flag to indicate that magnetometer data should be read at the
+        magnetometer ODR with separate reads instead of being included in
+        every FIFO record */
+    uint8_t mag_decimate:1;
+    /** Flag set by the watchdog when it restarts the driver, cleared once the
+        driver is back in normal operation */
+    uint8_t restarting:1;
 };
 
 
 
 
 extern int init_mpu9250(struct mpu9250_desc_t *inst,
+                        struct timer_wheel *wheel,
                         uint8_t i2c_addr,
                         uint8_t int_pin,
                         enum mpu9250_gyro_fsr gyro_fsr,
@@ -355,6 +452,171 @@ extern int init_mpu9250(struct mpu9250_desc_t *inst,
 
 extern void mpu9250_service(struct mpu9250_desc_t *inst);
 
+/**
+ *  Schedule the wait timer so that the service does not need to be run again
+ *  until the given time has passed.
+ *
+ *  @param inst The MPU9250 driver instance
+ *  @param duration Length of the wait in milliseconds
+ */
+extern void mpu9250_start_wait(struct mpu9250_desc_t *inst, uint32_t duration);
+
+/**
+ *  Get whether the driver is waiting for its wait timer to expire.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Non-zero if the service does not need to be run
+ */
+static inline int mpu9250_waiting(const struct mpu9250_desc_t *inst)
+{
+    return timer_wheel_pending(&inst->wait_timer);
+}
+
+
+/**
+ *  Set the topic to which every accel/gyro sample read from the sensor is
+ *  published, including every record of a FIFO burst. The topic's records must
+ *  be struct mpu9250_sample.
+ *
+ *  @param inst The MPU9250 driver instance
+ *  @param topic The topic, or NULL to stop publishing
+ */
+static inline void mpu9250_set_topic(struct mpu9250_desc_t *inst,
+                                     struct sensor_bus_topic *topic)
+{
+    inst->topic = topic;
+}
+
+/**
+ *  Publish the current sample. Called by the driver after each sample has been
+ *  stored in the last_* values.
+ *
+ *  @param inst The MPU9250 driver instance
+ */
+static inline void mpu9250_notify_sample(struct mpu9250_desc_t *inst)
+{
+    if (inst->topic == NULL) {
+        return;
+    }
+    struct mpu9250_sample *const sample = sensor_bus_claim(inst->topic);
+    sample->time = inst->last_sample_time;
+    sample->accel[0] = inst->last_accel_x;
+    sample->accel[1] = inst->last_accel_y;
+    sample->accel[2] = inst->last_accel_z;
+    sample->gyro[0] = inst->last_gyro_x;
+    sample->gyro[1] = inst->last_gyro_y;
+    sample->gyro[2] = inst->last_gyro_z;
+    sample->mag[0] = inst->last_mag_x;
+    sample->mag[1] = inst->last_mag_y;
+    sample->mag[2] = inst->last_mag_z;
+    sample->temp = inst->last_temp;
+    sensor_bus_commit(inst->topic);
+}
+
+/**
+ *  Request interrupt driven or FIFO driven operation. The change is made by
+ *  the driver at the next sample boundary, without repeating calibration.
+ *  Interrupt driven operation publishes each sample as soon as it is taken,
+ *  FIFO driven operation uses less bus and CPU time but publishes samples in
+ *  bursts.
+ *
+ *  @param inst The MPU9250 driver instance
+ *  @param use_fifo Non-zero for FIFO driven operation
+ */
+static inline void mpu9250_request_fifo(struct mpu9250_desc_t *inst,
+                                        uint8_t use_fifo)
+{
+    inst->fifo_requested = !!use_fifo;
+}
+
+/**
+ *  Request low power operation, in which accel/gyro samples are taken at
+ *  MPU9250_LOW_POWER_ODR and the magnetometer is powered down, or a return to
+ *  normal operation. The change is made by the driver at the next sample
+ *  boundary.
+ *
+ *  @param inst The MPU9250 driver instance
+ *  @param low_power Non-zero for low power operation
+ */
+static inline void mpu9250_request_low_power(struct mpu9250_desc_t *inst,
+                                             uint8_t low_power)
+{
+    inst->low_power_requested = !!low_power;
+}
+
+/**
+ *  Start switching modes if a different mode has been requested. A power
+ *  mode change is made before a change between interrupt and FIFO driven
+ *  operation. Called by the service in MPU9250_RUNNING and MPU9250_FIFO_WAIT
+ *  once no sample read is in progress.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Non-zero if the driver has entered a mode switch sequence
+ */
+extern int mpu9250_check_mode_switch(struct mpu9250_desc_t *inst);
+
+/**
+ *  Get the time since the most recent accel/gyro sample.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Age of the most recent sample in milliseconds
+ */
+static inline uint32_t mpu9250_data_age(const struct mpu9250_desc_t *inst)
+{
+    return (uint32_t)millis - inst->last_sample_time;
+}
+
+/**
+ *  Check that the driver is still producing samples and restart it if it is
+ *  not. A driver in normal operation which has gone more than two sample
+ *  intervals (two bursts in FIFO driven operation) plus
+ *  MPU9250_WATCHDOG_MARGIN without a sample has its transaction abandoned and
+ *  its buffer returned, and is restarted with the user reset sequence
+ *  followed by MPU9250_MAG_ENABLE. The WAI checks, self tests and calibration
+ *  are not repeated, so a restart takes a few register writes instead of
+ *  most of a second and can be done in flight. The requested interrupt or
+ *  FIFO driven operation is restored at the normal sample rate, a pending
+ *  low power request is made again afterwards. Should be called in each
+ *  iteration of the main loop, whether or not the driver is waiting.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Non-zero if the driver was restarted
+ */
+extern int mpu9250_watchdog(struct mpu9250_desc_t *inst);
+
+/**
+ *  Lease a transaction buffer from the buffer arena if the instance does not
+ *  already hold one.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Non-zero if the instance holds a buffer, 0 if the arena is empty and
+ *          the transaction should be retried later
+ */
+static inline int mpu9250_lease_buffer(struct mpu9250_desc_t *inst)
+{
+    if (inst->buffer == NULL) {
+        inst->buffer = buffer_arena_lease();
+    }
+    return inst->buffer != NULL;
+}
+
+/**
+ *  Return the transaction buffer held by an instance to the buffer arena once
+ *  the data read into it has been consumed.
+ *
+ *  @param inst The MPU9250 driver instance
+ */
+static inline void mpu9250_release_buffer(struct mpu9250_desc_t *inst)
+{
+    buffer_arena_release(inst->buffer);
+    inst->buffer = NULL;
+}
+
 
 
 
@@ -432,7 +694,130 @@ static inline uint16_t mpu9250_mag_sensitivity(const struct mpu9250_desc_t *inst
  */
 static inline uint16_t mpu9250_get_ag_odr(const struct mpu9250_desc_t *inst)
 {
-    return (uint16_t)1000 / ((uint16_t)(inst->odr) + 1);
+    const uint16_t div = inst->low_power ? MPU9250_LOW_POWER_ODR : inst->odr;
+    return (uint16_t)1000 / (div + 1);
+}
+
+/**
+ *  Get the sample rate for the magnetometer.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Magnetometer ODR in Hz
+ */
+static inline uint16_t mpu9250_get_mag_odr(const struct mpu9250_desc_t *inst)
+{
+    switch (inst->mag_odr) {
+        case AK8963_ODR_8HZ:
+            return 8;
+        case AK8963_ODR_100HZ:
+        default:
+            return 100;
+    }
+}
+
+/**
+ *  Get the value for I2C_MST_DLY so that slave 0 is only read once for every
+ *  magnetometer sample when magnetometer reads are decimated.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Number of accel/gyro samples to skip between slave 0 reads
+ */
+static inline uint8_t mpu9250_get_mag_delay(const struct mpu9250_desc_t *inst)
+{
+    const uint16_t mag_odr = mpu9250_get_mag_odr(inst);
+    const uint16_t ratio = mpu9250_get_ag_odr(inst) / mag_odr;
+    if (ratio == 0) {
+        return 0;
+    }
+    // I2C_MST_DLY is 5 bits
+    return (ratio > 32) ? 31 : (uint8_t)(ratio - 1);
+}
+
+/**
+ *  Get the size of each record in the FIFO.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return FIFO record size in bytes
+ */
+static inline uint8_t mpu9250_fifo_sample_size(
+                                            const struct mpu9250_desc_t *inst)
+{
+    if (inst->mag_decimate) {
+        return MPU9250_FIFO_AG_SAMPLE_SIZE;
+    }
+    return MPU9250_FIFO_AG_SAMPLE_SIZE + MPU9250_FIFO_MAG_SAMPLE_SIZE;
+}
+
+/**
+ *  Get the number of FIFO records that fit in one buffer sized burst read.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Number of records per burst (6 with magnetometer data in every
+ *          record, 9 with decimated magnetometer reads)
+ */
+static inline uint8_t mpu9250_fifo_samples_per_burst(
+                                            const struct mpu9250_desc_t *inst)
+{
+    return MPU9250_BUFFER_LENGTH / mpu9250_fifo_sample_size(inst);
+}
+
+/**
+ *  Estimate the number of bytes that need to be moved over the bus for each
+ *  second of data in FIFO driven operation, including FIFO count reads and
+ *  separate magnetometer reads.
+ *
+ *  @param inst The MPU9250 driver instance
+ *
+ *  @return Estimated bus bytes per second
+ */
+static inline uint32_t mpu9250_fifo_bus_bytes_per_second(
+                                            const struct mpu9250_desc_t *inst)
+{
+    const uint32_t odr = mpu9250_get_ag_odr(inst);
+    const uint32_t per_burst = mpu9250_fifo_samples_per_burst(inst);
+    const uint32_t bursts = (odr + per_burst - 1) / per_burst;
+
+    // Each burst is a FIFO_COUNT read followed by a FIFO_R_W read
+    uint32_t bytes = ((odr * mpu9250_fifo_sample_size(inst)) +
+                      (bursts * (2 + (2 * MPU9250_I2C_READ_OVERHEAD))));
+    if (inst->mag_decimate) {
+        // EXT_SENS_DATA is read each time the I2C master refreshes it
+        bytes += ((odr * (MPU9250_FIFO_MAG_SAMPLE_SIZE +
+                          MPU9250_I2C_READ_OVERHEAD)) /
+                  ((uint32_t)mpu9250_get_mag_delay(inst) + 1));
+    }
+    return bytes;
+}
+
+/**
+ *  Enable or disable decimation of magnetometer reads to the magnetometer ODR.
+ *  Must be called before the driver configures the I2C master (i.e. right
+ *  after init_mpu9250()). Decimation is only enabled if it moves fewer bytes
+ *  over the bus than magnetometer data in every FIFO record, which needs a
+ *  magnetometer ODR well below the accel/gyro ODR (e.g. 8 Hz with 100 Hz).
+ *
+ *  @param inst The MPU9250 driver instance
+ *  @param decimate Non-zero to read the magnetometer only at its own ODR
+ *
+ *  @return Non-zero if decimation is enabled
+ */
+static inline int mpu9250_set_mag_decimation(struct mpu9250_desc_t *inst,
+                                             uint8_t decimate)
+{
+    inst->mag_decimate = 0;
+    if (!decimate) {
+        return 0;
+    }
+    const uint32_t every_record = mpu9250_fifo_bus_bytes_per_second(inst);
+    inst->mag_decimate = 1;
+    if (mpu9250_fifo_bus_bytes_per_second(inst) >= every_record) {
+        inst->mag_decimate = 0;
+    }
+    return inst->mag_decimate;
 }
 
 /**
@@ -0,0 +1,170 @@
+/**
+ * @file ms5611-bench.c
+ * @desc Accuracy check and benchmark of MS5611 altitude calculation
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef MS5611_BENCH_MAIN
+
+#include "ms5611-test.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Documented bound on the error of the fast path for p0 from 500 to 1200
+    mbar in meters */
+#define MS5611_BENCH_BOUND_SEA      0.065
+/** Documented bound on the error of the fast path for any p0 from
+    MS5611_MIN_P0 to MS5611_MAX_PRESSURE in meters */
+#define MS5611_BENCH_BOUND_ALL      0.09
+
+/** Lowest p0 covered by MS5611_BENCH_BOUND_SEA */
+#define MS5611_BENCH_SEA_MIN_P0     50000
+
+
+/** (p / 1 Pa) ^ (1 / 5.255) for each pressure the sensor can produce */
+static double ms5611_bench_pow[MS5611_MAX_PRESSURE + 1];
+
+static double ms5611_bench_meters (ms5611_alt_t alt)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return (double)alt / 65536.0;
+#else
+    return (double)alt;
+#endif
+}
+
+/**
+ *  Get the largest error of the fast path versus the exact barometric formula
+ *  in double precision over every pressure the sensor can produce.
+ */
+static double ms5611_bench_error (struct ms5611_desc_t *inst, int32_t p0,
+                                  int32_t *worst_pressure)
+{
+    const double scale = 1.0 / pow((double)p0, 1.0 / 5.255);
+    double worst = 0;
+
+    ms5611_set_p0(inst, p0);
+    for (int32_t p = MS5611_MIN_PRESSURE; p <= MS5611_MAX_PRESSURE; p++) {
+        const double exact = 44330.0 * (1.0 - (ms5611_bench_pow[p] * scale));
+        const ms5611_alt_t fast = ms5611_calc_altitude_fast(inst, p);
+        const double error = fabs(ms5611_bench_meters(fast) - exact);
+        if (error > worst) {
+            worst = error;
+            *worst_pressure = p;
+        }
+    }
+    return worst;
+}
+
+/**
+ *  Get the average time for one altitude calculation in nanoseconds.
+ */
+static double ms5611_bench_time (struct ms5611_desc_t *inst, int fast,
+                                 uint32_t rounds)
+{
+    volatile ms5611_alt_t sink;
+    struct timespec start, end;
+
+    ms5611_set_fast_altitude(inst, fast);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint32_t r = 0; r < rounds; r++) {
+        for (int32_t p = MS5611_MIN_PRESSURE; p <= MS5611_MAX_PRESSURE; p++) {
+            sink = ms5611_calc_altitude(inst, p);
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    (void)sink;
+
+    const double ns = (((double)(end.tv_sec - start.tv_sec) * 1e9) +
+                       (double)(end.tv_nsec - start.tv_nsec));
+    return ns / ((double)rounds *
+                 (MS5611_MAX_PRESSURE - MS5611_MIN_PRESSURE + 1));
+}
+
+int main (int argc, char **argv)
+{
+    static struct ms5611_desc_t inst;
+    int32_t step = 10;
+    uint32_t rounds = 20;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "s:r:")) != -1) {
+        switch (opt) {
+            case 's':
+                step = (int32_t)strtol(optarg, NULL, 10);
+                step = (step < 1) ? 1 : step;
+                break;
+            case 'r':
+                rounds = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-s p0 step in Pa] [-r benchmark "
+                        "rounds]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    for (int32_t p = MS5611_MIN_PRESSURE; p <= MS5611_MAX_PRESSURE; p++) {
+        ms5611_bench_pow[p] = pow((double)p, 1.0 / 5.255);
+    }
+
+    // A p0 of 0 (tare before the first reading) must be refused and a very
+    // low p0 raised so that altitudes do not saturate
+    if (ms5611_set_p0(&inst, 0) == 0) {
+        fprintf(stderr, "p0 of 0 was accepted\n");
+        return 1;
+    }
+    ms5611_set_p0(&inst, MS5611_MIN_PRESSURE);
+    if (inst.p0 != MS5611_MIN_P0) {
+        fprintf(stderr, "p0 below MS5611_MIN_P0 was not raised\n");
+        return 1;
+    }
+
+    double worst_sea = 0, worst_all = 0;
+    int32_t sea_p0 = 0, sea_p = 0, all_p0 = 0, all_p = 0;
+    for (int32_t p0 = MS5611_MIN_P0; p0 <= MS5611_MAX_PRESSURE; p0 += step) {
+        int32_t p = 0;
+        const double error = ms5611_bench_error(&inst, p0, &p);
+        if ((p0 >= MS5611_BENCH_SEA_MIN_P0) && (error > worst_sea)) {
+            worst_sea = error;
+            sea_p0 = p0;
+            sea_p = p;
+        }
+        if (error > worst_all) {
+            worst_all = error;
+            all_p0 = p0;
+            all_p = p;
+        }
+    }
+
+    printf("p0 every %d Pa from %d Pa, every pressure from %d to %d Pa\n",
+           (int)step, MS5611_MIN_P0, MS5611_MIN_PRESSURE, MS5611_MAX_PRESSURE);
+    printf("p0 500 to 1200 mbar: worst %.4f m (p0 %d Pa, p %d Pa), "
+           "bound %.3f m\n", worst_sea, (int)sea_p0, (int)sea_p,
+           MS5611_BENCH_BOUND_SEA);
+    printf("any p0:              worst %.4f m (p0 %d Pa, p %d Pa), "
+           "bound %.3f m\n", worst_all, (int)all_p0, (int)all_p,
+           MS5611_BENCH_BOUND_ALL);
+
+    ms5611_set_p0(&inst, 101325);
+    const double exact = ms5611_bench_time(&inst, 0, rounds);
+    const double fast = ms5611_bench_time(&inst, 1, rounds);
+    printf("exact %.2f ns, fast %.2f ns per altitude (%.1fx)\n", exact, fast,
+           exact / fast);
+
+    if ((worst_sea >= MS5611_BENCH_BOUND_SEA) ||
+            (worst_all >= MS5611_BENCH_BOUND_ALL)) {
+        fprintf(stderr, "error bound exceeded\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,344 @@
+/**
+ * @file ms5611.c
+ * @desc Driver for MS5611 barometric pressure sensor
+ * @author Samuel Dewan
+ * @date 2019-06-04
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "ms5611-test.h"
+
+#include <math.h>
+
+#ifdef MS5611_HOST_BATCH
+#include <pthread.h>
+#endif
+
+/**
+ *  Values of (1 + m) ^ (1 / 5.255) for m = i / 128, 0 <= i <= 128 in Q2.30
+ *  fixed point.
+ */
+static const uint32_t ms5611_alt_mantissa_table[] = {
+    0x40000000, 0x401847F4, 0x40306904, 0x404863B9,
+    0x4060389A, 0x4077E82B, 0x408F72F0, 0x40A6D965,
+    0x40BE1C08, 0x40D53B52, 0x40EC37BA, 0x410311B5,
+    0x4119C9B5, 0x4130602B, 0x4146D585, 0x415D2A2E,
+    0x41735E8F, 0x41897311, 0x419F6819, 0x41B53E0A,
+    0x41CAF547, 0x41E08E2E, 0x41F6091F, 0x420B6675,
+    0x4220A68B, 0x4235C9BA, 0x424AD05A, 0x425FBABF,
+    0x4274893E, 0x42893C2A, 0x429DD3D4, 0x42B2508B,
+    0x42C6B29F, 0x42DAFA5B, 0x42EF280C, 0x43033BFB,
+    0x43173672, 0x432B17B9, 0x433EE016, 0x43528FCE,
+    0x43662726, 0x4379A661, 0x438D0DC0, 0x43A05D85,
+    0x43B395EF, 0x43C6B73D, 0x43D9C1AD, 0x43ECB57C,
+    0x43FF92E5, 0x44125A23, 0x44250B71, 0x4437A706,
+    0x444A2D1C, 0x445C9DE8, 0x446EF9A3, 0x44814080,
+    0x449372B6, 0x44A59077, 0x44B799F8, 0x44C98F69,
+    0x44DB70FE, 0x44ED3EE6, 0x44FEF952, 0x4510A071,
+    0x45223472, 0x4533B583, 0x454523D1, 0x45567F8A,
+    0x4567C8D8, 0x4578FFE8, 0x458A24E4, 0x459B37F7,
+    0x45AC394A, 0x45BD2907, 0x45CE0755, 0x45DED45C,
+    0x45EF9045, 0x46003B35, 0x4610D553, 0x46215EC5,
+    0x4631D7B0, 0x46424039, 0x46529883, 0x4662E0B4,
+    0x467318ED, 0x46834153, 0x46935A06, 0x46A3632A,
+    0x46B35CDF, 0x46C34747, 0x46D32282, 0x46E2EEB1,
+    0x46F2ABF2, 0x47025A67, 0x4711FA2D, 0x47218B63,
+    0x47310E27, 0x47408298, 0x474FE8D2, 0x475F40F3,
+    0x476E8B17, 0x477DC75B, 0x478CF5DB, 0x479C16B2,
+    0x47AB29FC, 0x47BA2FD4, 0x47C92855, 0x47D81398,
+    0x47E6F1B9, 0x47F5C2D0, 0x480486F7, 0x48133E48,
+    0x4821E8DA, 0x483086C8, 0x483F1828, 0x484D9D13,
+    0x485C15A1, 0x486A81E9, 0x4878E202, 0x48873604,
+    0x48957E04, 0x48A3BA19, 0x48B1EA5A, 0x48C00EDC,
+    0x48CE27B5, 0x48DC34FA, 0x48EA36C0, 0x48F82D1D,
+    0x49061825,
+};
+
+void ms5611_start_wait (struct ms5611_desc_t *inst, uint32_t duration)
+{
+    timer_wheel_schedule(inst->wheel, &inst->wait_timer,
+                         (uint32_t)millis + duration);
+}
+
+int ms5611_watchdog (struct ms5611_desc_t *inst)
+{
+    if (inst->state == MS5611_FAILED) {
+        return 0;
+    } else if ((inst->state < MS5611_IDLE) && !inst->restarting) {
+        // Still initializing, readings are expected from the end of the
+        // initialization sequence
+        inst->restart_time = (uint32_t)millis;
+        return 0;
+    } else if (inst->state >= MS5611_IDLE) {
+        inst->restarting = 0;
+    }
+
+    // Progress is measured from initialization or the most recent restart
+    // until the first new reading
+    uint32_t progress = inst->last_reading_time;
+    if ((int32_t)(inst->restart_time - progress) > 0) {
+        progress = inst->restart_time;
+    }
+    if (((uint32_t)millis - progress) <=
+            ((2 * inst->period) + MS5611_WATCHDOG_MARGIN)) {
+        return 0;
+    }
+
+    i2c_queue_abort(&inst->transaction);
+    timer_wheel_cancel(inst->wheel, &inst->wait_timer);
+    inst->i2c_in_progress = 0;
+    inst->state = MS5611_RESET;
+    inst->restarting = 1;
+    inst->restart_time = (uint32_t)millis;
+    if (inst->restart_count < UINT16_MAX) {
+        inst->restart_count++;
+    }
+    return 1;
+}
+
+int ms5611_set_p0 (struct ms5611_desc_t *inst, int32_t p0)
+{
+    if (p0 <= 0) {
+        return 1;
+    } else if (p0 < MS5611_MIN_P0) {
+        p0 = MS5611_MIN_P0;
+    }
+
+    inst->p0 = p0;
+    inst->p0_set = 1;
+
+    // (p / p0) ^ k = (2 ^ e / p0) ^ k * (1 + m) ^ k, precompute the first part
+    // for each octave along with the scale height. This is the only place
+    // where the fast path needs floating point math.
+    for (int i = 0; i < MS5611_ALT_TABLE_OCTAVES; i++) {
+        const float octave = (float)(1UL << (MS5611_ALT_TABLE_MIN_OCTAVE + i));
+        const float scale = (MS5611_ALT_SCALE *
+                             powf(octave / (float)p0, MS5611_ALT_EXPONENT));
+#ifdef FIXED_POINT_ALTITUDE
+        // Q17.15, scale is at most about 64 km since p0 is at least
+        // MS5611_MIN_P0
+        inst->alt_octave_scale[i] = (ms5611_alt_scale_t)(scale * 32768.0f);
+#else
+        // Include the Q2.30 scale factor of the mantissa table
+        inst->alt_octave_scale[i] = scale / (float)(1UL << 30);
+#endif
+    }
+    return 0;
+}
+
+ms5611_alt_t ms5611_calc_altitude_exact (int32_t p0, int32_t pressure)
+{
+    if (p0 <= 0) {
+        return 0;
+    }
+
+    const float alt = MS5611_ALT_SCALE * (1.0f - powf((float)pressure /
+                                                      (float)p0,
+                                                      MS5611_ALT_EXPONENT));
+#ifdef FIXED_POINT_ALTITUDE
+    // Saturate rather than convert values which do not fit
+    const float fixed = alt * 65536.0f;
+    if (!(fixed < 2147483520.0f)) {
+        return INT32_MAX;
+    } else if (fixed < -2147483648.0f) {
+        return INT32_MIN;
+    }
+    return (ms5611_alt_t)fixed;
+#else
+    return alt;
+#endif
+}
+
+ms5611_alt_t ms5611_calc_altitude_fast (const struct ms5611_desc_t *inst,
+                                        int32_t pressure)
+{
+    if (pressure < MS5611_MIN_PRESSURE) {
+        pressure = MS5611_MIN_PRESSURE;
+    } else if (pressure > MS5611_MAX_PRESSURE) {
+        pressure = MS5611_MAX_PRESSURE;
+    }
+
+    const uint32_t p = (uint32_t)pressure;
+    // Octave of pressure, p is at least 1000 so this is always at least 9
+    const unsigned octave = 31 - __builtin_clz(p);
+    // Number of bits below the segment index
+    const unsigned frac_bits = octave - MS5611_ALT_TABLE_SEG_BITS;
+
+    const uint32_t seg = ((p >> frac_bits) &
+                          ((1UL << MS5611_ALT_TABLE_SEG_BITS) - 1));
+    const uint32_t frac = p & ((1UL << frac_bits) - 1);
+
+    // Linear interpolation between table entries (the table is monotonic and
+    // the product fits in 32 bits since frac_bits is at most 9)
+    const uint32_t low = ms5611_alt_mantissa_table[seg];
+    const uint32_t high = ms5611_alt_mantissa_table[seg + 1];
+    const uint32_t mantissa = low + (((high - low) * frac) >> frac_bits);
+
+    const ms5611_alt_scale_t scale =
+                    inst->alt_octave_scale[octave - MS5611_ALT_TABLE_MIN_OCTAVE];
+#ifdef FIXED_POINT_ALTITUDE
+    // Q17.15 * Q2.30 -> Q16.16 is a shift right by 29
+    const int64_t alt = ((((int64_t)MS5611_ALT_SCALE) << 16) -
+                         (int64_t)(((uint64_t)scale * mantissa) >> 29));
+    if (alt > INT32_MAX) {
+        return INT32_MAX;
+    } else if (alt < INT32_MIN) {
+        return INT32_MIN;
+    }
+    return (ms5611_alt_t)alt;
+#else
+    return MS5611_ALT_SCALE - (scale * (float)mantissa);
+#endif
+}
+
+/**
+ *  Compensation of one reading. Written without branches, the second order
+ *  terms are selected with masks, so that the batch version vectorizes.
+ */
+static inline __attribute__((always_inline)) void ms5611_compensate_step (
+                                                        const uint16_t prom[6],
+                                                        uint32_t d1,
+                                                        uint32_t d2,
+                                                        int32_t *pressure,
+                                                        int32_t *temperature)
+{
+    // First order
+    const int64_t dt = (int64_t)d2 - ((int64_t)prom[4] << 8);
+    int64_t temp = 2000 + ((dt * prom[5]) >> 23);
+    int64_t off = ((int64_t)prom[1] << 16) + ((dt * prom[3]) >> 7);
+    int64_t sens = ((int64_t)prom[0] << 15) + ((dt * prom[2]) >> 8);
+
+    // Second order, below 20 C and again below -15 C
+    const int64_t low = -(int64_t)(temp < 2000);
+    const int64_t very_low = -(int64_t)(temp < -1500);
+    const int64_t t_low = temp - 2000;
+    const int64_t t_very_low = temp + 1500;
+    const int64_t t2 = ((dt * dt) >> 31) & low;
+    const int64_t off2 = ((((5 * t_low * t_low) >> 1) & low) +
+                          ((7 * t_very_low * t_very_low) & very_low));
+    const int64_t sens2 = ((((5 * t_low * t_low) >> 2) & low) +
+                           (((11 * t_very_low * t_very_low) >> 1) & very_low));
+    temp -= t2;
+    off -= off2;
+    sens -= sens2;
+
+    *temperature = (int32_t)temp;
+    *pressure = (int32_t)(((((int64_t)d1 * sens) >> 21) - off) >> 15);
+}
+
+void ms5611_compensate (const uint16_t prom[6], uint32_t d1, uint32_t d2,
+                        int32_t *pressure, int32_t *temperature)
+{
+    ms5611_compensate_step(prom, d1, d2, pressure, temperature);
+}
+
+#ifdef MS5611_HOST_BATCH
+/**
+ *  Batch compensation with every array as a restrict qualified parameter,
+ *  which GCC needs in order to vectorize without run time alias checks.
+ */
+static void ms5611_compensate_kernel (const uint16_t prom[6], uint32_t count,
+                                      const uint32_t *restrict d1,
+                                      const uint32_t *restrict d2,
+                                      int32_t *restrict pressure,
+                                      int32_t *restrict temperature)
+{
+    const uint16_t c[6] = { prom[0], prom[1], prom[2], prom[3], prom[4],
+                            prom[5] };
+    for (uint32_t i = 0; i < count; i++) {
+        ms5611_compensate_step(c, d1[i], d2[i], &pressure[i],
+                               &temperature[i]);
+    }
+}
+
+void ms5611_compensate_batch (const struct ms5611_desc_t *inst,
+                              uint32_t count, const uint32_t *d1,
+                              const uint32_t *d2, int32_t *pressure,
+                              int32_t *temperature, ms5611_alt_t *altitude)
+{
+    ms5611_compensate_kernel(inst->prom_values, count, d1, d2, pressure,
+                             temperature);
+    if (altitude == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        altitude[i] = ms5611_calc_altitude(inst, pressure[i]);
+    }
+}
+
+/** One thread's share of a threaded batch */
+struct ms5611_batch_chunk {
+    const struct ms5611_desc_t *inst;
+    uint32_t count;
+    const uint32_t *d1;
+    const uint32_t *d2;
+    int32_t *pressure;
+    int32_t *temperature;
+    ms5611_alt_t *altitude;
+};
+
+static void *ms5611_batch_thread (void *context)
+{
+    const struct ms5611_batch_chunk *const chunk = context;
+    ms5611_compensate_batch(chunk->inst, chunk->count, chunk->d1, chunk->d2,
+                            chunk->pressure, chunk->temperature,
+                            chunk->altitude);
+    return NULL;
+}
+
+void ms5611_compensate_batch_threads (const struct ms5611_desc_t *inst,
+                                      uint32_t count, const uint32_t *d1,
+                                      const uint32_t *d2, int32_t *pressure,
+                                      int32_t *temperature,
+                                      ms5611_alt_t *altitude,
+                                      uint32_t threads)
+{
+    if (threads > MS5611_BATCH_MAX_THREADS) {
+        threads = MS5611_BATCH_MAX_THREADS;
+    } else if (threads == 0) {
+        threads = 1;
+    }
+    // Share of each thread rounded up to whole chunks
+    uint32_t per_thread = (count + threads - 1) / threads;
+    per_thread = ((per_thread + MS5611_BATCH_CHUNK_ALIGN - 1) /
+                  MS5611_BATCH_CHUNK_ALIGN) * MS5611_BATCH_CHUNK_ALIGN;
+    if (per_thread >= count) {
+        ms5611_compensate_batch(inst, count, d1, d2, pressure, temperature,
+                                altitude);
+        return;
+    }
+
+    struct ms5611_batch_chunk chunks[MS5611_BATCH_MAX_THREADS];
+    pthread_t ids[MS5611_BATCH_MAX_THREADS];
+    uint8_t started[MS5611_BATCH_MAX_THREADS];
+    uint32_t n = 0;
+    for (uint32_t start = 0; start < count; start += per_thread, n++) {
+        struct ms5611_batch_chunk *const chunk = &chunks[n];
+        chunk->inst = inst;
+        chunk->count = ((count - start) < per_thread) ? (count - start) :
+                                                        per_thread;
+        chunk->d1 = d1 + start;
+        chunk->d2 = d2 + start;
+        chunk->pressure = pressure + start;
+        chunk->temperature = temperature + start;
+        chunk->altitude = (altitude != NULL) ? (altitude + start) : NULL;
+
+        // The first chunk is done by the calling thread
+        started[n] = ((n != 0) && (pthread_create(&ids[n], NULL,
+                                                  ms5611_batch_thread,
+                                                  chunk) == 0));
+    }
+
+    for (uint32_t i = 0; i < n; i++) {
+        if (!started[i]) {
+            ms5611_batch_thread(&chunks[i]);
+        }
+    }
+    for (uint32_t i = 0; i < n; i++) {
+        if (started[i]) {
+            pthread_join(ids[i], NULL);
+        }
+    }
+}
+#endif
@@ -11,6 +11,58 @@
 #define ms5611_test_h
 
 #include "test-global.h"
+#include "i2c-queue.h"
+#include "timer-wheel.h"
+#include "sensor-bus.h"
+
+/** Exponent used in the barometric formula (1 / 5.255) */
+#define MS5611_ALT_EXPONENT         0.190294957f
+/** Scale height used in the barometric formula in meters */
+#define MS5611_ALT_SCALE            44330.0f
+
+/** Lowest pressure the sensor can measure in Pascals (10 mbar) */
+#define MS5611_MIN_PRESSURE         1000
+/** Highest pressure the sensor can measure in Pascals (1200 mbar) */
+#define MS5611_MAX_PRESSURE         120000
+/** Lowest reference pressure in Pascals (100 mbar). Below about 66 mbar the
+    altitude of the highest pressures the sensor can measure no longer fits in
+    Q16.16, so lower values of p0 are raised to this. */
+#define MS5611_MIN_P0               10000
+
+/** log2 of the lowest power of two covered by the fast altitude table */
+#define MS5611_ALT_TABLE_MIN_OCTAVE 9
+/** Number of octaves of pressure covered by the fast altitude table (512 Pa to
+    131071 Pa) */
+#define MS5611_ALT_TABLE_OCTAVES    8
+/** log2 of the number of linear segments per octave in the fast altitude
+    table */
+#define MS5611_ALT_TABLE_SEG_BITS   7
+
+/** Time beyond two periods without a new reading after which the driver is
+    considered stalled in milliseconds */
+#define MS5611_WATCHDOG_MARGIN      50
+
+/** Most threads used by ms5611_compensate_batch_threads() */
+#define MS5611_BATCH_MAX_THREADS    64
+/** Readings per chunk boundary for threaded batch compensation, keeps each
+    thread's chunk a whole number of vectors and cache lines */
+#define MS5611_BATCH_CHUNK_ALIGN    64
+
+#ifdef FIXED_POINT_ALTITUDE
+/** Altitude in Q16.16 fixed point meters */
+typedef int32_t ms5611_alt_t;
+/** Per octave scale factor for fast altitude calculation in Q17.15 meters */
+typedef uint32_t ms5611_alt_scale_t;
+/** Convert a constant value in meters to an altitude */
+#define MS5611_ALT(m)   ((ms5611_alt_t)((m) * 65536))
+#else
+/** Altitude in meters */
+typedef float ms5611_alt_t;
+/** Per octave scale factor for fast altitude calculation */
+typedef float ms5611_alt_scale_t;
+/** Convert a constant value in meters to an altitude */
+#define MS5611_ALT(m)   ((ms5611_alt_t)(m))
+#endif
 
 enum ms5611_state {
     MS5611_RESET,
@@ -31,6 +83,18 @@ enum ms5611_state {
     MS5611_FAILED
 };
 
+/** Record published for each reading */
+struct ms5611_sample {
+    /** Time of reading */
+    uint32_t time;
+    /** Temperature compensated pressure in Pascals */
+    int32_t pressure;
+    /** Temperature in hundredths of a degree Celsius */
+    int32_t temperature;
+    /** Altitude, only valid if altitude calculation is enabled */
+    ms5611_alt_t altitude;
+};
+
 struct ms5611_desc_t {
     
     /** Time of last reading from sensor */
@@ -40,10 +104,13 @@ struct ms5611_desc_t {
     /** Temperature read from sensor */
     int32_t temperature;
     /** Altitude calculated from sensor */
-    float altitude;
+    ms5611_alt_t altitude;
     
-    /** Pressure used as 0 for altitude calculations */
-    float p0;
+    /** Pressure used as 0 for altitude calculations in Pascals */
+    int32_t p0;
+    /** Per octave scale factors for fast altitude calculation, derived from
+        p0 each time it is set */
+    ms5611_alt_scale_t alt_octave_scale[MS5611_ALT_TABLE_OCTAVES];
     /** Digital pressure value from ADC  */
     uint32_t d1;
     /** Digital tempuratue value from ADC */
@@ -51,16 +118,29 @@ struct ms5611_desc_t {
 
     /** Conversion start time */
     uint32_t conv_start_time;
+    /** Timer for conversion waits and the time until the next reading, the
+        service does not need to be run while it is pending */
+    struct timer_wheel_timer wait_timer;
+    /** Timer wheel on which wait_timer is scheduled */
+    struct timer_wheel *wheel;
     
     /** Time between readings of the sensor */
     uint32_t period;
+    /** Time at which the driver was last restarted by the watchdog, or last
+        seen initializing */
+    uint32_t restart_time;
+    /** Number of times that the driver has been restarted by the watchdog */
+    uint16_t restart_count;
+
+    /** Topic to which each reading is published (may be NULL) */
+    struct sensor_bus_topic *topic;
     
     /** Values read from sensor PROM */
     uint16_t prom_values[6];
     /** I2C address for sensor */
     uint8_t address;
-    /** I2C transaction id */
-    uint8_t t_id;
+    /** Descriptor for transactions on the shared I2C queue */
+    struct i2c_transaction transaction;
     /** Current driver state */
     enum ms5611_state state:4;
     /** Currently waiting for an I2C transaction to complete */
@@ -69,18 +149,27 @@ struct ms5611_desc_t {
     uint8_t calc_altitude:1;
     /** Flag to indicate whether p0 has been initialized */
     uint8_t p0_set:1;
+    /** Flag to indicate whether altitude should be calculated using the lookup
+        table instead of the exact barometric formula */
+    uint8_t fast_altitude:1;
+    /** Flag set by the watchdog when it restarts the driver, the PROM values
+        are kept so MS5611_RESET_WAIT continues with MS5611_IDLE instead of
+        reading them again. Cleared once the driver is back in MS5611_IDLE. */
+    uint8_t restarting:1;
 };
 
 /**
  * Initialize an instance of the MS5611 driver.
  *
  * @param inst Pointer to the instance descriptor to be initialized
+ * @param wheel Timer wheel on which the driver schedules its waits
  * @param csb Non-zero value if CSB pin of sensor is pulled high
  * @param period Period in milliseconds at which the sensor should be polled
  * @param calculate_altitude Whether the altitude value should be calculated
  *                           when the sensor is polled
  */
-extern void init_ms5611 (struct ms5611_desc_t *inst, uint8_t csb,
+extern void init_ms5611 (struct ms5611_desc_t *inst,
+                         struct timer_wheel *wheel, uint8_t csb,
                          uint32_t period, uint8_t calculate_altitude);
 
 
@@ -93,6 +182,167 @@ extern void init_ms5611 (struct ms5611_desc_t *inst, uint8_t csb,
  */
 extern void ms5611_service (struct ms5611_desc_t *inst);
 
+/**
+ * Schedule the wait timer so that the service does not need to be run again
+ * until the given time has passed.
+ *
+ * @param inst The MS5611 driver instance
+ * @param duration Length of the wait in milliseconds
+ */
+extern void ms5611_start_wait (struct ms5611_desc_t *inst, uint32_t duration);
+
+/**
+ * Get whether the driver is waiting for its wait timer to expire.
+ *
+ * @param inst The MS5611 driver instance
+ *
+ * @return Non-zero if the service does not need to be run
+ */
+static inline int ms5611_waiting (const struct ms5611_desc_t *inst)
+{
+    return timer_wheel_pending(&inst->wait_timer);
+}
+
+/**
+ * Set the reference pressure used as 0 for altitude calculations. This also
+ * rebuilds the p0 dependent part of the fast altitude table, so it should be
+ * used instead of writing p0 directly. Pressures below MS5611_MIN_P0 are
+ * raised to it.
+ *
+ * @param inst The MS5611 driver instance
+ * @param p0 The new reference pressure in Pascals
+ *
+ * @return 0 if p0 was set, 1 if it is not a valid pressure (p0 is unchanged)
+ */
+extern int ms5611_set_p0 (struct ms5611_desc_t *inst, int32_t p0);
+
+/**
+ * Calculate altitude relative to p0 using the exact barometric formula.
+ *
+ * h = 44330 * (1 - (p / p0) ^ (1 / 5.255))
+ *
+ * This uses powf even when FIXED_POINT_ALTITUDE is defined, targets without an
+ * FPU should use the fast path, which only needs floating point math when p0
+ * is set. With FIXED_POINT_ALTITUDE the result saturates at the limits of
+ * Q16.16.
+ *
+ * @param p0 The reference pressure in Pascals
+ * @param pressure The pressure in Pascals
+ *
+ * @return The altitude, 0 if p0 is not a valid pressure
+ */
+extern ms5611_alt_t ms5611_calc_altitude_exact (int32_t p0, int32_t pressure);
+
+/**
+ * Calculate altitude relative to p0 using the precomputed lookup table. The
+ * pressure is split into a power of two octave and a mantissa, (p / p0) ^ k is
+ * then the product of a per octave factor (calculated when p0 is set) and
+ * (1 + m) ^ k which is linearly interpolated from a fixed table of 128
+ * segments. Pressures outside of the range of the sensor are clamped.
+ *
+ * When FIXED_POINT_ALTITUDE is defined the calculation is done entirely in
+ * integer arithmetic. Since p0 is at least MS5611_MIN_P0 every altitude fits
+ * in Q16.16 without saturating.
+ *
+ * The maximum error versus the exact barometric formula (evaluated in double
+ * precision) over every pressure from MS5611_MIN_PRESSURE to
+ * MS5611_MAX_PRESSURE is less than 0.065 meters for any p0 from 500 to 1200
+ * mbar and less than 0.09 meters for any p0 from MS5611_MIN_P0 to
+ * MS5611_MAX_PRESSURE, in either build (checked by ms5611-bench.c for every p0
+ * in steps of 1 Pa).
+ *
+ * @param inst The MS5611 driver instance
+ * @param pressure The pressure in Pascals
+ *
+ * @return The altitude
+ */
+extern ms5611_alt_t ms5611_calc_altitude_fast (
+                                            const struct ms5611_desc_t *inst,
+                                            int32_t pressure);
+
+/**
+ * Calculate altitude relative to p0 using whichever method is selected for
+ * this instance.
+ *
+ * @param inst The MS5611 driver instance
+ * @param pressure The pressure in Pascals
+ *
+ * @return The altitude
+ */
+static inline ms5611_alt_t ms5611_calc_altitude (
+                                            const struct ms5611_desc_t *inst,
+                                            int32_t pressure)
+{
+    if (inst->fast_altitude) {
+        return ms5611_calc_altitude_fast(inst, pressure);
+    }
+    return ms5611_calc_altitude_exact(inst->p0, pressure);
+}
+
+/**
+ * Calculate temperature compensated pressure and temperature from raw ADC
+ * values with the first and second order compensation from the datasheet. Used
+ * by the driver after each reading, every intermediate value is 64 bits and
+ * divisions by powers of two are arithmetic shifts.
+ *
+ * @param prom Values read from the sensor PROM (C1 to C6)
+ * @param d1 Digital pressure value from ADC
+ * @param d2 Digital temperature value from ADC
+ * @param pressure Where the pressure in Pascals is stored
+ * @param temperature Where the temperature in hundredths of a degree Celsius
+ *                    is stored
+ */
+extern void ms5611_compensate (const uint16_t prom[6], uint32_t d1,
+                               uint32_t d2, int32_t *pressure,
+                               int32_t *temperature);
+
+#ifdef MS5611_HOST_BATCH
+/**
+ * Recalculate pressure, temperature and optionally altitude for an array of
+ * logged raw ADC values on the host, for example with a corrected p0. The
+ * results are bit identical to ms5611_compensate() and ms5611_calc_altitude()
+ * for the same instance. The compensation is written without branches so that
+ * it vectorizes when built with -O3.
+ *
+ * @param inst Instance giving the PROM values, p0 and altitude method
+ * @param count Number of readings
+ * @param d1 Digital pressure values
+ * @param d2 Digital temperature values
+ * @param pressure Where the pressures in Pascals are stored
+ * @param temperature Where the temperatures are stored
+ * @param altitude Where the altitudes are stored (may be NULL to skip altitude
+ *                 calculation)
+ */
+extern void ms5611_compensate_batch (const struct ms5611_desc_t *inst,
+                                     uint32_t count, const uint32_t *d1,
+                                     const uint32_t *d2, int32_t *pressure,
+                                     int32_t *temperature,
+                                     ms5611_alt_t *altitude);
+
+/**
+ * Same as ms5611_compensate_batch() with the readings split into contiguous
+ * chunks across several threads, for large archives. Link with -pthread. If a
+ * thread cannot be created its chunk is done by the calling thread.
+ *
+ * @param inst Instance giving the PROM values, p0 and altitude method
+ * @param count Number of readings
+ * @param d1 Digital pressure values
+ * @param d2 Digital temperature values
+ * @param pressure Where the pressures in Pascals are stored
+ * @param temperature Where the temperatures are stored
+ * @param altitude Where the altitudes are stored (may be NULL)
+ * @param threads Number of threads to use, at most MS5611_BATCH_MAX_THREADS
+ */
+extern void ms5611_compensate_batch_threads (const struct ms5611_desc_t *inst,
+                                             uint32_t count,
+                                             const uint32_t *d1,
+                                             const uint32_t *d2,
+                                             int32_t *pressure,
+                                             int32_t *temperature,
+                                             ms5611_alt_t *altitude,
+                                             uint32_t threads);
+#endif
+
 /**
  * Get the most recently measured pressure value.
  *
@@ -123,9 +373,10 @@ static inline int32_t ms5611_get_temperature (struct ms5611_desc_t *inst)
  *
  * @param inst The MS5611 driver instance
  *
- * @return The most recently measured altitude in meters
+ * @return The most recently measured altitude in meters (Q16.16 if
+ *         FIXED_POINT_ALTITUDE is defined)
  */
-static inline float ms5611_get_altitude (struct ms5611_desc_t *inst)
+static inline ms5611_alt_t ms5611_get_altitude (struct ms5611_desc_t *inst)
 {
     return inst->altitude;
 }
@@ -142,6 +393,64 @@ static inline uint32_t ms5611_get_last_reading_time (struct ms5611_desc_t *inst)
     return inst->last_reading_time;
 }
 
+/**
+ * Get the time since the most recent reading.
+ *
+ * @param inst The MS5611 driver instance
+ *
+ * @return Age of the most recent reading in milliseconds
+ */
+static inline uint32_t ms5611_data_age (const struct ms5611_desc_t *inst)
+{
+    return (uint32_t)millis - inst->last_reading_time;
+}
+
+/**
+ * Check that the driver is still producing readings and restart it if it is
+ * not. A driver which has gone more than two periods plus
+ * MS5611_WATCHDOG_MARGIN without a reading (for example because an I2C
+ * transaction never completed) has its transaction abandoned and is restarted
+ * from MS5611_RESET without reading the PROM again. Should be called in each
+ * iteration of the main loop, whether or not the driver is waiting.
+ *
+ * @param inst The MS5611 driver instance
+ *
+ * @return Non-zero if the driver was restarted
+ */
+extern int ms5611_watchdog (struct ms5611_desc_t *inst);
+
+/**
+ * Set the topic to which readings are published. The topic's records must be
+ * struct ms5611_sample.
+ *
+ * @param inst The MS5611 driver instance
+ * @param topic The topic, or NULL to stop publishing
+ */
+static inline void ms5611_set_topic (struct ms5611_desc_t *inst,
+                                     struct sensor_bus_topic *topic)
+{
+    inst->topic = topic;
+}
+
+/**
+ * Publish the current reading. Called by the driver after each reading has
+ * been stored.
+ *
+ * @param inst The MS5611 driver instance
+ */
+static inline void ms5611_publish_sample (struct ms5611_desc_t *inst)
+{
+    if (inst->topic == NULL) {
+        return;
+    }
+    struct ms5611_sample *const sample = sensor_bus_claim(inst->topic);
+    sample->time = inst->last_reading_time;
+    sample->pressure = inst->pressure;
+    sample->temperature = inst->temperature;
+    sample->altitude = inst->altitude;
+    sensor_bus_commit(inst->topic);
+}
+
 /**
  * Set the period at which readings are taken.
  *
@@ -155,15 +464,43 @@ static inline void ms5611_set_period (struct ms5611_desc_t *inst,
     inst->period = period;
 }
 
+/**
+ * Get the absolute value of an altitude or difference in altitude.
+ *
+ * @param alt The altitude
+ *
+ * @return The absolute value of alt
+ */
+static inline ms5611_alt_t ms5611_alt_abs (ms5611_alt_t alt)
+{
+    return (alt < 0) ? -alt : alt;
+}
+
+/**
+ * Select whether altitude should be calculated using the lookup table instead
+ * of the exact barometric formula.
+ *
+ * @param inst The MS5611 driver instance
+ * @param fast Non-zero to use the lookup table
+ */
+static inline void ms5611_set_fast_altitude (struct ms5611_desc_t *inst,
+                                             uint8_t fast)
+{
+    inst->fast_altitude = !!fast;
+}
+
 /**
  * Tare altitude calculations by setting the refernce pressure to the last
- * measured pressure.
+ * measured pressure. If there has not been a measurement yet the tare happens
+ * at the next one instead.
  *
  * @param inst The MS5611 driver instance
  */
 static inline void ms5611_tare_now (struct ms5611_desc_t *inst)
 {
-    inst->p0 = ((float)inst->pressure) / 100.0f;
+    if (ms5611_set_p0(inst, inst->pressure) != 0) {
+        inst->p0_set = 0;
+    }
 }
 
 /**
@@ -0,0 +1,92 @@
+/**
+ * @file peer-link.c
+ * @desc Heartbeats between redundant flight computers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "peer-link.h"
+
+#include <string.h>
+
+#include "deployment.h"
+
+void init_peer_link(struct peer_link *link, uint8_t board, uint32_t period,
+                    uint32_t timeout)
+{
+    memset(link, 0, sizeof(*link));
+    link->board = board;
+    link->period = period;
+    link->timeout = timeout;
+    // The first heartbeat is due straight away
+    link->sent_time = (uint32_t)millis - period;
+}
+
+int peer_link_heartbeat(struct peer_link *link,
+                        const struct deployment_service_desc_t *deployment,
+                        struct peer_heartbeat *heartbeat)
+{
+    if (((uint32_t)millis - link->sent_time) < link->period) {
+        return 0;
+    }
+    link->sent_time = (uint32_t)millis;
+
+    heartbeat->time = (uint32_t)millis;
+    heartbeat->altitude = deployment->last_altitude;
+    heartbeat->pyro_fired = deployment->pyro_fired;
+    heartbeat->seq = link->seq++;
+    heartbeat->board = link->board;
+    heartbeat->state = (uint8_t)deployment->state;
+    heartbeat->reserved[0] = 0;
+    heartbeat->reserved[1] = 0;
+    return 1;
+}
+
+void peer_link_receive(struct peer_link *link,
+                       const struct peer_heartbeat *heartbeat)
+{
+    if ((heartbeat->board >= PEER_LINK_MAX_BOARDS) ||
+            (heartbeat->board == link->board)) {
+        return;
+    }
+    struct peer_link_peer *const peer = &link->peers[heartbeat->board];
+
+    // A peer which was silent may have restarted and counts from zero again
+    if (peer->heard && !peer->silent) {
+        const int16_t gap = (int16_t)(heartbeat->seq - peer->last.seq);
+        if (gap <= 0) {
+            peer->stale++;
+            return;
+        }
+        peer->missed += (uint32_t)(gap - 1);
+    }
+    if (peer->heard) {
+        const uint32_t dt = (uint32_t)millis - peer->receive_time;
+        peer->gap_max = (dt > peer->gap_max) ? dt : peer->gap_max;
+    }
+
+    peer->last = *heartbeat;
+    peer->receive_time = (uint32_t)millis;
+    // Fired events are never forgotten, a peer which has restarted would
+    // otherwise clear them
+    peer->pyro_fired |= heartbeat->pyro_fired;
+    peer->received++;
+    peer->heard = 1;
+    peer->silent = 0;
+}
+
+void peer_link_service(struct peer_link *link)
+{
+    for (uint8_t i = 0; i < PEER_LINK_MAX_BOARDS; i++) {
+        struct peer_link_peer *const peer = &link->peers[i];
+        if (!peer->heard || peer->silent) {
+            continue;
+        }
+        if (((uint32_t)millis - peer->receive_time) > link->timeout) {
+            peer->silent = 1;
+            peer->timeouts++;
+        }
+    }
+}
@@ -0,0 +1,151 @@
+/**
+ * @file peer-link.h
+ * @desc Heartbeats between redundant flight computers
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef peer_link_h
+#define peer_link_h
+
+#include "test-global.h"
+#include "ms5611-test.h"
+
+/** Largest number of flight computers which exchange heartbeats */
+#ifndef PEER_LINK_MAX_BOARDS
+#define PEER_LINK_MAX_BOARDS    4
+#endif
+
+struct deployment_service_desc_t;
+
+/** Heartbeat sent by each flight computer to the others */
+struct peer_heartbeat {
+    /** Time at which the heartbeat was sent, by the sender's clock */
+    uint32_t time;
+    /** Sender's most recent altitude */
+    ms5611_alt_t altitude;
+    /** Sender's pyro events which have fired */
+    uint16_t pyro_fired;
+    /** Sequence number, incremented with each heartbeat from the sender */
+    uint16_t seq;
+    /** Sender's board number */
+    uint8_t board;
+    /** Sender's deployment state */
+    uint8_t state;
+    uint8_t reserved[2];
+};
+
+/** What is known of one other flight computer */
+struct peer_link_peer {
+    /** Most recent heartbeat received */
+    struct peer_heartbeat last;
+    /** Time at which the most recent heartbeat was received */
+    uint32_t receive_time;
+    /** Pyro events which the peer has reported firing, kept even after the
+        peer falls silent */
+    uint16_t pyro_fired;
+
+    /** Number of heartbeats received */
+    uint32_t received;
+    /** Number of heartbeats missed, from gaps in sequence numbers */
+    uint32_t missed;
+    /** Number of heartbeats which arrived after a newer one and were
+        ignored */
+    uint32_t stale;
+    /** Number of times the peer fell silent for longer than the timeout */
+    uint32_t timeouts;
+    /** Longest time between heartbeats in milliseconds */
+    uint32_t gap_max;
+
+    /** Flag set once a heartbeat has been received */
+    uint8_t heard:1;
+    /** Flag set while the peer is silent for longer than the timeout */
+    uint8_t silent:1;
+};
+
+/**
+ *  Heartbeat exchange with the other flight computers on the same rocket. Each
+ *  board sends its deployment state, altitude and fired pyro events every
+ *  period and keeps the most recent heartbeat from each of the others, so
+ *  that pyro events can depend on what the other boards have done (see
+ *  DEPLOYMENT_PYRO_PEER_NOT_FIRED). The transport is not part of the link,
+ *  heartbeats are handed to and taken from whatever carries them.
+ */
+struct peer_link {
+    /** Number of this board */
+    uint8_t board;
+    /** Sequence number of the next heartbeat */
+    uint16_t seq;
+    /** Time between heartbeats in milliseconds */
+    uint32_t period;
+    /** A peer which has not been heard from for this long is silent in
+        milliseconds */
+    uint32_t timeout;
+    /** Time at which the last heartbeat was sent */
+    uint32_t sent_time;
+
+    struct peer_link_peer peers[PEER_LINK_MAX_BOARDS];
+};
+
+/**
+ *  Initialize a peer link.
+ *
+ *  @param link The link to initialize
+ *  @param board Number of this board (less than PEER_LINK_MAX_BOARDS)
+ *  @param period Time between heartbeats in milliseconds
+ *  @param timeout Time after which a peer which has not been heard from is
+ *                 silent in milliseconds
+ */
+extern void init_peer_link(struct peer_link *link, uint8_t board,
+                           uint32_t period, uint32_t timeout);
+
+/**
+ *  Build a heartbeat if one is due.
+ *
+ *  @param link The link
+ *  @param deployment Deployment service whose status is sent
+ *  @param heartbeat Heartbeat to fill in
+ *
+ *  @return 1 if a heartbeat is due and has been filled in, 0 otherwise
+ */
+extern int peer_link_heartbeat(
+                        struct peer_link *link,
+                        const struct deployment_service_desc_t *deployment,
+                        struct peer_heartbeat *heartbeat);
+
+/**
+ *  Take a heartbeat received from another board.
+ *
+ *  @param link The link
+ *  @param heartbeat The heartbeat
+ */
+extern void peer_link_receive(struct peer_link *link,
+                              const struct peer_heartbeat *heartbeat);
+
+/**
+ *  Check for peers which have fallen silent, should be called in each
+ *  iteration of the main loop.
+ *
+ *  @param link The link
+ */
+extern void peer_link_service(struct peer_link *link);
+
+/**
+ *  Get the pyro events which any other board has reported firing.
+ *
+ *  @param link The link
+ *
+ *  @return One bit per pyro event
+ */
+static inline uint16_t peer_link_fired(const struct peer_link *link)
+{
+    uint16_t fired = 0;
+    for (uint8_t i = 0; i < PEER_LINK_MAX_BOARDS; i++) {
+        fired |= link->peers[i].pyro_fired;
+    }
+    return fired;
+}
+
+#endif /* peer_link_h */
@@ -0,0 +1,289 @@
+/**
+ * @file pt-bench.c
+ * @desc Compares a protothread against a bitfield state machine on a host
+ *       model of the MPU9250 FIFO read loop
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef PT_BENCH_MAIN
+
+#include "pt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ *  The body of mpu9250_service() is not part of this tree, so both versions
+ *  model the loop it runs in FIFO driven operation: wait for the sample
+ *  interrupt, read the FIFO count, read the samples and then read the
+ *  magnetometer, each transaction waiting for the bus before moving on. The
+ *  state machine is written the way the driver's is, one state per call with
+ *  the state to return to after a transaction kept in next_state. Build with
+ *  PT_USE_SWITCH to measure the switch based protothreads.
+ */
+
+/** Transactions made by the modelled read loop */
+enum pt_bench_cmd {
+    PT_BENCH_CMD_COUNT = 1,
+    PT_BENCH_CMD_READ,
+    PT_BENCH_CMD_MAG
+};
+
+/** Interrupt line and bus seen by both versions */
+struct pt_bench_env {
+    uint32_t rng;
+    /** Number of service calls until the transaction in progress completes */
+    uint8_t busy;
+    uint8_t in_progress:1;
+    uint8_t irq:1;
+
+    /** Number of passes through the read loop completed */
+    uint32_t samples;
+    /** Hash of the transactions started, in order */
+    uint32_t log;
+    /** Hash at the end of the most recent pass through the read loop, the
+        protothread may start the next pass in the same call */
+    uint32_t pass_log;
+};
+
+static inline uint32_t pt_bench_random(struct pt_bench_env *env)
+{
+    uint32_t x = env->rng;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    env->rng = x;
+    return x;
+}
+
+/**
+ *  Advance the model by one main loop pass. A transaction completes up to
+ *  three passes after it is started and the interrupt is raised at random.
+ */
+static inline void pt_bench_tick(struct pt_bench_env *env)
+{
+    const uint32_t x = pt_bench_random(env);
+    if (env->in_progress) {
+        if (env->busy == 0) {
+            env->in_progress = 0;
+        } else {
+            env->busy--;
+        }
+    }
+    if ((x >> 24) < 32) {
+        env->irq = 1;
+    }
+}
+
+static inline void pt_bench_start(struct pt_bench_env *env,
+                                  enum pt_bench_cmd cmd)
+{
+    env->busy = (uint8_t)(pt_bench_random(env) & 3);
+    env->in_progress = 1;
+    env->log = (env->log * 31) + (uint32_t)cmd;
+}
+
+static inline void pt_bench_end_pass(struct pt_bench_env *env)
+{
+    env->samples++;
+    env->pass_log = env->log;
+}
+
+enum pt_bench_state {
+    PT_BENCH_WAIT,
+    PT_BENCH_READ_COUNT,
+    PT_BENCH_READ_SAMPLES,
+    PT_BENCH_READ_MAG,
+    PT_BENCH_CMD_WAIT
+};
+
+struct pt_bench_fsm {
+    enum pt_bench_state state:4;
+    /** State to enter once the transaction in progress completes */
+    enum pt_bench_state next_state:4;
+    uint8_t mag:1;
+};
+
+__attribute__((noinline))
+static void pt_bench_fsm_service(struct pt_bench_fsm *inst,
+                                 struct pt_bench_env *env)
+{
+    switch (inst->state) {
+        case PT_BENCH_WAIT:
+            if (env->irq) {
+                env->irq = 0;
+                inst->state = PT_BENCH_READ_COUNT;
+            }
+            break;
+        case PT_BENCH_READ_COUNT:
+            pt_bench_start(env, PT_BENCH_CMD_COUNT);
+            inst->next_state = PT_BENCH_READ_SAMPLES;
+            inst->state = PT_BENCH_CMD_WAIT;
+            break;
+        case PT_BENCH_READ_SAMPLES:
+            pt_bench_start(env, PT_BENCH_CMD_READ);
+            inst->next_state = (inst->mag ? PT_BENCH_READ_MAG :
+                                            PT_BENCH_WAIT);
+            inst->state = PT_BENCH_CMD_WAIT;
+            break;
+        case PT_BENCH_READ_MAG:
+            pt_bench_start(env, PT_BENCH_CMD_MAG);
+            inst->next_state = PT_BENCH_WAIT;
+            inst->state = PT_BENCH_CMD_WAIT;
+            break;
+        case PT_BENCH_CMD_WAIT:
+            if (!env->in_progress) {
+                if (inst->next_state == PT_BENCH_WAIT) {
+                    pt_bench_end_pass(env);
+                }
+                inst->state = inst->next_state;
+            }
+            break;
+    }
+}
+
+struct pt_bench_thread {
+    struct pt pt;
+    /** Protothread for the transaction in progress */
+    struct pt cmd;
+    uint8_t mag:1;
+};
+
+static enum pt_status pt_bench_cmd(struct pt *pt, struct pt_bench_env *env,
+                                   enum pt_bench_cmd cmd)
+{
+    PT_BEGIN(pt);
+    pt_bench_start(env, cmd);
+    PT_WAIT_UNTIL(pt, !env->in_progress);
+    PT_END(pt);
+}
+
+__attribute__((noinline))
+static enum pt_status pt_bench_thread_service(struct pt_bench_thread *inst,
+                                              struct pt_bench_env *env)
+{
+    PT_BEGIN(&inst->pt);
+    for (;;) {
+        PT_WAIT_UNTIL(&inst->pt, env->irq);
+        env->irq = 0;
+        PT_SPAWN(&inst->pt, &inst->cmd,
+                 pt_bench_cmd(&inst->cmd, env, PT_BENCH_CMD_COUNT));
+        PT_SPAWN(&inst->pt, &inst->cmd,
+                 pt_bench_cmd(&inst->cmd, env, PT_BENCH_CMD_READ));
+        if (inst->mag) {
+            PT_SPAWN(&inst->pt, &inst->cmd,
+                     pt_bench_cmd(&inst->cmd, env, PT_BENCH_CMD_MAG));
+        }
+        pt_bench_end_pass(env);
+    }
+    PT_END(&inst->pt);
+}
+
+/** Result of running one version until it has read a number of samples */
+struct pt_bench_result {
+    double ns;
+    uint32_t calls;
+    uint32_t log;
+};
+
+static double pt_bench_elapsed(const struct timespec *start,
+                               const struct timespec *end)
+{
+    return (((double)(end->tv_sec - start->tv_sec) * 1e9) +
+            (double)(end->tv_nsec - start->tv_nsec));
+}
+
+static void pt_bench_run_fsm(uint32_t samples, uint32_t seed,
+                             struct pt_bench_result *result)
+{
+    struct pt_bench_env env = { .rng = seed };
+    struct pt_bench_fsm inst = { .state = PT_BENCH_WAIT, .mag = 1 };
+    struct timespec start, end;
+
+    result->calls = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (env.samples < samples) {
+        pt_bench_tick(&env);
+        pt_bench_fsm_service(&inst, &env);
+        result->calls++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result->ns = pt_bench_elapsed(&start, &end);
+    result->log = env.pass_log;
+}
+
+static void pt_bench_run_thread(uint32_t samples, uint32_t seed,
+                                struct pt_bench_result *result)
+{
+    struct pt_bench_env env = { .rng = seed };
+    struct pt_bench_thread inst = { .mag = 1 };
+    struct timespec start, end;
+
+    PT_INIT(&inst.pt);
+    result->calls = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (env.samples < samples) {
+        pt_bench_tick(&env);
+        pt_bench_thread_service(&inst, &env);
+        result->calls++;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    result->ns = pt_bench_elapsed(&start, &end);
+    result->log = env.pass_log;
+}
+
+int main(int argc, char **argv)
+{
+    uint32_t samples = 10000000;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "n:s:")) != -1) {
+        switch (opt) {
+            case 'n':
+                samples = (uint32_t)strtoul(optarg, NULL, 10);
+                samples = (samples == 0) ? 1 : samples;
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                seed = (seed == 0) ? 1 : seed;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-n samples] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    struct pt_bench_result fsm, thread;
+    pt_bench_run_fsm(samples, seed, &fsm);
+    pt_bench_run_thread(samples, seed, &thread);
+
+#ifdef PT_USE_LABELS
+    const char *const mode = "label";
+#else
+    const char *const mode = "switch";
+#endif
+    printf("%u sample reads, %s protothreads\n", (unsigned)samples, mode);
+    printf("  %12s %10s %12s %12s %8s\n", "", "calls", "ns/call", "ns/sample",
+           "bytes");
+    printf("  %12s %10u %12.2f %12.2f %8zu\n", "state machine",
+           (unsigned)fsm.calls, fsm.ns / fsm.calls, fsm.ns / samples,
+           sizeof(struct pt_bench_fsm));
+    printf("  %12s %10u %12.2f %12.2f %8zu\n", "protothread",
+           (unsigned)thread.calls, thread.ns / thread.calls,
+           thread.ns / samples, sizeof(struct pt_bench_thread));
+
+    if (fsm.log != thread.log) {
+        fprintf(stderr, "the versions made different transactions\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
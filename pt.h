@@ -0,0 +1,210 @@
+/**
+ * @file pt.h
+ * @desc Stackless coroutines (protothreads) for driver sequencing
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef pt_h
+#define pt_h
+
+#include "test-global.h"
+#include <stddef.h>
+
+/*
+ *  A protothread is a function which can block part way through and resume
+ *  from the same point the next time that it is called. The only state kept
+ *  between calls is the resume point in a struct pt, so local variables do not
+ *  survive a wait or yield and anything which must be kept should be stored in
+ *  the driver's descriptor.
+ *
+ *  With GCC or Clang the resume point is a label address and resuming costs a
+ *  single indirect jump. Other compilers, or any build with PT_USE_SWITCH
+ *  defined, use a switch on the line number instead. For that to work each
+ *  blocking PT_* macro must be on a line of its own and a protothread must not
+ *  contain a switch statement of its own around a blocking macro.
+ *
+ *  Example:
+ *
+ *      static enum pt_status read_sequence(struct pt *pt, struct dev *inst)
+ *      {
+ *          PT_BEGIN(pt);
+ *          start_transaction(inst);
+ *          PT_WAIT_UNTIL(pt, transaction_done(inst));
+ *          PT_END(pt);
+ *      }
+ */
+
+#if defined(__GNUC__) && !defined(PT_USE_SWITCH)
+#define PT_USE_LABELS
+#endif
+
+/** Result of running a protothread */
+enum pt_status {
+    /** Blocked waiting for a condition */
+    PT_WAITING = 0,
+    /** Gave up the processor voluntarily, can be called again immediately */
+    PT_YIELDED,
+    /** Ran to completion or exited, will start over if called again */
+    PT_EXITED
+};
+
+/** Resume point of a protothread */
+struct pt {
+#ifdef PT_USE_LABELS
+    /** Address of the label to resume at, NULL to start from the beginning */
+    void *lc;
+#else
+    /** Line number to resume at, 0 to start from the beginning */
+    uint16_t lc;
+#endif
+};
+
+#ifdef PT_USE_LABELS
+#define PT_CONCAT2(a, b) a ## b
+#define PT_CONCAT(a, b) PT_CONCAT2(a, b)
+
+#define PT_LC_INIT(pt) (pt)->lc = NULL
+#define PT_LC_RESUME(pt) do { \
+    if ((pt)->lc != NULL) { \
+        goto *(pt)->lc; \
+    } \
+} while (0)
+/* GCC mistakes label addresses for addresses of locals (-Wdangling-pointer) */
+#define PT_LC_SET_LABEL(pt, label) do { \
+    label: \
+    _Pragma("GCC diagnostic push") \
+    _Pragma("GCC diagnostic ignored \"-Wpragmas\"") \
+    _Pragma("GCC diagnostic ignored \"-Wdangling-pointer\"") \
+    (pt)->lc = &&label; \
+    _Pragma("GCC diagnostic pop") \
+} while (0)
+#define PT_LC_SET(pt) PT_LC_SET_LABEL(pt, PT_CONCAT(pt_label_, __COUNTER__))
+#define PT_LC_END(pt)
+#else
+#if defined(__GNUC__) && (__GNUC__ >= 7)
+#define PT_FALLTHROUGH __attribute__((fallthrough));
+#else
+#define PT_FALLTHROUGH
+#endif
+#define PT_LC_INIT(pt) (pt)->lc = 0
+#define PT_LC_RESUME(pt) switch ((pt)->lc) { case 0:
+#define PT_LC_SET(pt) (pt)->lc = __LINE__; PT_FALLTHROUGH case __LINE__:
+#define PT_LC_END(pt) }
+#endif
+
+/**
+ *  Initialize a protothread so that it starts from the beginning the next time
+ *  it is run.
+ *
+ *  @param pt The protothread
+ */
+#define PT_INIT(pt) PT_LC_INIT(pt)
+
+/**
+ *  Start of a protothread body, must be the first statement in the function.
+ *
+ *  @param pt The protothread
+ */
+#define PT_BEGIN(pt) { \
+    char pt_yield_flag = 1; \
+    (void)pt_yield_flag; \
+    PT_LC_RESUME(pt)
+
+/**
+ *  End of a protothread body, must be the last statement in the function.
+ *
+ *  @param pt The protothread
+ */
+#define PT_END(pt) \
+    PT_LC_END(pt); \
+    PT_INIT(pt); \
+    return PT_EXITED; \
+}
+
+/**
+ *  Block until a condition is true. The condition is checked right away and
+ *  then each time that the protothread is run.
+ *
+ *  @param pt The protothread
+ *  @param condition Expression to wait for
+ */
+#define PT_WAIT_UNTIL(pt, condition) do { \
+    PT_LC_SET(pt); \
+    if (!(condition)) { \
+        return PT_WAITING; \
+    } \
+} while (0)
+
+/**
+ *  Block while a condition is true.
+ *
+ *  @param pt The protothread
+ *  @param condition Expression to wait on
+ */
+#define PT_WAIT_WHILE(pt, condition) PT_WAIT_UNTIL((pt), !(condition))
+
+/**
+ *  Give up the processor once, resuming after this statement the next time
+ *  that the protothread is run.
+ *
+ *  @param pt The protothread
+ */
+#define PT_YIELD(pt) do { \
+    pt_yield_flag = 0; \
+    PT_LC_SET(pt); \
+    if (pt_yield_flag == 0) { \
+        return PT_YIELDED; \
+    } \
+} while (0)
+
+/**
+ *  Give up the processor at least once and then until a condition is true.
+ *
+ *  @param pt The protothread
+ *  @param condition Expression to wait for
+ */
+#define PT_YIELD_UNTIL(pt, condition) do { \
+    pt_yield_flag = 0; \
+    PT_LC_SET(pt); \
+    if ((pt_yield_flag == 0) || !(condition)) { \
+        return PT_YIELDED; \
+    } \
+} while (0)
+
+/**
+ *  Run a child protothread to completion, blocking this one until the child
+ *  exits. Replaces sub-sequences which return to a saved next state.
+ *
+ *  @param pt The protothread
+ *  @param child The child's struct pt
+ *  @param thread Call which runs the child, e.g. child_thread(child, inst)
+ */
+#define PT_SPAWN(pt, child, thread) do { \
+    PT_INIT(child); \
+    PT_WAIT_UNTIL((pt), (thread) == PT_EXITED); \
+} while (0)
+
+/**
+ *  Exit the protothread. It will start from the beginning if it is run again.
+ *
+ *  @param pt The protothread
+ */
+#define PT_EXIT(pt) do { \
+    PT_INIT(pt); \
+    return PT_EXITED; \
+} while (0)
+
+/**
+ *  Start the protothread over from the beginning the next time that it is run.
+ *
+ *  @param pt The protothread
+ */
+#define PT_RESTART(pt) do { \
+    PT_INIT(pt); \
+    return PT_WAITING; \
+} while (0)
+
+#endif /* pt_h */
@@ -0,0 +1,112 @@
+/**
+ * @file running-stats.h
+ * @desc Constant memory running mean and variance in integer arithmetic
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef running_stats_h
+#define running_stats_h
+
+#include "test-global.h"
+
+/**
+ *  Mean and variance of a stream of integer values, updated one value at a
+ *  time without keeping the values. Sums are taken of the differences from the
+ *  first value, which like Welford's update keeps the result accurate when the
+ *  variance is small compared to the mean, as it is for an altitude which
+ *  barely changes, and in integers is exact. Each value costs one 32 by 32 bit
+ *  multiply and no divisions.
+ *
+ *  Every value must differ from the first by less than 2^32.
+ */
+struct running_stats {
+    /** First value, the sums are of differences from it */
+    int64_t first;
+    /** Sum of the differences from the first value */
+    int64_t sum;
+    /** Sum of the squared differences from the first value, held at
+        UINT64_MAX if it overflows */
+    uint64_t sum_sq;
+    /** Number of values so far */
+    uint32_t count;
+};
+
+/**
+ *  Discard all values.
+ *
+ *  @param stats The statistics
+ */
+static inline void running_stats_reset(struct running_stats *stats)
+{
+    stats->first = 0;
+    stats->sum = 0;
+    stats->sum_sq = 0;
+    stats->count = 0;
+}
+
+/**
+ *  Add a value.
+ *
+ *  @param stats The statistics
+ *  @param value The value
+ */
+static inline void running_stats_add(struct running_stats *stats,
+                                     int64_t value)
+{
+    if (stats->count == 0) {
+        stats->first = value;
+    }
+    const int64_t delta = value - stats->first;
+    const uint32_t magnitude = (uint32_t)((delta < 0) ? -delta : delta);
+    const uint64_t sq = (uint64_t)magnitude * magnitude;
+
+    stats->count++;
+    stats->sum += delta;
+    stats->sum_sq = ((stats->sum_sq + sq) < sq) ? UINT64_MAX :
+                                                  (stats->sum_sq + sq);
+}
+
+/**
+ *  Get the mean of the values.
+ *
+ *  @param stats The statistics
+ *
+ *  @return The mean rounded towards the first value, 0 if there are no values
+ */
+static inline int64_t running_stats_mean(const struct running_stats *stats)
+{
+    return (stats->count == 0) ? 0 : (stats->first +
+                                      (stats->sum / (int64_t)stats->count));
+}
+
+/**
+ *  Get the sample variance of the values.
+ *
+ *  @param stats The statistics
+ *
+ *  @return The variance rounded down, 0 if there are fewer than two values and
+ *          UINT64_MAX if it is too large to be calculated
+ */
+static inline uint64_t running_stats_variance(
+                                        const struct running_stats *stats)
+{
+    if (stats->count < 2) {
+        return 0;
+    }
+
+    const uint64_t n = stats->count;
+    uint64_t n_sum_sq;
+    if ((stats->sum_sq == UINT64_MAX) ||
+            __builtin_mul_overflow(n, stats->sum_sq, &n_sum_sq)) {
+        return UINT64_MAX;
+    }
+    // sum^2 <= n * sum_sq, so neither this nor the difference overflows
+    const uint64_t sum = (uint64_t)((stats->sum < 0) ? -stats->sum :
+                                                       stats->sum);
+    return (n_sum_sq - (sum * sum)) / (n * (n - 1));
+}
+
+#endif /* running_stats_h */
@@ -0,0 +1,250 @@
+/**
+ * @file sensor-align.c
+ * @desc Aligns barometer and IMU samples onto a common timeline
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "sensor-align.h"
+
+#define ALIGN_MASK  (SENSOR_ALIGN_DEPTH - 1)
+
+#if (SENSOR_ALIGN_DEPTH & ALIGN_MASK) != 0
+#error SENSOR_ALIGN_DEPTH must be a power of two
+#endif
+
+void init_sensor_align(struct sensor_align_desc_t *inst, uint16_t period,
+                       int16_t baro_offset, int16_t imu_offset)
+{
+    inst->start_time = 0;
+    inst->period = period;
+    inst->baro_offset = baro_offset;
+    inst->imu_offset = imu_offset;
+    inst->baro_count = 0;
+    inst->imu_count = 0;
+    inst->out_count = 0;
+    inst->read_count = 0;
+    inst->overruns = 0;
+    inst->have_baro = 0;
+    inst->have_imu = 0;
+}
+
+static inline uint32_t point_time(const struct sensor_align_desc_t *inst,
+                                  uint32_t k)
+{
+    return inst->start_time + (k * inst->period);
+}
+
+static inline ms5611_alt_t interp_alt(ms5611_alt_t a0, ms5611_alt_t a1,
+                                      uint32_t dt, uint32_t span)
+{
+#ifdef FIXED_POINT_ALTITUDE
+    return a0 + (ms5611_alt_t)(((int64_t)(a1 - a0) * dt) / span);
+#else
+    return a0 + (((a1 - a0) * (float)dt) / (float)span);
+#endif
+}
+
+static inline int16_t interp_i16(int16_t v0, int16_t v1, uint32_t dt,
+                                 uint32_t span)
+{
+    return (int16_t)(v0 + (((int32_t)(v1 - v0) * (int32_t)dt) /
+                           (int32_t)span));
+}
+
+/**
+ *  Start the timeline once both streams have a sample, at the first period
+ *  boundary which both samples come before.
+ */
+static void try_start(struct sensor_align_desc_t *inst)
+{
+    if (!inst->have_baro || !inst->have_imu || (inst->period == 0)) {
+        return;
+    }
+
+    const uint32_t latest = ((int32_t)(inst->last_baro.time -
+                                       inst->last_imu.time) > 0) ?
+                                inst->last_baro.time : inst->last_imu.time;
+    inst->start_time = (((latest + inst->period - 1) / inst->period) *
+                        inst->period);
+}
+
+/**
+ *  Produce output samples for every point that both streams have filled.
+ *  Points more than SENSOR_ALIGN_DEPTH behind the leading stream have been
+ *  overwritten in its buffer and at most SENSOR_ALIGN_DEPTH outputs fit in the
+ *  output buffer, so after a stall older points are dropped, along with any
+ *  unread output, instead of being produced and overwritten. This bounds the
+ *  work done per push.
+ */
+static void emit(struct sensor_align_desc_t *inst)
+{
+    const int lead_baro = ((int32_t)(inst->baro_count - inst->imu_count) > 0);
+    const uint32_t ready = lead_baro ? inst->imu_count : inst->baro_count;
+    const uint32_t lead = lead_baro ? inst->baro_count : inst->imu_count;
+
+    const uint32_t first = lead - SENSOR_ALIGN_DEPTH;
+    if (((int32_t)(first - inst->out_count) > 0) &&
+            ((int32_t)(ready - first) > 0)) {
+        inst->overruns += first - inst->read_count;
+        inst->out_count = first;
+        inst->read_count = first;
+    }
+
+    while ((int32_t)(ready - inst->out_count) > 0) {
+        const uint32_t k = inst->out_count;
+        struct sensor_align_sample *const s = &inst->out[k & ALIGN_MASK];
+        s->time = point_time(inst, k);
+        s->altitude = inst->baro_points[k & ALIGN_MASK];
+        s->accel[0] = inst->imu_points[k & ALIGN_MASK][0];
+        s->accel[1] = inst->imu_points[k & ALIGN_MASK][1];
+        s->accel[2] = inst->imu_points[k & ALIGN_MASK][2];
+        inst->out_count++;
+    }
+
+    if ((inst->out_count - inst->read_count) > SENSOR_ALIGN_DEPTH) {
+        inst->overruns += (inst->out_count - inst->read_count -
+                           SENSOR_ALIGN_DEPTH);
+        inst->read_count = inst->out_count - SENSOR_ALIGN_DEPTH;
+    }
+}
+
+/**
+ *  Hold the last value of the barometer stream if it falls so far behind that
+ *  the IMU stream would overwrite points which have not been output yet (or the
+ *  other way around). This bounds buffering if a sensor stalls. Only the points
+ *  which are still in the buffer are filled, so the work is bounded too.
+ */
+static void hold_lagging(struct sensor_align_desc_t *inst)
+{
+    if ((int32_t)(inst->imu_count - inst->baro_count) >= SENSOR_ALIGN_DEPTH) {
+        const uint32_t held = inst->imu_count - (SENSOR_ALIGN_DEPTH - 1);
+        uint32_t k = held - SENSOR_ALIGN_DEPTH;
+        if ((int32_t)(k - inst->baro_count) < 0) {
+            k = inst->baro_count;
+        }
+        for (; k != held; k++) {
+            inst->baro_points[k & ALIGN_MASK] = inst->last_baro.altitude;
+        }
+        inst->baro_count = held;
+    }
+    if ((int32_t)(inst->baro_count - inst->imu_count) >= SENSOR_ALIGN_DEPTH) {
+        const uint32_t held = inst->baro_count - (SENSOR_ALIGN_DEPTH - 1);
+        uint32_t k = held - SENSOR_ALIGN_DEPTH;
+        if ((int32_t)(k - inst->imu_count) < 0) {
+            k = inst->imu_count;
+        }
+        for (; k != held; k++) {
+            int16_t *const p = inst->imu_points[k & ALIGN_MASK];
+            p[0] = inst->last_imu.accel[0];
+            p[1] = inst->last_imu.accel[1];
+            p[2] = inst->last_imu.accel[2];
+        }
+        inst->imu_count = held;
+    }
+}
+
+void sensor_align_push_baro(struct sensor_align_desc_t *inst, uint32_t time,
+                            ms5611_alt_t altitude)
+{
+    time += (uint32_t)(int32_t)inst->baro_offset;
+
+    if (inst->have_baro && inst->have_imu) {
+        const struct sensor_align_baro_point *const last = &inst->last_baro;
+        const uint32_t span = time - last->time;
+
+        // Skip points in a gap longer than the buffer, they would be
+        // overwritten before being output anyway
+        if ((int32_t)(time - point_time(inst, inst->baro_count)) >=
+                (int32_t)(SENSOR_ALIGN_DEPTH * inst->period)) {
+            inst->baro_count = (((time - inst->start_time) / inst->period) + 1 -
+                        SENSOR_ALIGN_DEPTH);
+        }
+
+        for (;;) {
+            const uint32_t t = point_time(inst, inst->baro_count);
+            if ((int32_t)(time - t) < 0) {
+                break;
+            }
+            const uint32_t dt = ((int32_t)(t - last->time) > 0) ?
+                                    (t - last->time) : 0;
+            inst->baro_points[inst->baro_count & ALIGN_MASK] =
+                        (span == 0) ? altitude :
+                                      interp_alt(last->altitude, altitude, dt,
+                                                 span);
+            inst->baro_count++;
+        }
+    }
+
+    inst->last_baro.time = time;
+    inst->last_baro.altitude = altitude;
+    if (!inst->have_baro) {
+        inst->have_baro = 1;
+        try_start(inst);
+    }
+
+    hold_lagging(inst);
+    emit(inst);
+}
+
+void sensor_align_push_imu(struct sensor_align_desc_t *inst, uint32_t time,
+                           int16_t x, int16_t y, int16_t z)
+{
+    time += (uint32_t)(int32_t)inst->imu_offset;
+
+    if (inst->have_baro && inst->have_imu) {
+        const struct sensor_align_imu_point *const last = &inst->last_imu;
+        const uint32_t span = time - last->time;
+
+        // Skip points in a gap longer than the buffer, they would be
+        // overwritten before being output anyway
+        if ((int32_t)(time - point_time(inst, inst->imu_count)) >=
+                (int32_t)(SENSOR_ALIGN_DEPTH * inst->period)) {
+            inst->imu_count = (((time - inst->start_time) / inst->period) + 1 -
+                        SENSOR_ALIGN_DEPTH);
+        }
+
+        for (;;) {
+            const uint32_t t = point_time(inst, inst->imu_count);
+            if ((int32_t)(time - t) < 0) {
+                break;
+            }
+            const uint32_t dt = ((int32_t)(t - last->time) > 0) ?
+                                    (t - last->time) : 0;
+            int16_t *const p = inst->imu_points[inst->imu_count & ALIGN_MASK];
+            if (span == 0) {
+                p[0] = x;
+                p[1] = y;
+                p[2] = z;
+            } else {
+                p[0] = interp_i16(last->accel[0], x, dt, span);
+                p[1] = interp_i16(last->accel[1], y, dt, span);
+                p[2] = interp_i16(last->accel[2], z, dt, span);
+            }
+            inst->imu_count++;
+        }
+    }
+
+    inst->last_imu.time = time;
+    inst->last_imu.accel[0] = x;
+    inst->last_imu.accel[1] = y;
+    inst->last_imu.accel[2] = z;
+    if (!inst->have_imu) {
+        inst->have_imu = 1;
+        try_start(inst);
+    }
+
+    hold_lagging(inst);
+    emit(inst);
+}
+
+const struct sensor_align_sample *sensor_align_read(
+                                            struct sensor_align_desc_t *inst)
+{
+    if (inst->read_count == inst->out_count) {
+        return NULL;
+    }
+    return &inst->out[(inst->read_count++) & ALIGN_MASK];
+}
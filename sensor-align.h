@@ -0,0 +1,139 @@
+/**
+ * @file sensor-align.h
+ * @desc Aligns barometer and IMU samples onto a common timeline
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef sensor_align_h
+#define sensor_align_h
+
+#include "test-global.h"
+#include "ms5611-test.h"
+
+/** Number of timeline points buffered for each stream and for output, must be
+    a power of two and at least one barometer period worth of points */
+#define SENSOR_ALIGN_DEPTH  32
+
+/** A barometer and IMU sample resampled onto the common timeline */
+struct sensor_align_sample {
+    /** Time of sample in milliseconds */
+    uint32_t time;
+    /** Altitude interpolated to time */
+    ms5611_alt_t altitude;
+    /** Acceleration interpolated to time */
+    int16_t accel[3];
+};
+
+struct sensor_align_baro_point {
+    uint32_t time;
+    ms5611_alt_t altitude;
+};
+
+struct sensor_align_imu_point {
+    uint32_t time;
+    int16_t accel[3];
+};
+
+struct sensor_align_desc_t {
+    /** Altitude at each timeline point */
+    ms5611_alt_t baro_points[SENSOR_ALIGN_DEPTH];
+    /** Acceleration at each timeline point */
+    int16_t imu_points[SENSOR_ALIGN_DEPTH][3];
+    /** Aligned output samples */
+    struct sensor_align_sample out[SENSOR_ALIGN_DEPTH];
+
+    /** Most recent latency corrected barometer sample */
+    struct sensor_align_baro_point last_baro;
+    /** Most recent latency corrected IMU sample */
+    struct sensor_align_imu_point last_imu;
+
+    /** Time of the first timeline point */
+    uint32_t start_time;
+    /** Time between timeline points in milliseconds */
+    uint16_t period;
+    /** Offset added to barometer timestamps to get the true sample time */
+    int16_t baro_offset;
+    /** Offset added to IMU timestamps to get the true sample time */
+    int16_t imu_offset;
+
+    /** Number of timeline points filled for barometer stream */
+    uint32_t baro_count;
+    /** Number of timeline points filled for IMU stream */
+    uint32_t imu_count;
+    /** Number of aligned samples produced */
+    uint32_t out_count;
+    /** Number of aligned samples consumed */
+    uint32_t read_count;
+    /** Number of aligned samples which were overwritten or dropped before
+        being read */
+    uint32_t overruns;
+
+    /** Whether a sample has been received from each stream yet */
+    uint8_t have_baro:1;
+    uint8_t have_imu:1;
+};
+
+/**
+ *  Initialize a sensor alignment stage.
+ *
+ *  @param inst The instance to be initialized
+ *  @param period Time between points on the common timeline in milliseconds
+ *  @param baro_offset Latency correction added to barometer timestamps in
+ *                     milliseconds
+ *  @param imu_offset Latency correction added to IMU timestamps in
+ *                    milliseconds
+ */
+extern void init_sensor_align(struct sensor_align_desc_t *inst,
+                              uint16_t period, int16_t baro_offset,
+                              int16_t imu_offset);
+
+/**
+ *  Add a barometer sample. Timeline points between the previous sample and
+ *  this one are filled by linear interpolation.
+ *
+ *  @param inst The alignment stage
+ *  @param time Timestamp from the driver
+ *  @param altitude Altitude measured at time
+ */
+extern void sensor_align_push_baro(struct sensor_align_desc_t *inst,
+                                   uint32_t time, ms5611_alt_t altitude);
+
+/**
+ *  Add an IMU sample. Timeline points between the previous sample and this one
+ *  are filled by linear interpolation.
+ *
+ *  @param inst The alignment stage
+ *  @param time Timestamp from the driver
+ *  @param x Acceleration on x axis
+ *  @param y Acceleration on y axis
+ *  @param z Acceleration on z axis
+ */
+extern void sensor_align_push_imu(struct sensor_align_desc_t *inst,
+                                  uint32_t time, int16_t x, int16_t y,
+                                  int16_t z);
+
+/**
+ *  Get the next aligned sample which has not been read yet.
+ *
+ *  @param inst The alignment stage
+ *
+ *  @return Pointer to the next aligned sample, NULL if there are none
+ */
+extern const struct sensor_align_sample *sensor_align_read(
+                                            struct sensor_align_desc_t *inst);
+
+/**
+ *  Get the number of aligned samples waiting to be read.
+ *
+ *  @param inst The alignment stage
+ */
+static inline uint32_t sensor_align_available(
+                                        const struct sensor_align_desc_t *inst)
+{
+    return inst->out_count - inst->read_count;
+}
+
+#endif /* sensor_align_h */
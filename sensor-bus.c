@@ -0,0 +1,70 @@
+/**
+ * @file sensor-bus.c
+ * @desc Publish/subscribe rings for timestamped sensor samples
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "sensor-bus.h"
+
+void init_sensor_bus_topic(struct sensor_bus_topic *topic, void *records,
+                           uint16_t record_size, uint16_t depth)
+{
+    topic->records = records;
+    topic->record_size = record_size;
+    topic->depth = depth;
+    topic->head = 0;
+}
+
+void init_sensor_bus_cursor(struct sensor_bus_cursor *cursor,
+                            const struct sensor_bus_topic *topic)
+{
+    cursor->topic = topic;
+    cursor->tail = (topic != NULL) ? topic->head : 0;
+    cursor->overruns = 0;
+}
+
+const void *sensor_bus_peek(struct sensor_bus_cursor *cursor)
+{
+    const struct sensor_bus_topic *const topic = cursor->topic;
+    if (topic == NULL) {
+        return NULL;
+    }
+
+    const uint32_t head = __atomic_load_n(&topic->head, __ATOMIC_ACQUIRE);
+    const uint32_t pending = head - cursor->tail;
+    if (pending == 0) {
+        return NULL;
+    }
+
+    // Skip records which have been overwritten. The slot after the oldest
+    // intact record may be being written right now, so stay one further back.
+    if (pending >= topic->depth) {
+        const uint32_t skip = pending - (uint32_t)(topic->depth - 1);
+        cursor->overruns += skip;
+        cursor->tail += skip;
+    }
+
+    const uint32_t i = cursor->tail & (uint32_t)(topic->depth - 1);
+    return topic->records + ((size_t)i * topic->record_size);
+}
+
+int sensor_bus_advance(struct sensor_bus_cursor *cursor)
+{
+    const struct sensor_bus_topic *const topic = cursor->topic;
+    if (topic == NULL) {
+        return 0;
+    }
+
+    // The slot for record tail is reused by record tail + depth, which starts
+    // being written once record tail + depth - 1 has been committed
+    const uint32_t head = __atomic_load_n(&topic->head, __ATOMIC_ACQUIRE);
+    const int intact = (head - cursor->tail) < topic->depth;
+    if (!intact) {
+        cursor->overruns++;
+    }
+    cursor->tail++;
+    return intact;
+}
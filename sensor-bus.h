@@ -0,0 +1,128 @@
+/**
+ * @file sensor-bus.h
+ * @desc Publish/subscribe rings for timestamped sensor samples
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef sensor_bus_h
+#define sensor_bus_h
+
+#include "test-global.h"
+#include <stddef.h>
+
+/**
+ *  A topic is a ring of fixed size sample records with a single publisher.
+ *  Records are written in place and are immutable once committed. Any number
+ *  of subscribers can read from a topic, each with its own cursor, without
+ *  the records being copied. A subscriber which falls more than depth records
+ *  behind skips ahead and counts the records it missed.
+ */
+struct sensor_bus_topic {
+    /** Record storage, depth * record_size bytes */
+    uint8_t *records;
+    /** Size of each record in bytes */
+    uint16_t record_size;
+    /** Number of records in the ring, must be a power of two of at least 2 */
+    uint16_t depth;
+    /** Number of records which have been committed */
+    uint32_t head;
+};
+
+struct sensor_bus_cursor {
+    /** Topic being read (may be NULL) */
+    const struct sensor_bus_topic *topic;
+    /** Number of records which this subscriber has consumed */
+    uint32_t tail;
+    /** Number of records which were overwritten before this subscriber read
+        them */
+    uint32_t overruns;
+};
+
+/**
+ *  Initialize a topic.
+ *
+ *  @param topic The topic to initialize
+ *  @param records Storage for depth records of record_size bytes each
+ *  @param record_size Size of each record in bytes
+ *  @param depth Number of records in the ring, must be a power of two of at
+ *               least 2
+ */
+extern void init_sensor_bus_topic(struct sensor_bus_topic *topic,
+                                  void *records, uint16_t record_size,
+                                  uint16_t depth);
+
+/**
+ *  Initialize a cursor. The cursor starts after the most recently committed
+ *  record, so only records published from now on will be read.
+ *
+ *  @param cursor The cursor to initialize
+ *  @param topic The topic to subscribe to (may be NULL)
+ */
+extern void init_sensor_bus_cursor(struct sensor_bus_cursor *cursor,
+                                   const struct sensor_bus_topic *topic);
+
+/**
+ *  Get the slot which the next record should be written into. The record is
+ *  not visible to subscribers until sensor_bus_commit() is called.
+ *
+ *  @param topic The topic to publish to
+ *
+ *  @return Pointer to record_size bytes
+ */
+static inline void *sensor_bus_claim(struct sensor_bus_topic *topic)
+{
+    const uint32_t i = topic->head & (uint32_t)(topic->depth - 1);
+    return topic->records + ((size_t)i * topic->record_size);
+}
+
+/**
+ *  Make the record returned by sensor_bus_claim() visible to subscribers.
+ *
+ *  @param topic The topic to publish to
+ */
+static inline void sensor_bus_commit(struct sensor_bus_topic *topic)
+{
+    __atomic_store_n(&topic->head, topic->head + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ *  Get the oldest record which the cursor has not consumed yet.
+ *
+ *  @param cursor The subscriber's cursor
+ *
+ *  @return Pointer to the record, or NULL if there are no new records
+ */
+extern const void *sensor_bus_peek(struct sensor_bus_cursor *cursor);
+
+/**
+ *  Consume the record returned by the last call to sensor_bus_peek(). The
+ *  return value only needs to be checked if the publisher can interrupt the
+ *  subscriber, otherwise the record cannot change while it is being used.
+ *
+ *  @param cursor The subscriber's cursor
+ *
+ *  @return 1 if the record was still intact, 0 if the publisher overwrote it
+ *          while it was being read (in which case it should be discarded)
+ */
+extern int sensor_bus_advance(struct sensor_bus_cursor *cursor);
+
+/**
+ *  Get the number of records waiting to be read by a cursor, including any
+ *  that have been overwritten.
+ *
+ *  @param cursor The subscriber's cursor
+ */
+static inline uint32_t sensor_bus_pending(
+                                    const struct sensor_bus_cursor *cursor)
+{
+    if (cursor->topic == NULL) {
+        return 0;
+    }
+    return __atomic_load_n(&cursor->topic->head, __ATOMIC_ACQUIRE) -
+                cursor->tail;
+}
+
+#endif /* sensor_bus_h */
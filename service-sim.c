@@ -0,0 +1,116 @@
+/**
+ * @file service-sim.c
+ * @desc Reports the driver service calls avoided by wait timers over
+ *       simulated flights
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef SERVICE_SIM_MAIN
+
+#include "flight-sim.h"
+#include "host-sim.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+int main(int argc, char **argv)
+{
+    static struct flight_sim_board board;
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .transonic_spike = 2000.0f,
+        .baro_glitch_rate = 0.001f, .baro_glitch = 5000.0f,
+        .accel_noise = 0.05f, .accel_bias = 0.05f, .gyro_noise = 0.1f,
+        .gyro_bias = 1.0f, .roll_rate = 60.0f, .temperature = 25.0f,
+        .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+        .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = ALTIMETER_PERIOD,
+        .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 10;
+    uint32_t seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:s:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] [-s seed]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    static struct flight_sim_duty total[DEPLOYMENT_NUM_STATES];
+    for (uint32_t f = 0; f < flights; f++) {
+        struct flight_sim sim;
+        config.pad_time = 10.0f + (0.0137f * (float)f);
+        millis = 0;
+        if (init_flight_sim(&sim, &config, 1, seed + f) != 0) {
+            fprintf(stderr, "out of memory\n");
+            return 1;
+        }
+        init_flight_sim_board(&board, &config);
+        board.replay.recovery_baro_period = ALTIMETER_RECOVERY_PERIOD;
+#ifdef IMU_RECOVERY_LOW_POWER
+        board.replay.recovery_imu_low_power = 1;
+#endif
+
+        flight_sim_run(&sim, (uint32_t)((config.pad_time + 400.0f) * 1000),
+                       flight_sim_replay_sink, &board.replay);
+        flight_sim_free(&sim);
+
+        for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+            total[s].time += board.replay.duty[s].time;
+            total[s].service_calls += board.replay.duty[s].service_calls;
+            total[s].service_skipped += board.replay.duty[s].service_skipped;
+        }
+    }
+
+    printf("%u flights, %u altimeters every %u ms (%u ms in recovery), "
+           "main loop every %u ms\n", (unsigned)flights,
+           (unsigned)ALTIMETER_COUNT, (unsigned)ALTIMETER_PERIOD,
+           (unsigned)ALTIMETER_RECOVERY_PERIOD,
+           (unsigned)(1000 / IMU_AG_SAMPLE_RATE));
+    printf("  %5s %10s %12s %12s %8s\n", "state", "time (s)", "calls/s",
+           "skipped/s", "skipped");
+
+    uint64_t time = 0, calls = 0, skipped = 0;
+    for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+        const struct flight_sim_duty *const d = &total[s];
+        if (d->time == 0) {
+            continue;
+        }
+        printf("  %5u %10.1f %12.1f %12.1f %7.1f%%\n", (unsigned)s,
+               (double)d->time / 1000.0,
+               (double)d->service_calls * 1000.0 / (double)d->time,
+               (double)d->service_skipped * 1000.0 / (double)d->time,
+               (d->service_calls == 0) ? 0.0 :
+                    (100.0 * (double)d->service_skipped /
+                     (double)d->service_calls));
+        time += d->time;
+        calls += d->service_calls;
+        skipped += d->service_skipped;
+    }
+    if (time != 0) {
+        printf("  %5s %10.1f %12.1f %12.1f %7.1f%%\n", "all",
+               (double)time / 1000.0, (double)calls * 1000.0 / (double)time,
+               (double)skipped * 1000.0 / (double)time,
+               (calls == 0) ? 0.0 : (100.0 * (double)skipped /
+                                     (double)calls));
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,228 @@
+/**
+ * @file telemetry-sched.c
+ * @desc Sends telemetry frames within a radio bandwidth budget
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "telemetry-sched.h"
+
+#include <string.h>
+
+void init_telemetry_sched(
+                    struct telemetry_sched *inst,
+                    const struct telemetry_rate rates[][TELEMETRY_NUM_TYPES],
+                    uint32_t budget, const struct sensor_bus_topic *baro_topic,
+                    const struct sensor_bus_topic *imu_topic,
+                    const struct deployment_service_desc_t *deployment,
+                    telemetry_send_cb send, void *send_context)
+{
+    inst->rates = rates;
+    inst->send = send;
+    inst->send_context = send_context;
+    inst->deployment = deployment;
+    init_sensor_bus_cursor(&inst->baro_cursor, baro_topic);
+    init_sensor_bus_cursor(&inst->imu_cursor, imu_topic);
+
+    inst->budget = budget;
+    inst->tokens = 0;
+    inst->token_time = (uint32_t)millis;
+
+    // Sort the kinds of frames by priority for each state once, so that the
+    // service does not have to (insertion sort, the lists are very short)
+    for (uint8_t s = 0; s < DEPLOYMENT_NUM_STATES; s++) {
+        uint8_t *const order = inst->order[s];
+        for (uint8_t t = 0; t < TELEMETRY_NUM_TYPES; t++) {
+            uint8_t i = t;
+            while ((i > 0) && (rates[s][order[i - 1]].priority >
+                               rates[s][t].priority)) {
+                order[i] = order[i - 1];
+                i--;
+            }
+            order[i] = t;
+        }
+    }
+
+    memset(inst->held, 0, sizeof(inst->held));
+    memset(inst->baro_sum, 0, sizeof(inst->baro_sum));
+    memset(inst->imu_sum, 0, sizeof(inst->imu_sum));
+    memset(inst->stats, 0, sizeof(inst->stats));
+    for (uint8_t t = 0; t < TELEMETRY_NUM_TYPES; t++) {
+        // Every kind of frame is due straight away
+        inst->sent_time[t] = (uint32_t)millis - TELEMETRY_OFF;
+    }
+    inst->seq = 0;
+}
+
+/**
+ *  Add the budget accumulated since the last call, up to the largest burst.
+ */
+static void telemetry_sched_refill(struct telemetry_sched *inst)
+{
+    uint32_t dt = (uint32_t)millis - inst->token_time;
+    inst->token_time = (uint32_t)millis;
+    dt = (dt < TELEMETRY_BUCKET_PERIOD) ? dt : TELEMETRY_BUCKET_PERIOD;
+
+    // The bucket always holds at least one of the largest frame, otherwise
+    // a small enough budget would never send anything
+    uint32_t depth = inst->budget * TELEMETRY_BUCKET_PERIOD;
+    depth = (depth > (TELEMETRY_MAX_FRAME * 1000)) ? depth :
+                                                (TELEMETRY_MAX_FRAME * 1000);
+    const uint32_t tokens = inst->tokens + (dt * inst->budget);
+    inst->tokens = (tokens < depth) ? tokens : depth;
+}
+
+/**
+ *  Discard the samples held for a kind of frame.
+ */
+static void telemetry_sched_release(struct telemetry_sched *inst,
+                                    uint8_t type)
+{
+    inst->held[type] = 0;
+    if (type == TELEMETRY_IMU) {
+        memset(inst->imu_sum, 0, sizeof(inst->imu_sum));
+    }
+}
+
+static void telemetry_sched_hold_baro(struct telemetry_sched *inst,
+                                      const struct ms5611_sample *sample,
+                                      uint8_t aggregate)
+{
+    uint16_t *const held = &inst->held[TELEMETRY_BARO];
+    if (!aggregate || (*held >= TELEMETRY_MAX_AGGREGATE)) {
+        inst->stats[TELEMETRY_BARO].decimated += *held;
+        *held = 0;
+    }
+
+    if (*held == 0) {
+        inst->baro = *sample;
+        inst->baro_sum[0] = sample->pressure;
+        inst->baro_sum[1] = sample->temperature;
+        *held = 1;
+        return;
+    }
+
+    (*held)++;
+    inst->baro_sum[0] += sample->pressure;
+    inst->baro_sum[1] += sample->temperature;
+    inst->baro.time = sample->time;
+    inst->baro.pressure = inst->baro_sum[0] / *held;
+    inst->baro.temperature = inst->baro_sum[1] / *held;
+    inst->baro.altitude += ((sample->altitude - inst->baro.altitude) /
+                            (ms5611_alt_t)*held);
+}
+
+static void telemetry_sched_hold_imu(struct telemetry_sched *inst,
+                                     const struct mpu9250_sample *sample,
+                                     uint8_t aggregate)
+{
+    uint16_t *const held = &inst->held[TELEMETRY_IMU];
+    if (!aggregate || (*held >= TELEMETRY_MAX_AGGREGATE)) {
+        inst->stats[TELEMETRY_IMU].decimated += *held;
+        telemetry_sched_release(inst, TELEMETRY_IMU);
+    }
+
+    const int16_t *const values[] = { sample->accel, sample->gyro,
+                                      sample->mag, &sample->temp };
+    int16_t *const means[] = { inst->imu.accel, inst->imu.gyro, inst->imu.mag,
+                               &inst->imu.temp };
+    const uint8_t counts[] = { 3, 3, 3, 1 };
+
+    (*held)++;
+    inst->imu.time = sample->time;
+    int32_t *sum = inst->imu_sum;
+    for (uint8_t i = 0; i < 4; i++) {
+        for (uint8_t j = 0; j < counts[i]; j++, sum++) {
+            *sum += values[i][j];
+            means[i][j] = (int16_t)(*sum / *held);
+        }
+    }
+}
+
+/**
+ *  Build a frame from the held samples or the deployment service status.
+ */
+static void telemetry_sched_frame(struct telemetry_sched *inst,
+                                  uint8_t *frame, uint8_t type)
+{
+    const void *payload;
+    struct telemetry_deployment status;
+
+    if (type == TELEMETRY_BARO) {
+        payload = &inst->baro;
+    } else if (type == TELEMETRY_IMU) {
+        payload = &inst->imu;
+    } else {
+        const struct deployment_service_desc_t *const dep = inst->deployment;
+        status.time = (uint32_t)millis;
+        status.altitude = dep->last_altitude;
+        status.vertical_velocity = dep->vertical_velocity;
+        status.pyro_fired = dep->pyro_fired;
+        status.state = (uint8_t)dep->state;
+        status.reserved = 0;
+        payload = &status;
+    }
+    telemetry_encode(frame, type, 0, inst->seq, payload);
+}
+
+void telemetry_sched_service(struct telemetry_sched *inst)
+{
+    telemetry_sched_refill(inst);
+
+    const enum deployment_service_state state = inst->deployment->state;
+    const struct telemetry_rate *const rates = inst->rates[state];
+
+    const struct ms5611_sample *baro;
+    while ((baro = sensor_bus_peek(&inst->baro_cursor)) != NULL) {
+        telemetry_sched_hold_baro(inst, baro, rates[TELEMETRY_BARO].aggregate);
+        sensor_bus_advance(&inst->baro_cursor);
+    }
+    const struct mpu9250_sample *imu;
+    while ((imu = sensor_bus_peek(&inst->imu_cursor)) != NULL) {
+        telemetry_sched_hold_imu(inst, imu, rates[TELEMETRY_IMU].aggregate);
+        sensor_bus_advance(&inst->imu_cursor);
+    }
+
+    for (uint8_t i = 0; i < TELEMETRY_NUM_TYPES; i++) {
+        const uint8_t type = inst->order[state][i];
+        const struct telemetry_rate *const rate = &rates[type];
+        struct telemetry_sched_stats *const stats = &inst->stats[type];
+
+        if (rate->period == TELEMETRY_OFF) {
+            stats->decimated += inst->held[type];
+            telemetry_sched_release(inst, type);
+            continue;
+        } else if ((type != TELEMETRY_DEPLOYMENT) && (inst->held[type] == 0)) {
+            continue;
+        } else if (((uint32_t)millis - inst->sent_time[type]) <
+                        rate->period) {
+            continue;
+        }
+
+        const uint16_t length = (sizeof(struct telemetry_header) +
+                                 telemetry_payload_length(type) +
+                                 TELEMETRY_CRC_LENGTH);
+        if (inst->tokens < ((uint32_t)length * 1000)) {
+            // Lower priority frames wait too, so that they cannot use up the
+            // budget this frame is waiting for
+            break;
+        }
+
+        uint8_t frame[TELEMETRY_MAX_FRAME];
+        telemetry_sched_frame(inst, frame, type);
+        if (inst->send(inst->send_context, frame, length) != 0) {
+            break;
+        }
+
+        inst->tokens -= (uint32_t)length * 1000;
+        inst->sent_time[type] = (uint32_t)millis;
+        inst->seq++;
+        stats->frames++;
+        stats->bytes += length;
+        stats->samples += (type == TELEMETRY_DEPLOYMENT) ? 1 :
+                                                           inst->held[type];
+        telemetry_sched_release(inst, type);
+    }
+}
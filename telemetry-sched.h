@@ -0,0 +1,160 @@
+/**
+ * @file telemetry-sched.h
+ * @desc Sends telemetry frames within a radio bandwidth budget
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef telemetry_sched_h
+#define telemetry_sched_h
+
+#include "test-global.h"
+#include "telemetry.h"
+#include "deployment.h"
+#include "sensor-bus.h"
+
+/** Period for a kind of frame which is not sent at all */
+#define TELEMETRY_OFF               0xFFFF
+/** Largest burst which can be sent at once is the budget for this many
+    milliseconds */
+#define TELEMETRY_BUCKET_PERIOD     250
+/** Most samples aggregated into one frame, keeps the sums from overflowing */
+#define TELEMETRY_MAX_AGGREGATE     16384
+
+/**
+ *  Function which hands a frame to the radio.
+ *
+ *  @param context Context given to init_telemetry_sched()
+ *  @param frame The frame
+ *  @param length Length of the frame in bytes
+ *
+ *  @return 0 if the frame was accepted, non-zero if the radio is busy
+ */
+typedef int (*telemetry_send_cb)(void *context, const uint8_t *frame,
+                                 uint16_t length);
+
+/**
+ *  How a kind of frame is sent in one deployment state.
+ */
+struct telemetry_rate {
+    /** Shortest time between frames in milliseconds, 0 to send a frame
+        whenever there are new samples or TELEMETRY_OFF */
+    uint16_t period;
+    /** Kinds of frames with a lower value are sent first */
+    uint8_t priority;
+    /** Send the mean of all of the samples since the last frame instead of
+        only the most recent sample */
+    uint8_t aggregate;
+};
+
+/** Counters for one kind of frame */
+struct telemetry_sched_stats {
+    /** Number of frames sent */
+    uint32_t frames;
+    /** Number of bytes sent */
+    uint32_t bytes;
+    /** Number of samples which went into frames */
+    uint32_t samples;
+    /** Number of samples which were replaced by a newer sample before they
+        could be sent */
+    uint32_t decimated;
+};
+
+/**
+ *  Telemetry scheduler. New samples are taken from the altimeter and IMU
+ *  topics as they are published and held until a frame of their kind is due,
+ *  either keeping only the most recent sample (decimation) or the mean of all
+ *  samples (aggregation). The radio budget is enforced with a token bucket
+ *  which fills at the budget in bytes per second. Due frames are sent in
+ *  priority order while there is budget for them, a frame which does not fit
+ *  stops lower priority frames from being sent until the bucket has refilled,
+ *  so when the budget is short it is the lowest priority data which is
+ *  decimated or aggregated further. Rates and priorities are given per
+ *  deployment state, so the mix of data follows the phase of the flight.
+ */
+struct telemetry_sched {
+    /** Rate of each kind of frame in each deployment state */
+    const struct telemetry_rate (*rates)[TELEMETRY_NUM_TYPES];
+    /** Kinds of frames in order of priority for each deployment state */
+    uint8_t order[DEPLOYMENT_NUM_STATES][TELEMETRY_NUM_TYPES];
+
+    /** Function which hands frames to the radio */
+    telemetry_send_cb send;
+    void *send_context;
+
+    /** Deployment service whose status is sent and whose state selects the
+        rates */
+    const struct deployment_service_desc_t *deployment;
+    struct sensor_bus_cursor baro_cursor;
+    struct sensor_bus_cursor imu_cursor;
+
+    /** Budget in bytes per second */
+    uint32_t budget;
+    /** Budget available in thousandths of a byte */
+    uint32_t tokens;
+    /** Time at which tokens was last updated */
+    uint32_t token_time;
+
+    /** Samples held for the next frame of each kind, the mean so far when
+        aggregating */
+    struct ms5611_sample baro;
+    struct mpu9250_sample imu;
+    /** Sums for aggregating samples, pressure and temperature for the
+        altimeter and each accel, gyro and mag axis then temperature for the
+        IMU */
+    int32_t baro_sum[2];
+    int32_t imu_sum[10];
+    /** Number of samples held for each kind of frame */
+    uint16_t held[TELEMETRY_NUM_TYPES];
+    /** Time at which each kind of frame was last sent */
+    uint32_t sent_time[TELEMETRY_NUM_TYPES];
+
+    /** Sequence number of the next frame */
+    uint16_t seq;
+    struct telemetry_sched_stats stats[TELEMETRY_NUM_TYPES];
+};
+
+/**
+ *  Initialize a telemetry scheduler.
+ *
+ *  @param inst The scheduler to initialize
+ *  @param rates Rate of each kind of frame in each deployment state
+ *  @param budget Radio bandwidth budget in bytes per second
+ *  @param baro_topic Topic of altimeter readings (may be NULL)
+ *  @param imu_topic Topic of IMU samples (may be NULL)
+ *  @param deployment Deployment service
+ *  @param send Function which hands frames to the radio
+ *  @param send_context Context for send
+ */
+extern void init_telemetry_sched(
+                    struct telemetry_sched *inst,
+                    const struct telemetry_rate rates[][TELEMETRY_NUM_TYPES],
+                    uint32_t budget, const struct sensor_bus_topic *baro_topic,
+                    const struct sensor_bus_topic *imu_topic,
+                    const struct deployment_service_desc_t *deployment,
+                    telemetry_send_cb send, void *send_context);
+
+/**
+ *  Take new samples and send any frames which are due and fit the budget.
+ *  Should be called in each iteration of the main loop, after the deployment
+ *  service.
+ *
+ *  @param inst The scheduler
+ */
+extern void telemetry_sched_service(struct telemetry_sched *inst);
+
+/**
+ *  Change the bandwidth budget.
+ *
+ *  @param inst The scheduler
+ *  @param budget Radio bandwidth budget in bytes per second
+ */
+static inline void telemetry_sched_set_budget(struct telemetry_sched *inst,
+                                              uint32_t budget)
+{
+    inst->budget = budget;
+}
+
+#endif /* telemetry_sched_h */
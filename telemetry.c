@@ -0,0 +1,159 @@
+/**
+ * @file telemetry.c
+ * @desc Telemetry frame format shared by the flight computer and ground station
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "telemetry.h"
+
+#include <string.h>
+
+/** Payload length of each kind of frame */
+static const uint8_t telemetry_lengths[TELEMETRY_NUM_TYPES] = {
+    [TELEMETRY_BARO] = sizeof(struct ms5611_sample),
+    [TELEMETRY_IMU] = sizeof(struct mpu9250_sample),
+    [TELEMETRY_DEPLOYMENT] = sizeof(struct telemetry_deployment)
+};
+
+/** CRC-16 (CCITT) lookup table for one nibble at a time */
+static const uint16_t crc_table[16] = {
+    0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+    0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF
+};
+
+uint16_t telemetry_crc(const void *data, uint32_t length)
+{
+    const uint8_t *bytes = data;
+    uint16_t crc = 0xFFFF;
+
+    for (uint32_t i = 0; i < length; i++) {
+        crc = crc_table[((crc >> 12) ^ (bytes[i] >> 4)) & 0xF] ^ (crc << 4);
+        crc = crc_table[((crc >> 12) ^ bytes[i]) & 0xF] ^ (crc << 4);
+    }
+    return crc;
+}
+
+uint8_t telemetry_payload_length(uint8_t type)
+{
+    return (type < TELEMETRY_NUM_TYPES) ? telemetry_lengths[type] : 0;
+}
+
+uint16_t telemetry_encode(uint8_t *frame, enum telemetry_type type,
+                          uint8_t source, uint16_t seq, const void *payload)
+{
+    const uint8_t length = telemetry_payload_length(type);
+    if (length == 0) {
+        return 0;
+    }
+
+    const struct telemetry_header header = {
+        .sync = TELEMETRY_SYNC,
+        .type = type,
+        .length = length,
+        .seq = seq,
+        .source = source,
+#ifdef FIXED_POINT_ALTITUDE
+        .flags = TELEMETRY_FLAG_FIXED_POINT
+#else
+        .flags = 0
+#endif
+    };
+    memcpy(frame, &header, sizeof(header));
+    memcpy(frame + sizeof(header), payload, length);
+
+    const uint16_t body = sizeof(header) + length;
+    const uint16_t crc = telemetry_crc(frame, body);
+    frame[body] = (uint8_t)crc;
+    frame[body + 1] = (uint8_t)(crc >> 8);
+    return body + TELEMETRY_CRC_LENGTH;
+}
+
+void init_telemetry_decoder(struct telemetry_decoder *dec)
+{
+    dec->count = 0;
+    dec->frames = 0;
+    dec->crc_errors = 0;
+    dec->skipped = 0;
+}
+
+/**
+ *  Decode as many frames as possible from the start of the buffer and discard
+ *  the bytes which have been used.
+ */
+static void telemetry_decode_buffer(struct telemetry_decoder *dec,
+                                    telemetry_frame_cb callback,
+                                    void *context)
+{
+    const uint8_t sync[2] = { (uint8_t)TELEMETRY_SYNC,
+                              (uint8_t)(TELEMETRY_SYNC >> 8) };
+    uint16_t start = 0;
+
+    for (;;) {
+        const uint16_t remaining = dec->count - start;
+        const uint8_t *const frame = dec->buffer + start;
+
+        if ((remaining >= 1) && (frame[0] != sync[0])) {
+            start++;
+            dec->skipped++;
+            continue;
+        } else if (remaining < 2) {
+            break;
+        } else if (frame[1] != sync[1]) {
+            start++;
+            dec->skipped++;
+            continue;
+        } else if (remaining < sizeof(struct telemetry_header)) {
+            break;
+        }
+
+        // The buffer is not necessarily aligned for the header
+        struct telemetry_header header;
+        memcpy(&header, frame, sizeof(header));
+        const uint8_t length = telemetry_payload_length(header.type);
+        if ((length == 0) || (header.length != length)) {
+            start++;
+            dec->skipped++;
+            continue;
+        }
+
+        const uint16_t body = sizeof(header) + length;
+        if (remaining < (body + TELEMETRY_CRC_LENGTH)) {
+            break;
+        }
+        const uint16_t crc = frame[body] | (frame[body + 1] << 8);
+        if (crc != telemetry_crc(frame, body)) {
+            // Could be a sync pattern inside another frame, search again from
+            // the next byte
+            dec->crc_errors++;
+            start++;
+            dec->skipped++;
+            continue;
+        }
+
+        dec->frames++;
+        callback(context, frame, body + TELEMETRY_CRC_LENGTH);
+        start += body + TELEMETRY_CRC_LENGTH;
+    }
+
+    memmove(dec->buffer, dec->buffer + start, dec->count - start);
+    dec->count -= start;
+}
+
+void telemetry_decode(struct telemetry_decoder *dec, const uint8_t *data,
+                      uint32_t length, telemetry_frame_cb callback,
+                      void *context)
+{
+    while (length > 0) {
+        uint32_t n = sizeof(dec->buffer) - dec->count;
+        n = (length < n) ? length : n;
+        memcpy(dec->buffer + dec->count, data, n);
+        dec->count += n;
+        data += n;
+        length -= n;
+
+        telemetry_decode_buffer(dec, callback, context);
+    }
+}
@@ -0,0 +1,180 @@
+/**
+ * @file telemetry.h
+ * @desc Telemetry frame format shared by the flight computer and ground station
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef telemetry_h
+#define telemetry_h
+
+#include "test-global.h"
+#include "ms5611-test.h"
+#include "mpu9250-test.h"
+
+/** Value of the sync field at the start of each frame, 0xA5 0x5A on the wire */
+#define TELEMETRY_SYNC              0x5AA5
+/** Largest payload in bytes */
+#define TELEMETRY_MAX_PAYLOAD       64
+/** Size of the CRC at the end of each frame */
+#define TELEMETRY_CRC_LENGTH        2
+/** Largest frame in bytes */
+#define TELEMETRY_MAX_FRAME (sizeof(struct telemetry_header) + \
+                             TELEMETRY_MAX_PAYLOAD + TELEMETRY_CRC_LENGTH)
+
+/** Flag set in frames from a build where altitudes are Q16.16 fixed point */
+#define TELEMETRY_FLAG_FIXED_POINT  (1 << 0)
+
+/** Kinds of frames, each has a payload of a fixed layout */
+enum telemetry_type {
+    /** Altimeter reading, struct ms5611_sample, source is the altimeter */
+    TELEMETRY_BARO,
+    /** IMU sample, struct mpu9250_sample */
+    TELEMETRY_IMU,
+    /** Deployment service status, struct telemetry_deployment */
+    TELEMETRY_DEPLOYMENT,
+    TELEMETRY_NUM_TYPES
+};
+
+/**
+ *  Header at the start of each frame. Frames are little endian, a header is
+ *  followed by length bytes of payload and a CRC-16 (CCITT) of the header and
+ *  payload.
+ */
+struct telemetry_header {
+    /** TELEMETRY_SYNC */
+    uint16_t sync;
+    /** Kind of frame (enum telemetry_type) */
+    uint8_t type;
+    /** Length of the payload in bytes */
+    uint8_t length;
+    /** Incremented for every frame sent */
+    uint16_t seq;
+    /** Which instance of a sensor the frame is from */
+    uint8_t source;
+    /** TELEMETRY_FLAG_* */
+    uint8_t flags;
+};
+
+/** Deployment service status record */
+struct telemetry_deployment {
+    /** Time at which the status was sampled */
+    uint32_t time;
+    /** Most recent altitude */
+    ms5611_alt_t altitude;
+    /** Filtered vertical velocity from the altimeter */
+    ms5611_alt_t vertical_velocity;
+    /** Pyro events which have fired */
+    uint16_t pyro_fired;
+    /** Deployment service state */
+    uint8_t state;
+    uint8_t reserved;
+};
+
+/**
+ *  Incremental decoder for a stream of frames, which finds frame boundaries
+ *  by the sync field and skips anything which does not make a valid frame.
+ */
+struct telemetry_decoder {
+    /** Bytes received which have not been decoded yet */
+    uint8_t buffer[TELEMETRY_MAX_FRAME];
+    uint16_t count;
+
+    /** Number of valid frames decoded */
+    uint32_t frames;
+    /** Number of frames discarded because of a bad CRC */
+    uint32_t crc_errors;
+    /** Number of bytes discarded while searching for a frame */
+    uint32_t skipped;
+};
+
+/**
+ *  Function called for each valid frame. The frame is not necessarily
+ *  aligned, records should be copied out of it with memcpy().
+ *
+ *  @param context Context given to telemetry_decode()
+ *  @param frame The whole frame, starting with its header
+ *  @param length Length of the frame in bytes
+ */
+typedef void (*telemetry_frame_cb)(void *context, const uint8_t *frame,
+                                   uint16_t length);
+
+/**
+ *  Get the payload length for a kind of frame.
+ *
+ *  @param type The kind of frame
+ *
+ *  @return The length in bytes, 0 if type is not a valid kind of frame
+ */
+extern uint8_t telemetry_payload_length(uint8_t type);
+
+/**
+ *  Compute the CRC-16 (CCITT, initial value 0xFFFF) of a block of memory.
+ *
+ *  @param data Data to compute CRC of
+ *  @param length Length of data in bytes
+ *
+ *  @return CRC of data
+ */
+extern uint16_t telemetry_crc(const void *data, uint32_t length);
+
+/**
+ *  Build a frame.
+ *
+ *  @param frame Buffer of at least TELEMETRY_MAX_FRAME bytes
+ *  @param type The kind of frame
+ *  @param source Which instance of a sensor the frame is from
+ *  @param seq Sequence number
+ *  @param payload The record, of the layout for type
+ *
+ *  @return Length of the frame in bytes, 0 if type is not valid
+ */
+extern uint16_t telemetry_encode(uint8_t *frame, enum telemetry_type type,
+                                 uint8_t source, uint16_t seq,
+                                 const void *payload);
+
+/**
+ *  Initialize a decoder.
+ *
+ *  @param dec The decoder
+ */
+extern void init_telemetry_decoder(struct telemetry_decoder *dec);
+
+/**
+ *  Decode received bytes, calling callback for each valid frame. Bytes which
+ *  do not complete a frame are kept for the next call.
+ *
+ *  @param dec The decoder
+ *  @param data Received bytes
+ *  @param length Number of received bytes
+ *  @param callback Function called for each valid frame
+ *  @param context Context for callback
+ */
+extern void telemetry_decode(struct telemetry_decoder *dec,
+                             const uint8_t *data, uint32_t length,
+                             telemetry_frame_cb callback, void *context);
+
+/**
+ *  Get the header of a valid frame.
+ *
+ *  @param frame The frame
+ */
+static inline const struct telemetry_header *telemetry_frame_header(
+                                                        const uint8_t *frame)
+{
+    return (const struct telemetry_header *)frame;
+}
+
+/**
+ *  Get the payload of a valid frame.
+ *
+ *  @param frame The frame
+ */
+static inline const void *telemetry_frame_payload(const uint8_t *frame)
+{
+    return frame + sizeof(struct telemetry_header);
+}
+
+#endif /* telemetry_h */
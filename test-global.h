@@ -2,6 +2,18 @@
 #define test_global_h
 #include <stdint.h>
 
+/* Represent altitudes as Q16.16 fixed point meters instead of floats if
+   defined, for targets without an FPU */
+//#define FIXED_POINT_ALTITUDE
+
+/* Record state changes, I2C transactions and GPIO changes into the trace ring
+   if defined */
+//#define ENABLE_TRACE
+
+/* Measure the cycles taken by each driver and deployment state and by each
+   main loop iteration if defined (see wcet.h) */
+//#define ENABLE_WCET
+
 
 extern void init_variant(void);
 extern void variant_service(void);
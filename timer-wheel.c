@@ -0,0 +1,166 @@
+/**
+ * @file timer-wheel.c
+ * @desc Hierarchical timer wheel for scheduling deadlines in milliseconds
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "timer-wheel.h"
+
+#define SLOT_MASK   (TIMER_WHEEL_SLOTS - 1)
+
+void init_timer_wheel(struct timer_wheel *inst, uint32_t now)
+{
+    for (int l = 0; l < TIMER_WHEEL_LEVELS; l++) {
+        for (int s = 0; s < TIMER_WHEEL_SLOTS; s++) {
+            inst->slots[l][s] = NULL;
+        }
+    }
+    inst->now = now;
+    inst->count = 0;
+}
+
+void init_timer_wheel_timer(struct timer_wheel_timer *timer,
+                            timer_wheel_cb callback, void *context)
+{
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->callback = callback;
+    timer->context = context;
+    timer->deadline = 0;
+}
+
+static void insert(struct timer_wheel *inst, struct timer_wheel_timer *timer)
+{
+    // inst->now is the next tick to be processed
+    uint32_t delta = timer->deadline - inst->now;
+    if ((int32_t)delta < 0) {
+        // Already expired, put it in the next slot to be processed
+        delta = 0;
+    }
+
+    // Find the lowest level which can represent this deadline
+    int level = 0;
+    while ((level < (TIMER_WHEEL_LEVELS - 1)) &&
+           (delta >= (1UL << ((level + 1) * TIMER_WHEEL_SLOT_BITS)))) {
+        level++;
+    }
+
+    uint32_t when = (delta == 0) ? inst->now : timer->deadline;
+    if ((level == (TIMER_WHEEL_LEVELS - 1)) &&
+            (delta >= (1UL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOT_BITS)))) {
+        // Too far in the future, park it in the furthest slot of the top level
+        // and reinsert it when that slot is cascaded
+        when = (inst->now + (SLOT_MASK << (level * TIMER_WHEEL_SLOT_BITS)));
+    }
+
+    const unsigned slot = (when >> (level * TIMER_WHEEL_SLOT_BITS)) & SLOT_MASK;
+    struct timer_wheel_timer **const head = &inst->slots[level][slot];
+
+    timer->next = *head;
+    if (timer->next != NULL) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+}
+
+static void unlink(struct timer_wheel_timer *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next != NULL) {
+        timer->next->pprev = timer->pprev;
+    }
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+void timer_wheel_schedule(struct timer_wheel *inst,
+                          struct timer_wheel_timer *timer, uint32_t deadline)
+{
+    if (timer_wheel_pending(timer)) {
+        unlink(timer);
+    } else {
+        inst->count++;
+    }
+
+    timer->deadline = deadline;
+    insert(inst, timer);
+}
+
+void timer_wheel_cancel(struct timer_wheel *inst,
+                        struct timer_wheel_timer *timer)
+{
+    if (!timer_wheel_pending(timer)) {
+        return;
+    }
+    unlink(timer);
+    inst->count--;
+}
+
+/**
+ *  Move all timers in a slot of an upper level down to the levels below.
+ */
+static void cascade(struct timer_wheel *inst, int level)
+{
+    const unsigned slot = ((inst->now >> (level * TIMER_WHEEL_SLOT_BITS)) &
+                           SLOT_MASK);
+    struct timer_wheel_timer *timer = inst->slots[level][slot];
+    inst->slots[level][slot] = NULL;
+
+    while (timer != NULL) {
+        struct timer_wheel_timer *const next = timer->next;
+        insert(inst, timer);
+        timer = next;
+    }
+}
+
+uint16_t timer_wheel_advance(struct timer_wheel *inst, uint32_t now)
+{
+    uint16_t expired = 0;
+
+    // inst->now is the next tick which has not been processed yet
+    while ((int32_t)(now - inst->now) >= 0) {
+        if (inst->count == 0) {
+            // Nothing to expire, skip straight to the current time
+            inst->now = now + 1;
+            break;
+        }
+
+        const unsigned slot = inst->now & SLOT_MASK;
+
+        // Pull timers from upper levels down when lower levels wrap around
+        if (slot == 0) {
+            for (int l = 1; l < TIMER_WHEEL_LEVELS; l++) {
+                cascade(inst, l);
+                if (((inst->now >> (l * TIMER_WHEEL_SLOT_BITS)) &
+                     SLOT_MASK) != 0) {
+                    break;
+                }
+            }
+        }
+
+        // Detach the current slot before moving on so that callbacks which
+        // reschedule their timers land in a later slot
+        struct timer_wheel_timer *expiring = inst->slots[0][slot];
+        inst->slots[0][slot] = NULL;
+        if (expiring != NULL) {
+            expiring->pprev = &expiring;
+        }
+        inst->now++;
+
+        while (expiring != NULL) {
+            struct timer_wheel_timer *const timer = expiring;
+            unlink(timer);
+            inst->count--;
+            expired++;
+            if (timer->callback != NULL) {
+                timer->callback(timer->context);
+            }
+        }
+    }
+
+    return expired;
+}
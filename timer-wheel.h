@@ -0,0 +1,120 @@
+/**
+ * @file timer-wheel.h
+ * @desc Hierarchical timer wheel for scheduling deadlines in milliseconds
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef timer_wheel_h
+#define timer_wheel_h
+
+#include "test-global.h"
+#include <stddef.h>
+
+/** log2 of number of slots at each level of the wheel */
+#define TIMER_WHEEL_SLOT_BITS   6
+/** Number of slots at each level of the wheel */
+#define TIMER_WHEEL_SLOTS       (1 << TIMER_WHEEL_SLOT_BITS)
+/** Number of levels in the wheel, 3 levels of 64 slots cover deadlines up to
+    about 262 seconds away, later deadlines are cascaded as they get closer */
+#define TIMER_WHEEL_LEVELS      3
+
+struct timer_wheel_timer;
+
+/**
+ *  Function called when a timer expires.
+ *
+ *  @param context The context pointer from the timer
+ */
+typedef void (*timer_wheel_cb)(void *context);
+
+struct timer_wheel_timer {
+    /** Next timer in the same slot */
+    struct timer_wheel_timer *next;
+    /** Pointer to the pointer to this timer in its slot, NULL if the timer is
+        not scheduled */
+    struct timer_wheel_timer **pprev;
+    /** Function called when the timer expires (may be NULL) */
+    timer_wheel_cb callback;
+    /** Context for callback */
+    void *context;
+    /** Value of millis at which the timer expires */
+    uint32_t deadline;
+};
+
+struct timer_wheel {
+    /** Lists of timers for each slot of each level */
+    struct timer_wheel_timer *slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    /** Time up to which the wheel has been advanced */
+    uint32_t now;
+    /** Number of scheduled timers */
+    uint16_t count;
+};
+
+/**
+ *  Initialize a timer wheel.
+ *
+ *  @param inst The timer wheel to be initialized
+ *  @param now The current value of millis
+ */
+extern void init_timer_wheel(struct timer_wheel *inst, uint32_t now);
+
+/**
+ *  Initialize a timer.
+ *
+ *  @param timer The timer to be initialized
+ *  @param callback Function to be called when the timer expires (may be NULL)
+ *  @param context Context for callback
+ */
+extern void init_timer_wheel_timer(struct timer_wheel_timer *timer,
+                                   timer_wheel_cb callback, void *context);
+
+/**
+ *  Schedule a timer, O(1). If the timer is already scheduled it is moved to the
+ *  new deadline. Deadlines which have already passed expire on the next call
+ *  to timer_wheel_advance().
+ *
+ *  @param inst The timer wheel
+ *  @param timer The timer
+ *  @param deadline Value of millis at which the timer should expire
+ */
+extern void timer_wheel_schedule(struct timer_wheel *inst,
+                                 struct timer_wheel_timer *timer,
+                                 uint32_t deadline);
+
+/**
+ *  Cancel a timer, O(1). Has no effect if the timer is not scheduled.
+ *
+ *  @param inst The timer wheel
+ *  @param timer The timer
+ */
+extern void timer_wheel_cancel(struct timer_wheel *inst,
+                               struct timer_wheel_timer *timer);
+
+/**
+ *  Advance the wheel to the current time and expire all timers with deadlines
+ *  at or before it. Each expired timer is descheduled before its callback is
+ *  called, so callbacks may reschedule their timer.
+ *
+ *  @param inst The timer wheel
+ *  @param now The current value of millis
+ *
+ *  @return The number of timers which expired
+ */
+extern uint16_t timer_wheel_advance(struct timer_wheel *inst, uint32_t now);
+
+/**
+ *  Get whether a timer is scheduled.
+ *
+ *  @param timer The timer
+ *
+ *  @return Non-zero if the timer is scheduled and has not yet expired
+ */
+static inline int timer_wheel_pending(const struct timer_wheel_timer *timer)
+{
+    return timer->pprev != NULL;
+}
+
+#endif /* timer_wheel_h */
@@ -0,0 +1,264 @@
+/**
+ * @file trace.c
+ * @desc Low overhead binary event trace buffer
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "trace.h"
+
+#if (TRACE_BUFFER_LENGTH & (TRACE_BUFFER_LENGTH - 1)) != 0
+#error TRACE_BUFFER_LENGTH must be a power of two
+#endif
+
+#ifdef ENABLE_TRACE
+struct trace_record trace_buffer_g[TRACE_BUFFER_LENGTH];
+uint32_t trace_head_g;
+#endif
+
+uint32_t trace_dump(struct trace_record *dest, uint32_t max)
+{
+#ifdef ENABLE_TRACE
+    const uint32_t head = __atomic_load_n(&trace_head_g, __ATOMIC_ACQUIRE);
+    uint32_t count = (head < TRACE_BUFFER_LENGTH) ? head : TRACE_BUFFER_LENGTH;
+    if (count > max) {
+        count = max;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        dest[i] = trace_buffer_g[(head - count + i) &
+                                 (TRACE_BUFFER_LENGTH - 1)];
+    }
+    return count;
+#else
+    (void)dest;
+    (void)max;
+    return 0;
+#endif
+}
+
+#ifdef TRACE_HOST_EXPORT
+
+/** Chrome trace thread id used for each kind of event */
+enum trace_track {
+    TRACK_DEPLOYMENT = 1,
+    TRACK_MS5611,
+    TRACK_MPU9250,
+    TRACK_I2C,
+    TRACK_GPIO
+};
+
+static const char *const deployment_state_names[] = {
+    "IDLE", "ARMED", "POWERED_ASCENT", "COASTING_ASCENT", "DROGUE_DEPLOY",
+    "DROGUE_DESCENT", "MAIN_DEPLOY", "MAIN_DESCENT", "RECOVERY"
+};
+
+static int state_track(uint8_t type, int *track, const char **prefix)
+{
+    switch (type) {
+        case TRACE_DEPLOYMENT_STATE:
+            *track = TRACK_DEPLOYMENT;
+            *prefix = "deployment";
+            return 1;
+        case TRACE_MS5611_STATE:
+            *track = TRACK_MS5611;
+            *prefix = "ms5611";
+            return 1;
+        case TRACE_MPU9250_STATE:
+            *track = TRACK_MPU9250;
+            *prefix = "mpu9250";
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void print_state_name(FILE *out, const struct trace_record *r,
+                             const char *prefix)
+{
+    if ((r->type == TRACE_DEPLOYMENT_STATE) &&
+            (r->arg < (sizeof(deployment_state_names) /
+                       sizeof(deployment_state_names[0])))) {
+        fprintf(out, "%s", deployment_state_names[r->arg]);
+    } else {
+        fprintf(out, "%s state %u", prefix, (unsigned)r->arg);
+    }
+}
+
+int trace_export_chrome(FILE *out, const struct trace_record *records,
+                        uint32_t count, uint32_t us_per_tick)
+{
+    const char *sep = "";
+    const uint32_t t0 = (count > 0) ? records[0].time : 0;
+
+    fprintf(out, "{\"traceEvents\":[\n");
+
+    for (uint32_t i = 0; i < count; i++) {
+        const struct trace_record *const r = &records[i];
+        const uint64_t ts = (uint64_t)(r->time - t0) * us_per_tick;
+        int track;
+        const char *prefix;
+
+        if (state_track(r->type, &track, &prefix)) {
+            // State lasts until the next change of the same state machine or
+            // the end of the trace
+            uint32_t end = records[count - 1].time;
+            for (uint32_t j = i + 1; j < count; j++) {
+                if (records[j].type == r->type && records[j].id == r->id) {
+                    end = records[j].time;
+                    break;
+                }
+            }
+            fprintf(out, "%s{\"name\":\"", sep);
+            print_state_name(out, r, prefix);
+            fprintf(out, "\",\"ph\":\"X\",\"pid\":%u,\"tid\":%d,"
+                    "\"ts\":%llu,\"dur\":%llu}", (unsigned)r->id, track,
+                    (unsigned long long)ts,
+                    (unsigned long long)((uint64_t)(end - r->time) *
+                                         us_per_tick));
+        } else if (r->type == TRACE_I2C_START) {
+            fprintf(out, "%s{\"name\":\"i2c 0x%02x\",\"ph\":\"B\",\"pid\":0,"
+                    "\"tid\":%d,\"ts\":%llu,\"args\":{\"priority\":%u}}", sep,
+                    (unsigned)r->id, TRACK_I2C, (unsigned long long)ts,
+                    (unsigned)r->arg);
+        } else if (r->type == TRACE_I2C_COMPLETE) {
+            fprintf(out, "%s{\"ph\":\"E\",\"pid\":0,\"tid\":%d,\"ts\":%llu,"
+                    "\"args\":{\"success\":%u}}", sep, TRACK_I2C,
+                    (unsigned long long)ts, (unsigned)r->arg);
+        } else if (r->type == TRACE_GPIO) {
+            fprintf(out, "%s{\"name\":\"gpio %u\",\"ph\":\"C\",\"pid\":0,"
+                    "\"tid\":%d,\"ts\":%llu,\"args\":{\"value\":%u}}", sep,
+                    (unsigned)r->id, TRACK_GPIO, (unsigned long long)ts,
+                    (unsigned)r->arg);
+        } else {
+            continue;
+        }
+        sep = ",\n";
+    }
+
+    fprintf(out, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return ferror(out) ? -1 : 0;
+}
+
+#endif
+
+#ifdef TRACE_EXPORT_MAIN
+
+#ifndef TRACE_HOST_EXPORT
+#error trace export must be built with TRACE_HOST_EXPORT defined
+#endif
+
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ *  Convert a trace dump to Chrome trace event JSON. The dump is either the
+ *  records returned by trace_dump() in order, or with -h a raw image of
+ *  trace_buffer_g (e.g. dumped from a debugger) together with the value of
+ *  trace_head_g, from which the records are put back in order. Records are
+ *  read in host byte order.
+ */
+int main(int argc, char **argv)
+{
+    uint32_t us_per_tick = 1000;
+    uint32_t head = 0;
+    int have_head = 0;
+    const char *out_path = NULL;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:o:u:")) != -1) {
+        switch (opt) {
+            case 'h':
+                head = (uint32_t)strtoul(optarg, NULL, 0);
+                have_head = 1;
+                break;
+            case 'o':
+                out_path = optarg;
+                break;
+            case 'u':
+                us_per_tick = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                optind = argc;
+                break;
+        }
+    }
+    if (optind != (argc - 1)) {
+        fprintf(stderr, "usage: %s [-h trace_head_g] [-u us per tick] "
+                "[-o output] dump\n", argv[0]);
+        return 2;
+    }
+
+    FILE *const in = fopen(argv[optind], "rb");
+    if (in == NULL) {
+        perror(argv[optind]);
+        return 1;
+    }
+    uint32_t length = 0, capacity = 0;
+    struct trace_record *records = NULL;
+    for (;;) {
+        if (length == capacity) {
+            capacity = (capacity == 0) ? TRACE_BUFFER_LENGTH : (capacity * 2);
+            struct trace_record *const grown = realloc(records,
+                                                capacity * sizeof(*records));
+            if (grown == NULL) {
+                fprintf(stderr, "out of memory\n");
+                fclose(in);
+                free(records);
+                return 1;
+            }
+            records = grown;
+        }
+        const size_t n = fread(&records[length], sizeof(*records),
+                               capacity - length, in);
+        length += (uint32_t)n;
+        if (n == 0) {
+            break;
+        }
+    }
+    const int read_error = ferror(in);
+    fclose(in);
+    if (read_error) {
+        perror(argv[optind]);
+        free(records);
+        return 1;
+    }
+
+    // A raw ring image is unrolled so that the oldest record comes first,
+    // slots which were never written are left out
+    struct trace_record *ordered = records;
+    uint32_t count = length;
+    if (have_head && (length != 0)) {
+        count = (head < length) ? head : length;
+        ordered = malloc(((count == 0) ? 1 : count) * sizeof(*ordered));
+        if (ordered == NULL) {
+            fprintf(stderr, "out of memory\n");
+            free(records);
+            return 1;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            ordered[i] = records[(head - count + i) % length];
+        }
+    }
+
+    FILE *const out = (out_path == NULL) ? stdout : fopen(out_path, "w");
+    int ret = 1;
+    if (out == NULL) {
+        perror(out_path);
+    } else if ((trace_export_chrome(out, ordered, count, us_per_tick) != 0) ||
+               ((out != stdout) && (fclose(out) != 0))) {
+        perror((out_path == NULL) ? "stdout" : out_path);
+    } else {
+        ret = 0;
+    }
+
+    if (ordered != records) {
+        free(ordered);
+    }
+    free(records);
+    return ret;
+}
+
+#endif
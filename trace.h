@@ -0,0 +1,123 @@
+/**
+ * @file trace.h
+ * @desc Low overhead binary event trace buffer
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef trace_h
+#define trace_h
+
+#include "test-global.h"
+
+/** Number of records in the trace ring, must be a power of two */
+#ifndef TRACE_BUFFER_LENGTH
+#define TRACE_BUFFER_LENGTH     256
+#endif
+
+/** Source of timestamps for trace records, can be redefined to a cycle
+    counter for finer resolution */
+#ifndef TRACE_TIMESTAMP
+#define TRACE_TIMESTAMP()       ((uint32_t)millis)
+#endif
+
+/** Kinds of trace events */
+enum trace_event_type {
+    /** Deployment service state changed, arg is the new state */
+    TRACE_DEPLOYMENT_STATE,
+    /** MS5611 driver state changed, arg is the new state */
+    TRACE_MS5611_STATE,
+    /** MPU9250 driver state changed, arg is the new state */
+    TRACE_MPU9250_STATE,
+    /** I2C transaction started, id is the device address, arg is the
+        priority class */
+    TRACE_I2C_START,
+    /** I2C transaction finished, id is the device address, arg is non-zero
+        on success */
+    TRACE_I2C_COMPLETE,
+    /** GPIO output changed, id is the pin, arg is the new value */
+    TRACE_GPIO
+};
+
+/** An 8 byte trace record */
+struct trace_record {
+    /** Value of TRACE_TIMESTAMP() when the event occurred */
+    uint32_t time;
+    /** Kind of event (enum trace_event_type) */
+    uint8_t type;
+    /** Event specific identifier (instance, address or pin) */
+    uint8_t id;
+    /** Event specific argument */
+    uint16_t arg;
+};
+
+#ifdef ENABLE_TRACE
+
+/** Trace ring */
+extern struct trace_record trace_buffer_g[TRACE_BUFFER_LENGTH];
+/** Total number of records ever written, the next record is written at this
+    index modulo TRACE_BUFFER_LENGTH */
+extern uint32_t trace_head_g;
+
+/**
+ *  Record a trace event. Safe to call from interrupts, the slot is claimed
+ *  with a single atomic increment and the oldest record is overwritten when
+ *  the ring is full.
+ *
+ *  @param type Kind of event
+ *  @param id Event specific identifier
+ *  @param arg Event specific argument
+ */
+static inline void trace_event(enum trace_event_type type, uint8_t id,
+                               uint16_t arg)
+{
+    const uint32_t i = __atomic_fetch_add(&trace_head_g, 1, __ATOMIC_RELAXED);
+    struct trace_record *const r = &trace_buffer_g[i &
+                                                   (TRACE_BUFFER_LENGTH - 1)];
+    r->time = TRACE_TIMESTAMP();
+    r->type = (uint8_t)type;
+    r->id = id;
+    r->arg = arg;
+}
+
+#define TRACE(type, id, arg) trace_event((type), (uint8_t)(id), (uint16_t)(arg))
+
+#else
+
+#define TRACE(type, id, arg) ((void)0)
+
+#endif
+
+/**
+ *  Copy the records currently in the trace ring out in order, oldest first.
+ *
+ *  @param dest Buffer for records
+ *  @param max Maximum number of records to copy
+ *
+ *  @return Number of records copied (always 0 if tracing is disabled)
+ */
+extern uint32_t trace_dump(struct trace_record *dest, uint32_t max);
+
+#ifdef TRACE_HOST_EXPORT
+#include <stdio.h>
+
+/**
+ *  Write dumped trace records as Chrome trace event JSON, which can be opened
+ *  in chrome://tracing or Perfetto. State changes become duration events
+ *  lasting until the next change of the same state machine, I2C transactions
+ *  become duration events and GPIO changes become counter tracks.
+ *
+ *  @param out File to write JSON to
+ *  @param records Records in order, oldest first
+ *  @param count Number of records
+ *  @param us_per_tick Number of microseconds per timestamp tick
+ *
+ *  @return 0 on success
+ */
+extern int trace_export_chrome(FILE *out, const struct trace_record *records,
+                               uint32_t count, uint32_t us_per_tick);
+#endif
+
+#endif /* trace_h */
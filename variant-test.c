@@ -11,36 +11,214 @@
 #include "ms5611-test.h"
 #include "mpu9250-test.h"
 #include "deployment.h"
+#include "timer-wheel.h"
+#include "sensor-align.h"
+#include "baro-vote.h"
+#include "sensor-bus.h"
+#include "trace.h"
+#include "telemetry-sched.h"
+#include "peer-link.h"
+#include "wcet.h"
+
+struct timer_wheel timer_wheel_g;
+struct variant_service_stats variant_service_stats_g;
 
 #ifdef ENABLE_ALTIMETER
-struct ms5611_desc_t altimeter_g;
+struct ms5611_desc_t altimeter_g[ALTIMETER_COUNT];
+struct sensor_bus_topic altimeter_topic_g[ALTIMETER_COUNT];
+static struct ms5611_sample altimeter_records[ALTIMETER_COUNT]
+                                             [ALTIMETER_TOPIC_DEPTH];
+static const uint8_t altimeter_csb[ALTIMETER_COUNT] = ALTIMETER_CSB;
+#ifdef ENABLE_ALTIMETER_VOTE
+struct baro_vote_desc_t altimeter_vote_g;
+struct sensor_bus_topic altimeter_vote_topic_g;
+static struct ms5611_sample altimeter_vote_records[ALTIMETER_TOPIC_DEPTH];
+/* Topic which altitude consumers subscribe to */
+#define ALTITUDE_TOPIC  (&altimeter_vote_topic_g)
+#else
+#define ALTITUDE_TOPIC  (&altimeter_topic_g[0])
+#endif
 #endif
 
 #ifdef ENABLE_IMU
 struct mpu9250_desc_t imu_g;
+struct sensor_bus_topic imu_topic_g;
+static struct mpu9250_sample imu_records[IMU_TOPIC_DEPTH];
 #endif
 
 #ifdef ENABLE_DEPLOYMENT_SERVICE
 struct deployment_service_desc_t deployment_g;
+/** Set once sensors have been switched to their recovery power mode */
+static uint8_t recovery_power_mode;
+#endif
+
+const struct deployment_pyro_event deployment_pyro_events_g[] =
+                                                        DEPLOYMENT_PYRO_EVENTS;
+const uint8_t deployment_num_pyro_events_g =
+        (uint8_t)(sizeof(deployment_pyro_events_g) /
+                  sizeof(deployment_pyro_events_g[0]));
+
+_Static_assert((sizeof(deployment_pyro_events_g) /
+                sizeof(deployment_pyro_events_g[0])) <=
+                    DEPLOYMENT_MAX_PYRO_EVENTS, "Too many pyro events");
+
+#ifdef ENABLE_PEER_LINK
+struct peer_link peer_link_g;
+#endif
+
+#ifdef ENABLE_TELEMETRY_SERVICE
+struct telemetry_sched telemetry_g;
+static const struct telemetry_rate telemetry_rates[][TELEMETRY_NUM_TYPES] =
+                                                            TELEMETRY_RATES;
+_Static_assert((sizeof(telemetry_rates) / sizeof(telemetry_rates[0])) ==
+                    DEPLOYMENT_NUM_STATES, "Missing telemetry rates");
+#endif
+
+#ifdef ENABLE_SENSOR_ALIGNMENT
+struct sensor_align_desc_t sensor_align_g;
+static struct sensor_bus_cursor align_baro_cursor;
+static struct sensor_bus_cursor align_imu_cursor;
 #endif
 
+#ifdef ENABLE_ALTIMETER
+#ifdef ENABLE_ALTIMETER_VOTE
+#define RAM_ALTIMETER   (sizeof(altimeter_g) + sizeof(altimeter_topic_g) + \
+                         sizeof(altimeter_records) + \
+                         sizeof(altimeter_vote_g) + \
+                         sizeof(altimeter_vote_topic_g) + \
+                         sizeof(altimeter_vote_records))
+#else
+#define RAM_ALTIMETER   (sizeof(altimeter_g) + sizeof(altimeter_topic_g) + \
+                         sizeof(altimeter_records))
+#endif
+#else
+#define RAM_ALTIMETER   0
+#endif
+#ifdef ENABLE_IMU
+#define RAM_IMU         (sizeof(imu_g) + sizeof(imu_topic_g) + \
+                         sizeof(imu_records))
+#else
+#define RAM_IMU         0
+#endif
+#ifdef ENABLE_DEPLOYMENT_SERVICE
+#define RAM_DEPLOYMENT  (sizeof(deployment_g) + sizeof(recovery_power_mode))
+#else
+#define RAM_DEPLOYMENT  0
+#endif
+#ifdef ENABLE_SENSOR_ALIGNMENT
+#define RAM_SENSOR_ALIGN    (sizeof(sensor_align_g) + \
+                             sizeof(align_baro_cursor) + \
+                             sizeof(align_imu_cursor))
+#else
+#define RAM_SENSOR_ALIGN    0
+#endif
+#ifdef ENABLE_TELEMETRY_SERVICE
+#define RAM_TELEMETRY   sizeof(telemetry_g)
+#else
+#define RAM_TELEMETRY   0
+#endif
+#ifdef ENABLE_PEER_LINK
+#define RAM_PEER_LINK   sizeof(peer_link_g)
+#else
+#define RAM_PEER_LINK   0
+#endif
+#ifdef ENABLE_TRACE
+#define RAM_TRACE       (sizeof(trace_buffer_g) + sizeof(trace_head_g))
+#else
+#define RAM_TRACE       0
+#endif
+#ifdef ENABLE_WCET
+#define RAM_WCET        (sizeof(wcet_ms5611_g) + sizeof(wcet_mpu9250_g) + \
+                         sizeof(wcet_deployment_g) + sizeof(wcet_loop_g))
+#else
+#define RAM_WCET        0
+#endif
+#define RAM_BUFFER_ARENA    (BUFFER_ARENA_NUM_BUFFERS * \
+                             BUFFER_ARENA_BUFFER_LENGTH)
+#define RAM_SCHEDULING  (sizeof(timer_wheel_g) + \
+                         sizeof(variant_service_stats_g))
+
+const struct variant_ram_report variant_ram_report_g = {
+    .buffer_arena = RAM_BUFFER_ARENA,
+    .altimeter = RAM_ALTIMETER,
+    .imu = RAM_IMU,
+    .deployment = RAM_DEPLOYMENT,
+    .sensor_align = RAM_SENSOR_ALIGN,
+    .telemetry = RAM_TELEMETRY,
+    .peer_link = RAM_PEER_LINK,
+    .trace = RAM_TRACE,
+    .wcet = RAM_WCET,
+    .scheduling = RAM_SCHEDULING,
+    .total = (RAM_BUFFER_ARENA + RAM_ALTIMETER + RAM_IMU + RAM_DEPLOYMENT +
+              RAM_SENSOR_ALIGN + RAM_TELEMETRY + RAM_PEER_LINK + RAM_TRACE +
+              RAM_WCET + RAM_SCHEDULING)
+};
+
 void init_variant(void)
 {
+    init_timer_wheel(&timer_wheel_g, (uint32_t)millis);
+#ifdef ENABLE_WCET
+    init_wcet(WCET_LOOP_BUDGET);
+#endif
+    variant_service_stats_g.window_start = (uint32_t)millis;
+    variant_service_stats_g.skipped = 0;
+    variant_service_stats_g.skipped_per_second = 0;
 
-    // Init Altimeter
+    // Init Altimeters
 #ifdef ENABLE_ALTIMETER
-    init_ms5611(&altimeter_g, ALTIMETER_CSB, ALTIMETER_PERIOD, 1);
-#ifdef ENABLE_TELEMETRY_SERVICE
-    telemetry_register_ms5611_alt(&telemetry_g, &altimeter_g);
+    for (uint8_t i = 0; i < ALTIMETER_COUNT; i++) {
+        init_ms5611(&altimeter_g[i], &timer_wheel_g, altimeter_csb[i],
+                    ALTIMETER_PERIOD, 1);
+        init_sensor_bus_topic(&altimeter_topic_g[i], altimeter_records[i],
+                              sizeof(altimeter_records[i][0]),
+                              ALTIMETER_TOPIC_DEPTH);
+        ms5611_set_topic(&altimeter_g[i], &altimeter_topic_g[i]);
+#ifdef ALTIMETER_FAST_ALTITUDE
+        ms5611_set_fast_altitude(&altimeter_g[i], 1);
+#endif
+        // Stagger the altimeters through the period so that their readings
+        // are interleaved
+        if (i != 0) {
+            ms5611_start_wait(&altimeter_g[i],
+                              (i * ALTIMETER_PERIOD) / ALTIMETER_COUNT);
+        }
+    }
+#ifdef ENABLE_ALTIMETER_VOTE
+    init_sensor_bus_topic(&altimeter_vote_topic_g, altimeter_vote_records,
+                          sizeof(altimeter_vote_records[0]),
+                          ALTIMETER_TOPIC_DEPTH);
+    init_baro_vote(&altimeter_vote_g, &altimeter_vote_topic_g,
+                   ALTIMETER_VOTE_MAX_AGE, ALTIMETER_VOTE_TOLERANCE);
+    for (uint8_t i = 0; i < ALTIMETER_COUNT; i++) {
+        baro_vote_add_sensor(&altimeter_vote_g, &altimeter_g[i]);
+    }
 #endif
 #endif
 
     // Init IMU
 #ifdef ENABLE_IMU
-    init_mpu9250(&imu_g, IMU_ADDR, IMU_INT_PIN, IMU_GYRO_FSR,
-                 IMU_GYRO_BW, IMU_ACCEL_FSR, IMU_ACCEL_BW, IMU_AG_SAMPLE_RATE,
-                 IMU_MAG_SAMPLE_RATE, IMU_USE_FIFO);
+    init_mpu9250(&imu_g, &timer_wheel_g, IMU_ADDR, IMU_INT_PIN,
+                 IMU_GYRO_FSR, IMU_GYRO_BW, IMU_ACCEL_FSR, IMU_ACCEL_BW,
+                 IMU_AG_SAMPLE_RATE, IMU_MAG_SAMPLE_RATE, IMU_USE_FIFO);
+    init_sensor_bus_topic(&imu_topic_g, imu_records, sizeof(imu_records[0]),
+                          IMU_TOPIC_DEPTH);
+    mpu9250_set_topic(&imu_g, &imu_topic_g);
+    mpu9250_request_fifo(&imu_g, IMU_USE_FIFO);
+#ifdef IMU_MAG_DECIMATE
+    mpu9250_set_mag_decimation(&imu_g, 1);
+#endif
+#endif
+    // Sensor alignment
+#ifdef ENABLE_SENSOR_ALIGNMENT
+#if !defined(ENABLE_ALTIMETER) || !defined(ENABLE_IMU)
+#error  Sensor alignment requires altimeter and IMU
 #endif
+    init_sensor_align(&sensor_align_g, SENSOR_ALIGN_PERIOD,
+                      SENSOR_ALIGN_BARO_OFFSET, SENSOR_ALIGN_IMU_OFFSET);
+    init_sensor_bus_cursor(&align_baro_cursor, ALTITUDE_TOPIC);
+    init_sensor_bus_cursor(&align_imu_cursor, &imu_topic_g);
+#endif
+
     // Deployment service
 #ifdef ENABLE_DEPLOYMENT_SERVICE
 #ifndef ENABLE_ALTIMETER
@@ -49,21 +227,175 @@ void init_variant(void)
 #ifndef ENABLE_IMU
 #error  Deployment service requires IMU
 #endif
-    init_deployment(&deployment_g, &altimeter_g, &imu_g);
+    init_deployment(&deployment_g, ALTITUDE_TOPIC, &imu_g);
+#endif
+
+    // Peer link
+#ifdef ENABLE_PEER_LINK
+#ifndef ENABLE_DEPLOYMENT_SERVICE
+#error  Peer link requires deployment service
+#endif
+    init_peer_link(&peer_link_g, PEER_LINK_BOARD, PEER_LINK_PERIOD,
+                   PEER_LINK_TIMEOUT);
+    deployment_set_peer(&deployment_g, &peer_link_g);
+#endif
+
+    // Telemetry
+#ifdef ENABLE_TELEMETRY_SERVICE
+#ifndef ENABLE_DEPLOYMENT_SERVICE
+#error  Telemetry service requires deployment service
+#endif
+    init_telemetry_sched(&telemetry_g, telemetry_rates, TELEMETRY_BUDGET,
+                         ALTITUDE_TOPIC, &imu_topic_g, &deployment_g,
+                         TELEMETRY_RADIO_SEND, TELEMETRY_RADIO_CONTEXT);
 #endif
 }
 
+static inline void update_service_stats(void)
+{
+    if (((uint32_t)millis - variant_service_stats_g.window_start) >= 1000) {
+        variant_service_stats_g.skipped_per_second =
+                                            variant_service_stats_g.skipped;
+        variant_service_stats_g.skipped = 0;
+        variant_service_stats_g.window_start = (uint32_t)millis;
+    }
+}
+
+#ifdef ENABLE_TRACE
+/** Driver states as of the last trace record, so that only changes are
+    recorded */
+static uint8_t trace_ms5611_state[ALTIMETER_COUNT] = {
+    [0 ... (ALTIMETER_COUNT - 1)] = 0xFF
+};
+static uint8_t trace_mpu9250_state = 0xFF;
+#endif
+
+#ifdef ENABLE_SENSOR_ALIGNMENT
+static inline void feed_sensor_align(void)
+{
+    const struct ms5611_sample *baro;
+    while ((baro = sensor_bus_peek(&align_baro_cursor)) != NULL) {
+        sensor_align_push_baro(&sensor_align_g, baro->time, baro->altitude);
+        sensor_bus_advance(&align_baro_cursor);
+    }
+
+    const struct mpu9250_sample *imu;
+    while ((imu = sensor_bus_peek(&align_imu_cursor)) != NULL) {
+        sensor_align_push_imu(&sensor_align_g, imu->time, imu->accel[0],
+                              imu->accel[1], imu->accel[2]);
+        sensor_bus_advance(&align_imu_cursor);
+    }
+}
+#endif
+
+#ifdef ENABLE_DEPLOYMENT_SERVICE
+/**
+ *  Reduce the sensors' duty cycle once the rocket has landed so that the
+ *  recovery beacon battery lasts longer. Only the altitude is still reported.
+ */
+static void enter_recovery_power_mode(void)
+{
+#ifdef ENABLE_ALTIMETER
+    for (uint8_t i = 0; i < ALTIMETER_COUNT; i++) {
+        ms5611_set_period(&altimeter_g[i], ALTIMETER_RECOVERY_PERIOD);
+    }
+#ifdef ENABLE_ALTIMETER_VOTE
+    baro_vote_set_max_age(&altimeter_vote_g, 2 * ALTIMETER_RECOVERY_PERIOD);
+#endif
+#endif
+#if defined(ENABLE_IMU) && defined(IMU_RECOVERY_LOW_POWER)
+    mpu9250_request_low_power(&imu_g, 1);
+#endif
+    recovery_power_mode = 1;
+}
+#endif
+
 void variant_service(void)
 {
+#ifdef ENABLE_DEPLOYMENT_SERVICE
+    WCET_BEGIN(loop, deployment_g.state);
+#else
+    WCET_BEGIN(loop, 0);
+#endif
+    timer_wheel_advance(&timer_wheel_g, (uint32_t)millis);
+    update_service_stats();
+
+    // Drivers which are waiting on a timer are only serviced once it fires
 #ifdef ENABLE_ALTIMETER
-    ms5611_service(&altimeter_g);
+    for (uint8_t i = 0; i < ALTIMETER_COUNT; i++) {
+        WCET_BEGIN(ms5611, altimeter_g[i].state);
+#ifdef ENABLE_DRIVER_WATCHDOG
+        ms5611_watchdog(&altimeter_g[i]);
+#endif
+        if (ms5611_waiting(&altimeter_g[i])) {
+            variant_service_stats_g.skipped++;
+        } else {
+            ms5611_service(&altimeter_g[i]);
+        }
+        WCET_END(&wcet_ms5611_g, ms5611, altimeter_g[i].state);
+#ifdef ENABLE_TRACE
+        if (altimeter_g[i].state != trace_ms5611_state[i]) {
+            trace_ms5611_state[i] = altimeter_g[i].state;
+            TRACE(TRACE_MS5611_STATE, i, trace_ms5611_state[i]);
+        }
+#endif
+    }
+#ifdef ENABLE_ALTIMETER_VOTE
+    baro_vote_service(&altimeter_vote_g);
+#endif
 #endif
 
 #ifdef ENABLE_IMU
-    mpu9250_service(&imu_g);
+    WCET_BEGIN(mpu9250, imu_g.state);
+#ifdef ENABLE_DRIVER_WATCHDOG
+    mpu9250_watchdog(&imu_g);
+#endif
+    if (mpu9250_waiting(&imu_g)) {
+        variant_service_stats_g.skipped++;
+    } else {
+        mpu9250_service(&imu_g);
+    }
+    WCET_END(&wcet_mpu9250_g, mpu9250, imu_g.state);
+#ifdef ENABLE_TRACE
+    if (imu_g.state != trace_mpu9250_state) {
+        trace_mpu9250_state = imu_g.state;
+        TRACE(TRACE_MPU9250_STATE, 0, trace_mpu9250_state);
+    }
+#endif
+#endif
+
+#ifdef ENABLE_SENSOR_ALIGNMENT
+    feed_sensor_align();
+#endif
+
+#ifdef ENABLE_PEER_LINK
+    peer_link_service(&peer_link_g);
 #endif
 
 #ifdef ENABLE_DEPLOYMENT_SERVICE
+    WCET_BEGIN(deployment, deployment_g.state);
     deployment_service(&deployment_g);
+    WCET_END(&wcet_deployment_g, deployment, deployment_g.state);
+    if (!recovery_power_mode && (deployment_get_state(&deployment_g) ==
+                                    DEPLOYMENT_STATE_RECOVERY)) {
+        enter_recovery_power_mode();
+    }
+#endif
+
+#ifdef ENABLE_PEER_LINK
+    struct peer_heartbeat heartbeat;
+    if (peer_link_heartbeat(&peer_link_g, &deployment_g, &heartbeat)) {
+        PEER_LINK_SEND(&heartbeat);
+    }
+#endif
+
+#ifdef ENABLE_TELEMETRY_SERVICE
+    telemetry_sched_service(&telemetry_g);
+#endif
+
+#ifdef ENABLE_DEPLOYMENT_SERVICE
+    WCET_END(&wcet_loop_g, loop, deployment_g.state);
+#else
+    WCET_END(&wcet_loop_g, loop, 0);
 #endif
 }
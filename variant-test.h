@@ -22,6 +22,10 @@
 #undef telemtry_h_skipped
 #endif
 #include "deployment.h"
+#include "sensor-align.h"
+#include "baro-vote.h"
+#include "telemetry-sched.h"
+#include "peer-link.h"
 
 /* String to identify this configuration */
 #define VARIANT_STRING "Rocket"
@@ -48,6 +52,14 @@
 //
 //
 
+/* These are the defaults for the deployment configuration record, which are
+   used when there is no valid record in non-volatile storage */
+
+/* Address of the deployment configuration record in flash, only the defaults
+   are used if not defined (host builds with DEPLOYMENT_CONFIG_HOST_FILE
+   defined read the record from a file instead) */
+//#define DEPLOYMENT_CONFIG_NVM_ADDRESS               0x0003F000
+
 /* Acceleration threashold to trigger transition into powered ascent state in
    g */
 #define DEPLOYMENT_POWERED_ASCENT_ACCEL_THREASHOLD  4
@@ -60,28 +72,188 @@
 /* Backup altitude threashold to trigger transition into coasting ascent state
    in meters */
 #define DEPLOYMENT_COASTING_ASCENT_ALT_THREASHOLD   2000
+/* Number of most recent IMU samples considered when detecting launch and
+   burnout (at most 32) */
+#define DEPLOYMENT_ACCEL_WINDOW_LENGTH              10
+/* Number of samples in the window which must be above the powered ascent
+   acceleration threashold to detect launch */
+#define DEPLOYMENT_LAUNCH_WINDOW_COUNT              6
+/* Number of samples in the window which must be at or below the coasting
+   ascent acceleration threashold to detect burnout */
+#define DEPLOYMENT_BURNOUT_WINDOW_COUNT             6
 /* Mininum altitude threashold for transition into coasting ascent state in
    meters */
 #define DEPLOYMENT_COASTING_ASCENT_ALT_MINIMUM      500
 /* Number of consecutive samples below the maximum altitude we have seen
    required to deploy drogue chute */
 #define DEPLOYMENT_DESCENDING_SAMPLE_THREASHOLD     5
-/* Amount of change in altitude required to indicate that we are still moving in
-   meters */
-#define DEPLOYMENT_LANDED_ALT_CHANGE                0.5f
-/* Number of consecutive samples of staying still required before we can be
-   sure that we have landed */
-#define DEPLOYMENT_LANDED_SAMPLE_THREASHOLD         100
+/* Length of each landing detection window in milliseconds, landing is detected
+   at the end of the first still window */
+#define DEPLOYMENT_LANDED_WINDOW                    2000
+/* Largest standard deviation of altitude over a window for the window to count
+   as still in meters (allows for wind gusts on the ground) */
+#define DEPLOYMENT_LANDED_ALT_STDDEV                1.5f
+/* Largest change in mean altitude between windows for the window to count as
+   still in meters per second */
+#define DEPLOYMENT_LANDED_VELOCITY                  1.0f
+/* Largest standard deviation of acceleration magnitude over a window for the
+   window to count as still in g */
+#define DEPLOYMENT_LANDED_ACCEL_STDDEV              0.1f
+/* Largest standard deviation of rotation rate magnitude over a window for the
+   window to count as still in degrees per second */
+#define DEPLOYMENT_LANDED_GYRO_STDDEV               5.0f
+
+/* Track attitude from every IMU sample so that deployment can check the tilt
+   from vertical, off by default since none of the variant's pyro events use
+   DEPLOYMENT_PYRO_UPRIGHT and each sample would cost about 50 multiplies and 2
+   square roots */
+//#define ENABLE_ATTITUDE
+/* Cosine of the largest tilt from vertical at which DEPLOYMENT_PYRO_UPRIGHT
+   is met (30 degrees) */
+#define DEPLOYMENT_UPRIGHT_COS_TILT                 0.866f
+
+/* Keep measuring the ground altitude and gyro bias while idle or armed on the
+   pad, the most recent values are kept when launch is detected */
+#define ENABLE_PAD_BASELINE
+/* Length of each baseline measurement window in milliseconds */
+#define DEPLOYMENT_BASELINE_WINDOW                  5000
+/* Largest standard deviation of altitude over a window for the window to be
+   used in meters */
+#define DEPLOYMENT_BASELINE_ALT_STDDEV              1.0f
+/* Largest standard deviation of each gyro axis over a window for the window
+   to be used in degrees per second */
+#define DEPLOYMENT_BASELINE_GYRO_STDDEV             0.5f
+
+/* States in which the IMU is switched to interrupt driven operation for the
+   lowest latency, the IMU uses FIFO driven operation in all other states.
+   Leave undefined to use IMU_USE_FIFO for the whole flight. */
+#define DEPLOYMENT_IMU_INTERRUPT_STATES \
+        (DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_ARMED) | \
+         DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_POWERED_ASCENT))
+
+/* Pyro events with altitude, descent or velocity conditions do not fire while
+   the most recent altimeter sample is older than this in milliseconds */
+#define DEPLOYMENT_BARO_MAX_AGE                     500
+/* Launch and burnout are only detected from altitude while the most recent IMU
+   sample is older than this in milliseconds */
+#define DEPLOYMENT_IMU_MAX_AGE                      500
 
 /* Length of time that current is applied to ematches in milliseconds */
 #define DEPLOYMENT_EMATCH_FIRE_DURATION             500
 
-/* The altitude at which the drogue parachute will be deployed*/
+/* The altitude at which the drogue parachute will be deployed in meters */
 #define DROGUE_DEPLOY_ALTITUDE                      1000
 
-/* The altitude at which the main parachute will be deployed*/
+/* The altitude at which the main parachute will be deployed in meters */
 #define MAIN_DEPLOY_ALTITUDE                        500
 
+/* Pyro events, see struct deployment_pyro_event. Events are evaluated in
+   table order and an event which changes state ends the pass, so events which
+   share a state should be listed with the state changing event last. Fields
+   which are not given default to no condition and DEPLOYMENT_PYRO_KEEP_STATE.
+   Altitude, velocity, delay and duration are defaults for the configuration
+   record, altitude and velocity are in millimeters (DEPLOYMENT_MM()).
+   Example of a backup drogue channel which fires two seconds after the
+   primary if descent is fast:
+    {
+        .states = (DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_DROGUE_DESCENT)),
+        .conditions = (DEPLOYMENT_PYRO_AFTER_EVENT |
+                       DEPLOYMENT_PYRO_BELOW_VELOCITY),
+        .ref_event = 0,
+        .delay = 2000,
+        .velocity = DEPLOYMENT_MM(-50),
+        .pin = BACKUP_DROGUE_EMATCH_PIN,
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION
+    } */
+#define DEPLOYMENT_PYRO_EVENTS { \
+    { \
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_COASTING_ASCENT), \
+        .conditions = (DEPLOYMENT_PYRO_BELOW_ALT | \
+                       DEPLOYMENT_PYRO_DESCENDING), \
+        .altitude = DEPLOYMENT_MM(DROGUE_DEPLOY_ALTITUDE), \
+        .pin = DROGUE_EMATCH_PIN, \
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION, \
+        .fire_state = DEPLOYMENT_STATE_DROGUE_DEPLOY, \
+        .done_state = DEPLOYMENT_STATE_DROGUE_DESCENT \
+    }, \
+    { \
+        .states = DEPLOYMENT_STATE_BIT(DEPLOYMENT_STATE_DROGUE_DESCENT), \
+        .conditions = (DEPLOYMENT_PYRO_BELOW_ALT | \
+                       DEPLOYMENT_PYRO_DESCENDING), \
+        .altitude = DEPLOYMENT_MM(MAIN_DEPLOY_ALTITUDE), \
+        .pin = MAIN_EMATCH_PIN, \
+        .duration = DEPLOYMENT_EMATCH_FIRE_DURATION, \
+        .fire_state = DEPLOYMENT_STATE_MAIN_DEPLOY, \
+        .done_state = DEPLOYMENT_STATE_MAIN_DESCENT \
+    } \
+}
+
+//
+//
+//  Memory
+//
+//
+
+/* Number of I2C/DMA transaction buffers shared between all drivers */
+#define BUFFER_ARENA_NUM_BUFFERS    2
+
+/** Static RAM used by each part of the variant in bytes, available from the
+    debugger or map file as variant_ram_report_g */
+struct variant_ram_report {
+    /** Transaction buffers */
+    uint32_t buffer_arena;
+    /** Altimeter drivers, their topics and the vote */
+    uint32_t altimeter;
+    /** IMU driver and its topic */
+    uint32_t imu;
+    uint32_t deployment;
+    /** Timestamp alignment stage and its cursors */
+    uint32_t sensor_align;
+    /** Telemetry scheduler */
+    uint32_t telemetry;
+    uint32_t peer_link;
+    /** Trace ring */
+    uint32_t trace;
+    /** Worst case execution time tables */
+    uint32_t wcet;
+    /** Timer wheel and service call statistics */
+    uint32_t scheduling;
+    uint32_t total;
+};
+extern const struct variant_ram_report variant_ram_report_g;
+
+//
+//
+//  Scheduling
+//
+//
+
+/* Restart drivers which stop producing samples (for example because an I2C
+   transaction never completed) if defined */
+#define ENABLE_DRIVER_WATCHDOG
+
+/* Clock frequency of the CPU in Hz */
+#define VARIANT_CPU_HZ              48000000UL
+/* Cycles available for one main loop iteration, measured against when
+   ENABLE_WCET is defined and the cycle counter counts CPU cycles (see
+   WCET_TARGET_CYCLES). The loop must fit within one IMU sample period. */
+#define WCET_LOOP_BUDGET            (VARIANT_CPU_HZ / IMU_AG_SAMPLE_RATE)
+
+/** Timer wheel with which drivers register their waits */
+extern struct timer_wheel timer_wheel_g;
+
+/** Statistics on service calls skipped because a driver was waiting on a
+    timer */
+struct variant_service_stats {
+    /** Start of the current one second window */
+    uint32_t window_start;
+    /** Service calls skipped in the current window */
+    uint32_t skipped;
+    /** Service calls skipped in the last complete one second window */
+    uint32_t skipped_per_second;
+};
+extern struct variant_service_stats variant_service_stats_g;
+
 //
 //
 //  Altimeter
@@ -90,11 +262,36 @@
 
 /* Altimeter enabled if defined */
 #define ENABLE_ALTIMETER
-/* Altimeter CSB setting */
-#define ALTIMETER_CSB 0
-/* Altimeter sample period in milliseconds */
+/* Number of altimeters (at most BARO_VOTE_MAX_SENSORS), if more than one their
+   readings are interleaved and fused with a median vote (with two, the one
+   which strays from the fused trend is left out) */
+#define ALTIMETER_COUNT 2
+/* Altimeter CSB settings, one per altimeter */
+#define ALTIMETER_CSB {0, 1}
+/* Sample period of each altimeter in milliseconds */
 #define ALTIMETER_PERIOD MS_TO_MILLIS(100)
-extern struct ms5611_desc_t altimeter_g;
+/* Sample period of each altimeter in the recovery state in milliseconds */
+#define ALTIMETER_RECOVERY_PERIOD MS_TO_MILLIS(1000)
+/* Calculate altitude using a lookup table instead of powf if defined, needed
+   for FIXED_POINT_ALTITUDE to avoid floating point math on each reading */
+#define ALTIMETER_FAST_ALTITUDE
+/* Number of readings buffered for altimeter subscribers (power of two) */
+#define ALTIMETER_TOPIC_DEPTH 8
+extern struct ms5611_desc_t altimeter_g[ALTIMETER_COUNT];
+extern struct sensor_bus_topic altimeter_topic_g[ALTIMETER_COUNT];
+
+#if ALTIMETER_COUNT > 1
+#define ENABLE_ALTIMETER_VOTE
+/* Readings older than this are left out of the vote in milliseconds */
+#define ALTIMETER_VOTE_MAX_AGE (2 * ALTIMETER_PERIOD)
+/* Altimeters further than this from the fused altitude are counted as
+   disagreeing, and with two altimeters one further than this from the
+   predicted altitude is left out of the vote */
+#define ALTIMETER_VOTE_TOLERANCE MS5611_ALT(10)
+extern struct baro_vote_desc_t altimeter_vote_g;
+/* Fused altimeter readings */
+extern struct sensor_bus_topic altimeter_vote_topic_g;
+#endif
 
 //
 //
@@ -114,11 +311,55 @@ extern struct ms5611_desc_t altimeter_g;
 #define IMU_ACCEL_FSR           MPU9250_ACCEL_FSR_16G
 #define IMU_ACCEL_BW            MPU9250_ACCEL_BW_45HZ
 #define IMU_AG_SAMPLE_RATE      100
-#define IMU_MAG_SAMPLE_RATE     AK8963_ODR_100HZ
+/* 8 Hz so that decimated magnetometer reads save bus traffic, at 100 Hz
+   they move more bytes than magnetometer data in every FIFO record */
+#define IMU_MAG_SAMPLE_RATE     AK8963_ODR_8HZ
 #define IMU_USE_FIFO            1
+/* Drop the IMU to its lowest sample rate and power down the magnetometer in
+   the recovery state if defined */
+#define IMU_RECOVERY_LOW_POWER
+/* Read magnetometer at its own ODR instead of in every FIFO record if
+   defined, ignored unless that saves bus traffic */
+#define IMU_MAG_DECIMATE
+/* Number of samples buffered for IMU subscribers (power of two), should hold
+   at least one full FIFO burst */
+#define IMU_TOPIC_DEPTH 64
 
 #ifdef ENABLE_IMU
 extern struct mpu9250_desc_t imu_g;
+extern struct sensor_bus_topic imu_topic_g;
+#endif
+
+//
+//
+//  Sensor alignment
+//
+//
+
+/* Barometer and IMU samples are resampled onto a common timeline if defined,
+   off by default since the deployment service does not read the aligned
+   samples yet (see sensor_align_read()), align-sim checks them against
+   replayed flights */
+//#define ENABLE_SENSOR_ALIGNMENT
+/* Period of the common timeline in milliseconds */
+#define SENSOR_ALIGN_PERIOD         10
+/* Correction added to barometer timestamps in milliseconds (timestamp is taken
+   when the pressure conversion starts, conversion takes about 9 ms). A vote of
+   staggered altimeters is stamped with its newest reading but follows the
+   middle one. */
+#ifdef ENABLE_ALTIMETER_VOTE
+#define SENSOR_ALIGN_BARO_OFFSET    (5 - (int16_t)(((ALTIMETER_COUNT - 1) * \
+                                            (ALTIMETER_PERIOD / \
+                                             ALTIMETER_COUNT)) / 2))
+#else
+#define SENSOR_ALIGN_BARO_OFFSET    5
+#endif
+/* Correction added to IMU timestamps in milliseconds (group delay of the 44.8
+   Hz accelerometer DLPF) */
+#define SENSOR_ALIGN_IMU_OFFSET     -5
+
+#ifdef ENABLE_SENSOR_ALIGNMENT
+extern struct sensor_align_desc_t sensor_align_g;
 #endif
 //
 //
@@ -132,4 +373,97 @@ extern struct mpu9250_desc_t imu_g;
 extern struct deployment_service_desc_t deployment_g;
 #endif
 
+/** Pyro event table built from DEPLOYMENT_PYRO_EVENTS */
+extern const struct deployment_pyro_event deployment_pyro_events_g[];
+/** Number of entries in deployment_pyro_events_g */
+extern const uint8_t deployment_num_pyro_events_g;
+
+//
+//
+//  Peer link
+//
+//
+
+/* Heartbeats are exchanged with the other flight computers on the rocket if
+   defined, so that pyro events can use DEPLOYMENT_PYRO_PEER_NOT_FIRED.
+   Requires PEER_LINK_SEND and a transport which passes heartbeats it receives
+   to peer_link_receive(&peer_link_g, ...) */
+//#define ENABLE_PEER_LINK
+/* Function which sends a heartbeat to the other boards, called as
+   PEER_LINK_SEND(const struct peer_heartbeat *heartbeat) */
+//#define PEER_LINK_SEND
+/* Number of this board, each board on the rocket must have its own */
+#define PEER_LINK_BOARD             0
+/* Time between heartbeats in milliseconds */
+#define PEER_LINK_PERIOD            MS_TO_MILLIS(100)
+/* A board which has not been heard from for this long is silent in
+   milliseconds */
+#define PEER_LINK_TIMEOUT           MS_TO_MILLIS(500)
+
+#ifdef ENABLE_PEER_LINK
+extern struct peer_link peer_link_g;
+#endif
+
+//
+//
+//  Telemetry
+//
+//
+
+/* Telemetry scheduler enabled if defined, requires TELEMETRY_RADIO_SEND */
+//#define ENABLE_TELEMETRY_SERVICE
+/* Function which hands frames to the radio (a telemetry_send_cb) */
+//#define TELEMETRY_RADIO_SEND
+/* Context for TELEMETRY_RADIO_SEND */
+#define TELEMETRY_RADIO_CONTEXT     NULL
+/* Bandwidth budget for telemetry in bytes per second, somewhat below the
+   radio's link rate (57600 baud) to leave room for retries */
+#define TELEMETRY_BUDGET            4800
+
+/* Period in milliseconds (0 for new samples or TELEMETRY_OFF), priority
+   (lower first) and whether samples are aggregated for each kind of frame in
+   each deployment state. On the pad status and slow housekeeping data, under
+   power the IMU at full rate to capture the boost, while coasting the
+   barometer to capture apogee, under canopy the barometer and status at a
+   lower rate and in recovery only status as a beacon. */
+#define TELEMETRY_RATE(p, pri, agg) \
+        { .period = (p), .priority = (pri), .aggregate = (agg) }
+#define TELEMETRY_PAD_RATES { \
+    [TELEMETRY_DEPLOYMENT] = TELEMETRY_RATE(1000, 0, 0), \
+    [TELEMETRY_BARO] = TELEMETRY_RATE(1000, 1, 1), \
+    [TELEMETRY_IMU] = TELEMETRY_RATE(1000, 2, 1) \
+}
+#define TELEMETRY_DESCENT_RATES { \
+    [TELEMETRY_BARO] = TELEMETRY_RATE(200, 0, 0), \
+    [TELEMETRY_DEPLOYMENT] = TELEMETRY_RATE(200, 1, 0), \
+    [TELEMETRY_IMU] = TELEMETRY_RATE(1000, 2, 1) \
+}
+#define TELEMETRY_RATES { \
+    [DEPLOYMENT_STATE_IDLE] = TELEMETRY_PAD_RATES, \
+    [DEPLOYMENT_STATE_ARMED] = TELEMETRY_PAD_RATES, \
+    [DEPLOYMENT_STATE_POWERED_ASCENT] = { \
+        [TELEMETRY_IMU] = TELEMETRY_RATE(0, 0, 0), \
+        [TELEMETRY_DEPLOYMENT] = TELEMETRY_RATE(100, 1, 0), \
+        [TELEMETRY_BARO] = TELEMETRY_RATE(100, 2, 0) \
+    }, \
+    [DEPLOYMENT_STATE_COASTING_ASCENT] = { \
+        [TELEMETRY_BARO] = TELEMETRY_RATE(0, 0, 0), \
+        [TELEMETRY_DEPLOYMENT] = TELEMETRY_RATE(100, 1, 0), \
+        [TELEMETRY_IMU] = TELEMETRY_RATE(50, 2, 1) \
+    }, \
+    [DEPLOYMENT_STATE_DROGUE_DEPLOY] = TELEMETRY_DESCENT_RATES, \
+    [DEPLOYMENT_STATE_DROGUE_DESCENT] = TELEMETRY_DESCENT_RATES, \
+    [DEPLOYMENT_STATE_MAIN_DEPLOY] = TELEMETRY_DESCENT_RATES, \
+    [DEPLOYMENT_STATE_MAIN_DESCENT] = TELEMETRY_DESCENT_RATES, \
+    [DEPLOYMENT_STATE_RECOVERY] = { \
+        [TELEMETRY_DEPLOYMENT] = TELEMETRY_RATE(2000, 0, 0), \
+        [TELEMETRY_BARO] = TELEMETRY_RATE(TELEMETRY_OFF, 1, 0), \
+        [TELEMETRY_IMU] = TELEMETRY_RATE(TELEMETRY_OFF, 2, 0) \
+    } \
+}
+
+#ifdef ENABLE_TELEMETRY_SERVICE
+extern struct telemetry_sched telemetry_g;
+#endif
+
 #endif /* variant_h */
@@ -0,0 +1,225 @@
+/**
+ * @file wcet-sim.c
+ * @desc Measures worst case execution times over simulated flights
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifdef WCET_SIM_MAIN
+
+#ifndef ENABLE_WCET
+#error wcet-sim must be built with ENABLE_WCET defined
+#endif
+#ifndef WCET_HOST_REPEAT
+#error wcet-sim must be built with WCET_HOST_REPEAT defined
+#endif
+
+#include "flight-sim.h"
+#include "host-sim.h"
+#include "wcet.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/*
+ *  Coverage: the bodies of ms5611_service() and mpu9250_service() are not part
+ *  of this tree, so the ms5611 and mpu9250 tables time the stand-ins in
+ *  flight_sim_replay_sink() which load the samples into the descriptors, plus
+ *  the real driver watchdogs. They are not the WCET of the driver state
+ *  machines, which is not covered here, and the states which the stand-ins
+ *  never visit are listed as never measured. The deployment and loop tables
+ *  time the real deployment service, every one of its states must be measured
+ *  for the run to pass.
+ *
+ *  Cycles are from the host's time stamp counter, which cannot be compared
+ *  with WCET_LOOP_BUDGET (target CPU cycles), so no budget is enforced unless
+ *  one in host cycles is given with -b.
+ */
+
+static int wcet_sim_compare(const void *a, const void *b)
+{
+    const struct wcet_transition *const x = a;
+    const struct wcet_transition *const y = b;
+    if (x->from != y->from) {
+        return (int)x->from - (int)y->from;
+    }
+    return (int)x->to - (int)y->to;
+}
+
+/**
+ *  Print the worst case for each state which was measured and for each
+ *  transition, and list the states up to num_states which never were.
+ *
+ *  @return Number of states up to num_states which were never measured
+ */
+static uint8_t wcet_sim_print(const char *name, struct wcet_table *table,
+                              uint8_t num_states)
+{
+    printf("%s:\n", name);
+    printf("  %5s %10s %10s\n", "state", "count", "max");
+    for (uint8_t s = 0; s < WCET_MAX_STATES; s++) {
+        if (table->state_count[s] == 0) {
+            continue;
+        }
+        printf("  %5u %10u %10u\n", (unsigned)s,
+               (unsigned)table->state_count[s], (unsigned)table->state_max[s]);
+    }
+
+    qsort(table->transitions, table->num_transitions,
+          sizeof(table->transitions[0]), wcet_sim_compare);
+    printf("  %12s %10s %10s\n", "transition", "count", "max");
+    for (uint16_t i = 0; i < table->num_transitions; i++) {
+        const struct wcet_transition *const t = &table->transitions[i];
+        if (t->from == t->to) {
+            continue;
+        }
+        printf("  %5u -> %-3u %10u %10u\n", (unsigned)t->from,
+               (unsigned)t->to, (unsigned)t->count, (unsigned)t->max);
+    }
+    if (table->dropped != 0) {
+        printf("  %u measurements of transitions which did not fit\n",
+               (unsigned)table->dropped);
+    }
+
+    uint8_t unmeasured = 0;
+    for (uint8_t s = 0; s < num_states; s++) {
+        if (table->state_count[s] != 0) {
+            continue;
+        }
+        printf("%s%u", (unmeasured == 0) ? "  never measured: " : " ",
+               (unsigned)s);
+        unmeasured++;
+    }
+    if (unmeasured != 0) {
+        printf("\n");
+    }
+    return unmeasured;
+}
+
+int main(int argc, char **argv)
+{
+    static struct flight_sim_board board;
+    struct flight_sim_config config = {
+        .thrust = 5000.0f, .burn_time = 2.5f, .dry_mass = 20.0f,
+        .propellant_mass = 5.0f, .cd_area = 0.008f, .drogue_rate = 25.0f,
+        .main_rate = 6.0f, .main_altitude = 450.0f,
+        .ground_pressure = 101325.0f, .pad_time = 10.0f, .baro_noise = 3.0f,
+        .baro_bias = 50.0f, .transonic_spike = 2000.0f,
+        .baro_glitch_rate = 0.001f, .baro_glitch = 5000.0f,
+        .accel_noise = 0.05f, .accel_bias = 0.05f, .gyro_noise = 0.1f,
+        .gyro_bias = 1.0f, .roll_rate = 60.0f, .temperature = 25.0f,
+        .accel_fsr = IMU_ACCEL_FSR, .gyro_fsr = IMU_GYRO_FSR,
+        .imu_odr = IMU_AG_SAMPLE_RATE, .baro_period = ALTIMETER_PERIOD,
+        .num_baro = ALTIMETER_COUNT
+    };
+    uint32_t flights = 20;
+    uint32_t budget = 0;
+    uint32_t seed = 1;
+    uint32_t repeats = 5;
+    float fault_rate = 0.02f;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "f:b:p:r:s:")) != -1) {
+        switch (opt) {
+            case 'f':
+                flights = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'b':
+                budget = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            case 'p':
+                fault_rate = strtof(optarg, NULL);
+                break;
+            case 'r':
+                repeats = (uint32_t)strtoul(optarg, NULL, 10);
+                repeats = (repeats == 0) ? 1 : repeats;
+                break;
+            case 's':
+                seed = (uint32_t)strtoul(optarg, NULL, 10);
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-f flights] "
+                        "[-b loop budget in host cycles] [-p fault rate] "
+                        "[-r repeats] [-s seed]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    // The flights are the same in every repeat, so each measurement is made
+    // repeats times and the second most cycles taken count (see struct
+    // wcet_repeat)
+    static struct wcet_repeat repeat;
+    for (uint32_t r = 0; r < repeats; r++) {
+        init_wcet(WCET_LOOP_BUDGET);
+        init_wcet_table(&wcet_loop_g, budget);
+        wcet_repeat_start(&repeat, r == 0);
+
+        for (uint32_t f = 0; f < flights; f++) {
+            struct flight_sim sim;
+            config.pad_time = 10.0f + (0.0137f * (float)f);
+            millis = 0;
+            if (init_flight_sim(&sim, &config, 1, seed + f) != 0) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            init_flight_sim_board(&board, &config);
+            board.replay.recovery_baro_period = ALTIMETER_RECOVERY_PERIOD;
+#ifdef IMU_RECOVERY_LOW_POWER
+            board.replay.recovery_imu_low_power = 1;
+#endif
+            // Every other flight has stuck reads, so that the watchdog restarts
+            // and the stale sensor paths are measured too
+            if ((f & 1) && (fault_rate > 0.0f)) {
+                flight_sim_replay_init_faults(&board.replay, fault_rate,
+                                              seed + f);
+            }
+
+            flight_sim_run(&sim, (uint32_t)((config.pad_time + 400.0f) * 1000),
+                           flight_sim_replay_sink, &board.replay);
+            flight_sim_free(&sim);
+        }
+    }
+    wcet_repeat_g = NULL;
+    free(repeat.cycles);
+
+    printf("%u flights, second most host cycles from WCET_CYCLES() over %u "
+           "repeats\n", (unsigned)flights, (unsigned)repeats);
+    printf("driver tables time the replay stand-ins, not the driver state "
+           "machines\n");
+    wcet_sim_print("ms5611", &wcet_ms5611_g, MS5611_FAILED + 1);
+    wcet_sim_print("mpu9250", &wcet_mpu9250_g,
+                   MPU9250_FAILED_MAG_SELF_TEST + 1);
+    const uint8_t unmeasured =
+            (wcet_sim_print("deployment", &wcet_deployment_g,
+                            DEPLOYMENT_NUM_STATES) +
+             wcet_sim_print("loop", &wcet_loop_g, DEPLOYMENT_NUM_STATES));
+
+    uint32_t worst = 0;
+    for (uint8_t s = 0; s < WCET_MAX_STATES; s++) {
+        worst = (wcet_loop_g.state_max[s] > worst) ? wcet_loop_g.state_max[s] :
+                                                     worst;
+    }
+    if (budget != 0) {
+        printf("loop budget %u host cycles, worst %u, %u overruns\n",
+               (unsigned)budget, (unsigned)worst,
+               (unsigned)wcet_loop_g.overruns);
+    } else {
+        printf("loop worst %u host cycles, WCET_LOOP_BUDGET (%u target "
+               "cycles) is only enforced on target\n", (unsigned)worst,
+               (unsigned)WCET_LOOP_BUDGET);
+    }
+    if (unmeasured != 0) {
+        fprintf(stderr, "deployment states were never measured\n");
+        return 1;
+    }
+    if (wcet_loop_g.overruns != 0) {
+        fprintf(stderr, "loop budget exceeded\n");
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,132 @@
+/**
+ * @file wcet.c
+ * @desc Measured worst case execution time per state machine state
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#include "wcet.h"
+
+#include <string.h>
+
+#ifdef WCET_HOST_REPEAT
+#include <stdlib.h>
+#endif
+
+#ifdef ENABLE_WCET
+struct wcet_table wcet_ms5611_g;
+struct wcet_table wcet_mpu9250_g;
+struct wcet_table wcet_deployment_g;
+struct wcet_table wcet_loop_g;
+#endif
+
+#ifdef WCET_HOST_REPEAT
+struct wcet_repeat *wcet_repeat_g;
+
+/**
+ *  Get the second most cycles taken by the current measurement in any run.
+ */
+static uint32_t wcet_repeat_filter(struct wcet_repeat *repeat, uint32_t cycles)
+{
+    if (repeat->first) {
+        if (repeat->index == repeat->length) {
+            const uint32_t length = (repeat->length == 0) ? 4096 :
+                                                        (repeat->length * 2);
+            uint32_t *const grown = realloc(repeat->cycles,
+                                            2 * length * sizeof(uint32_t));
+            if (grown == NULL) {
+                return cycles;
+            }
+            repeat->cycles = grown;
+            repeat->length = length;
+        }
+        uint32_t *const most = &repeat->cycles[2 * repeat->index++];
+        most[0] = cycles;
+        most[1] = 0;
+        return cycles;
+    }
+
+    // A run which did not repeat the first exactly is recorded as is
+    if (repeat->index >= repeat->length) {
+        return cycles;
+    }
+    uint32_t *const most = &repeat->cycles[2 * repeat->index++];
+    if (cycles > most[0]) {
+        most[1] = most[0];
+        most[0] = cycles;
+    } else if (cycles > most[1]) {
+        most[1] = cycles;
+    }
+    return most[1];
+}
+#endif
+
+void init_wcet_table(struct wcet_table *table, uint32_t budget)
+{
+    memset(table, 0, sizeof(*table));
+    table->budget = budget;
+}
+
+void wcet_record(struct wcet_table *table, uint8_t from, uint8_t to,
+                 uint32_t cycles)
+{
+#ifdef WCET_HOST_REPEAT
+    if (wcet_repeat_g != NULL) {
+        cycles = wcet_repeat_filter(wcet_repeat_g, cycles);
+    }
+#endif
+    if ((table->budget != 0) && (cycles > table->budget)) {
+        table->overruns++;
+    }
+
+    if (from < WCET_MAX_STATES) {
+        table->state_count[from]++;
+        if (cycles > table->state_max[from]) {
+            table->state_max[from] = cycles;
+        }
+    }
+
+    // Few distinct transitions are taken, a linear search is enough and keeps
+    // the table small
+    struct wcet_transition *t = table->transitions;
+    struct wcet_transition *const end = t + table->num_transitions;
+    while ((t != end) && ((t->from != from) || (t->to != to))) {
+        t++;
+    }
+    if (t == end) {
+        if (table->num_transitions >= WCET_MAX_TRANSITIONS) {
+            table->dropped++;
+            return;
+        }
+        t->from = from;
+        t->to = to;
+        t->max = 0;
+        t->count = 0;
+        table->num_transitions++;
+    }
+    t->count++;
+    if (cycles > t->max) {
+        t->max = cycles;
+    }
+}
+
+void init_wcet(uint32_t loop_budget)
+{
+#ifdef ENABLE_WCET
+    init_wcet_table(&wcet_ms5611_g, 0);
+    init_wcet_table(&wcet_mpu9250_g, 0);
+    init_wcet_table(&wcet_deployment_g, 0);
+#ifdef WCET_TARGET_CYCLES
+    init_wcet_table(&wcet_loop_g, loop_budget);
+#else
+    // Not the cycles that the budget is written in
+    (void)loop_budget;
+    init_wcet_table(&wcet_loop_g, 0);
+#endif
+    wcet_enable_counter();
+#else
+    (void)loop_budget;
+#endif
+}
@@ -0,0 +1,180 @@
+/**
+ * @file wcet.h
+ * @desc Measured worst case execution time per state machine state
+ * @author
+ * @date 2026-10-19
+ * Last Author:
+ * Last Edited On:
+ */
+
+#ifndef wcet_h
+#define wcet_h
+
+#include "test-global.h"
+
+/** Largest number of states in a measured state machine */
+#define WCET_MAX_STATES         64
+/** Largest number of distinct transitions recorded for a state machine */
+#ifndef WCET_MAX_TRANSITIONS
+#define WCET_MAX_TRANSITIONS    128
+#endif
+
+/** Source of cycle counts. Uses the time stamp counter on x86 hosts and the
+    DWT cycle counter on Cortex-M3/M4/M7 (see wcet_enable_counter()), can be
+    redefined for other targets. WCET_TARGET_CYCLES is defined when the counter
+    counts cycles of the CPU that budgets are written for, which should also be
+    done along with WCET_CYCLES() for another target whose counter runs at its
+    CPU clock. Budgets are only enforced then, host time stamp counter cycles
+    cannot be compared with them. */
+#ifndef WCET_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+#define WCET_CYCLES()   ((uint32_t)__builtin_ia32_rdtsc())
+#elif defined(__ARM_ARCH_7M__) || defined(__ARM_ARCH_7EM__)
+#define WCET_DWT_CTRL   (*(volatile uint32_t *)0xE0001000UL)
+#define WCET_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004UL)
+#define WCET_DEMCR      (*(volatile uint32_t *)0xE000EDFCUL)
+#define WCET_CYCLES()   (WCET_DWT_CYCCNT)
+#define WCET_TARGET_CYCLES
+#elif defined(ENABLE_WCET)
+#error No cycle counter for this target, define WCET_CYCLES()
+#endif
+#endif
+
+/** Most cycles and number of times for one transition */
+struct wcet_transition {
+    uint32_t max;
+    uint32_t count;
+    uint8_t from;
+    uint8_t to;
+};
+
+/**
+ *  Worst case execution times of one state machine. A measurement is keyed by
+ *  the state before the measured code ran and the state after, so both the
+ *  worst case for each state and for each transition out of it (including
+ *  returns from subsequences to a stored next state) are kept.
+ */
+struct wcet_table {
+    /** Most cycles taken in each state */
+    uint32_t state_max[WCET_MAX_STATES];
+    /** Number of measurements for each state */
+    uint32_t state_count[WCET_MAX_STATES];
+    struct wcet_transition transitions[WCET_MAX_TRANSITIONS];
+    uint16_t num_transitions;
+    /** Number of transitions which were not kept because the list was
+        full */
+    uint32_t dropped;
+
+    /** Measurements above this many cycles are counted as overruns (0 for
+        none) */
+    uint32_t budget;
+    uint32_t overruns;
+};
+
+#ifdef ENABLE_WCET
+/** Service calls for each MS5611 driver (watchdog and state machine) */
+extern struct wcet_table wcet_ms5611_g;
+/** Service calls for the MPU9250 driver (watchdog and state machine) */
+extern struct wcet_table wcet_mpu9250_g;
+/** Deployment service calls */
+extern struct wcet_table wcet_deployment_g;
+/** Whole main loop iterations, keyed by deployment state */
+extern struct wcet_table wcet_loop_g;
+
+/** Start measuring code which may change a state machine's state */
+#define WCET_BEGIN(name, state) \
+        const uint8_t name##_wcet_state = (uint8_t)(state); \
+        const uint32_t name##_wcet_start = WCET_CYCLES()
+/** Finish a measurement started with WCET_BEGIN() */
+#define WCET_END(table, name, state) \
+        wcet_record((table), name##_wcet_state, (uint8_t)(state), \
+                    WCET_CYCLES() - name##_wcet_start)
+#else
+#define WCET_BEGIN(name, state) ((void)0)
+#define WCET_END(table, name, state) ((void)0)
+#endif
+
+/**
+ *  Clear a table.
+ *
+ *  @param table The table
+ *  @param budget Cycles above which a measurement is an overrun, 0 for none
+ */
+extern void init_wcet_table(struct wcet_table *table, uint32_t budget);
+
+/**
+ *  Record a measurement.
+ *
+ *  @param table The table
+ *  @param from State before the measured code ran
+ *  @param to State after the measured code ran
+ *  @param cycles Cycles taken
+ */
+extern void wcet_record(struct wcet_table *table, uint8_t from, uint8_t to,
+                        uint32_t cycles);
+
+/**
+ *  Clear all of the global tables, the loop table gets the given budget if
+ *  WCET_TARGET_CYCLES is defined and none otherwise.
+ *
+ *  @param loop_budget Cycles available for one main loop iteration
+ */
+extern void init_wcet(uint32_t loop_budget);
+
+#ifdef WCET_HOST_REPEAT
+/**
+ *  Measurements of a deterministic run which is repeated. The two most cycles
+ *  taken by each measurement over all of the runs so far are kept, and the
+ *  second of them is what is recorded. The slowest path through the code is
+ *  taken in every run and stays in the worst cases, while preemption by the
+ *  host OS drops out as long as it does not hit the same measurement in more
+ *  than one run. Needs at least three runs, with one run each measurement is
+ *  recorded as is and with two the fewer cycles are.
+ */
+struct wcet_repeat {
+    /** Most and second most cycles for each measurement, in the order they
+        are made (measurement i at 2 * i and 2 * i + 1) */
+    uint32_t *cycles;
+    /** Number of measurements which cycles has room for */
+    uint32_t length;
+    /** Number of measurements made in this run so far */
+    uint32_t index;
+    /** Set during the first run, when measurements are added to cycles */
+    uint8_t first;
+};
+
+/** Repetition in progress, NULL if each measurement is recorded as is */
+extern struct wcet_repeat *wcet_repeat_g;
+
+/**
+ *  Start a run.
+ *
+ *  @param repeat The repetition
+ *  @param first Non-zero for the first run
+ */
+static inline void wcet_repeat_start(struct wcet_repeat *repeat, int first)
+{
+    repeat->index = 0;
+    repeat->first = (first != 0);
+    wcet_repeat_g = repeat;
+}
+#endif
+
+#if defined(WCET_DWT_CTRL)
+/**
+ *  Start the DWT cycle counter, must be called before measuring.
+ */
+static inline void wcet_enable_counter(void)
+{
+    // TRCENA, then CYCCNTENA
+    WCET_DEMCR |= (1UL << 24);
+    WCET_DWT_CYCCNT = 0;
+    WCET_DWT_CTRL |= 1UL;
+}
+#else
+static inline void wcet_enable_counter(void)
+{
+}
+#endif
+
+#endif /* wcet_h */